@@ -0,0 +1,44 @@
+#ifndef HEADER_GE_CULLING_BOXES_HPP
+#define HEADER_GE_CULLING_BOXES_HPP
+
+#include "aabbox3d.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace GE
+{
+/** Bounding boxes stored as structure of arrays, so that many of them are
+ *  tested against frustums at once with SIMD. The arrays are padded to a
+ *  multiple of 4 boxes and keep their memory when cleared. */
+class GECullingBoxes
+{
+private:
+    std::vector<float> m_min_x, m_min_y, m_min_z;
+
+    std::vector<float> m_max_x, m_max_y, m_max_z;
+
+    unsigned m_size;
+
+    // ------------------------------------------------------------------------
+    void cullScalar(const float* frustums, unsigned frustum_count,
+                    std::vector<uint8_t>* culled) const;
+public:
+    // ------------------------------------------------------------------------
+    GECullingBoxes() : m_size(0) {}
+    // ------------------------------------------------------------------------
+    void clear();
+    // ------------------------------------------------------------------------
+    void add(const irr::core::aabbox3df& bb);
+    // ------------------------------------------------------------------------
+    unsigned size() const                                   { return m_size; }
+    // ------------------------------------------------------------------------
+    void cull(const float* frustums, unsigned frustum_count,
+              std::vector<uint8_t>* culled) const;
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // GECullingBoxes
+
+}
+
+#endif
@@ -0,0 +1,244 @@
+#include "ge_culling_boxes.hpp"
+
+#include <simd_wrapper.h>
+
+#include <algorithm>
+#include <cassert>
+#include <random>
+
+namespace GE
+{
+// ----------------------------------------------------------------------------
+void GECullingBoxes::clear()
+{
+    m_min_x.clear();
+    m_min_y.clear();
+    m_min_z.clear();
+    m_max_x.clear();
+    m_max_y.clear();
+    m_max_z.clear();
+    m_size = 0;
+}   // clear
+
+// ----------------------------------------------------------------------------
+void GECullingBoxes::add(const irr::core::aabbox3df& bb)
+{
+    if (m_size % 4 == 0)
+    {
+        // Start a new group of 4 boxes, results of unused ones are ignored
+        m_min_x.resize(m_size + 4, 0.0f);
+        m_min_y.resize(m_size + 4, 0.0f);
+        m_min_z.resize(m_size + 4, 0.0f);
+        m_max_x.resize(m_size + 4, 0.0f);
+        m_max_y.resize(m_size + 4, 0.0f);
+        m_max_z.resize(m_size + 4, 0.0f);
+    }
+    m_min_x[m_size] = bb.MinEdge.X;
+    m_min_y[m_size] = bb.MinEdge.Y;
+    m_min_z[m_size] = bb.MinEdge.Z;
+    m_max_x[m_size] = bb.MaxEdge.X;
+    m_max_y[m_size] = bb.MaxEdge.Y;
+    m_max_z[m_size] = bb.MaxEdge.Z;
+    m_size++;
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Tests all boxes against frustums of 6 planes each (24 floats per frustum,
+ *  as written by mathPlaneFrustumf). A box is outside a frustum if all its
+ *  corners are behind one of the planes, which is the case if the corner
+ *  furthest along the plane normal is behind it.
+ *  \param culled Set to a bit mask for each box, with bit n set if the box
+ *         is outside frustum n. It can be larger than size().
+ */
+void GECullingBoxes::cull(const float* frustums, unsigned frustum_count,
+                          std::vector<uint8_t>* culled) const
+{
+#ifdef CPU_SSE_SUPPORT
+    assert(frustum_count <= 8);
+    const unsigned count = (unsigned)m_min_x.size();
+    culled->assign(count, 0);
+    for (unsigned f = 0; f < frustum_count; f++)
+    {
+        const float* planes = frustums + f * 24;
+        const uint8_t bit = (uint8_t)(1 << f);
+        __m128 plane[24];
+        for (unsigned i = 0; i < 24; i++)
+            plane[i] = _mm_set1_ps(planes[i]);
+        const __m128 zero = _mm_setzero_ps();
+        for (unsigned i = 0; i < count; i += 4)
+        {
+            const __m128 min_x = _mm_loadu_ps(&m_min_x[i]);
+            const __m128 min_y = _mm_loadu_ps(&m_min_y[i]);
+            const __m128 min_z = _mm_loadu_ps(&m_min_z[i]);
+            const __m128 max_x = _mm_loadu_ps(&m_max_x[i]);
+            const __m128 max_y = _mm_loadu_ps(&m_max_y[i]);
+            const __m128 max_z = _mm_loadu_ps(&m_max_z[i]);
+            __m128 outside = zero;
+            for (unsigned p = 0; p < 24; p += 4)
+            {
+                __m128 dist = _mm_max_ps(_mm_mul_ps(min_x, plane[p]),
+                    _mm_mul_ps(max_x, plane[p]));
+                dist = _mm_add_ps(dist, _mm_max_ps(
+                    _mm_mul_ps(min_y, plane[p + 1]),
+                    _mm_mul_ps(max_y, plane[p + 1])));
+                dist = _mm_add_ps(dist, _mm_max_ps(
+                    _mm_mul_ps(min_z, plane[p + 2]),
+                    _mm_mul_ps(max_z, plane[p + 2])));
+                dist = _mm_add_ps(dist, plane[p + 3]);
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, zero));
+            }
+            const int mask = _mm_movemask_ps(outside);
+            for (unsigned j = 0; j < 4; j++)
+            {
+                if ((mask >> j) & 1)
+                    (*culled)[i + j] |= bit;
+            }
+        }
+    }
+#else
+    cullScalar(frustums, frustum_count, culled);
+#endif
+}   // cull
+
+// ----------------------------------------------------------------------------
+/** Same as cull without SIMD, used when SSE is not available. */
+void GECullingBoxes::cullScalar(const float* frustums, unsigned frustum_count,
+                                std::vector<uint8_t>* culled) const
+{
+    assert(frustum_count <= 8);
+    const unsigned count = (unsigned)m_min_x.size();
+    culled->assign(count, 0);
+    for (unsigned f = 0; f < frustum_count; f++)
+    {
+        const float* planes = frustums + f * 24;
+        const uint8_t bit = (uint8_t)(1 << f);
+        for (unsigned i = 0; i < count; i++)
+        {
+            for (unsigned p = 0; p < 24; p += 4)
+            {
+                const float dist =
+                    std::max(m_min_x[i] * planes[p],
+                    m_max_x[i] * planes[p]) +
+                    std::max(m_min_y[i] * planes[p + 1],
+                    m_max_y[i] * planes[p + 1]) +
+                    std::max(m_min_z[i] * planes[p + 2],
+                    m_max_z[i] * planes[p + 2]) + planes[p + 3];
+                if (dist < 0.0f)
+                {
+                    (*culled)[i] |= bit;
+                    break;
+                }
+            }
+        }
+    }
+}   // cullScalar
+
+// ----------------------------------------------------------------------------
+/** Returns if all 8 corners of a box are behind one of the 6 planes, which
+ *  is how boxes were culled one by one before. */
+static bool isOutside(const irr::core::aabbox3df& bb, const float* planes)
+{
+    for (unsigned p = 0; p < 24; p += 4)
+    {
+        bool outside = true;
+        for (unsigned c = 0; c < 8 && outside; c++)
+        {
+            const float x = (c & 1) ? bb.MaxEdge.X : bb.MinEdge.X;
+            const float y = (c & 2) ? bb.MaxEdge.Y : bb.MinEdge.Y;
+            const float z = (c & 4) ? bb.MaxEdge.Z : bb.MinEdge.Z;
+            if (x * planes[p] + y * planes[p + 1] + z * planes[p + 2] +
+                planes[p + 3] >= 0.0f)
+                outside = false;
+        }
+        if (outside)
+            return true;
+    }
+    return false;
+}   // isOutside
+
+// ----------------------------------------------------------------------------
+/** Compares the SIMD and scalar culling with testing the corners of each
+ *  box, for random boxes against the planes of a camera bounding box (as in
+ *  GECullingTool::init) and random frustums. Box counts which are not a
+ *  multiple of 4 test the padding.
+ */
+void GECullingBoxes::unitTesting()
+{
+    using namespace irr::core;
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> extent(0.0f, 30.0f);
+    std::uniform_real_distribution<float> normal(-1.0f, 1.0f);
+
+    GECullingBoxes boxes;
+    std::vector<aabbox3df> bbs;
+    std::vector<uint8_t> culled, culled_scalar;
+    const unsigned counts[] = { 1, 3, 4, 5, 8, 13, 64, 127 };
+    for (unsigned count : counts)
+    {
+        for (unsigned run = 0; run < 20; run++)
+        {
+            // The camera bounding box and two frustums
+            float planes[72];
+            vector3df cam_min(position(random), position(random),
+                position(random));
+            vector3df cam_max = cam_min + vector3df(extent(random),
+                extent(random), extent(random)) * 3.0f;
+            const float bbox_planes[24] =
+            {
+                 1.0f,  0.0f,  0.0f, -cam_min.X,
+                -1.0f,  0.0f,  0.0f,  cam_max.X,
+                 0.0f,  1.0f,  0.0f, -cam_min.Y,
+                 0.0f, -1.0f,  0.0f,  cam_max.Y,
+                 0.0f,  0.0f,  1.0f, -cam_min.Z,
+                 0.0f,  0.0f, -1.0f,  cam_max.Z
+            };
+            std::copy(bbox_planes, bbox_planes + 24, planes);
+            for (unsigned i = 24; i < 72; i += 4)
+            {
+                planes[i] = normal(random);
+                planes[i + 1] = normal(random);
+                planes[i + 2] = normal(random);
+                planes[i + 3] = position(random);
+            }
+
+            // Reused like in GECullingTool, so the padding of the previous
+            // boxes must not matter
+            boxes.clear();
+            bbs.clear();
+            for (unsigned i = 0; i < count; i++)
+            {
+                vector3df min(position(random), position(random),
+                    position(random));
+                vector3df max = min + vector3df(extent(random),
+                    extent(random), extent(random));
+                bbs.emplace_back(min, max);
+            }
+            // A box touching a face of the camera bounding box is not culled
+            bbs[0] = aabbox3df(vector3df(cam_max.X, cam_min.Y, cam_min.Z),
+                vector3df(cam_max.X + 1.0f, cam_max.Y, cam_max.Z));
+            for (const aabbox3df& bb : bbs)
+                boxes.add(bb);
+            assert(boxes.size() == count);
+
+            boxes.cull(planes, 3, &culled);
+            boxes.cullScalar(planes, 3, &culled_scalar);
+            assert(culled.size() >= count && culled.size() % 4 == 0);
+            assert(culled_scalar.size() == culled.size());
+            for (unsigned i = 0; i < count; i++)
+            {
+                uint8_t expected = 0;
+                for (unsigned f = 0; f < 3; f++)
+                {
+                    if (isOutside(bbs[i], planes + f * 24))
+                        expected |= (uint8_t)(1 << f);
+                }
+                assert(culled[i] == expected);
+                assert(culled_scalar[i] == expected);
+            }
+            assert((culled[0] & 1) == 0);
+        }
+    }
+}   // unitTesting
+
+}
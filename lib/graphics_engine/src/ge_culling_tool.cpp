@@ -4,8 +4,11 @@
 #include "ge_spm_buffer.hpp"
 #include "ge_vulkan_camera_scene_node.hpp"
 
+#include "IMesh.h"
 #include "ISceneNode.h"
 
+#include <cstring>
+
 namespace GE
 {
 // ----------------------------------------------------------------------------
@@ -13,6 +16,22 @@ void GECullingTool::init(GEVulkanCameraSceneNode* cam)
 {
     mathPlaneFrustumf(&m_frustum[0].X, cam->getPVM());
     m_cam_bbox = cam->getViewFrustum()->getBoundingBox();
+
+    // A box doesn't intersect the camera bounding box if it's behind one of
+    // its faces
+    const irr::core::vector3df& min = m_cam_bbox.MinEdge;
+    const irr::core::vector3df& max = m_cam_bbox.MaxEdge;
+    const float bbox_planes[24] =
+    {
+         1.0f,  0.0f,  0.0f, -min.X,
+        -1.0f,  0.0f,  0.0f,  max.X,
+         0.0f,  1.0f,  0.0f, -min.Y,
+         0.0f, -1.0f,  0.0f,  max.Y,
+         0.0f,  0.0f,  1.0f, -min.Z,
+         0.0f,  0.0f, -1.0f,  max.Z
+    };
+    memcpy(m_planes, bbox_planes, sizeof(bbox_planes));
+    memcpy(m_planes + 24, &m_frustum[0].X, 24 * sizeof(float));
 }   // init
 
 // ----------------------------------------------------------------------------
@@ -60,4 +79,22 @@ bool GECullingTool::isCulled(GESPMBuffer* buffer, irr::scene::ISceneNode* node)
     return isCulled(bb);
 }   // isCulled
 
+// ----------------------------------------------------------------------------
+/** Tests all mesh buffers of a mesh at once, use isMeshBufferCulled to get
+ *  the result of each.
+ */
+void GECullingTool::cullMeshBuffers(irr::scene::IMesh* mesh,
+                                    irr::scene::ISceneNode* node)
+{
+    m_boxes.clear();
+    const irr::core::matrix4& transform = node->getAbsoluteTransformation();
+    for (unsigned i = 0; i < mesh->getMeshBufferCount(); i++)
+    {
+        irr::core::aabbox3df bb = mesh->getMeshBuffer(i)->getBoundingBox();
+        transform.transformBoxEx(bb);
+        m_boxes.add(bb);
+    }
+    m_boxes.cull(m_planes, 2, &m_culled);
+}   // cullMeshBuffers
+
 }
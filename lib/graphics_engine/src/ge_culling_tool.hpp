@@ -1,13 +1,15 @@
 #ifndef HEADER_GE_CULLING_TOOL_HPP
 #define HEADER_GE_CULLING_TOOL_HPP
 
+#include "ge_culling_boxes.hpp"
+
 #include "aabbox3d.h"
 #include "quaternion.h"
 #include "matrix4.h"
 
 namespace irr
 {
-    namespace scene { class ISceneNode; }
+    namespace scene { class IMesh; class ISceneNode; }
 }
 
 namespace GE
@@ -21,6 +23,14 @@ private:
     irr::core::quaternion m_frustum[6];
 
     irr::core::aabbox3df m_cam_bbox;
+
+    /** The camera bounding box as 6 planes followed by m_frustum, for
+     *  GECullingBoxes::cull. */
+    float m_planes[48];
+
+    GECullingBoxes m_boxes;
+
+    std::vector<uint8_t> m_culled;
 public:
     // ------------------------------------------------------------------------
     void init(GEVulkanCameraSceneNode* cam);
@@ -28,6 +38,12 @@ public:
     bool isCulled(irr::core::aabbox3df& bb);
     // ------------------------------------------------------------------------
     bool isCulled(GESPMBuffer* buffer, irr::scene::ISceneNode* node);
+    // ------------------------------------------------------------------------
+    void cullMeshBuffers(irr::scene::IMesh* mesh,
+                         irr::scene::ISceneNode* node);
+    // ------------------------------------------------------------------------
+    /** Returns if a mesh buffer is culled after cullMeshBuffers. */
+    bool isMeshBufferCulled(unsigned i) const      { return m_culled[i] != 0; }
 };   // GECullingTool
 
 }
@@ -240,11 +240,12 @@ void GEVulkanDrawCall::addNode(irr::scene::ISceneNode* node)
         return;
 
     bool added_skinning = false;
+    m_culling_tool->cullMeshBuffers(mesh, node);
     for (unsigned i = 0; i < mesh->getMeshBufferCount(); i++)
     {
         GESPMBuffer* buffer = static_cast<GESPMBuffer*>(
             mesh->getMeshBuffer(i));
-        if (m_culling_tool->isCulled(buffer, node))
+        if (m_culling_tool->isMeshBufferCulled(i))
             continue;
         const std::string& shader = getShader(node, i);
         if (buffer->getHardwareMappingHint_Vertex() == irr::scene::EHM_STREAM ||
@@ -654,6 +654,7 @@ UserConfig::UserConfig()
 {
     m_filename = "config.xml";
     m_warning  = "";
+    m_save_enabled = true;
     //m_blacklist_res.clear();
 
 }   // UserConfig
@@ -728,6 +729,8 @@ bool UserConfig::loadConfig()
 /** Write settings to config file. */
 void UserConfig::saveConfig()
 {
+    if (!m_save_enabled)
+        return;
     const std::string filename = file_manager->getUserConfigFile(m_filename);
     std::stringstream ss;
     ss << "<?xml version=\"1.0\"?>\n";
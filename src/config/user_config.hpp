@@ -1430,6 +1430,10 @@ private:
     std::string        m_filename;
     irr::core::stringw m_warning;
 
+    /** False in processes which must not write the user config file, like
+     *  forked server rooms. */
+    bool               m_save_enabled;
+
     static const int m_current_config_version;
 
 public:
@@ -1440,6 +1444,7 @@ public:
 
     bool  loadConfig();
     void  saveConfig();
+    void  disableSaving()                            { m_save_enabled = false; }
 
     const irr::core::stringw& getWarning()        { return m_warning;  }
     void  resetWarning()                          { m_warning="";      }
@@ -58,8 +58,8 @@ void FixedPipelineRenderer::render(float dt, bool is_loading)
 
         std::ostringstream oss;
         oss << "drawAll() for kart " << i;
-        PROFILER_PUSH_CPU_MARKER(oss.str().c_str(), (i+1)*60,
-                                 0x00, 0x00);
+        PROFILER_PUSH_CPU_MARKER_DYNAMIC(oss.str().c_str(), (i+1)*60,
+                                         0x00, 0x00);
         camera->activate();
         rg->preRenderCallback(camera);   // adjusts start referee
 
@@ -91,7 +91,8 @@ void FixedPipelineRenderer::render(float dt, bool is_loading)
         std::ostringstream oss;
         oss << "renderPlayerView() for kart " << i;
 
-        PROFILER_PUSH_CPU_MARKER(oss.str().c_str(), 0x00, 0x00, (i+1)*60);
+        PROFILER_PUSH_CPU_MARKER_DYNAMIC(oss.str().c_str(), 0x00, 0x00,
+                                         (i+1)*60);
         rg->renderPlayerView(camera, dt);
         PROFILER_POP_CPU_MARKER();
 
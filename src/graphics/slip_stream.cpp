@@ -44,6 +44,8 @@
 #include <SMeshBuffer.h>
 #include <SMesh.h>
 
+#include <algorithm>
+
 #ifndef SERVER_ONLY
 #include <ge_main.hpp>
 #include <ge_render_info.hpp>
@@ -918,15 +920,38 @@ void SlipStream::update(int ticks)
     bool is_inner_sstreaming = false;
     bool is_outer_sstreaming = false;
     m_target_kart            = NULL;
-    std::vector<float> target_value;
+    std::vector<float> target_value(num_karts, 0.0f);
 
     // Note that this loop can not be simply replaced with a shorter loop
     // using only the karts with a better position - since a kart might
-    // be a lap behind
-    for(unsigned int i=0; i<num_karts; i++)
+    // be a lap behind. Instead only the karts close enough to pass the
+    // quick distance test below are tested (plus the previous target, so
+    // that it's reset the same way). All karts are tested when debugging
+    // to set the debug colors of all of them.
+    std::vector<unsigned int> karts;
+    const KartProximityIndex& index = world->getKartProximityIndex();
+    if (UserConfigParams::m_slipstream_debug || !index.isValid(num_karts))
+    {
+        for (unsigned int i = 0; i < num_karts; i++)
+            karts.push_back(i);
+    }
+    else
+    {
+        index.getKartsInRange(m_kart->getXYZ(),
+            index.getMaxSlipstreamLength() + 0.5f*m_kart->getKartLength(),
+            &karts);
+        if (m_previous_target_id >= 0 &&
+            !std::binary_search(karts.begin(), karts.end(),
+                                (unsigned int)m_previous_target_id))
+        {
+            karts.insert(std::lower_bound(karts.begin(), karts.end(),
+                (unsigned int)m_previous_target_id), m_previous_target_id);
+        }
+    }
+
+    for(unsigned int i : karts)
     {
         m_target_kart= world->getKart(i);
-        target_value.push_back(0);
 
         // Don't test for slipstream with itself, a kart that is being
         // rescued or exploding, a ghost kart or an eliminated kart
@@ -1022,7 +1047,11 @@ void SlipStream::update(int ticks)
             is_outer_sstreaming     = true;
             continue;
         }
-    }   // for i < num_karts
+    }   // for i in karts
+
+    // The loop used to leave the last kart as target if none is found
+    if (num_karts > 0)
+        m_target_kart = world->getKart(num_karts - 1);
 
     int best_target=-1;
     float best_target_value=0.0f;
@@ -54,9 +54,9 @@
 #include <cassert>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
+#include <ge_culling_boxes.hpp>
 #include <ge_main.hpp>
 
 #include <IrrlichtDevice.h>
@@ -83,20 +83,48 @@ SPShader* g_normal_visualizer = NULL;
 // ----------------------------------------------------------------------------
 SPShader* g_glow_shader = NULL;
 // ----------------------------------------------------------------------------
-// std::string is layer_1 and layer_2 texture name combined
-typedef std::unordered_map<SPShader*, std::unordered_map<std::string,
-    std::unordered_set<SPMeshBuffer*> > > DrawCall;
-
-DrawCall g_draw_calls[DCT_FOR_VAO];
+// Layer_1 and layer_2 texture name combined to the id used in draw calls,
+// 0 is for sampler-less shaders
+std::unordered_map<std::string, unsigned> g_texture_compare_ids;
+// ----------------------------------------------------------------------------
+/** A mesh buffer drawn with a shader and texture in this frame. The arrays
+ *  below are only cleared each frame, so their memory is reused. */
+struct DrawCall
+{
+    SPShader* m_shader;
+    unsigned m_texture_id;
+    int m_material_id;
+    SPMeshBuffer* m_mb;
+};
+// Sorted by shader drawing priority, shader and texture in updateModelMatrix
+std::vector<DrawCall> g_draw_calls[DCT_FOR_VAO];
 // ----------------------------------------------------------------------------
-std::vector<std::pair<SPShader*, std::vector<std::pair<std::array<GLuint, 6>,
-    std::vector<std::pair<SPMeshBuffer*, int/*material_id*/> > > > > >
-    g_final_draw_calls[DCT_FOR_VAO];
+/** Range of g_draw_calls which uses the same shader and textures. */
+struct TextureDrawCall
+{
+    std::array<GLuint, 6> m_textures;
+    unsigned m_first, m_end;
+};
+std::vector<TextureDrawCall> g_texture_draw_calls[DCT_FOR_VAO];
 // ----------------------------------------------------------------------------
-std::unordered_map<unsigned, std::pair<core::vector3df,
-    std::unordered_set<SPMeshBuffer*> > > g_glow_meshes;
+/** Range of g_texture_draw_calls which uses the same shader. */
+struct ShaderDrawCall
+{
+    SPShader* m_shader;
+    unsigned m_first, m_end;
+};
+std::vector<ShaderDrawCall> g_final_draw_calls[DCT_FOR_VAO];
+// ----------------------------------------------------------------------------
+struct GlowMesh
+{
+    unsigned m_key;
+    core::vector3df m_color;
+    SPMeshBuffer* m_mb;
+};
+// Sorted by glow color in updateModelMatrix
+std::vector<GlowMesh> g_glow_meshes;
 // ----------------------------------------------------------------------------
-std::unordered_set<SPMeshBuffer*> g_instances;
+std::vector<SPMeshBuffer*> g_instances;
 // ----------------------------------------------------------------------------
 std::array<GLuint, ST_COUNT> g_samplers;
 // ----------------------------------------------------------------------------
@@ -111,6 +139,21 @@ std::vector<std::shared_ptr<SPDynamicDrawCall> > g_dy_dc;
 // ----------------------------------------------------------------------------
 float g_frustums[5][24] = { { } };
 // ----------------------------------------------------------------------------
+/** Mesh buffer of a node added in this frame, culled in cullObjects(). */
+struct CullingObject
+{
+    SPMeshNode* m_node;
+    unsigned m_mb;
+    core::aabbox3df m_bb;
+};
+std::vector<CullingObject> g_culling_objects;
+// ----------------------------------------------------------------------------
+std::vector<std::pair<SPDynamicDrawCall*, core::aabbox3df> > g_culling_dy_dc;
+// ----------------------------------------------------------------------------
+// Boxes of g_culling_objects or g_culling_dy_dc, and the result of culling
+GE::GECullingBoxes g_culling_boxes;
+std::vector<uint8_t> g_culled;
+// ----------------------------------------------------------------------------
 unsigned sp_solid_poly_count = 0;
 // ----------------------------------------------------------------------------
 unsigned sp_shadow_poly_count = 0;
@@ -725,19 +768,92 @@ void prepareDrawCalls()
             g_stk_sbr->getShadowMatrices()->getSunOrthoMatrices()[3]);
     }
 
-    for (auto& p : g_draw_calls)
-    {
-        p.clear();
-    }
-    for (auto& p : g_final_draw_calls)
+    for (unsigned i = 0; i < DCT_FOR_VAO; i++)
     {
-        p.clear();
+        g_draw_calls[i].clear();
+        g_texture_draw_calls[i].clear();
+        g_final_draw_calls[i].clear();
     }
     g_glow_meshes.clear();
     g_instances.clear();
+    g_culling_objects.clear();
+    g_culling_boxes.clear();
 }
 
 // ----------------------------------------------------------------------------
+/** Returns the id of a combined layer_1 and layer_2 texture name, mesh
+ *  buffers keep it so that draw calls are grouped without using strings.
+ */
+unsigned getTextureCompareID(const std::string& name)
+{
+    if (g_texture_compare_ids.empty())
+        g_texture_compare_ids[""] = 0;
+    auto ret = g_texture_compare_ids.find(name);
+    if (ret != g_texture_compare_ids.end())
+        return ret->second;
+    unsigned id = (unsigned)g_texture_compare_ids.size();
+    g_texture_compare_ids[name] = id;
+    return id;
+}   // getTextureCompareID
+
+// ----------------------------------------------------------------------------
+/** Adds a draw call of the mesh buffer for each of its textures, or one for
+ *  all if the shader doesn't use the textures of the mesh.
+ */
+void addDrawCall(DrawCallType dct, SPShader* shader, SPMeshBuffer* mb,
+                 bool sampler_less)
+{
+    for (auto& p : mb->getTextureCompareIDs())
+    {
+        if (!sampler_less)
+        {
+            g_draw_calls[dct].push_back({ shader, p.first, (int)p.second,
+                mb });
+        }
+        else if (p.first == 0)
+        {
+            // Mesh with empty texture names
+            g_draw_calls[dct].push_back({ shader, 0, (int)p.second, mb });
+            return;
+        }
+    }
+    if (sampler_less)
+        g_draw_calls[dct].push_back({ shader, 0, -1, mb });
+}   // addDrawCall
+
+// ----------------------------------------------------------------------------
+/** Adds an edge of each side of a box for the bounding boxes view. */
+void addBoxForViz(const core::aabbox3df& bb)
+{
+    addEdgeForViz(getCorner(bb, 0), getCorner(bb, 1));
+    addEdgeForViz(getCorner(bb, 1), getCorner(bb, 5));
+    addEdgeForViz(getCorner(bb, 5), getCorner(bb, 4));
+    addEdgeForViz(getCorner(bb, 4), getCorner(bb, 0));
+    addEdgeForViz(getCorner(bb, 2), getCorner(bb, 3));
+    addEdgeForViz(getCorner(bb, 3), getCorner(bb, 7));
+    addEdgeForViz(getCorner(bb, 7), getCorner(bb, 6));
+    addEdgeForViz(getCorner(bb, 6), getCorner(bb, 2));
+    addEdgeForViz(getCorner(bb, 0), getCorner(bb, 2));
+    addEdgeForViz(getCorner(bb, 1), getCorner(bb, 3));
+    addEdgeForViz(getCorner(bb, 5), getCorner(bb, 7));
+    addEdgeForViz(getCorner(bb, 4), getCorner(bb, 6));
+}   // addBoxForViz
+
+// ----------------------------------------------------------------------------
+/** Culls all boxes of g_culling_boxes against the camera and (if used) the
+ *  shadow cascades frustums, g_culled then has for each box the bit mask of
+ *  the frustums (in DrawCallType order) it is outside of.
+ */
+void cullBoxes()
+{
+    g_culling_boxes.cull(&g_frustums[0][0], g_handle_shadow ? 5 : 1,
+        &g_culled);
+}   // cullBoxes
+
+// ----------------------------------------------------------------------------
+/** Queues the mesh buffers of a node for culling, they are culled together
+ *  in cullObjects().
+ */
 void addObject(SPMeshNode* node)
 {
     if (!sp_culling)
@@ -751,82 +867,72 @@ void addObject(SPMeshNode* node)
     }
 
     const core::matrix4& model_matrix = node->getAbsoluteTransformation();
-    bool added_for_skinning = false;
     for (unsigned m = 0; m < node->getSPM()->getMeshBufferCount(); m++)
     {
-        SPMeshBuffer* mb = node->getSPM()->getSPMeshBuffer(m);
-        SPShader* shader = node->getShader(m);
-        if (shader == NULL)
+        if (node->getShader(m) == NULL)
         {
             continue;
         }
-        core::aabbox3df bb = mb->getBoundingBox();
+        core::aabbox3df bb =
+            node->getSPM()->getSPMeshBuffer(m)->getBoundingBox();
         model_matrix.transformBoxEx(bb);
-        std::vector<bool> discard;
-        const bool handle_shadow = node->isInShadowPass() &&
-            g_handle_shadow && shader->hasShader(RP_SHADOW);
-        discard.resize((handle_shadow ? 5 : 1), false);
+        g_culling_boxes.add(bb);
+        g_culling_objects.push_back({ node, m, bb });
+    }
+}   // addObject
+
+// ----------------------------------------------------------------------------
+/** Culls the mesh buffers added with addObject() in one batch and adds the
+ *  visible ones to the draw calls.
+ */
+void cullObjects()
+{
+    if (!sp_culling)
+    {
+        return;
+    }
 
-        for (int dc_type = 0; dc_type < (handle_shadow ? 5 : 1); dc_type++)
+    cullBoxes();
+    SPMeshNode* skinning_node = NULL;
+    SPMeshNode* skipped_node = NULL;
+    for (unsigned i = 0; i < g_culling_objects.size(); i++)
+    {
+        SPMeshNode* node = g_culling_objects[i].m_node;
+        if (node == skipped_node)
         {
-            for (int i = 0; i < 24; i += 4)
-            {
-                bool outside = true;
-                for (int j = 0; j < 8; j++)
-                {
-                    const float dist =
-                        getCorner(bb, j).X * g_frustums[dc_type][i] +
-                        getCorner(bb, j).Y * g_frustums[dc_type][i + 1] +
-                        getCorner(bb, j).Z * g_frustums[dc_type][i + 2] +
-                        g_frustums[dc_type][i + 3];
-                    outside = outside && dist < 0.0f;
-                    if (!outside)
-                    {
-                        break;
-                    }
-                }
-                if (outside)
-                {
-                    discard[dc_type] = true;
-                    break;
-                }
-            }
+            continue;
         }
-        if (handle_shadow ?
-            (discard[0] && discard[1] && discard[2] && discard[3] &&
-            discard[4]) : discard[0])
+        const unsigned m = g_culling_objects[i].m_mb;
+        SPMeshBuffer* mb = node->getSPM()->getSPMeshBuffer(m);
+        SPShader* shader = node->getShader(m);
+        const bool handle_shadow = node->isInShadowPass() &&
+            g_handle_shadow && shader->hasShader(RP_SHADOW);
+        const int dc_count = handle_shadow ? 5 : 1;
+        const uint8_t all = (uint8_t)((1 << dc_count) - 1);
+        const uint8_t discard = g_culled[i] & all;
+        if (discard == all)
         {
             continue;
         }
 
         if (irr_driver->getBoundingBoxesViz())
         {
-            addEdgeForViz(getCorner(bb, 0), getCorner(bb, 1));
-            addEdgeForViz(getCorner(bb, 1), getCorner(bb, 5));
-            addEdgeForViz(getCorner(bb, 5), getCorner(bb, 4));
-            addEdgeForViz(getCorner(bb, 4), getCorner(bb, 0));
-            addEdgeForViz(getCorner(bb, 2), getCorner(bb, 3));
-            addEdgeForViz(getCorner(bb, 3), getCorner(bb, 7));
-            addEdgeForViz(getCorner(bb, 7), getCorner(bb, 6));
-            addEdgeForViz(getCorner(bb, 6), getCorner(bb, 2));
-            addEdgeForViz(getCorner(bb, 0), getCorner(bb, 2));
-            addEdgeForViz(getCorner(bb, 1), getCorner(bb, 3));
-            addEdgeForViz(getCorner(bb, 5), getCorner(bb, 7));
-            addEdgeForViz(getCorner(bb, 4), getCorner(bb, 6));
+            addBoxForViz(g_culling_objects[i].m_bb);
         }
 
         mb->uploadGLMesh();
         // For first frame only need the vbo to be initialized
-        if (!added_for_skinning && node->getAnimationState())
+        if (skinning_node != node && node->getAnimationState())
         {
-            added_for_skinning = true;
+            skinning_node = node;
             int skinning_offset = g_skinning_offset + node->getTotalJoints();
             if (skinning_offset > int(stk_config->m_max_skinning_bones))
             {
                 Log::error("SPBase", "No enough space to render skinned"
                     " mesh %s! Max joints can hold: %d",
                     node->getName(), stk_config->m_max_skinning_bones);
-                return;
+                skipped_node = node;
+                continue;
             }
             node->setSkinningOffset(g_skinning_offset);
             g_skinning_mesh.push_back(node);
@@ -840,9 +946,9 @@ void addObject(SPMeshNode* node)
             node->getTextureMatrix(m)[1], hue,
             (short)node->getSkinningOffset());
 
-        for (int dc_type = 0; dc_type < (handle_shadow ? 5 : 1); dc_type++)
+        for (int dc_type = 0; dc_type < dc_count; dc_type++)
         {
-            if (discard[dc_type])
+            if ((discard >> dc_type) & 1)
             {
                 continue;
             }
@@ -860,11 +966,8 @@ void addObject(SPMeshNode* node)
                 // All transparent draw calls go DCT_TRANSPARENT
                 if (dc_type == 0)
                 {
-                    auto& ret = g_draw_calls[DCT_TRANSPARENT][shader];
-                    for (auto& p : mb->getTextureCompare())
-                    {
-                        ret[p.first].insert(mb);
-                    }
+                    addDrawCall(DCT_TRANSPARENT, shader, mb,
+                        false/*sampler_less*/);
                     mb->addInstanceData(id, DCT_TRANSPARENT);
                 }
                 else
@@ -878,42 +981,26 @@ void addObject(SPMeshNode* node)
                 const RenderPass check_pass =
                     dc_type == DCT_NORMAL ? RP_1ST : RP_SHADOW;
                 const bool sampler_less = shader->samplerLess(check_pass);
-                auto& ret = g_draw_calls[dc_type][shader];
-                if (sampler_less)
-                {
-                    ret[""].insert(mb);
-                }
-                else
-                {
-                    for (auto& p : mb->getTextureCompare())
-                    {
-                        ret[p.first].insert(mb);
-                    }
-                }
+                addDrawCall((DrawCallType)dc_type, shader, mb, sampler_less);
                 mb->addInstanceData(id, (DrawCallType)dc_type);
                 if (UserConfigParams::m_glow && node->hasGlowColor() &&
                     CVS->isDeferredEnabled() && dc_type == DCT_NORMAL)
                 {
                     video::SColorf gc = node->getGlowColor();
-                    unsigned key = gc.toSColor().color;
-                    auto ret = g_glow_meshes.find(key);
-                    if (ret == g_glow_meshes.end())
-                    {
-                        g_glow_meshes[key] = std::make_pair(
-                            core::vector3df(gc.r, gc.g, gc.b),
-                            std::unordered_set<SPMeshBuffer*>());
-                    }
-                    g_glow_meshes.at(key).second.insert(mb);
+                    g_glow_meshes.push_back({ gc.toSColor().color,
+                        core::vector3df(gc.r, gc.g, gc.b), mb });
                 }
             }
-            g_instances.insert(mb);
+            g_instances.push_back(mb);
         }
     }
-}
+}   // cullObjects
 
 // ----------------------------------------------------------------------------
 void handleDynamicDrawCall()
 {
+    g_culling_boxes.clear();
+    g_culling_dy_dc.clear();
     for (unsigned dc_num = 0; dc_num < g_dy_dc.size(); dc_num++)
     {
         SPDynamicDrawCall* dydc = g_dy_dc[dc_num].get();
@@ -921,72 +1008,46 @@ void handleDynamicDrawCall()
         {
             // They need to be updated independent of culling result
             // otherwise some data will be missed if offset update is used
-            g_instances.insert(dydc);
+            g_instances.push_back(dydc);
         }
         if (!dydc->isVisible() || dydc->notReadyFromDrawing() ||
             dydc->isRemoving() || !sp_culling)
         {
             continue;
         }
-
-        SPShader* shader = dydc->getShader();
         core::aabbox3df bb = dydc->getBoundingBox();
         dydc->getAbsoluteTransformation().transformBoxEx(bb);
-        std::vector<bool> discard;
+        g_culling_boxes.add(bb);
+        g_culling_dy_dc.emplace_back(dydc, bb);
+    }
+    if (g_culling_dy_dc.empty())
+    {
+        return;
+    }
+
+    cullBoxes();
+    for (unsigned i = 0; i < g_culling_dy_dc.size(); i++)
+    {
+        SPDynamicDrawCall* dydc = g_culling_dy_dc[i].first;
+        SPShader* shader = dydc->getShader();
         const bool handle_shadow =
             g_handle_shadow && shader->hasShader(RP_SHADOW);
-        discard.resize((handle_shadow ? 5 : 1), false);
-        for (int dc_type = 0; dc_type < (handle_shadow ? 5 : 1); dc_type++)
-        {
-            for (int i = 0; i < 24; i += 4)
-            {
-                bool outside = true;
-                for (int j = 0; j < 8; j++)
-                {
-                    const float dist =
-                        getCorner(bb, j).X * g_frustums[dc_type][i] +
-                        getCorner(bb, j).Y * g_frustums[dc_type][i + 1] +
-                        getCorner(bb, j).Z * g_frustums[dc_type][i + 2] +
-                        g_frustums[dc_type][i + 3];
-                    outside = outside && dist < 0.0f;
-                    if (!outside)
-                    {
-                        break;
-                    }
-                }
-                if (outside)
-                {
-                    discard[dc_type] = true;
-                    break;
-                }
-            }
-        }
-        if (handle_shadow ?
-            (discard[0] && discard[1] && discard[2] && discard[3] &&
-            discard[4]) : discard[0])
+        const int dc_count = handle_shadow ? 5 : 1;
+        const uint8_t all = (uint8_t)((1 << dc_count) - 1);
+        const uint8_t discard = g_culled[i] & all;
+        if (discard == all)
         {
             continue;
         }
 
         if (irr_driver->getBoundingBoxesViz())
         {
-            addEdgeForViz(getCorner(bb, 0), getCorner(bb, 1));
-            addEdgeForViz(getCorner(bb, 1), getCorner(bb, 5));
-            addEdgeForViz(getCorner(bb, 5), getCorner(bb, 4));
-            addEdgeForViz(getCorner(bb, 4), getCorner(bb, 0));
-            addEdgeForViz(getCorner(bb, 2), getCorner(bb, 3));
-            addEdgeForViz(getCorner(bb, 3), getCorner(bb, 7));
-            addEdgeForViz(getCorner(bb, 7), getCorner(bb, 6));
-            addEdgeForViz(getCorner(bb, 6), getCorner(bb, 2));
-            addEdgeForViz(getCorner(bb, 0), getCorner(bb, 2));
-            addEdgeForViz(getCorner(bb, 1), getCorner(bb, 3));
-            addEdgeForViz(getCorner(bb, 5), getCorner(bb, 7));
-            addEdgeForViz(getCorner(bb, 4), getCorner(bb, 6));
+            addBoxForViz(g_culling_dy_dc[i].second);
         }
 
-        for (int dc_type = 0; dc_type < (handle_shadow ? 5 : 1); dc_type++)
+        for (int dc_type = 0; dc_type < dc_count; dc_type++)
         {
-            if (discard[dc_type])
+            if ((discard >> dc_type) & 1)
             {
                 continue;
             }
@@ -1004,11 +1065,8 @@ void handleDynamicDrawCall()
                 // All transparent draw calls go DCT_TRANSPARENT
                 if (dc_type == 0)
                 {
-                    auto& ret = g_draw_calls[DCT_TRANSPARENT][shader];
-                    for (auto& p : dydc->getTextureCompare())
-                    {
-                        ret[p.first].insert(dydc);
-                    }
+                    addDrawCall(DCT_TRANSPARENT, shader, dydc,
+                        false/*sampler_less*/);
                 }
                 else
                 {
@@ -1021,18 +1079,8 @@ void handleDynamicDrawCall()
                 const RenderPass check_pass =
                     dc_type == DCT_NORMAL ? RP_1ST : RP_SHADOW;
                 const bool sampler_less = shader->samplerLess(check_pass);
-                auto& ret = g_draw_calls[dc_type][shader];
-                if (sampler_less)
-                {
-                    ret[""].insert(dydc);
-                }
-                else
-                {
-                    for (auto& p : dydc->getTextureCompare())
-                    {
-                        ret[p.first].insert(dydc);
-                    }
-                }
+                addDrawCall((DrawCallType)dc_type, shader, dydc,
+                    sampler_less);
             }
         }
     }
@@ -1051,47 +1099,50 @@ void updateModelMatrix()
 
     for (unsigned i = 0; i < DCT_FOR_VAO; i++)
     {
-        DrawCall* dc = &g_draw_calls[(DrawCallType)i];
         // Sort dc based on the drawing priority of shaders
         // The larger the drawing priority int, the last it will be drawn
-        using DrawCallPair = std::pair<SPShader*,
-            std::unordered_map<std::string,
-            std::unordered_set<SPMeshBuffer*> > >;
-        std::vector<DrawCallPair> sorted_dc;
-        for (auto& p : *dc)
-        {
-            sorted_dc.push_back(p);
-        }
-        std::sort(sorted_dc.begin(), sorted_dc.end(),
-            [](const DrawCallPair& a, const DrawCallPair& b)->bool
+        // A mesh buffer is added once per instance, so remove duplicates
+        std::vector<DrawCall>& dc = g_draw_calls[i];
+        std::sort(dc.begin(), dc.end(),
+            [](const DrawCall& a, const DrawCall& b)->bool
             {
-                return a.first->getDrawingPriority() <
-                    b.first->getDrawingPriority();
+                const int pa = a.m_shader->getDrawingPriority();
+                const int pb = b.m_shader->getDrawingPriority();
+                if (pa != pb)
+                    return pa < pb;
+                if (a.m_shader != b.m_shader)
+                    return std::less<SPShader*>()(a.m_shader, b.m_shader);
+                if (a.m_texture_id != b.m_texture_id)
+                    return a.m_texture_id < b.m_texture_id;
+                return std::less<SPMeshBuffer*>()(a.m_mb, b.m_mb);
             });
-        for (unsigned dc = 0; dc < sorted_dc.size(); dc++)
-        {
-            auto& p = sorted_dc[dc];
-            g_final_draw_calls[i].emplace_back(p.first,
-            std::vector<std::pair<std::array<GLuint, 6>,
-                std::vector<std::pair<SPMeshBuffer*, int> > > >());
-
-            unsigned texture = 0;
-            for (auto& q : p.second)
+        dc.erase(std::unique(dc.begin(), dc.end(),
+            [](const DrawCall& a, const DrawCall& b)->bool
             {
-                if (q.second.empty())
-                {
-                    continue;
-                }
-                std::array<GLuint, 6> texture_names =
-                    {{ 0, 0, 0, 0, 0, 0 }};
-                int material_id =
-                    (*(q.second.begin()))->getMaterialID(q.first);
+                return a.m_shader == b.m_shader &&
+                    a.m_texture_id == b.m_texture_id && a.m_mb == b.m_mb;
+            }), dc.end());
 
-                if (material_id != -1)
+        std::vector<TextureDrawCall>& tdc = g_texture_draw_calls[i];
+        std::vector<ShaderDrawCall>& sdc = g_final_draw_calls[i];
+        for (unsigned j = 0; j < dc.size(); j++)
+        {
+            const bool new_shader =
+                j == 0 || dc[j].m_shader != dc[j - 1].m_shader;
+            if (new_shader)
+            {
+                sdc.push_back({ dc[j].m_shader, (unsigned)tdc.size(),
+                    (unsigned)tdc.size() });
+            }
+            if (new_shader || dc[j].m_texture_id != dc[j - 1].m_texture_id)
+            {
+                // The textures of the first mesh buffer are used for all
+                std::array<GLuint, 6> texture_names = {{ 0, 0, 0, 0, 0, 0 }};
+                if (dc[j].m_material_id != -1)
                 {
                     const std::array<std::shared_ptr<SPTexture>, 6>& textures =
-                        (*(q.second.begin()))->getSPTexturesByMaterialID
-                        (material_id);
+                        dc[j].m_mb->getSPTexturesByMaterialID
+                        (dc[j].m_material_id);
                     texture_names =
                         {{
                             textures[0]->getTextureHandler(),
@@ -1102,19 +1153,25 @@ void updateModelMatrix()
                             textures[5]->getTextureHandler()
                         }};
                 }
-                g_final_draw_calls[i][dc].second.emplace_back
-                    (texture_names,
-                    std::vector<std::pair<SPMeshBuffer*, int> >());
-                for (SPMeshBuffer* spmb : q.second)
-                {
-                    g_final_draw_calls[i][dc].second[texture].second.push_back
-                        (std::make_pair(spmb, material_id == -1 ?
-                        -1 : spmb->getMaterialID(q.first)));
-                }
-                texture++;
+                tdc.push_back({ texture_names, j, j });
+                sdc.back().m_end++;
             }
+            tdc.back().m_end = j + 1;
         }
     }
+
+    std::sort(g_glow_meshes.begin(), g_glow_meshes.end(),
+        [](const GlowMesh& a, const GlowMesh& b)->bool
+        {
+            if (a.m_key != b.m_key)
+                return a.m_key < b.m_key;
+            return std::less<SPMeshBuffer*>()(a.m_mb, b.m_mb);
+        });
+    g_glow_meshes.erase(std::unique(g_glow_meshes.begin(),
+        g_glow_meshes.end(), [](const GlowMesh& a, const GlowMesh& b)->bool
+        {
+            return a.m_key == b.m_key && a.m_mb == b.m_mb;
+        }), g_glow_meshes.end());
 }
 
 // ----------------------------------------------------------------------------
@@ -1180,6 +1237,9 @@ void uploadAll()
         g_stk_sbr->getShadowMatrices()->getMatricesData());
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
+    std::sort(g_instances.begin(), g_instances.end());
+    g_instances.erase(std::unique(g_instances.begin(), g_instances.end()),
+        g_instances.end());
     for (SPMeshBuffer* spmb : g_instances)
     {
         spmb->uploadInstanceData();
@@ -1201,37 +1261,21 @@ void drawSPDebugView()
     }
     g_normal_visualizer->use();
     g_normal_visualizer->bindPrefilledTextures();
-    for (unsigned i = 0; i < g_final_draw_calls[0].size(); i++)
+    for (const DrawCall& dc : g_draw_calls[DCT_NORMAL])
     {
-        auto& p = g_final_draw_calls[0][i];
-        for (unsigned j = 0; j < p.second.size(); j++)
-        {
-            for (unsigned k = 0; k < p.second[j].second.size(); k++)
-            {
-                // Make sure tangents and joints are not drawn undefined
-                glVertexAttrib4f(5, 0.0f, 0.0f, 0.0f, 0.0f);
-                glVertexAttribI4i(6, 0, 0, 0, 0);
-                glVertexAttrib4f(7, 0.0f, 0.0f, 0.0f, 0.0f);
-                p.second[j].second[k].first->draw(DCT_NORMAL,
-                    -1/*material_id*/);
-            }
-        }
+        // Make sure tangents and joints are not drawn undefined
+        glVertexAttrib4f(5, 0.0f, 0.0f, 0.0f, 0.0f);
+        glVertexAttribI4i(6, 0, 0, 0, 0);
+        glVertexAttrib4f(7, 0.0f, 0.0f, 0.0f, 0.0f);
+        dc.m_mb->draw(DCT_NORMAL, -1/*material_id*/);
     }
-    for (unsigned i = 0; i < g_final_draw_calls[5].size(); i++)
+    for (const DrawCall& dc : g_draw_calls[DCT_TRANSPARENT])
     {
-        auto& p = g_final_draw_calls[5][i];
-        for (unsigned j = 0; j < p.second.size(); j++)
-        {
-            for (unsigned k = 0; k < p.second[j].second.size(); k++)
-            {
-                // Make sure tangents and joints are not drawn undefined
-                glVertexAttrib4f(5, 0.0f, 0.0f, 0.0f, 0.0f);
-                glVertexAttribI4i(6, 0, 0, 0, 0);
-                glVertexAttrib4f(7, 0.0f, 0.0f, 0.0f, 0.0f);
-                p.second[j].second[k].first->draw(DCT_TRANSPARENT,
-                    -1/*material_id*/);
-            }
-        }
+        // Make sure tangents and joints are not drawn undefined
+        glVertexAttrib4f(5, 0.0f, 0.0f, 0.0f, 0.0f);
+        glVertexAttribI4i(6, 0, 0, 0, 0);
+        glVertexAttrib4f(7, 0.0f, 0.0f, 0.0f, 0.0f);
+        dc.m_mb->draw(DCT_TRANSPARENT, -1/*material_id*/);
     }
     g_normal_visualizer->unuse();
 }
@@ -1247,13 +1291,11 @@ void drawGlow()
     SPUniformAssigner* glow_color_assigner =
         g_glow_shader->getUniformAssigner("col");
     assert(glow_color_assigner != NULL);
-    for (auto& p : g_glow_meshes)
+    for (unsigned i = 0; i < g_glow_meshes.size(); i++)
     {
-        glow_color_assigner->setValue(p.second.first);
-        for (SPMeshBuffer* spmb : p.second.second)
-        {
-            spmb->draw(DCT_NORMAL, -1/*material_id*/);
-        }
+        if (i == 0 || g_glow_meshes[i].m_key != g_glow_meshes[i - 1].m_key)
+            glow_color_assigner->setValue(g_glow_meshes[i].m_color);
+        g_glow_meshes[i].m_mb->draw(DCT_NORMAL, -1/*material_id*/);
     }
     g_glow_shader->unuse();
 }
@@ -1263,34 +1305,35 @@ void draw(RenderPass rp, DrawCallType dct)
 {
     std::stringstream profiler_name;
     profiler_name << "SP::Draw " << dct << " with " << rp;
-    PROFILER_PUSH_CPU_MARKER(profiler_name.str().c_str(),
+    PROFILER_PUSH_CPU_MARKER_DYNAMIC(profiler_name.str().c_str(),
         (uint8_t)(float(dct + rp + 2) / float(DCT_FOR_VAO + RP_COUNT) * 255.0f),
         (uint8_t)(float(dct + 1) / (float)DCT_FOR_VAO * 255.0f) ,
         (uint8_t)(float(rp + 1) / (float)RP_COUNT * 255.0f));
 
     assert(dct < DCT_FOR_VAO);
-    for (unsigned i = 0; i < g_final_draw_calls[dct].size(); i++)
+    for (const ShaderDrawCall& p : g_final_draw_calls[dct])
     {
-        auto& p = g_final_draw_calls[dct][i];
-        if (!p.first->hasShader(rp))
+        SPShader* shader = p.m_shader;
+        if (!shader->hasShader(rp))
         {
             continue;
         }
-        p.first->use(rp);
+        shader->use(rp);
         static std::vector<SPUniformAssigner*> shader_uniforms;
-        p.first->setUniformsPerObject(static_cast<SPPerObjectUniform*>
-            (p.first), &shader_uniforms, rp);
-        p.first->bindPrefilledTextures(rp);
-        for (unsigned j = 0; j < p.second.size(); j++)
+        shader->setUniformsPerObject(static_cast<SPPerObjectUniform*>
+            (shader), &shader_uniforms, rp);
+        shader->bindPrefilledTextures(rp);
+        for (unsigned j = p.m_first; j < p.m_end; j++)
         {
-            p.first->bindTextures(p.second[j].first, rp);
-            for (unsigned k = 0; k < p.second[j].second.size(); k++)
+            const TextureDrawCall& tdc = g_texture_draw_calls[dct][j];
+            shader->bindTextures(tdc.m_textures, rp);
+            for (unsigned k = tdc.m_first; k < tdc.m_end; k++)
             {
+                const DrawCall& dc = g_draw_calls[dct][k];
                 static std::vector<SPUniformAssigner*> draw_call_uniforms;
-                p.first->setUniformsPerObject(static_cast<SPPerObjectUniform*>
-                    (p.second[j].second[k].first), &draw_call_uniforms, rp);
-                p.second[j].second[k].first->draw(dct,
-                    p.second[j].second[k].second/*material_id*/);
+                shader->setUniformsPerObject(static_cast<SPPerObjectUniform*>
+                    (dc.m_mb), &draw_call_uniforms, rp);
+                dc.m_mb->draw(dct, dc.m_material_id);
                 for (SPUniformAssigner* ua : draw_call_uniforms)
                 {
                     ua->reset();
@@ -1303,7 +1346,7 @@ void draw(RenderPass rp, DrawCallType dct)
             ua->reset();
         }
         shader_uniforms.clear();
-        p.first->unuse(rp);
+        shader->unuse(rp);
     }
     PROFILER_POP_CPU_MARKER();
 }   // draw
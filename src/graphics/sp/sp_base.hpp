@@ -120,6 +120,8 @@ void drawSPDebugView();
 // ----------------------------------------------------------------------------
 void addObject(SPMeshNode*);
 // ----------------------------------------------------------------------------
+void cullObjects();
+// ----------------------------------------------------------------------------
 void initSTKRenderer(ShaderBasedRenderer*);
 // ----------------------------------------------------------------------------
 void prepareScene();
@@ -143,6 +145,8 @@ SPMesh* convertEVTStandard(irr::scene::IMesh* mesh,
 // ----------------------------------------------------------------------------
 void uploadSPM(irr::scene::IMesh* mesh);
 // ----------------------------------------------------------------------------
+unsigned getTextureCompareID(const std::string& name);
+// ----------------------------------------------------------------------------
 #ifdef SERVER_ONLY
 inline void setMaxTextureSize() {}
 #else
@@ -141,6 +141,7 @@ void SPMeshBuffer::uploadGLMesh()
         m_tex_cmp[std::get<2>(m_stk_material[i])->getSamplerPath(0) +
             std::get<2>(m_stk_material[i])->getSamplerPath(1)] = i;
     }
+    updateTextureCompareIDs();
 
     bool use_2_uv = std::get<2>(m_stk_material[0])->use2UV();
     bool use_tangents = m_shaders[0]->useTangents();
@@ -468,8 +469,22 @@ void SPMeshBuffer::reloadTextureCompare()
             m_textures[i][0]->getPath() + m_textures[i][1]->getPath();
         m_tex_cmp[name] = i;
     }
+    updateTextureCompareIDs();
 }   // reloadTextureCompare
 
+// ----------------------------------------------------------------------------
+void SPMeshBuffer::updateTextureCompareIDs()
+{
+#ifndef SERVER_ONLY
+    m_tex_cmp_ids.clear();
+    for (auto& p : m_tex_cmp)
+    {
+        m_tex_cmp_ids.emplace_back(SP::getTextureCompareID(p.first),
+            p.second);
+    }
+#endif
+}   // updateTextureCompareIDs
+
 // ----------------------------------------------------------------------------
 void SPMeshBuffer::setSTKMaterial(Material* m)
 {
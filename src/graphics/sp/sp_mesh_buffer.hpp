@@ -56,6 +56,10 @@ protected:
 
     std::unordered_map<std::string, unsigned> m_tex_cmp;
 
+    /** m_tex_cmp as (getTextureCompareID(name), material id) pairs, used to
+     *  build draw calls without comparing strings. */
+    std::vector<std::pair<unsigned, unsigned> > m_tex_cmp_ids;
+
     std::vector<video::S3DVertexSkinnedMesh> m_vertices;
 
     GLuint m_ibo, m_vbo;
@@ -64,6 +68,8 @@ protected:
 
     unsigned m_pitch;
 
+    void updateTextureCompareIDs();
+
 private:
     std::vector<uint16_t> m_indices;
 
@@ -223,6 +229,9 @@ public:
     const std::unordered_map<std::string, unsigned>& getTextureCompare() const
                                                           { return m_tex_cmp; }
     // ------------------------------------------------------------------------
+    const std::vector<std::pair<unsigned, unsigned> >&
+        getTextureCompareIDs() const                  { return m_tex_cmp_ids; }
+    // ------------------------------------------------------------------------
     int getMaterialID(const std::string& tex_cmp) const
     {
         auto itr = m_tex_cmp.find(tex_cmp);
@@ -22,17 +22,18 @@
 #include "graphics/sp/sp_base.hpp"
 #include "graphics/sp/sp_shader.hpp"
 #include "graphics/sp/sp_shader_manager.hpp"
+#include "graphics/sp/sp_texture_cache.hpp"
 #include "graphics/sp/sp_texture_manager.hpp"
 #include "graphics/central_settings.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/material.hpp"
+#include "utils/file_utils.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
 
 #include <IImageLoader.h>
 #include <IReadFile.h>
 #include <IVideoDriver.h>
-#include <IWriteFile.h>
 
 #if !defined(SERVER_ONLY)
 #include <squish.h>
@@ -51,8 +52,6 @@ extern "C"
 
 #include <numeric>
 
-static const uint8_t CACHE_VERSION = 2;
-
 namespace SP
 {
 // ----------------------------------------------------------------------------
@@ -89,10 +88,7 @@ SPTexture::SPTexture(const std::string& path, Material* m, bool undo_srgb,
     }
 #endif
 
-    m_cache_directory = file_manager->getCachedTexturesDir() +
-        cache_subdir + "/" + container_id;
-    file_manager->checkAndCreateDirectoryP(m_cache_directory);
-
+    m_cache_variant = cache_subdir;
 #endif
 }   // SPTexture
 
@@ -203,7 +199,7 @@ std::shared_ptr<video::IImage> SPTexture::getTextureImage() const
         image->getDimension().Height; i++)
     {
         const bool use_tex_compress = CVS->isTextureCompressionEnabled() &&
-            !m_cache_directory.empty();
+            !m_cache_variant.empty();
 #ifndef USE_GLES2
         if (use_tex_compress)
         {
@@ -231,7 +227,7 @@ std::shared_ptr<video::IImage> SPTexture::getTextureImage() const
 }   // getTextureImage
 
 // ----------------------------------------------------------------------------
-bool SPTexture::compressedTexImage2d(std::shared_ptr<video::IImage> texture,
+bool SPTexture::compressedTexImage2d(const uint8_t* compressed,
                                      const std::vector<std::pair
                                      <core::dimension2du, unsigned> >&
                                      mipmap_sizes)
@@ -245,7 +241,6 @@ bool SPTexture::compressedTexImage2d(std::shared_ptr<video::IImage> texture,
     glDeleteTextures(1, &m_texture_name);
     glGenTextures(1, &m_texture_name);
     glBindTexture(GL_TEXTURE_2D, m_texture_name);
-    uint8_t* compressed = (uint8_t*)texture->lock();
     unsigned cur_mipmap_size = 0;
     for (unsigned i = 0; i < mipmap_sizes.size(); i++)
     {
@@ -328,130 +323,112 @@ bool SPTexture::texImage2d(std::shared_ptr<video::IImage> texture,
     return true;
 }   // texImage2d
 
+#ifndef SERVER_ONLY
 // ----------------------------------------------------------------------------
-bool SPTexture::saveCompressedTexture(std::shared_ptr<video::IImage> texture,
-                                      const std::vector<std::pair
-                                      <core::dimension2du, unsigned> >& sizes,
-                                      const std::string& cache_location)
+/** Adds a string and its terminating zero to a FNV-1a hash. */
+static void hashString(const std::string& str, uint64_t* hash)
 {
-#if !defined(SERVER_ONLY)
-    const unsigned total_size = std::accumulate(sizes.begin(), sizes.end(), 0,
-        [] (const unsigned int previous, const std::pair
-        <core::dimension2du, unsigned>& cur_sizes)
-       { return previous + cur_sizes.second; });
-    io::IWriteFile* file = irr::io::createWriteFile(cache_location.c_str(),
-        false);
-    if (file == NULL)
+    for (size_t i = 0; i <= str.size(); i++)
     {
-        return true;
+        *hash ^= (uint8_t)str.c_str()[i];
+        *hash *= 1099511628211ULL;
     }
-    file->write(&CACHE_VERSION, 1);
-    const unsigned mm_sizes = (unsigned)sizes.size();
-    file->write(&mm_sizes, 4);
-    for (auto& p : sizes)
-    {
-        file->write(&p.first.Width, 4);
-        file->write(&p.first.Height, 4);
-        file->write(&p.second, 4);
-    }
-    file->write(texture->lock(), total_size);
-    file->drop();
-#endif
-    return true;
-}   // saveCompressedTexture
+}   // hashString
 
 // ----------------------------------------------------------------------------
-bool SPTexture::useTextureCache(const std::string& full_path,
-                                std::string* cache_loc)
+/** Adds the content of a file to a FNV-1a hash.
+ *  \return False if the file can't be read.
+ */
+static bool hashFile(const std::string& path, uint64_t* hash)
 {
-#ifndef SERVER_ONLY
-    if (!CVS->isTextureCompressionEnabled() || m_cache_directory.empty())
-    {
+    FILE* fp = FileUtils::fopenU8Path(path, "rb");
+    if (!fp)
         return false;
-    }
-
-    std::string basename = StringUtils::getBasename(m_path);
-    *cache_loc = m_cache_directory + "/" + basename + ".sptz";
-
-    if (file_manager->fileExists(*cache_loc) &&
-        file_manager->fileIsNewer(*cache_loc, m_path))
+    std::vector<uint8_t> buffer(65536);
+    size_t size;
+    while ((size = fread(buffer.data(), 1, buffer.size(), fp)) > 0)
     {
-        if (m_material && (!m_material->getColorizationMask().empty() ||
-            m_material->getAlphaMask().empty()))
+        for (size_t i = 0; i < size; i++)
         {
-            std::string mask_path = StringUtils::getPath(m_path) + "/" +
-                (!m_material->getColorizationMask().empty() ?
-                m_material->getColorizationMask() :
-                m_material->getAlphaMask());
-            if (!file_manager->fileIsNewer(*cache_loc, mask_path))
-            {
-                return false;
-            }
+            *hash ^= buffer[i];
+            *hash *= 1099511628211ULL;
         }
-        return true;
     }
+    fclose(fp);
+    return true;
+}   // hashFile
 #endif
-    return false;
-}   // useTextureCache
 
 // ----------------------------------------------------------------------------
-std::shared_ptr<video::IImage> SPTexture::getTextureCache(const std::string& p,
-    std::vector<std::pair<core::dimension2du, unsigned> >* sizes)
+/** Computes the key of this texture in the texture cache, from the content
+ *  of the image and its masks and all settings changing the compressed
+ *  texture, so textures with the same name in different tracks or addons
+ *  don't share a cache and an edited texture is compressed again.
+ *  \return False if the texture isn't cached.
+ */
+bool SPTexture::getCacheKey(uint64_t* key) const
 {
-    std::shared_ptr<video::IImage> cache;
-#if !defined(SERVER_ONLY)
-    io::IReadFile* file = irr::io::createReadFile(p.c_str());
-    if (file == NULL)
+#ifndef SERVER_ONLY
+    if (!CVS->isTextureCompressionEnabled() || m_cache_variant.empty() ||
+        !SPTextureManager::get()->getTextureCache())
     {
-        return cache;
+        return false;
     }
 
-    uint8_t cache_version;
-    file->read(&cache_version, 1);
-    if (cache_version != CACHE_VERSION)
+    uint64_t hash = 14695981039346656037ULL;
+    hashString(m_cache_variant, &hash);
+    hashString(StringUtils::toString(sp_max_texture_size.load()) + " " +
+        StringUtils::toString(stk_config->m_tc_quality) + " " +
+        StringUtils::toString(m_undo_srgb), &hash);
+    if (!hashFile(m_path, &hash))
     {
-        return cache;
+        return false;
     }
-
-    unsigned mm_sizes;
-    file->read(&mm_sizes, 4);
-    sizes->resize(mm_sizes);
-    for (unsigned i = 0; i < mm_sizes; i++)
+    if (m_material)
     {
-        file->read(&((*sizes)[i].first.Width), 4);
-        file->read(&((*sizes)[i].first.Height), 4);
-        file->read(&((*sizes)[i].second), 4);
+        // Everything used by getMask, a missing mask is not used either
+        hashString(m_material->getShaderName(), &hash);
+        hashString(StringUtils::toString(m_material->getColorizationFactor())
+            + " " + StringUtils::toString(m_material->isColorizable()), &hash);
+        hashString(m_material->getColorizationMask(), &hash);
+        hashString(m_material->getAlphaMask(), &hash);
+        if (!m_material->getColorizationMask().empty())
+        {
+            hashFile(StringUtils::getPath(m_path) + "/" +
+                m_material->getColorizationMask(), &hash);
+        }
+        if (!m_material->getAlphaMask().empty())
+        {
+            hashFile(StringUtils::getPath(m_path) + "/" +
+                m_material->getAlphaMask(), &hash);
+        }
     }
-
-    const unsigned total_cache_size = std::accumulate(sizes->begin(),
-        sizes->end(), 0,[] (const unsigned int previous, const std::pair
-        <core::dimension2du, unsigned>& cur_sizes)
-       { return previous + cur_sizes.second; });
-    cache.reset(irr_driver->getVideoDriver()->createImage(video::ECF_A8R8G8B8,
-        (*sizes)[0].first));
-    assert(cache->getReferenceCount() == 1);
-    file->read(cache->lock(), total_cache_size);
-    file->drop();
+    *key = hash;
+    return true;
+#else
+    return false;
 #endif
-    return cache;
-}   // getTextureCache
+}   // getCacheKey
 
 // ----------------------------------------------------------------------------
 bool SPTexture::threadedLoad()
 {
 #ifndef SERVER_ONLY
-    std::string cache_loc;
-    if (useTextureCache(m_path, &cache_loc))
+    uint64_t cache_key = 0;
+    const bool use_cache = getCacheKey(&cache_key);
+    if (use_cache)
     {
+        // Uploaded directly from the cache file mapping
         std::vector<std::pair<core::dimension2du, unsigned> > sizes;
-        std::shared_ptr<video::IImage> cache = getTextureCache(cache_loc,
+        std::shared_ptr<const uint8_t> cache =
+            SPTextureManager::get()->getTextureCache()->get(cache_key,
             &sizes);
         if (cache)
         {
             SPTextureManager::get()->increaseGLCommandFunctionCount(1);
             SPTextureManager::get()->addGLCommandFunction(
                 [this, cache, sizes]()->bool
-                { return compressedTexImage2d(cache, sizes); });
+                { return compressedTexImage2d(cache.get(), sizes); });
             return true;
         }
     }
@@ -470,20 +447,24 @@ bool SPTexture::threadedLoad()
     }
     std::shared_ptr<video::IImage> mipmaps;
 
-    if (!m_cache_directory.empty() && CVS->isTextureCompressionEnabled() &&
+    if (!m_cache_variant.empty() && CVS->isTextureCompressionEnabled() &&
         image->getDimension().Width >= 4 && image->getDimension().Height >= 4)
     {
         auto r = compressTexture(image);
         SPTextureManager::get()->increaseGLCommandFunctionCount(1);
         SPTextureManager::get()->addGLCommandFunction(
             [this, image, r]()->bool
-            { return compressedTexImage2d(image, r); });
-        if (!cache_loc.empty())
+            {
+                return compressedTexImage2d((const uint8_t*)image->lock(), r);
+            });
+        if (use_cache)
         {
             SPTextureManager::get()->addThreadedFunction(
-                [this, image, r, cache_loc]()->bool
+                [image, r, cache_key]()->bool
                 {
-                    return saveCompressedTexture(image, r, cache_loc);
+                    SPTextureManager::get()->getTextureCache()->add(cache_key,
+                        (const uint8_t*)image->lock(), r);
+                    return true;
                 });
         }
     }
@@ -50,7 +50,9 @@ class SPTexture : public NoCopy
 private:
     std::string m_path;
 
-    std::string m_cache_directory;
+    /** Settings the compressed texture depends on, empty if the texture
+     *  isn't compressed. */
+    std::string m_cache_variant;
 
     GLuint m_texture_name = 0;
 
@@ -141,22 +143,14 @@ private:
     bool texImage2d(std::shared_ptr<video::IImage> texture,
         std::shared_ptr<video::IImage> mipmaps);
     // ------------------------------------------------------------------------
-    bool compressedTexImage2d(std::shared_ptr<video::IImage> texture,
+    bool compressedTexImage2d(const uint8_t* compressed,
                               const std::vector<std::pair<core::dimension2du,
                               unsigned> >& mipmap_sizes);
     // ------------------------------------------------------------------------
-    bool saveCompressedTexture(std::shared_ptr<video::IImage> texture,
-                              const std::vector<std::pair<core::dimension2du,
-                              unsigned> >& sizes,
-                              const std::string& cache_location);
-    // ------------------------------------------------------------------------
     std::vector<std::pair<core::dimension2du, unsigned> >
                       compressTexture(std::shared_ptr<video::IImage>& texture);
     // ------------------------------------------------------------------------
-    bool useTextureCache(const std::string& full_path, std::string* cache_loc);
-    // ------------------------------------------------------------------------
-    std::shared_ptr<video::IImage> getTextureCache(const std::string& path,
-        std::vector<std::pair<core::dimension2du, unsigned> >* sizes);
+    bool getCacheKey(uint64_t* key) const;
 
 public:
     // ------------------------------------------------------------------------
@@ -0,0 +1,476 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef SERVER_ONLY
+
+#include "graphics/sp/sp_texture_cache.hpp"
+#include "io/file_manager.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+#include <sys/stat.h>
+
+#ifdef WIN32
+#  include <windows.h>
+#  include <io.h>
+#else
+#  include <fcntl.h>
+#  include <sys/file.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+namespace
+{
+    const uint32_t INDEX_MAGIC = 0x58444953; // "SIDX" little endian
+    /** To be changed when the format of the files or the compressed data
+     *  changes. */
+    const uint32_t CACHE_VERSION = 3;
+
+    /** A new archive is started when adding a texture would make the last
+     *  one larger than this. */
+    const uint64_t MAX_ARCHIVE_SIZE = 256 * 1024 * 1024;
+
+    /** The cache is cleared when loaded if its archives are larger than
+     *  this in total. */
+    const uint64_t MAX_CACHE_SIZE = 1024 * 1024 * 1024;
+
+    struct IndexHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_version;
+    };
+
+    // ------------------------------------------------------------------------
+    /** Advisory lock of a whole file, so game processes sharing the cache
+     *  don't append to it at the same time. */
+    bool lockFile(FILE* fp, bool exclusive)
+    {
+#ifdef WIN32
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(fp));
+        OVERLAPPED overlapped = {};
+        return LockFileEx(handle, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0,
+            MAXDWORD, MAXDWORD, &overlapped) != 0;
+#else
+        return flock(fileno(fp), exclusive ? LOCK_EX : LOCK_SH) == 0;
+#endif
+    }   // lockFile
+
+    // ------------------------------------------------------------------------
+    void unlockFile(FILE* fp)
+    {
+#ifdef WIN32
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(fp));
+        OVERLAPPED overlapped = {};
+        UnlockFileEx(handle, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+        flock(fileno(fp), LOCK_UN);
+#endif
+    }   // unlockFile
+
+    // ------------------------------------------------------------------------
+    /** Truncates a file opened for writing to size 0. */
+    bool truncateFile(FILE* fp)
+    {
+#ifdef WIN32
+        return _chsize(_fileno(fp), 0) == 0;
+#else
+        return ftruncate(fileno(fp), 0) == 0;
+#endif
+    }   // truncateFile
+
+    // ------------------------------------------------------------------------
+    /** Removes the textures cached before the archives were used, saved as
+     *  one .sptz file per texture in <variant>/<container>/ directories. */
+    void removeOldCache()
+    {
+        const std::string dir = file_manager->getCachedTexturesDir();
+        std::set<std::string> variants;
+        file_manager->listFiles(variants, dir);
+        for (const std::string& variant : variants)
+        {
+            // hd, hd-linear, resized_N and resized_N-linear
+            if (!StringUtils::startsWith(variant, "hd") &&
+                !StringUtils::startsWith(variant, "resized_"))
+                continue;
+            const std::string variant_dir = dir + variant;
+            std::set<std::string> containers;
+            file_manager->listFiles(containers, variant_dir);
+            for (const std::string& container : containers)
+            {
+                if (container == "." || container == "..")
+                    continue;
+                const std::string container_dir = variant_dir + "/" +
+                    container;
+                if (file_manager->isDirectory(container_dir))
+                    file_manager->removeDirectory(container_dir);
+            }
+            file_manager->removeDirectory(variant_dir);
+        }
+        Log::info("SPTextureCache", "Removed old texture cache in %s.",
+            dir.c_str());
+    }   // removeOldCache
+}
+
+namespace SP
+{
+// ----------------------------------------------------------------------------
+/** \param directory Directory of the cache files, ending with '/'. */
+SPTextureCache::SPTextureCache(const std::string& directory)
+              : m_directory(directory)
+{
+    file_manager->checkAndCreateDirectoryP(m_directory);
+    m_index_file = m_directory + "index.sptc";
+    loadIndex();
+}   // SPTextureCache
+
+// ----------------------------------------------------------------------------
+std::string SPTextureCache::getArchivePath(unsigned i) const
+{
+    return m_directory + StringUtils::insertValues("textures_%d.sptp", i);
+}   // getArchivePath
+
+// ----------------------------------------------------------------------------
+/** Reads the index file and finds the archives. A record pointing past the
+ *  end of its archive (if the game stopped while adding it) is ignored, an
+ *  outdated or damaged index clears the cache. The textures cached by older
+ *  versions are removed when the index is created the first time.
+ */
+void SPTextureCache::loadIndex()
+{
+    for (unsigned i = 0; ; i++)
+    {
+        struct stat st;
+        Archive archive;
+        archive.m_path = getArchivePath(i);
+        if (FileUtils::statU8Path(archive.m_path, &st) != 0)
+            break;
+        archive.m_size = (uint64_t)st.st_size;
+        archive.m_mapped_size = 0;
+        m_archives.push_back(archive);
+    }
+
+    FILE* fp = FileUtils::fopenU8Path(m_index_file, "rb");
+    if (!fp)
+    {
+        struct stat st;
+        if (FileUtils::statU8Path(m_index_file, &st) != 0)
+            removeOldCache();
+        clear();
+        return;
+    }
+    // Don't read a record being written by another game
+    lockFile(fp, false/*exclusive*/);
+    std::vector<IndexEntry> records;
+    IndexHeader header;
+    bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+        header.m_magic == INDEX_MAGIC && header.m_version == CACHE_VERSION;
+    IndexEntry entry;
+    while (valid && fread(&entry, sizeof(entry), 1, fp) == 1)
+        records.push_back(entry);
+    // A partial record would misplace all records added after it
+    valid = valid && feof(fp) && ftell(fp) ==
+        long(sizeof(header) + records.size() * sizeof(IndexEntry));
+    unlockFile(fp);
+    fclose(fp);
+
+    uint64_t total_size = 0;
+    for (const Archive& archive : m_archives)
+        total_size += archive.m_size;
+    if (!valid || total_size > MAX_CACHE_SIZE)
+    {
+        Log::info("SPTextureCache", "Clearing texture cache in %s.",
+            m_directory.c_str());
+        clear();
+        return;
+    }
+
+    for (const IndexEntry& record : records)
+    {
+        if (record.m_archive < m_archives.size() &&
+            record.m_offset + record.m_size <=
+            m_archives[record.m_archive].m_size)
+            m_entries[record.m_key] = record;
+    }
+}   // loadIndex
+
+// ----------------------------------------------------------------------------
+/** Removes all cache files and writes an empty index. The index is locked
+ *  meanwhile, so no other game appends to the cache while it's cleared. All
+ *  archives in the directory are removed, even after a missing one.
+ */
+void SPTextureCache::clear()
+{
+    m_archives.clear();
+    m_entries.clear();
+
+    // Not opened with "wb", which would truncate it before it's locked
+    FILE* fp = FileUtils::fopenU8Path(m_index_file, "ab");
+    if (!fp || !lockFile(fp, true/*exclusive*/))
+    {
+        Log::warn("SPTextureCache", "Cannot write %s.", m_index_file.c_str());
+        if (fp)
+            fclose(fp);
+        return;
+    }
+
+    std::set<std::string> files;
+    file_manager->listFiles(files, m_directory);
+    for (const std::string& file : files)
+    {
+        if (StringUtils::startsWith(file, "textures_") &&
+            StringUtils::hasSuffix(file, ".sptp"))
+        {
+            remove(FileUtils::getPortableWritingPath(m_directory + file)
+                .c_str());
+        }
+    }
+
+    IndexHeader header;
+    header.m_magic = INDEX_MAGIC;
+    header.m_version = CACHE_VERSION;
+    bool written = truncateFile(fp) &&
+        fwrite(&header, sizeof(header), 1, fp) == 1 && fflush(fp) == 0;
+    unlockFile(fp);
+    written = fclose(fp) == 0 && written;
+    if (!written)
+        Log::warn("SPTextureCache", "Cannot write %s.", m_index_file.c_str());
+}   // clear
+
+// ----------------------------------------------------------------------------
+/** Finds the archives added or grown by other games since they were last
+ *  checked. Called with the index locked.
+ */
+void SPTextureCache::updateArchives()
+{
+    for (unsigned i = m_archives.empty() ? 0 :
+        (unsigned)m_archives.size() - 1; ; i++)
+    {
+        struct stat st;
+        const std::string path = getArchivePath(i);
+        if (FileUtils::statU8Path(path, &st) != 0)
+            break;
+        if (i == m_archives.size())
+        {
+            Archive archive;
+            archive.m_path = path;
+            archive.m_mapped_size = 0;
+            m_archives.push_back(archive);
+        }
+        m_archives[i].m_size = (uint64_t)st.st_size;
+    }
+}   // updateArchives
+
+// ----------------------------------------------------------------------------
+/** Returns the mapped archive, mapped again if end is past the current
+ *  mapping as textures were added to it since. The previous mapping is
+ *  unmapped once all textures using it are released. NULL if it can't be
+ *  mapped.
+ */
+std::shared_ptr<const uint8_t> SPTextureCache::getMappedData(Archive* archive,
+                                                             uint64_t end)
+{
+#ifdef WIN32
+    return NULL;
+#else
+    if (archive->m_mapping && archive->m_mapped_size >= end)
+        return archive->m_mapping;
+
+    int fd = open(FileUtils::getPortableWritingPath(archive->m_path).c_str(),
+        O_RDONLY);
+    if (fd == -1)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < end)
+    {
+        close(fd);
+        return NULL;
+    }
+    const size_t size = (size_t)st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    archive->m_mapping.reset((const uint8_t*)data,
+        [size](const uint8_t* p) { munmap((void*)p, size); });
+    archive->m_mapped_size = size;
+    return archive->m_mapping;
+#endif
+}   // getMappedData
+
+// ----------------------------------------------------------------------------
+/** Returns the compressed data of all mipmaps of a cached texture, or NULL
+ *  if not cached. The data is in the mapped archive, which is kept mapped
+ *  until the returned pointer is released.
+ *  \param key Hash of everything the texture is made from.
+ *  \param sizes Set to the size of each mipmap and its data.
+ */
+std::shared_ptr<const uint8_t> SPTextureCache::get(uint64_t key,
+                                                   Sizes* sizes)
+{
+    std::unique_lock<std::mutex> ul(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+        return NULL;
+    const IndexEntry entry = it->second;
+    std::shared_ptr<const uint8_t> data;
+#ifdef WIN32
+    // Read outside the lock, archives are only appended to
+    const std::string path = m_archives[entry.m_archive].m_path;
+    ul.unlock();
+    FILE* fp = FileUtils::fopenU8Path(path, "rb");
+    if (!fp)
+        return NULL;
+    uint8_t* buffer = new uint8_t[entry.m_size];
+    bool read = fseek(fp, (long)entry.m_offset, SEEK_SET) == 0 &&
+        fread(buffer, entry.m_size, 1, fp) == 1;
+    fclose(fp);
+    data.reset(buffer, [](const uint8_t* p) { delete [] p; });
+    if (!read)
+        return NULL;
+#else
+    std::shared_ptr<const uint8_t> mapped =
+        getMappedData(&m_archives[entry.m_archive],
+        entry.m_offset + entry.m_size);
+    ul.unlock();
+    if (!mapped)
+        return NULL;
+    // Aliasing constructor, the entry keeps the mapping alive
+    data = std::shared_ptr<const uint8_t>(mapped,
+        mapped.get() + entry.m_offset);
+#endif
+
+    // Each entry is the number of mipmaps, their width, height and data size
+    // then the data of all mipmaps
+    uint32_t count;
+    memcpy(&count, data.get(), 4);
+    uint64_t header_size = 4 + (uint64_t)count * 12;
+    if (count == 0 || header_size > entry.m_size)
+        return NULL;
+    sizes->resize(count);
+    uint64_t total_size = 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+        const uint8_t* p = data.get() + 4 + i * 12;
+        memcpy(&(*sizes)[i].first.Width, p, 4);
+        memcpy(&(*sizes)[i].first.Height, p + 4, 4);
+        memcpy(&(*sizes)[i].second, p + 8, 4);
+        total_size += (*sizes)[i].second;
+    }
+    if (header_size + total_size != entry.m_size)
+    {
+        Log::warn("SPTextureCache", "Invalid cached texture %llx.",
+            (unsigned long long)key);
+        return NULL;
+    }
+    // Aliasing constructor, the data keeps the whole entry alive
+    return std::shared_ptr<const uint8_t>(data, data.get() + header_size);
+}   // get
+
+// ----------------------------------------------------------------------------
+/** Appends a compressed texture to the last archive, then its location to
+ *  the index, so the index never points to data not written completely.
+ *  The index is locked meanwhile, and the offset is taken from the archive
+ *  file, as other games using the same cache may append to it too.
+ *  \param key Hash of everything the texture is made from.
+ *  \param data Compressed data of all mipmaps.
+ *  \param sizes Size of each mipmap and its data.
+ */
+void SPTextureCache::add(uint64_t key, const uint8_t* data,
+                         const Sizes& sizes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The same texture can be used with different paths
+    if (m_entries.find(key) != m_entries.end())
+        return;
+
+    std::vector<uint8_t> header(4 + sizes.size() * 12);
+    const uint32_t count = (uint32_t)sizes.size();
+    uint64_t total_size = 0;
+    memcpy(header.data(), &count, 4);
+    for (unsigned i = 0; i < sizes.size(); i++)
+    {
+        memcpy(&header[4 + i * 12], &sizes[i].first.Width, 4);
+        memcpy(&header[8 + i * 12], &sizes[i].first.Height, 4);
+        memcpy(&header[12 + i * 12], &sizes[i].second, 4);
+        total_size += sizes[i].second;
+    }
+    const uint64_t entry_size = header.size() + total_size;
+
+    FILE* index = FileUtils::fopenU8Path(m_index_file, "ab");
+    if (!index || !lockFile(index, true/*exclusive*/))
+    {
+        Log::warn("SPTextureCache", "Cannot write %s.", m_index_file.c_str());
+        if (index)
+            fclose(index);
+        return;
+    }
+    updateArchives();
+    if (m_archives.empty() || (m_archives.back().m_size > 0 &&
+        m_archives.back().m_size + entry_size > MAX_ARCHIVE_SIZE))
+    {
+        Archive archive;
+        archive.m_path = getArchivePath((unsigned)m_archives.size());
+        archive.m_size = 0;
+        archive.m_mapped_size = 0;
+        m_archives.push_back(archive);
+    }
+    Archive& archive = m_archives.back();
+
+    FILE* fp = FileUtils::fopenU8Path(archive.m_path, "ab");
+    long offset = -1;
+    bool written = fp && fseek(fp, 0, SEEK_END) == 0 &&
+        (offset = ftell(fp)) != -1 &&
+        fwrite(header.data(), header.size(), 1, fp) == 1 &&
+        fwrite(data, (size_t)total_size, 1, fp) == 1;
+    written = fp && fclose(fp) == 0 && written;
+    if (!written)
+    {
+        Log::warn("SPTextureCache", "Cannot write %s.",
+            archive.m_path.c_str());
+        unlockFile(index);
+        fclose(index);
+        return;
+    }
+
+    IndexEntry entry;
+    entry.m_key = key;
+    entry.m_archive = (uint32_t)(m_archives.size() - 1);
+    entry.m_size = (uint32_t)entry_size;
+    entry.m_offset = (uint64_t)offset;
+    archive.m_size = entry.m_offset + entry_size;
+
+    written = fwrite(&entry, sizeof(entry), 1, index) == 1 &&
+        fflush(index) == 0;
+    unlockFile(index);
+    written = fclose(index) == 0 && written;
+    if (!written)
+    {
+        Log::warn("SPTextureCache", "Cannot write %s.", m_index_file.c_str());
+        return;
+    }
+    m_entries[key] = entry;
+}   // add
+
+}
+
+#endif
@@ -0,0 +1,115 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_SP_TEXTURE_CACHE_HPP
+#define HEADER_SP_TEXTURE_CACHE_HPP
+
+#ifndef SERVER_ONLY
+
+#include "utils/no_copy.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dimension2d.h>
+
+using namespace irr;
+
+namespace SP
+{
+
+/** Compressed textures (with all mipmaps) saved by a hash of everything
+ *  they are made from, so the same texture used in different tracks or
+ *  addons is compressed once, and an edited one never uses a stale cache.
+ *  Textures are appended to a few large archive files, with an index file
+ *  recording where each one is. Archives are memory mapped (except on
+ *  Windows), so a cached texture is uploaded directly from the mapping.
+ *  Several games can share the cache, appending is done with the index
+ *  file locked.
+ *  Entries are never removed one by one: the whole cache is cleared when it
+ *  becomes too large, which also removes textures not used anymore.
+ *  Thread safe, textures are looked up and added by the loading threads.
+ */
+class SPTextureCache : public NoCopy
+{
+public:
+    typedef std::vector<std::pair<core::dimension2du, unsigned> > Sizes;
+
+private:
+    /** Location of a texture, as saved in the index file. */
+    struct IndexEntry
+    {
+        uint64_t m_key;
+        uint32_t m_archive;
+        uint32_t m_size;
+        uint64_t m_offset;
+    };
+
+    struct Archive
+    {
+        std::string m_path;
+
+        uint64_t m_size;
+
+        /** Latest mapping of the archive, replaced when it grows. Pending
+         *  uploads keep the previous ones alive until they are done. */
+        std::shared_ptr<const uint8_t> m_mapping;
+
+        uint64_t m_mapped_size;
+    };
+
+    const std::string m_directory;
+
+    std::string m_index_file;
+
+    std::vector<Archive> m_archives;
+
+    std::unordered_map<uint64_t, IndexEntry> m_entries;
+
+    std::mutex m_mutex;
+
+    // ------------------------------------------------------------------------
+    std::string getArchivePath(unsigned i) const;
+    // ------------------------------------------------------------------------
+    void loadIndex();
+    // ------------------------------------------------------------------------
+    void clear();
+    // ------------------------------------------------------------------------
+    void updateArchives();
+    // ------------------------------------------------------------------------
+    std::shared_ptr<const uint8_t> getMappedData(Archive* archive,
+                                                 uint64_t end);
+
+public:
+    SPTextureCache(const std::string& directory);
+    // ------------------------------------------------------------------------
+    std::shared_ptr<const uint8_t> get(uint64_t key, Sizes* sizes);
+    // ------------------------------------------------------------------------
+    void add(uint64_t key, const uint8_t* data, const Sizes& sizes);
+
+};   // class SPTextureCache
+
+}
+
+#endif
+
+#endif
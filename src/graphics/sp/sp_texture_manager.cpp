@@ -20,8 +20,10 @@
 #include "graphics/sp/sp_texture_manager.hpp"
 #include "graphics/sp/sp_base.hpp"
 #include "graphics/sp/sp_texture.hpp"
+#include "graphics/sp/sp_texture_cache.hpp"
 #include "graphics/central_settings.hpp"
 #include "graphics/irr_driver.hpp"
+#include "io/file_manager.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/vs.hpp"
 
@@ -73,6 +75,11 @@ SPTextureManager::SPTextureManager()
                 }
             });
     }
+    if (CVS->isTextureCompressionEnabled())
+    {
+        m_texture_cache.reset(new SPTextureCache(
+            file_manager->getCachedTexturesDir() + "sp/"));
+    }
     m_textures["unicolor_white"] = SPTexture::getWhiteTexture();
     m_textures[""] = SPTexture::getTransparentTexture();
 }   // SPTextureManager
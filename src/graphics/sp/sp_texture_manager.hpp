@@ -42,6 +42,7 @@ class Material;
 namespace SP
 {
 class SPTexture;
+class SPTextureCache;
 
 class SPTextureManager : public NoCopy
 {
@@ -64,6 +65,9 @@ private:
 
     std::list<std::thread> m_threaded_load_obj;
 
+    /** NULL if texture compression is disabled. */
+    std::unique_ptr<SPTextureCache> m_texture_cache;
+
 public:
     // ------------------------------------------------------------------------
     static SPTextureManager* get()
@@ -117,6 +121,8 @@ public:
     void increaseGLCommandFunctionCount(int count)
                                   { m_gl_cmd_function_count.fetch_add(count); }
     // ------------------------------------------------------------------------
+    SPTextureCache* getTextureCache() const   { return m_texture_cache.get(); }
+    // ------------------------------------------------------------------------
     void checkForGLCommand(bool before_scene = false);
     // ------------------------------------------------------------------------
     std::shared_ptr<SPTexture> getTexture(const std::string& p,
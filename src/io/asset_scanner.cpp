@@ -0,0 +1,262 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "io/asset_scanner.hpp"
+
+#include "io/file_manager.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <sys/stat.h>
+
+/** First line of cache files, to be changed if the format changes. */
+static const char* CACHE_HEADER = "stk-asset-dirs 1";
+
+// ----------------------------------------------------------------------------
+/** \param config_name Name of the config file of each asset, like kart.xml.
+ *  \param trailing_slash If asset directories end with '/'.
+ */
+AssetScanner::AssetScanner(const std::string& config_name,
+                           bool trailing_slash)
+            : m_config_name(config_name), m_trailing_slash(trailing_slash),
+              m_cache_file(file_manager->getCacheDir() +
+                  StringUtils::removeExtension(config_name) + "_dirs.cache")
+{
+}   // AssetScanner
+
+// ----------------------------------------------------------------------------
+/** Returns the subdirectories of dir with the config file, or "." if dir
+ *  itself has it (subdirectories are not checked then). */
+std::vector<std::string> AssetScanner::listDir(const std::string& dir) const
+{
+    std::vector<std::string> subdirs;
+    if (file_manager->fileExists(getConfigFile(dir)))
+    {
+        subdirs.push_back(".");
+        return subdirs;
+    }
+    std::set<std::string> files;
+    file_manager->listFiles(files, dir);
+    for (const std::string& file : files)
+    {
+        if (file == "." || file == "..")
+            continue;
+        std::string subdir = m_trailing_slash ? dir + file + "/" : dir + file;
+        if (file_manager->fileExists(getConfigFile(subdir)))
+            subdirs.push_back(file);
+    }
+    return subdirs;
+}   // listDir
+
+// ----------------------------------------------------------------------------
+/** Returns all assets in the search paths, with their config file parsed
+ *  if possible. The cache file is updated if any search path changed. */
+std::vector<AssetScanner::Asset>
+    AssetScanner::scan(const std::vector<std::string>& search_paths)
+{
+    loadCache();
+    std::map<std::string, CachedDir> cache;
+    bool changed = false;
+    const int64_t now = (int64_t)StkTime::getTimeSinceEpoch();
+
+    std::vector<Asset> assets;
+    for (const std::string& dir : search_paths)
+    {
+        struct stat st;
+        int64_t mtime = -1;
+        if (FileUtils::statU8Path(dir, &st) == 0)
+            mtime = (int64_t)st.st_mtime;
+
+        std::vector<std::string> subdirs;
+        auto it = m_cache.find(dir);
+        if (mtime != -1 && it != m_cache.end() && it->second.m_mtime == mtime)
+        {
+            subdirs = it->second.m_subdirs;
+            cache[dir] = it->second;
+        }
+        else
+        {
+            subdirs = listDir(dir);
+            // A directory changed in the same second it's listed can change
+            // again without a new modification time, so it's not cached
+            if (mtime != -1 && now - mtime > 1)
+            {
+                cache[dir] = { mtime, subdirs };
+                changed = true;
+            }
+        }
+
+        for (const std::string& subdir : subdirs)
+        {
+            Asset asset;
+            if (subdir == ".")
+                asset.m_dir = dir;
+            else
+            {
+                asset.m_dir = m_trailing_slash ? dir + subdir + "/" :
+                    dir + subdir;
+            }
+            asset.m_config_file = getConfigFile(asset.m_dir);
+            assets.push_back(std::move(asset));
+        }
+    }
+
+    if (changed || cache.size() != m_cache.size())
+    {
+        std::swap(m_cache, cache);
+        saveCache();
+    }
+    parseAll(assets);
+    return assets;
+}   // scan
+
+// ----------------------------------------------------------------------------
+/** Parses the config files of all assets using all cores. Files are read
+ *  directly and not through the irrlicht file system, which isn't thread
+ *  safe, creating the XML readers from memory is. */
+void AssetScanner::parseAll(std::vector<Asset>& assets)
+{
+    std::atomic<unsigned int> next_asset(0);
+    auto parse = [&assets, &next_asset]()
+        {
+            for (unsigned int i = next_asset++; i < assets.size();
+                 i = next_asset++)
+            {
+                FILE* fp =
+                    FileUtils::fopenU8Path(assets[i].m_config_file, "rb");
+                if (!fp)
+                    continue;
+                std::string content;
+                char buffer[4096];
+                size_t size;
+                while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+                    content.append(buffer, size);
+                fclose(fp);
+                if (!content.empty())
+                {
+                    assets[i].m_root.reset(
+                        file_manager->createXMLTreeFromString(content));
+                    if (assets[i].m_root)
+                    {
+                        assets[i].m_root->setFileName(
+                            assets[i].m_config_file);
+                    }
+                }
+            }
+        };
+
+    unsigned int thread_count = std::min(std::thread::hardware_concurrency(),
+        (unsigned int)assets.size() / 8);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < thread_count; i++)
+        threads.emplace_back(parse);
+    parse();
+    for (std::thread& t : threads)
+        t.join();
+}   // parseAll
+
+// ----------------------------------------------------------------------------
+void AssetScanner::loadCache()
+{
+    m_cache.clear();
+    FILE* fp = FileUtils::fopenU8Path(m_cache_file, "rb");
+    if (!fp)
+        return;
+    std::string content;
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        content.append(buffer, size);
+    fclose(fp);
+
+    std::istringstream in(content);
+    std::string line;
+    if (!std::getline(in, line) || line != CACHE_HEADER)
+        return;
+    // Each directory is "<mtime> <count> <path>", followed by one line for
+    // each subdirectory
+    while (std::getline(in, line))
+    {
+        std::istringstream dir_line(line);
+        CachedDir dir;
+        unsigned int count = 0;
+        std::string path;
+        if (!(dir_line >> dir.m_mtime >> count) ||
+            !std::getline(dir_line >> std::ws, path))
+        {
+            Log::warn("AssetScanner", "Invalid cache file %s.",
+                m_cache_file.c_str());
+            m_cache.clear();
+            return;
+        }
+        for (unsigned int i = 0; i < count; i++)
+        {
+            std::string subdir;
+            if (!std::getline(in, subdir))
+            {
+                m_cache.clear();
+                return;
+            }
+            dir.m_subdirs.push_back(subdir);
+        }
+        m_cache[path] = dir;
+    }
+}   // loadCache
+
+// ----------------------------------------------------------------------------
+/** Writes the cache to a temporary file renamed afterwards, so an
+ *  interrupted write never leaves a partial cache. */
+void AssetScanner::saveCache() const
+{
+    const std::string tmp_file = m_cache_file + ".tmp";
+    FILE* fp = FileUtils::fopenU8Path(tmp_file, "wb");
+    if (!fp)
+    {
+        Log::warn("AssetScanner", "Cannot write %s.", tmp_file.c_str());
+        return;
+    }
+    fprintf(fp, "%s\n", CACHE_HEADER);
+    for (auto& p : m_cache)
+    {
+        fprintf(fp, "%lld %u %s\n", (long long)p.second.m_mtime,
+            (unsigned int)p.second.m_subdirs.size(), p.first.c_str());
+        for (const std::string& subdir : p.second.m_subdirs)
+            fprintf(fp, "%s\n", subdir.c_str());
+    }
+    bool written = ferror(fp) == 0;
+    written = fclose(fp) == 0 && written;
+    if (written && FileUtils::renameU8Path(tmp_file, m_cache_file) != 0)
+    {
+        // Windows doesn't replace existing file when renaming
+        remove(FileUtils::getPortableWritingPath(m_cache_file).c_str());
+        written = FileUtils::renameU8Path(tmp_file, m_cache_file) == 0;
+    }
+    if (!written)
+    {
+        Log::warn("AssetScanner", "Cannot write %s.", m_cache_file.c_str());
+        remove(FileUtils::getPortableWritingPath(tmp_file).c_str());
+    }
+}   // saveCache
@@ -0,0 +1,94 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_ASSET_SCANNER_HPP
+#define HEADER_ASSET_SCANNER_HPP
+
+#include "io/xml_node.hpp"
+#include "utils/no_copy.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Finds the kart or track directories in search paths (a directory with
+ *  the config file, or its subdirectories with it) and parses all config
+ *  files in parallel, so loading only has to create the objects.
+ *  The subdirectories found in each search path are saved in a cache file
+ *  with the modification time of the search path, so unchanged ones (like
+ *  the addons directory when nothing was installed) aren't listed and
+ *  probed again.
+ */
+class AssetScanner : public NoCopy
+{
+public:
+    /** A directory with the config file, in the same order as found by
+     *  listing the search paths. */
+    struct Asset
+    {
+        std::string m_dir;
+        std::string m_config_file;
+        /** NULL if the file couldn't be read directly (like from an
+         *  archive), it's then parsed when loading as before. */
+        std::unique_ptr<XMLNode> m_root;
+    };
+
+private:
+    struct CachedDir
+    {
+        int64_t m_mtime;
+        /** Subdirectories with the config file, "." for the directory
+         *  itself. */
+        std::vector<std::string> m_subdirs;
+    };
+
+    /** Name of the config file, like kart.xml. */
+    const std::string m_config_name;
+
+    /** If directories of assets end with '/' (tracks) or not (karts). */
+    const bool m_trailing_slash;
+
+    const std::string m_cache_file;
+
+    std::map<std::string, CachedDir> m_cache;
+
+    // ------------------------------------------------------------------------
+    std::string getConfigFile(const std::string& dir) const
+    {
+        return m_trailing_slash ? dir + m_config_name :
+            dir + "/" + m_config_name;
+    }
+    // ------------------------------------------------------------------------
+    std::vector<std::string> listDir(const std::string& dir) const;
+    // ------------------------------------------------------------------------
+    void loadCache();
+    // ------------------------------------------------------------------------
+    void saveCache() const;
+    // ------------------------------------------------------------------------
+    static void parseAll(std::vector<Asset>& assets);
+
+public:
+    AssetScanner(const std::string& config_name, bool trailing_slash);
+    // ------------------------------------------------------------------------
+    std::vector<Asset> scan(const std::vector<std::string>& search_paths);
+
+};   // class AssetScanner
+
+#endif // HEADER_ASSET_SCANNER_HPP
@@ -266,6 +266,7 @@ FileManager::FileManager()
     checkAndCreateScreenshotDir();
     checkAndCreateReplayDir();
     checkAndCreateCachedTexturesDir();
+    checkAndCreateCacheDir();
     checkAndCreateGPDir();
 
     redirectOutput();
@@ -841,6 +842,15 @@ std::string FileManager::getCachedTexturesDir() const
     return m_cached_textures_dir;
 }   // getCachedTexturesDir
 
+//-----------------------------------------------------------------------------
+/** Returns the directory in which data generated from the assets (other than
+ *  textures) should be cached.
+ */
+std::string FileManager::getCacheDir() const
+{
+    return m_cache_dir;
+}   // getCacheDir
+
 //-----------------------------------------------------------------------------
 /** Returns the directory in which user-defined grand prix should be stored.
  */
@@ -1201,6 +1211,32 @@ void FileManager::checkAndCreateCachedTexturesDir()
 
 }   // checkAndCreateCachedTexturesDir
 
+// ----------------------------------------------------------------------------
+/** Creates the directory for other cached data. This will set m_cache_dir
+ *  with the appropriate path.
+ */
+void FileManager::checkAndCreateCacheDir()
+{
+#if defined(WIN32) || defined(__HAIKU__)
+    m_cache_dir = m_user_config_dir + "cached-data/";
+#elif defined(__APPLE__)
+    m_cache_dir = getenv("HOME");
+    m_cache_dir += "/Library/Application Support/SuperTuxKart/CachedData/";
+#else
+    m_cache_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart",
+                                         ".cache/", ".");
+    m_cache_dir += "cached-data/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cache_dir))
+    {
+        Log::error("FileManager", "Can not create cache directory '%s', "
+            "falling back to '.'.", m_cache_dir.c_str());
+        m_cache_dir = ".";
+    }
+
+}   // checkAndCreateCacheDir
+
 // ----------------------------------------------------------------------------
 /** Creates the directories for user-defined grand prix. This will set m_gp_dir
  *  with the appropriate path.
@@ -98,6 +98,9 @@ private:
     /** Directory where resized textures are cached. */
     std::string       m_cached_textures_dir;
 
+    /** Directory where other data generated from the assets is cached. */
+    std::string       m_cache_dir;
+
     /** Directory where user-defined grand prix are stored. */
     std::string       m_gp_dir;
 
@@ -128,6 +131,7 @@ private:
     void              checkAndCreateScreenshotDir();
     void              checkAndCreateReplayDir();
     void              checkAndCreateCachedTexturesDir();
+    void              checkAndCreateCacheDir();
     void              checkAndCreateGPDir();
     void              discoverPaths();
     void              addAssetsSearchPath();
@@ -154,6 +158,7 @@ public:
     std::string       getScreenshotDir() const;
     std::string       getReplayDir() const;
     std::string       getCachedTexturesDir() const;
+    std::string       getCacheDir() const;
     std::string       getGPDir() const;
     bool              checkAndCreateDirectory(const std::string &path);
     bool              checkAndCreateDirectoryP(const std::string &path);
@@ -86,6 +86,18 @@ XMLNode::~XMLNode()
     m_nodes.clear();
 }   // ~XMLNode
 
+// ----------------------------------------------------------------------------
+/** Sets the file name shown in error messages of this node and all its
+ *  children, for trees created from a string with the content of a file.
+ *  \param filename Name of the XML file.
+ */
+void XMLNode::setFileName(const std::string &filename)
+{
+    m_file_name = filename;
+    for (unsigned int i = 0; i < m_nodes.size(); i++)
+        m_nodes[i]->setFileName(filename);
+}   // setFileName
+
 // ----------------------------------------------------------------------------
 /** Stores all attributes, and reads in all children.
  *  \param xml The XML reader.
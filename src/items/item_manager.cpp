@@ -53,6 +53,9 @@ std::vector<std::string>     ItemManager::m_icon;
 bool                         ItemManager::m_disable_item_collection = false;
 std::mt19937                 ItemManager::m_random_engine;
 uint32_t                     ItemManager::m_random_seed = 0;
+// Item::hitKart halves the vertical part of the distance, so a kart hits an
+// item at most sqrt(4 * 1.2) (m_distance_2 in Item) away
+const float                  ItemManager::ITEM_CELL_SIZE = 2.5f;
 
 //-----------------------------------------------------------------------------
 /** Loads the default item meshes (high- and low-resolution).
@@ -253,10 +256,15 @@ unsigned int ItemManager::insertItem(Item *item)
 
 //-----------------------------------------------------------------------------
 /** Insert into the appropriate quad list, if there is a quad list
- *  (i.e. race mode has a quad graph).
+ *  (i.e. race mode has a quad graph), and into the spatial hash used to
+ *  detect item hits.
  */
 void ItemManager::insertItemInQuad(Item *item)
 {
+    const Vec3& xyz = item->getXYZ();
+    m_items_in_cells[getItemCellKey(getItemCell(xyz.getX()),
+                                    getItemCell(xyz.getZ()))].push_back(item);
+
     if(m_items_in_quads)
     {
         int graph_node = item->getGraphNode();
@@ -388,26 +396,43 @@ void ItemManager::collectedItem(ItemState *item, AbstractKart *kart)
  */
 void  ItemManager::checkItemHit(AbstractKart* kart)
 {
-    // We could use m_items_in_quads to to check for item hits: take the quad
-    // of the graph node of the kart, and only check items in that quad. But
-    // then we also need to check for any adjacent quads (since an item just
-    // on the order of one quad might get hit from an adjacent quad). Then
-    // it is possible that a quad is that short that we need to test adjacent
-    // of adjacent quads. And check for items outside of the track.
-    // Since at this stace item detection is by far not a bottle neck,
-    // the original, simple and stable algorithm is left in place.
-
     /** Disable item collection detection for debug purposes. */
     if(m_disable_item_collection) return;
 
-    // Spare tire karts don't collect items
+    // Only the items in the 3x3 cells around the kart can be hit. They are
+    // tested in the order of their index, the same as testing all items.
+    const Vec3& xyz = kart->getXYZ();
+    const int cx = getItemCell(xyz.getX());
+    const int cz = getItemCell(xyz.getZ());
+    AllItemTypes nearby_items;
+    for (int x = cx - 1; x <= cx + 1; x++)
+    {
+        for (int z = cz - 1; z <= cz + 1; z++)
+        {
+            auto cell = m_items_in_cells.find(getItemCellKey(x, z));
+            if (cell != m_items_in_cells.end())
+            {
+                nearby_items.insert(nearby_items.end(), cell->second.begin(),
+                                    cell->second.end());
+            }
+        }
+    }
+    if (nearby_items.empty()) return;
+    std::sort(nearby_items.begin(), nearby_items.end(),
+        [](const ItemState* a, const ItemState* b)
+        {
+            return a->getItemId() < b->getItemId();
+        });
+
+    // Spare tire karts don't collect items, this is tested only if there is
+    // any item close to avoid the dynamic_cast most of the time
     if ( dynamic_cast<SpareTireAI*>(kart->getController()) ) return;
 
-    for(AllItemTypes::iterator i =m_all_items.begin();
-                               i!=m_all_items.end();  i++)
+    for(AllItemTypes::iterator i =nearby_items.begin();
+                               i!=nearby_items.end();  i++)
     {
         // Ignore items that have been collected or are not available atm
-        if ((!*i) || !(*i)->isAvailable() || (*i)->isUsedUp()) continue;
+        if (!(*i)->isAvailable() || (*i)->isUsedUp()) continue;
 
         // Shielded karts can simply drive over bubble gums without any effect
         if ( kart->isShielded() &&
@@ -424,7 +449,7 @@ void  ItemManager::checkItemHit(AbstractKart* kart)
         {
             collectedItem(*i, kart);
         }   // if hit
-    }   // for m_all_items
+    }   // for nearby_items
 }   // checkItemHit
 
 //-----------------------------------------------------------------------------
@@ -535,11 +560,27 @@ void ItemManager::deleteItem(ItemState *item)
 }   // delete item
 
 //-----------------------------------------------------------------------------
-/** Removes an items from the items-in-quad list only
+/** Removes an items from the items-in-quad list and the spatial hash only.
  *  \param The item to delete.
  */
 void ItemManager::deleteItemInQuad(ItemState* item)
 {
+    const Vec3& xyz = item->getXYZ();
+    auto cell = m_items_in_cells.find(getItemCellKey(
+        getItemCell(xyz.getX()), getItemCell(xyz.getZ())));
+    assert(cell != m_items_in_cells.end());
+    if (cell != m_items_in_cells.end())
+    {
+        AllItemTypes& items = cell->second;
+        AllItemTypes::iterator it = std::find(items.begin(), items.end(),
+                                              item);
+        assert(it != items.end());
+        if (it != items.end())
+            items.erase(it);
+        if (items.empty())
+            m_items_in_cells.erase(cell);
+    }
+
     if(m_items_in_quads)
     {
         int sector = item->getGraphNode();
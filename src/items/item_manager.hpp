@@ -35,6 +35,7 @@
 #include <memory>
 #include <random>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Kart;
@@ -113,6 +114,26 @@ private:
      *  field is undefined if no Graph exist, e.g. arena without navmesh. */
     std::vector< AllItemTypes > *m_items_in_quads;
 
+    /** Spatial hash of all items on a 2d (x, z) grid, used by checkItemHit
+     *  to only test the items near a kart. */
+    std::unordered_map<uint64_t, AllItemTypes> m_items_in_cells;
+
+    /** Size of a cell in m_items_in_cells, it must be at least the largest
+     *  distance at which an item can be hit, so only the 3x3 cells around
+     *  a kart need to be tested. */
+    static const float ITEM_CELL_SIZE;
+
+    // ------------------------------------------------------------------------
+    static int getItemCell(float f)
+    {
+        return (int)floorf(f / ITEM_CELL_SIZE);
+    }
+    // ------------------------------------------------------------------------
+    static uint64_t getItemCellKey(int x, int z)
+    {
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+    }
+
     /** Stores all item models. */
     static std::vector<scene::IMesh *> m_item_mesh;
 
@@ -92,7 +92,7 @@ void NetworkItemManager::collectedItem(ItemState *item, AbstractKart *kart)
                   World::getWorld()->getTicksSinceStart(),
                   item->getItemId(), item->getType(), item->getTicksTillReturn());
 
-    if(NetworkConfig::get()->isServer())
+    if (!NetworkConfig::get()->isClient())
     {
         ItemManager::collectedItem(item, kart);
         // The server saves the collected item as item event info
@@ -116,7 +116,7 @@ void NetworkItemManager::collectedItem(ItemState *item, AbstractKart *kart)
  */
 void NetworkItemManager::switchItems()
 {
-    if (NetworkConfig::get()->isServer())
+    if (!NetworkConfig::get()->isClient())
     {
         // The server saves the collected item as item event info
         m_item_events.lock();
@@ -219,29 +219,19 @@ void NetworkItemManager::setItemConfirmationTime(std::weak_ptr<STKPeer> peer,
  *  to save the initial state, which is the first confirmed state by all
  *  clients.
  */
-BareNetworkString* NetworkItemManager::saveState(std::vector<std::string>* ru)
+bool NetworkItemManager::saveState(BareNetworkString* buffer,
+                                   std::vector<std::string>* ru)
 {
     ru->push_back(getUniqueIdentity());
     // On the server:
     // ==============
     m_item_events.lock();
-    uint16_t n = (uint16_t)m_item_events.getData().size();
-    if(n==0)
-    {
-        BareNetworkString *s = new BareNetworkString();
-        m_item_events.unlock();
-        return s;
-    }
-
-    BareNetworkString *s =
-        new BareNetworkString(n * (  sizeof(int) + sizeof(uint16_t)
-                                   + sizeof(uint8_t)              ) );
-    for (auto p : m_item_events.getData())
+    for (auto& p : m_item_events.getData())
     {
-        p.saveState(s);
+        p.saveState(buffer);
     }
     m_item_events.unlock();
-    return s;
+    return true;
 }   // saveState
 
 //-----------------------------------------------------------------------------
@@ -484,7 +474,14 @@ void NetworkItemManager::restoreState(BareNetworkString *buffer, int count)
         // ... will be copied from item state to item
         if (is && item)
         {
+            // Keep the spatial hash of items up to date if the confirmed
+            // item is at a different location
+            const bool moved = item->getXYZ() != is->getXYZ();
+            if (moved)
+                deleteItemInQuad(item);
             *(ItemState*)item = *is;
+            if (moved)
+                insertItemInQuad(dynamic_cast<Item*>(item));
         }
         else if (is && !item)
         {
@@ -1928,13 +1928,7 @@ void SkiddingAI::computeNearestKarts()
     std::sort(overall_distance.begin(), overall_distance.end(), std::greater<float>());
    
     // Get the AI's position (the position update may not be done, leading to crashes)
-    int curr_position = 1;
-    for(unsigned int i=0; i<m_world->getNumKarts(); i++)
-    {
-        if(   m_world->getOverallDistance(i) > own_overall_distance
-           && !m_world->getKart(i)->isEliminated())
-            curr_position++;
-    }
+    int curr_position = 1 + m_world->getNumKartsAheadOf(own_overall_distance);
 
     for(unsigned int i=0; i<n; i++)
     {
@@ -62,6 +62,7 @@
 #include "karts/rescue_animation.hpp"
 #include "karts/skidding.hpp"
 #include "main_loop.hpp"
+#include "modes/benchmark.hpp"
 #include "modes/capture_the_flag.hpp"
 #include "modes/linear_world.hpp"
 #include "modes/overworld.hpp"
@@ -1440,7 +1441,9 @@ void Kart::update(int ticks)
     // based on the collision speed.
     m_body->setRestitution(m_kart_properties->getRestitution(fabsf(m_speed)));
 
+    Benchmark::beginSection(Benchmark::BS_AI);
     m_controller->update(ticks);
+    Benchmark::endSection(Benchmark::BS_AI);
 
 #ifndef SERVER_ONLY
 #undef DEBUG_CAMERA_SHAKE
@@ -1724,7 +1727,9 @@ void Kart::update(int ticks)
     }   // if there is material
     PROFILER_POP_CPU_MARKER();
 
+    Benchmark::beginSection(Benchmark::BS_ITEMS);
     Track::getCurrentTrack()->getItemManager()->checkItemHit(this);
+    Benchmark::endSection(Benchmark::BS_ITEMS);
 
     const bool emergency = has_animation_before;
 
@@ -70,7 +70,8 @@ std::string KartProperties::getHandicapAsString(HandicapLevel h)
  *  Otherwise the defaults are taken from STKConfig (and since they are all
  *  defined, it is guaranteed that each kart has well defined physics values).
  */
-KartProperties::KartProperties(const std::string &filename)
+KartProperties::KartProperties(const std::string &filename,
+                               const XMLNode *xml)
 {
     m_is_addon = false;
     m_icon_material = NULL;
@@ -103,7 +104,7 @@ KartProperties::KartProperties(const std::string &filename)
     // The default constructor for stk_config uses filename=""
     if (filename != "")
     {
-        load(filename, "kart");
+        load(filename, "kart", xml);
     }
     else
     {
@@ -214,13 +215,15 @@ void KartProperties::handleOnDemandLoadTexture()
 /** Loads the kart properties from a file.
  *  \param filename Filename to load.
  *  \param node Name of the xml node to load the data from
+ *  \param xml The already parsed file if not NULL.
  */
-void KartProperties::load(const std::string &filename, const std::string &node)
+void KartProperties::load(const std::string &filename, const std::string &node,
+                          const XMLNode *xml)
 {
     // Get the default values from STKConfig. This will also allocate any
     // pointers used in KartProperties
 
-    const XMLNode* root = new XMLNode(filename);
+    const XMLNode* root = xml ? xml : new XMLNode(filename);
     std::string kart_type;
 
     if (root->get("type", &kart_type))
@@ -275,7 +278,7 @@ void KartProperties::load(const std::string &filename, const std::string &node)
                    filename.c_str());
         Log::error("[KartProperties]", "%s", err.what());
     }
-    if(root) delete root;
+    if(root != xml) delete root;
 
     // Set a default group (that has to happen after init_default and load)
     if(m_groups.size()==0)
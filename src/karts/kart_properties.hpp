@@ -197,7 +197,8 @@ private:
     InterpolationArray m_restitution;
 
     void  load              (const std::string &filename,
-                             const std::string &node);
+                             const std::string &node,
+                             const XMLNode *xml = NULL);
     void combineCharacteristics(HandicapLevel h);
 
     void setWheelBase(float kart_length)
@@ -215,7 +216,8 @@ public:
     /** Returns the string representation of a handicap level. */
     static std::string      getHandicapAsString(HandicapLevel h);
 
-          KartProperties    (const std::string &filename="");
+          KartProperties    (const std::string &filename="",
+                             const XMLNode *xml = NULL);
          ~KartProperties    ();
     void  copyForPlayer     (const KartProperties *source,
                              HandicapLevel h = HANDICAP_NONE);
@@ -26,6 +26,7 @@
 #include "config/user_config.hpp"
 #include "graphics/irr_driver.hpp"
 #include "guiengine/engine.hpp"
+#include "io/asset_scanner.hpp"
 #include "io/file_manager.hpp"
 #include "karts/kart_properties.hpp"
 #include "karts/xml_characteristic.hpp"
@@ -161,31 +162,22 @@ void KartPropertiesManager::removeKart(const std::string &ident)
 void KartPropertiesManager::loadAllKarts(bool loading_icon)
 {
     m_all_kart_dirs.clear();
-    std::vector<std::string>::const_iterator dir;
-    for(dir = m_kart_search_path.begin(); dir!=m_kart_search_path.end(); dir++)
+    // Each search path contains a kart or subdirectories with karts, all
+    // kart.xml are parsed in parallel first
+    AssetScanner scanner("kart.xml", /*trailing_slash*/false);
+    std::vector<AssetScanner::Asset> karts = scanner.scan(m_kart_search_path);
+    for (AssetScanner::Asset& kart : karts)
     {
-        // First check if there is a kart in the current directory
-        // -------------------------------------------------------
-        if(loadKart(*dir)) continue;
-
-        // If not, check each subdir of this directory.
-        // --------------------------------------------
-        std::set<std::string> result;
-        file_manager->listFiles(result, *dir);
-        for(std::set<std::string>::const_iterator subdir=result.begin();
-            subdir!=result.end(); subdir++)
-        {
-            const bool loaded = loadKart(*dir+*subdir);
+        const bool loaded = loadKart(kart.m_dir, kart.m_root.get());
 
-            if (loaded && loading_icon)
-            {
-                GUIEngine::addLoadingIcon(irr_driver->getTexture(
-                    m_karts_properties[m_karts_properties.size()-1]
-                            .getAbsoluteIconFile()              )
-                                          );
-            }
-        }   // for all files in the currently handled directory
-    }   // for i
+        if (loaded && loading_icon)
+        {
+            GUIEngine::addLoadingIcon(irr_driver->getTexture(
+                m_karts_properties[m_karts_properties.size()-1]
+                        .getAbsoluteIconFile()              )
+                                      );
+        }
+    }   // for all karts
 }   // loadAllKarts
 
 //-----------------------------------------------------------------------------
@@ -248,8 +240,10 @@ void KartPropertiesManager::loadCharacteristics(const XMLNode *root)
 //-----------------------------------------------------------------------------
 /** Loads a single kart and (if not disabled) the corresponding 3d model.
  *  \param filename Full path to the kart config file.
+ *  \param xml The already parsed kart.xml if not NULL.
  */
-bool KartPropertiesManager::loadKart(const std::string &dir)
+bool KartPropertiesManager::loadKart(const std::string &dir,
+                                     const XMLNode *xml)
 {
     std::string config_filename = dir + "/kart.xml";
     if(!file_manager->fileExists(config_filename))
@@ -258,7 +252,7 @@ bool KartPropertiesManager::loadKart(const std::string &dir)
     KartProperties* kart_properties;
     try
     {
-        kart_properties = new KartProperties(config_filename);
+        kart_properties = new KartProperties(config_filename, xml);
     }
     catch (std::runtime_error& err)
     {
@@ -0,0 +1,104 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "karts/kart_proximity_index.hpp"
+
+#include "karts/abstract_kart.hpp"
+#include "karts/kart_properties.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/** Size of a grid cell in metres, about the usual slipstream length. */
+static const float KART_CELL_SIZE = 10.0f;
+
+/** Speed a kart may gain during one update (e.g. by a zipper) on top of its
+ *  current speed, used to bound the slipstream length. */
+static const float MAX_SPEED_GAIN = 10.0f;
+
+// ----------------------------------------------------------------------------
+int KartProximityIndex::getCell(float f)
+{
+    float cell = floorf(f / KART_CELL_SIZE);
+    // Karts far outside of the track (e.g. falling) end up in the last cell
+    if (cell < -1000000.0f)
+        return -1000000;
+    if (cell > 1000000.0f)
+        return 1000000;
+    return (int)cell;
+}   // getCell
+
+// ----------------------------------------------------------------------------
+/** Rebuilds the index from the current position of all karts.
+ */
+void KartProximityIndex::update(
+                       const std::vector<std::shared_ptr<AbstractKart> >& karts)
+{
+    m_cells.clear();
+    m_xyz.clear();
+    m_max_slipstream_length = 0.0f;
+    for (unsigned int i = 0; i < karts.size(); i++)
+    {
+        const AbstractKart* kart = karts[i].get();
+        const Vec3& xyz = kart->getXYZ();
+        m_xyz.push_back(xyz);
+        m_cells.emplace_back(getCellKey(getCell(xyz.x()), getCell(xyz.z())),
+            i);
+
+        // Same as the quick test in SlipStream::update, with the largest
+        // speed the kart can have in this update
+        float speed = fabsf(kart->getSpeed());
+        if (kart->getBody())
+            speed = std::max(speed, kart->getVelocity().length());
+        const KartProperties* kp = kart->getKartProperties();
+        float l = kp->getSlipstreamLength() * 1.1f *
+            (speed + MAX_SPEED_GAIN) / kp->getSlipstreamBaseSpeed() +
+            kart->getKartLength();
+        m_max_slipstream_length = std::max(m_max_slipstream_length, l);
+    }
+    std::sort(m_cells.begin(), m_cells.end());
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Returns the world ids (sorted) of all karts which were at most radius
+ *  away from xyz when the index was built.
+ */
+void KartProximityIndex::getKartsInRange(const Vec3& xyz, float radius,
+                                         std::vector<unsigned int>* karts) const
+{
+    karts->clear();
+    const int min_x = getCell(xyz.x() - radius);
+    const int max_x = getCell(xyz.x() + radius);
+    const int min_z = getCell(xyz.z() - radius);
+    const int max_z = getCell(xyz.z() + radius);
+    const float radius2 = radius * radius;
+    for (int x = min_x; x <= max_x; x++)
+    {
+        // All cells of one x are next to each other in m_cells
+        auto it = std::lower_bound(m_cells.begin(), m_cells.end(),
+            std::make_pair(getCellKey(x, min_z), 0u));
+        const uint64_t last_key = getCellKey(x, max_z);
+        for (; it != m_cells.end() && it->first <= last_key; it++)
+        {
+            if ((m_xyz[it->second] - xyz).length2() <= radius2)
+                karts->push_back(it->second);
+        }
+    }
+    std::sort(karts->begin(), karts->end());
+}   // getKartsInRange
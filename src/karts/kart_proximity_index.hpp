@@ -0,0 +1,82 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_KART_PROXIMITY_INDEX_HPP
+#define HEADER_KART_PROXIMITY_INDEX_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class AbstractKart;
+
+/** \ingroup karts */
+
+/** A uniform grid (in the x-z plane) of the kart positions, rebuilt once per
+ *  world update before the karts are updated. It's used to find karts close
+ *  to a point without testing all karts.
+ *  Positions are the ones at the beginning of the world update, so users
+ *  must still test the real positions of the karts returned.
+ */
+class KartProximityIndex : public NoCopy
+{
+private:
+    /** Cell key (x cell in the upper, z cell in the lower 32 bits) and
+     *  world kart id of each kart, sorted. */
+    std::vector<std::pair<uint64_t, unsigned int> > m_cells;
+
+    /** The positions of all karts when the index was built. */
+    std::vector<Vec3> m_xyz;
+
+    /** Upper bound of the distance (from the kart center) at which any kart
+     *  can give slipstream during this update. */
+    float m_max_slipstream_length;
+
+    // ------------------------------------------------------------------------
+    static int getCell(float f);
+    // ------------------------------------------------------------------------
+    static uint64_t getCellKey(int x, int z)
+    {
+        // Flip the sign bits so that negative cells are sorted first
+        return ((uint64_t)((uint32_t)x ^ 0x80000000u) << 32) |
+            ((uint32_t)z ^ 0x80000000u);
+    }   // getCellKey
+
+public:
+    // ------------------------------------------------------------------------
+    KartProximityIndex() : m_max_slipstream_length(0.0f) {}
+    // ------------------------------------------------------------------------
+    void update(const std::vector<std::shared_ptr<AbstractKart> >& karts);
+    // ------------------------------------------------------------------------
+    void getKartsInRange(const Vec3& xyz, float radius,
+                         std::vector<unsigned int>* karts) const;
+    // ------------------------------------------------------------------------
+    /** Returns true if the index was built for this number of karts. */
+    bool isValid(unsigned int num_karts) const
+                                         { return m_xyz.size() == num_karts; }
+    // ------------------------------------------------------------------------
+    float getMaxSlipstreamLength() const   { return m_max_slipstream_length; }
+
+};   // KartProximityIndex
+
+#endif
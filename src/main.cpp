@@ -158,6 +158,7 @@
 #  endif
 #else
 #  include <signal.h>
+#  include <sys/wait.h>
 #  include <unistd.h>
 #endif
 
@@ -242,6 +243,7 @@ extern "C" {
 #include "karts/kart_properties.hpp"
 #include "karts/kart_properties_manager.hpp"
 #include "karts/official_karts.hpp"
+#include "modes/benchmark.hpp"
 #include "modes/cutscene_world.hpp"
 #include "modes/demo_world.hpp"
 #include "network/protocols/connect_to_server.hpp"
@@ -294,6 +296,9 @@ extern "C" {
 #include "io/rich_presence.hpp"
 
 #include <IrrlichtDevice.h>
+#ifndef SERVER_ONLY
+#include <ge_culling_boxes.hpp>
+#endif
 
 static void cleanSuperTuxKart();
 static void cleanUserConfig();
@@ -592,6 +597,10 @@ void cmdLineHelp()
                               "laps.\n"
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
+    "       --benchmark=n      Run n seconds of a game with AI karts only and\n"
+    "                          report the time used by the server side\n"
+    "                          simulation (use with --no-graphics, --track,\n"
+    "                          --mode and --numkarts).\n"
     "       --unlock-all       Permanently unlock all karts and tracks for testing.\n"
     "       --no-unlock-all    Disable unlock-all (i.e. base unlocking on player achievement).\n"
     "       --xmas=n           Toggle Xmas/Christmas mode. n=0 Use current date, n=1, Always enable,\n"
@@ -606,9 +615,15 @@ void cmdLineHelp()
     "                          spaces are allowed in the track names.\n"
     "       --demo-laps=n      Number of laps to use in a demo.\n"
     "       --demo-karts=n     Number of karts to use in a demo.\n"
-    "       --history          Replay history file 'history.dat'.\n"
+    "       --history[=file]   Replay history file 'history.dat' or the given\n"
+    "                          file. Histories saved by a server (save-history)\n"
+    "                          are re-simulated like on the server, use with\n"
+    "                          --benchmark=n to time them.\n"
     "       --server-config=file Specify the server_config.xml for server hosting, it will create\n"
     "                            one if not found.\n"
+    "       --server-rooms=f1,f2 Host one more server for each server config file in processes\n"
+    "                          forked after loading karts and tracks, so they share that\n"
+    "                          memory (with --server-config, not available on Windows).\n"
     "       --network-console  Enable network console.\n"
     "       --wan-server=name  Start a Wan server (not a playing client).\n"
     "       --public-server    Allow direct connection to the server (without stk server)\n"
@@ -1016,7 +1031,8 @@ int handleCmdLinePreliminary()
 /** Handles command line options.
  *  \param argc Number of command line options
  */
-int handleCmdLine(bool has_server_config, bool has_parent_process)
+int handleCmdLine(bool has_server_config, bool has_parent_process,
+                  const std::string& server_room_config)
 {
     // Some generic variables used in scanning:
     int n;
@@ -1377,6 +1393,14 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         NetworkConfig::get()->setIsPublicServer();
     }
 
+    if (!server_room_config.empty())
+    {
+        // Server options above are for the main server, a forked room only
+        // uses its own config. Only the main process reads stdin.
+        ServerConfig::loadServerConfig(server_room_config);
+        STKHost::m_enable_console = false;
+    }
+
     unsigned server_id = 0;
     if ((NetworkConfig::get()->isServer() && ServerConfig::m_wan_server) ||
         CommandLine::has("--server-id", &server_id))
@@ -1726,8 +1750,25 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         RaceManager::get()->setNumLaps(999999); // profile end depends on time
     }   // --profile-time
 
-    if(CommandLine::has("--history"))
+    if (CommandLine::has("--benchmark", &n))
+    {
+        if (n <= 0)
+        {
+            Log::error("main", "Invalid benchmark time: %i.", n);
+            return 0;
+        }
+        Log::verbose("main", "Benchmark: %d seconds.", n);
+        UserConfigParams::m_no_start_screen = true;
+        Benchmark::enable((float)n);
+        RaceManager::get()->setNumLaps(999999); // end depends on time
+    }   // --benchmark
+
+    std::string history_file;
+    if (CommandLine::has("--history", &history_file) ||
+        CommandLine::has("--history"))
     {
+        if (!history_file.empty())
+            history->setFilename(history_file);
         history->setReplayHistory(true);
         // Force the no-start screen flag, since this initialises
         // the player structures correctly.
@@ -1784,7 +1825,8 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
 
     CommandLine::reportInvalidParameters();
 
-    if (ProfileWorld::isProfileMode() || GUIEngine::isNoGraphics())
+    if (ProfileWorld::isProfileMode() || Benchmark::isEnabled() ||
+        GUIEngine::isNoGraphics())
     {
         UserConfigParams::m_sfx = false;  // Disable sound effects
         UserConfigParams::m_music = false;// and music when profiling
@@ -1843,7 +1885,7 @@ void clearGlobalVariables()
 }   // clearGlobalVariables
 
 //=============================================================================
-void initRest()
+void initRest(bool start_network_thread)
 {
     SP::setMaxTextureSize();
     irr_driver = new IrrDriver();
@@ -1922,7 +1964,8 @@ void initRest()
     // The rest will be read later (since the rest needs the unlock- and
     // achievement managers to be created, which can only be created later).
     PlayerManager::create();
-    Online::RequestManager::get()->startNetworkThread();
+    if (start_network_thread)
+        Online::RequestManager::get()->startNetworkThread();
 #ifndef SERVER_ONLY
     if (!GUIEngine::isNoGraphics())
         NewsManager::get();   // this will create the news manager
@@ -1991,6 +2034,87 @@ void initRest()
 
 }   // initRest
 
+//=============================================================================
+#if !defined(WIN32) && !defined(MOBILE_STK) && !defined(__SWITCH__)
+/** Process id of each forked server room, 0 once it has been reaped. */
+static std::vector<pid_t> g_server_room_pids;
+
+// ----------------------------------------------------------------------------
+/** SIGCHLD handler of the main process, reaps the server rooms which stopped
+ *  so they don't stay as zombie processes. */
+static void reapServerRooms(int)
+{
+    int saved_errno = errno;
+    for (pid_t& pid : g_server_room_pids)
+    {
+        if (pid != 0 && waitpid(pid, NULL, WNOHANG) == pid)
+            pid = 0;
+    }
+    errno = saved_errno;
+}   // reapServerRooms
+#endif
+
+// ----------------------------------------------------------------------------
+/** Forks a process for each additional server room, after karts, tracks and
+ *  models are loaded so all rooms share that memory (copy on write) instead
+ *  of each server process loading it. Each forked process uses the server
+ *  config of its room (loaded in handleCmdLine, so the options of the main
+ *  server don't override it) and its own log file, doesn't save the user
+ *  config, and stops with the main process.
+ *  It must be called before any thread is started.
+ *  \param server_rooms Server config file of each additional room.
+ *  \return The server config of the room in a forked process, empty in the
+ *  main process.
+ */
+static std::string forkServerRooms(const std::vector<std::string>& server_rooms)
+{
+#if defined(WIN32) || defined(MOBILE_STK) || defined(__SWITCH__)
+    Log::warn("main", "--server-rooms is not supported on this platform.");
+#else
+    Log::flushBuffers();
+    const unsigned parent_pid = (unsigned)getpid();
+    for (const std::string& config : server_rooms)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            Log::error("main", "Failed to fork server room for %s.",
+                config.c_str());
+            continue;
+        }
+        if (pid != 0)
+        {
+            Log::info("main", "Server room for %s started in process %d.",
+                config.c_str(), (int)pid);
+            g_server_room_pids.push_back(pid);
+            continue;
+        }
+        g_server_room_pids.clear();
+        Log::closeOutputFiles();
+        FileManager::setStdoutName(StringUtils::removeExtension(
+            StringUtils::getBasename(config)) + ".log");
+        file_manager->redirectOutput();
+        // All processes share the user config file
+        user_config->disableSaving();
+        srand((unsigned)time(0) ^ (unsigned)getpid());
+        // Exit when the main server process is gone
+        delete main_loop;
+        main_loop = new MainLoop(parent_pid);
+        return config;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = reapServerRooms;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+    // Rooms which stopped before the handler was set
+    reapServerRooms(SIGCHLD);
+#endif
+    return "";
+}   // forkServerRooms
+
 //=============================================================================
 void askForInternetPermission()
 {
@@ -2179,6 +2303,11 @@ int main(int argc, char *argv[])
                     StringUtils::removeExtension(base_name) + ".log");
             }
         }
+        // Server config of additional rooms, see forkServerRooms
+        std::vector<std::string> server_rooms;
+        if (!server_config.empty() && !CommandLine::has("--graphical-server")
+            && CommandLine::has("--server-rooms", &s))
+            server_rooms = StringUtils::split(s, ',');
 
         if(CommandLine::has("--root", &s))
             FileManager::addRootDirs(s);
@@ -2261,7 +2390,8 @@ int main(int argc, char *argv[])
         // Create the story mode timer with empty setting first, it will
         // be reset later after story mode status and player manager is loaded
         story_mode_timer = new StoryModeTimer();
-        initRest();
+        // Thread can only be started after forking server rooms
+        initRest(server_rooms.empty()/*start_network_thread*/);
 
 #ifdef ENABLE_WIIUSE
         wiimote_manager = new WiimoteManager();
@@ -2336,8 +2466,16 @@ int main(int argc, char *argv[])
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI_ICON,
                                                           "banana.png")    );
 
+        std::string server_room_config;
+        if (!server_rooms.empty())
+        {
+            server_room_config = forkServerRooms(server_rooms);
+            Online::RequestManager::get()->startNetworkThread();
+        }
+
         //handleCmdLine() needs InitTuxkart() so it can't be called first
-        if (!handleCmdLine(!server_config.empty(), has_parent_process))
+        if (!handleCmdLine(!server_config.empty(), has_parent_process,
+            server_room_config))
             exit(0);
 
 #ifndef SERVER_ONLY
@@ -2564,7 +2702,16 @@ int main(int argc, char *argv[])
 
         // Not replaying
         // =============
-        if(!ProfileWorld::isProfileMode())
+        if (Benchmark::isEnabled())
+        {
+            // Benchmark
+            // =========
+            RaceManager::get()->setMajorMode(RaceManager::MAJOR_MODE_SINGLE);
+            RaceManager::get()->setNumPlayers(0);
+            RaceManager::get()->setupPlayerKartInfo();
+            RaceManager::get()->startNew(false);
+        }
+        else if(!ProfileWorld::isProfileMode())
         {
             if(UserConfigParams::m_no_start_screen)
             {
@@ -2807,6 +2954,10 @@ void runUnitTests()
     Log::info("UnitTest", "=====================");
     Log::info("UnitTest", "MiniGLM");
     MiniGLM::unitTesting();
+#ifndef SERVER_ONLY
+    Log::info("UnitTest", "GECullingBoxes");
+    GE::GECullingBoxes::unitTesting();
+#endif
     Log::info("UnitTest", "GraphicsRestrictions");
     GraphicsRestrictions::unitTesting();
     Log::info("UnitTest", "NetworkString");
@@ -35,6 +35,7 @@
 #include "guiengine/modaldialog.hpp"
 #include "guiengine/screen_keyboard.hpp"
 #include "input/input_manager.hpp"
+#include "modes/benchmark.hpp"
 #include "modes/world.hpp"
 #include "modes/profile_world.hpp"
 #include "network/network_config.hpp"
@@ -221,9 +222,10 @@ double MainLoop::getLimitedDt()
     }
 #endif
 
-    // In profile mode without graphics, run with a fixed dt of 1/60
+    // In profile mode without graphics and in benchmark mode, run with a
+    // fixed dt of 1/60
     if ((ProfileWorld::isProfileMode() && GUIEngine::isNoGraphics()) ||
-        UserConfigParams::m_arena_ai_stats)
+        Benchmark::isEnabled() || UserConfigParams::m_arena_ai_stats)
     {
         return 1.0f/60.0f;
     }
@@ -642,7 +644,11 @@ void MainLoop::run()
                 PROFILER_PUSH_CPU_MARKER("Update race", 0, 255, 255);
                 if (World::getWorld())
                 {
+                    if (Benchmark::isEnabled())
+                        Benchmark::beginTick();
                     updateRace(1, fast_forward);
+                    if (Benchmark::isEnabled())
+                        Benchmark::endTick();
                 }
                 PROFILER_POP_CPU_MARKER();
 
@@ -722,6 +728,7 @@ void MainLoop::run()
         if ((UserConfigParams::m_swap_interval == 0 ||
             GUIEngine::isNoGraphics()) &&
             m_throttle_fps && !ProfileWorld::isProfileMode() &&
+            !Benchmark::isEnabled() &&
             current_fps > max_fps)
         {
             double wait_time = 1.0 / max_fps - 1.0 / current_fps;
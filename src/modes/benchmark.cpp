@@ -0,0 +1,162 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "modes/benchmark.hpp"
+
+#include "config/stk_config.hpp"
+#include "main_loop.hpp"
+#include "modes/world.hpp"
+#include "network/protocols/game_protocol.hpp"
+#include "network/rewind_manager.hpp"
+#include "race/race_manager.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+
+bool  Benchmark::m_enabled  = false;
+bool  Benchmark::m_finished = false;
+float Benchmark::m_time     = 0.0f;
+std::chrono::steady_clock::time_point Benchmark::m_section_start[BS_COUNT];
+double Benchmark::m_tick_time[BS_COUNT];
+int Benchmark::m_tick_count[BS_COUNT];
+std::vector<float> Benchmark::m_samples[BS_COUNT];
+std::vector<unsigned> Benchmark::m_state_sizes;
+std::shared_ptr<GameProtocol> Benchmark::m_game_protocol;
+
+//-----------------------------------------------------------------------------
+/** Enables benchmark mode.
+ *  \param time Game time in seconds to run the benchmark for, not counting
+ *         the time before the start of the race.
+ */
+void Benchmark::enable(float time)
+{
+    m_enabled  = true;
+    m_finished = false;
+    m_time     = time;
+    for (int i = 0; i < BS_COUNT; i++)
+    {
+        m_tick_time[i]  = 0.0;
+        m_tick_count[i] = 0;
+        m_samples[i].clear();
+    }
+    m_state_sizes.clear();
+}   // enable
+
+//-----------------------------------------------------------------------------
+/** Called by the main loop before a world update of one tick. */
+void Benchmark::beginTick()
+{
+    if (m_finished)
+        return;
+    // Created here as it needs the item manager of the loaded track, a
+    // replayed history has its own
+    if (!m_game_protocol && RewindManager::isEnabled() &&
+        GameProtocol::emptyInstance())
+        m_game_protocol = GameProtocol::createInstance();
+    beginSection(BS_TICK);
+}   // beginTick
+
+//-----------------------------------------------------------------------------
+/** Called by the main loop after a world update of one tick. The times are
+ *  only kept once the race has started. Aborts the game when the benchmark
+ *  time is over or the game ended.
+ */
+void Benchmark::endTick()
+{
+    if (m_finished)
+        return;
+    endSection(BS_TICK);
+
+    World* world = World::getWorld();
+    const bool measure = world && world->isActiveRacePhase();
+    for (int i = 0; i < BS_COUNT; i++)
+    {
+        if (measure && m_tick_count[i] > 0)
+            m_samples[i].push_back((float)m_tick_time[i]);
+        m_tick_time[i]  = 0.0;
+        m_tick_count[i] = 0;
+    }
+    if (!measure)
+        m_state_sizes.clear();
+
+    const int ticks = (int)m_samples[BS_TICK].size();
+    if (ticks < stk_config->time2Ticks(m_time) && (measure || ticks == 0))
+        return;
+
+    report();
+    m_finished = true;
+    m_game_protocol.reset();
+    main_loop->requestAbort();
+}   // endTick
+
+//-----------------------------------------------------------------------------
+/** Returns the value at the given fraction of the sorted values. */
+template<typename T>
+static T getPercentile(const std::vector<T>& sorted, float fraction)
+{
+    size_t n = (size_t)(fraction * (float)(sorted.size() - 1) + 0.5f);
+    return sorted[std::min(n, sorted.size() - 1)];
+}   // getPercentile
+
+//-----------------------------------------------------------------------------
+/** Prints the percentiles of the time of each section and the state sizes.
+ */
+void Benchmark::report()
+{
+    static const char* names[BS_COUNT] =
+        { "tick", "karts", "ai", "physics", "items", "state save" };
+
+    Log::info("Benchmark", "%s on %s with %d karts, %d ticks measured.",
+        World::getWorld() ? World::getWorld()->getIdent().c_str() : "",
+        RaceManager::get()->getTrackName().c_str(),
+        RaceManager::get()->getNumberOfKarts(),
+        (int)m_samples[BS_TICK].size());
+    Log::info("Benchmark", "%-12s %7s %9s %9s %9s %9s %9s", "section (us)",
+        "count", "mean", "p50", "p90", "p99", "max");
+    for (int i = 0; i < BS_COUNT; i++)
+    {
+        std::vector<float>& samples = m_samples[i];
+        if (samples.empty())
+        {
+            Log::info("Benchmark", "%-12s %7d", names[i], 0);
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        double total = 0.0;
+        for (float f : samples)
+            total += f;
+        Log::info("Benchmark", "%-12s %7d %9.1f %9.1f %9.1f %9.1f %9.1f",
+            names[i], (int)samples.size(), total / samples.size(),
+            getPercentile(samples, 0.5f), getPercentile(samples, 0.9f),
+            getPercentile(samples, 0.99f), samples.back());
+    }
+
+    if (m_state_sizes.empty())
+    {
+        Log::info("Benchmark", "No states saved.");
+        return;
+    }
+    std::sort(m_state_sizes.begin(), m_state_sizes.end());
+    double total = 0.0;
+    for (unsigned size : m_state_sizes)
+        total += size;
+    Log::info("Benchmark", "State size (bytes): count %d mean %.1f p50 %u "
+        "p99 %u max %u", (int)m_state_sizes.size(),
+        total / m_state_sizes.size(), getPercentile(m_state_sizes, 0.5f),
+        getPercentile(m_state_sizes, 0.99f), m_state_sizes.back());
+}   // report
@@ -0,0 +1,111 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_BENCHMARK_HPP
+#define HEADER_BENCHMARK_HPP
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class GameProtocol;
+
+/**
+ * \brief Headless benchmark of the server side simulation.
+ *  A game with AI karts only is run for a given time (in any mode), with the
+ *  rewind manager enabled and the states saved with GameProtocol like on a
+ *  server (but not sent). The time used per tick by each part of the update
+ *  and the size of the states are reported at the end.
+ * \ingroup modes
+ */
+class Benchmark
+{
+public:
+    /** Timed parts of a tick. Items are the item updates and the item hit
+     *  checks of the karts, which like AI are also included in karts. */
+    enum Section
+    {
+        BS_TICK,
+        BS_KARTS,
+        BS_AI,
+        BS_PHYSICS,
+        BS_ITEMS,
+        BS_STATE_SAVE,
+        BS_COUNT
+    };
+
+private:
+    /** If benchmark mode was selected. */
+    static bool m_enabled;
+
+    /** Set when the benchmark is done, the game is then aborted. */
+    static bool m_finished;
+
+    /** Game time in seconds to run the benchmark for. */
+    static float m_time;
+
+    /** Start time of each section which is being timed. */
+    static std::chrono::steady_clock::time_point m_section_start[BS_COUNT];
+
+    /** Time used by each section in the current tick in microseconds. */
+    static double m_tick_time[BS_COUNT];
+
+    /** Number of times each section was timed in the current tick. */
+    static int m_tick_count[BS_COUNT];
+
+    /** Times of each section in all measured ticks in which it was used. */
+    static std::vector<float> m_samples[BS_COUNT];
+
+    /** Size of each saved state in bytes. */
+    static std::vector<unsigned> m_state_sizes;
+
+    /** Used to save the states, as there is no lobby to create it. */
+    static std::shared_ptr<GameProtocol> m_game_protocol;
+
+    static void report();
+
+public:
+    static void enable(float time);
+    static void beginTick();
+    static void endTick();
+    // ------------------------------------------------------------------------
+    /** Returns true if benchmark mode was selected. */
+    static bool isEnabled()                               { return m_enabled; }
+    // ------------------------------------------------------------------------
+    static void addStateSize(unsigned size) { m_state_sizes.push_back(size); }
+    // ------------------------------------------------------------------------
+    /** Starts timing a section, does nothing if not benchmarking. */
+    static void beginSection(Section s)
+    {
+        if (m_enabled)
+            m_section_start[s] = std::chrono::steady_clock::now();
+    }   // beginSection
+    // ------------------------------------------------------------------------
+    /** Adds the time since beginSection to the section in this tick. */
+    static void endSection(Section s)
+    {
+        if (!m_enabled)
+            return;
+        m_tick_time[s] += std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - m_section_start[s]).count();
+        m_tick_count[s]++;
+    }   // endSection
+
+};   // class Benchmark
+
+#endif
@@ -51,6 +51,7 @@
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
 
+#include <algorithm>
 #include <climits>
 #include <iostream>
 
@@ -294,8 +295,70 @@ void LinearWorld::updateTrackSectors()
                                      * Track::getCurrentTrack()->getTrackLength()
                         + getDistanceDownTrackForKart(kart->getWorldKartId(), true);
     }   // for n
+    // The AI uses the ranking during the kart updates
+    updateDistanceRanking();
 }   // updateTrackSectors
 
+//-----------------------------------------------------------------------------
+/** Sorts m_distance_ranking by the current overall distances. It's almost
+ *  sorted from the previous call, so the insertion sort takes linear time
+ *  unless many karts overtake each other at once.
+ */
+void LinearWorld::updateDistanceRanking()
+{
+    const unsigned int kart_amount = (unsigned int)m_kart_info.size();
+    if (m_distance_ranking.size() != kart_amount)
+    {
+        m_distance_ranking.resize(kart_amount);
+        for (unsigned int i = 0; i < kart_amount; i++)
+            m_distance_ranking[i] = i;
+    }
+
+    for (unsigned int i = 1; i < kart_amount; i++)
+    {
+        const int id = m_distance_ranking[i];
+        const float distance = m_kart_info[id].m_overall_distance;
+        const int initial_position = m_karts[id]->getInitialPosition();
+        unsigned int j = i;
+        while (j > 0)
+        {
+            const int prev = m_distance_ranking[j - 1];
+            const float prev_distance = m_kart_info[prev].m_overall_distance;
+            if (prev_distance > distance ||
+                (prev_distance == distance &&
+                 m_karts[prev]->getInitialPosition() < initial_position))
+                break;
+            m_distance_ranking[j] = prev;
+            j--;
+        }
+        m_distance_ranking[j] = id;
+    }
+}   // updateDistanceRanking
+
+//-----------------------------------------------------------------------------
+/** Returns the number of karts which are not eliminated and have driven
+ *  further than the given overall distance.
+ */
+unsigned int LinearWorld::getNumKartsAheadOf(float distance) const
+{
+    // The ranking is sorted by decreasing distance
+    auto end = std::partition_point(m_distance_ranking.begin(),
+        m_distance_ranking.end(), [this, distance](int id)
+        {
+            return m_kart_info[id].m_overall_distance > distance;
+        });
+    if (m_eliminated_karts == 0)
+        return (unsigned int)(end - m_distance_ranking.begin());
+
+    unsigned int count = 0;
+    for (auto it = m_distance_ranking.begin(); it != end; it++)
+    {
+        if (!m_karts[*it]->isEliminated())
+            count++;
+    }
+    return count;
+}   // getNumKartsAheadOf
+
 //-----------------------------------------------------------------------------
 /** This updates all only graphical elements.It is only called once per
 *  rendered frame, not once per time step.
@@ -598,6 +661,20 @@ float LinearWorld::getEstimatedFinishTime(const int kart_id) const
     return m_kart_info[kart_id].m_estimated_finish;
 }   // getEstimatedFinishTime
 
+//-----------------------------------------------------------------------------
+/** Returns the distance between two karts along the track, taking into
+ *  account that the kart ahead can be a lap in front.
+ */
+float LinearWorld::getDistanceBetweenKarts(const AbstractKart* a,
+                                           const AbstractKart* b) const
+{
+    const float length = Track::getCurrentTrack()->getTrackLength();
+    float d = fabsf(
+        getDistanceDownTrackForKart(a->getWorldKartId(), false) -
+        getDistanceDownTrackForKart(b->getWorldKartId(), false));
+    return std::min(d, length - d);
+}   // getDistanceBetweenKarts
+
 //-----------------------------------------------------------------------------
 int LinearWorld::getTicksAtLapForKart(const int kart_id) const
 {
@@ -867,6 +944,28 @@ void LinearWorld::updateRacePosition()
     beginSetKartPositions();
     const unsigned int kart_amount = (unsigned int) m_karts.size();
 
+    // A kart that hasn't finished is behind all karts that have finished
+    // (and are not eliminated), and behind the karts before it in the
+    // distance ranking (initial positions are unique, so there are no
+    // ties). So walk the ranking once instead of comparing all pairs of
+    // karts.
+    updateDistanceRanking();
+    std::vector<int> positions(kart_amount, 1);
+    int num_ahead = 0;
+    for (unsigned int i = 0; i < kart_amount; i++)
+    {
+        if (m_karts[i]->hasFinishedRace() && !m_karts[i]->isEliminated())
+            num_ahead++;
+    }
+    for (unsigned int r = 0; r < kart_amount; r++)
+    {
+        const int id = m_distance_ranking[r];
+        AbstractKart* kart = m_karts[id].get();
+        if (kart->isEliminated() || kart->hasFinishedRace())
+            continue;
+        positions[id] = ++num_ahead;
+    }
+
 #ifdef DEBUG
     bool rank_changed = false;
 #endif
@@ -891,33 +990,10 @@ void LinearWorld::updateRacePosition()
         }
         KartInfo& kart_info = m_kart_info[i];
 
-        int p = 1 ;
-
-        const unsigned int my_id = kart->getWorldKartId();
-        const float my_distance  = m_kart_info[my_id].m_overall_distance;
-
-        // Count karts ahead of the current kart, i.e. kart that are
-        // already finished or have covered a larger overall distance.
-        for (unsigned int j = 0 ; j < kart_amount ; j++)
-        {
-            // don't compare a kart with itself and ignore eliminated karts
-            if(j == my_id || m_karts[j]->isEliminated())
-                continue;
-
-            // If the other kart has:
-            // - finished the race (but this kart hasn't)
-            // - or is ahead
-            // - or has the same distance (very unlikely) but started earlier
-            // it is ahead --> increase position
-            if((!kart->hasFinishedRace() && m_karts[j]->hasFinishedRace()) ||
-                m_kart_info[j].m_overall_distance > my_distance            ||
-               (m_kart_info[j].m_overall_distance == my_distance &&
-                m_karts[j]->getInitialPosition()<kart->getInitialPosition() ) )
-            {
-                p++;
-            }
-
-        } //next kart
+        // Karts ahead of the current kart are karts that are already
+        // finished, have covered a larger overall distance, or have the
+        // same distance (very unlikely) but started earlier
+        int p = positions[i];
 
 #ifndef DEBUG
         setKartPosition(i, p);
@@ -71,6 +71,14 @@ private:
     /* if set then the game will auto end after this time for networking */
     float       m_finish_timeout;
 
+    /** World kart ids sorted by overall distance (largest first, equal
+     *  distances by initial position). Karts rarely overtake each other,
+     *  so it's kept sorted with an insertion sort whenever the distances
+     *  change. */
+    std::vector<int> m_distance_ranking;
+
+    void  updateDistanceRanking();
+
     /** This calculate the time difference between the second kart in the race
      *  (there must be at least two) and the first kart in the race
      *  (who must be a ghost).
@@ -149,7 +157,11 @@ public:
                                             bool account_for_checklines) const;
     void          updateTrackSectors();
     void          updateRacePosition();
+    unsigned int  getNumKartsAheadOf(float distance) const;
     float         getDistanceToCenterForKart(const int kart_id) const;
+    virtual float getDistanceBetweenKarts(const AbstractKart* a,
+                                          const AbstractKart* b) const
+                                                                      OVERRIDE;
     float         getEstimatedFinishTime(const int kart_id) const;
     int           getLapForKart(const int kart_id) const;
     int           getTicksAtLapForKart(const int kart_id) const;
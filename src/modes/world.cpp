@@ -51,6 +51,7 @@
 #include "karts/kart_properties_manager.hpp"
 #include "karts/kart_rewinder.hpp"
 #include "main_loop.hpp"
+#include "modes/benchmark.hpp"
 #include "modes/overworld.hpp"
 #include "network/child_loop.hpp"
 #include "network/protocols/client_lobby.hpp"
@@ -131,7 +132,9 @@ World::World() : WorldStatus()
 {
     if (m_process_type == PT_MAIN)
         GUIEngine::getDevice()->setResizable(true);
-    RewindManager::setEnable(NetworkConfig::get()->isNetworking());
+    RewindManager::setEnable(NetworkConfig::get()->isNetworking() ||
+                             Benchmark::isEnabled() ||
+                             history->replayNetworkEvents());
 #ifdef DEBUG
     m_magic_number = 0xB01D6543;
 #endif
@@ -1197,9 +1200,14 @@ void World::update(int ticks)
 
     PROFILER_PUSH_CPU_MARKER("World::update (Kart::upate)", 0x40, 0x7F, 0x00);
 
+    // Karts only move in the physics update, so the index built here is
+    // used by all kart updates (e.g. slipstream) in this update
+    m_kart_proximity_index.update(m_karts);
+
     // Update all the karts. This in turn will also update the controller,
     // which causes all AI steering commands set. So in the following
     // physics update the new steering is taken into account.
+    Benchmark::beginSection(Benchmark::BS_KARTS);
     const int kart_amount = (int)m_karts.size();
     for (int i = 0 ; i < kart_amount; ++i)
     {
@@ -1211,6 +1219,7 @@ void World::update(int ticks)
         if (isStartPhase())
             m_karts[i]->makeKartRest();
     }
+    Benchmark::endSection(Benchmark::BS_KARTS);
     PROFILER_POP_CPU_MARKER();
     if(RaceManager::get()->isRecordingRace()) ReplayRecorder::get()->update(ticks);
 
@@ -1219,7 +1228,9 @@ void World::update(int ticks)
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_PUSH_CPU_MARKER("World::update (physics)", 0xa0, 0x7F, 0x00);
+    Benchmark::beginSection(Benchmark::BS_PHYSICS);
     Physics::get()->update(ticks);
+    Benchmark::endSection(Benchmark::BS_PHYSICS);
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_POP_CPU_MARKER();
@@ -1669,6 +1680,16 @@ KartTeam World::getKartTeam(unsigned int kart_id) const
     return n->second;
 }   // getKartTeam
 
+//-----------------------------------------------------------------------------
+/** Returns the straight line distance between two karts, game modes with a
+ *  graph override this to use the distance along it.
+ */
+float World::getDistanceBetweenKarts(const AbstractKart* a,
+                                     const AbstractKart* b) const
+{
+    return (a->getXYZ() - b->getXYZ()).length();
+}   // getDistanceBetweenKarts
+
 //-----------------------------------------------------------------------------
 void World::setAITeam()
 {
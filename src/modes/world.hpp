@@ -33,6 +33,7 @@
 #include <stdexcept>
 
 #include "graphics/weather.hpp"
+#include "karts/kart_proximity_index.hpp"
 #include "modes/world_status.hpp"
 #include "race/highscores.hpp"
 #include "states_screens/race_gui_base.hpp"
@@ -115,6 +116,9 @@ protected:
     KartList                  m_karts;
     RandomGenerator           m_random;
 
+    /** Positions of all karts at the beginning of the update. */
+    KartProximityIndex        m_kart_proximity_index;
+
     AbstractKart* m_fastest_kart;
     /** Number of eliminated karts. */
     int         m_eliminated_karts;
@@ -346,6 +350,10 @@ public:
     /** Returns all karts. */
     const KartList & getKarts() const { return m_karts; }
     // ------------------------------------------------------------------------
+    /** Returns the index of kart positions at the beginning of the update. */
+    const KartProximityIndex& getKartProximityIndex() const
+                                             { return m_kart_proximity_index; }
+    // ------------------------------------------------------------------------
     /** Returns the number of currently active (i.e.non-elikminated) karts. */
     unsigned int    getCurrentNumKarts() const { return (int)m_karts.size() -
                                                          m_eliminated_karts; }
@@ -418,6 +426,11 @@ public:
     }
     // ------------------------------------------------------------------------
     virtual bool isGoalPhase() const { return false; }
+    // ------------------------------------------------------------------------
+    /** Returns the distance between two karts, used by the server to send
+     *  state of far away karts less frequently. */
+    virtual float getDistanceBetweenKarts(const AbstractKart* a,
+                                          const AbstractKart* b) const;
 };   // World
 
 #endif
@@ -21,7 +21,7 @@
 #include "karts/controller/spare_tire_ai.hpp"
 #include "karts/kart_properties.hpp"
 #include "race/history.hpp"
-#include "tracks/graph.hpp"
+#include "tracks/arena_graph.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_sector.hpp"
 #include "utils/log.hpp"
@@ -243,6 +243,24 @@ int WorldWithRank::getSectorForKart(const AbstractKart *kart) const
     return getTrackSector(kart->getWorldKartId())->getCurrentGraphNode();
 }   // getSectorForKart
 
+//-----------------------------------------------------------------------------
+/** Returns the distance between two karts along the navmesh in arenas, or
+ *  the straight line distance if it's not available.
+ */
+float WorldWithRank::getDistanceBetweenKarts(const AbstractKart* a,
+                                             const AbstractKart* b) const
+{
+    ArenaGraph* ag = ArenaGraph::get();
+    if (ag)
+    {
+        int node_a = getSectorForKart(a);
+        int node_b = getSectorForKart(b);
+        if (node_a != Graph::UNKNOWN_SECTOR && node_b != Graph::UNKNOWN_SECTOR)
+            return ag->getDistance(node_a, node_b);
+    }
+    return World::getDistanceBetweenKarts(a, b);
+}   // getDistanceBetweenKarts
+
 //-----------------------------------------------------------------------------
 /** Localize each kart on the graph using its center xyz.
  */
@@ -101,6 +101,10 @@ public:
     bool isOnRoad(unsigned int kart_index) const;
     // ------------------------------------------------------------------------
     int getSectorForKart(const AbstractKart *kart) const;
+    // ------------------------------------------------------------------------
+    virtual float getDistanceBetweenKarts(const AbstractKart* a,
+                                          const AbstractKart* b) const
+                                                                      OVERRIDE;
 
 };   // WorldWithRank
 
@@ -0,0 +1,165 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/asset_catalog.hpp"
+#include "network/network_string.hpp"
+
+// ----------------------------------------------------------------------------
+/** Writes the bitset packed in bytes after its number of bits. */
+void AssetBitset::encode(BareNetworkString* ns) const
+{
+    ns->addUInt16((uint16_t)m_size);
+    for (unsigned i = 0; i < (m_size + 7) / 8; i++)
+        ns->addUInt8((uint8_t)(m_words[i / 8] >> (i % 8 * 8)));
+}   // encode
+
+// ----------------------------------------------------------------------------
+void AssetBitset::decode(const BareNetworkString& ns)
+{
+    m_words.clear();
+    resize(ns.getUInt16());
+    for (unsigned i = 0; i < (m_size + 7) / 8; i++)
+        m_words[i / 8] |= uint64_t(ns.getUInt8()) << (i % 8 * 8);
+    // Remove garbage after the last bit
+    if (m_size % 64 != 0)
+        m_words.back() &= (uint64_t(1) << (m_size % 64)) - 1;
+}   // decode
+
+// ----------------------------------------------------------------------------
+void AssetCatalog::clear()
+{
+    m_karts.clear();
+    m_tracks.clear();
+    m_kart_indices.clear();
+    m_track_indices.clear();
+    updateHash();
+}   // clear
+
+// ----------------------------------------------------------------------------
+/** FNV-1a of all identities in order, so it changes whenever an asset is
+ *  appended. */
+void AssetCatalog::updateHash()
+{
+    uint32_t hash = 2166136261u;
+    auto add = [&hash](const std::string& ident)
+        {
+            // Include the terminating zero to separate identities
+            for (size_t i = 0; i <= ident.size(); i++)
+            {
+                hash ^= (uint8_t)ident.c_str()[i];
+                hash *= 16777619u;
+            }
+        };
+    for (const std::string& kart : m_karts)
+        add(kart);
+    add("");
+    for (const std::string& track : m_tracks)
+        add(track);
+    m_hash = hash;
+}   // updateHash
+
+// ----------------------------------------------------------------------------
+/** Appends the karts and tracks not yet in the catalog, assets removed
+ *  later are kept so existing indices stay valid. The number of each is
+ *  limited to 65535 like when sending identities.
+ *  \return True if anything was added.
+ */
+bool AssetCatalog::update(const std::vector<std::string>& karts,
+                          const std::vector<std::string>& tracks)
+{
+    bool changed = false;
+    for (const std::string& kart : karts)
+    {
+        if (m_karts.size() >= 65535 ||
+            m_kart_indices.find(kart) != m_kart_indices.end())
+            continue;
+        m_kart_indices[kart] = (unsigned)m_karts.size();
+        m_karts.push_back(kart);
+        changed = true;
+    }
+    for (const std::string& track : tracks)
+    {
+        if (m_tracks.size() >= 65535 ||
+            m_track_indices.find(track) != m_track_indices.end())
+            continue;
+        m_track_indices[track] = (unsigned)m_tracks.size();
+        m_tracks.push_back(track);
+        changed = true;
+    }
+    if (changed)
+        updateHash();
+    return changed;
+}   // update
+
+// ----------------------------------------------------------------------------
+void AssetCatalog::encode(BareNetworkString* ns) const
+{
+    ns->addUInt16((uint16_t)m_karts.size())
+        .addUInt16((uint16_t)m_tracks.size());
+    for (const std::string& kart : m_karts)
+        ns->encodeString(kart);
+    for (const std::string& track : m_tracks)
+        ns->encodeString(track);
+}   // encode
+
+// ----------------------------------------------------------------------------
+void AssetCatalog::decode(const BareNetworkString& ns)
+{
+    std::vector<std::string> karts(ns.getUInt16());
+    std::vector<std::string> tracks(ns.getUInt16());
+    for (std::string& kart : karts)
+        ns.decodeString(&kart);
+    for (std::string& track : tracks)
+        ns.decodeString(&track);
+    clear();
+    update(karts, tracks);
+}   // decode
+
+// ----------------------------------------------------------------------------
+/** Removes from idents the karts of this catalog not set in the bitset,
+ *  identities not in the catalog are kept. */
+void AssetCatalog::eraseMissingKarts(const AssetBitset& karts,
+                                     std::set<std::string>* idents) const
+{
+    auto it = idents->begin();
+    while (it != idents->end())
+    {
+        int index = getKartIndex(*it);
+        if (index != -1 && !karts.test(index))
+            it = idents->erase(it);
+        else
+            it++;
+    }
+}   // eraseMissingKarts
+
+// ----------------------------------------------------------------------------
+/** Removes from idents the tracks of this catalog not set in the bitset,
+ *  identities not in the catalog are kept. */
+void AssetCatalog::eraseMissingTracks(const AssetBitset& tracks,
+                                      std::set<std::string>* idents) const
+{
+    auto it = idents->begin();
+    while (it != idents->end())
+    {
+        int index = getTrackIndex(*it);
+        if (index != -1 && !tracks.test(index))
+            it = idents->erase(it);
+        else
+            it++;
+    }
+}   // eraseMissingTracks
@@ -0,0 +1,184 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_ASSET_CATALOG_HPP
+#define HEADER_ASSET_CATALOG_HPP
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class BareNetworkString;
+
+/** One bit for each kart or track of an AssetCatalog, set if the asset is
+ *  available. Missing bits of a shorter bitset are taken as not set, so a
+ *  bitset stays valid when the catalog grows.
+ */
+class AssetBitset
+{
+private:
+    std::vector<uint64_t> m_words;
+
+    /** Number of bits, as sent over the network. */
+    unsigned m_size;
+
+public:
+    AssetBitset() : m_size(0) {}
+    // ------------------------------------------------------------------------
+    void resize(unsigned size)
+    {
+        m_size = size;
+        m_words.resize((size + 63) / 64, 0);
+    }
+    // ------------------------------------------------------------------------
+    /** Returns true if never resized, like for peers which didn't send their
+     *  assets (AI peer). */
+    bool empty() const                               { return m_size == 0; }
+    // ------------------------------------------------------------------------
+    void set(unsigned i)
+    {
+        if (i < m_size)
+            m_words[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    // ------------------------------------------------------------------------
+    bool test(unsigned i) const
+    {
+        return i < m_size && (m_words[i / 64] >> (i % 64) & 1) != 0;
+    }
+    // ------------------------------------------------------------------------
+    /** Returns the number of bits set in both bitsets. */
+    unsigned countCommon(const AssetBitset& other) const
+    {
+        unsigned count = 0;
+        size_t n = std::min(m_words.size(), other.m_words.size());
+        // std::popcount is C++20 only
+        for (size_t i = 0; i < n; i++)
+            count += (unsigned)std::bitset<64>(m_words[i] &
+                other.m_words[i]).count();
+        return count;
+    }
+    // ------------------------------------------------------------------------
+    /** Clears the bits not set in the other bitset. */
+    void intersect(const AssetBitset& other)
+    {
+        size_t n = std::min(m_words.size(), other.m_words.size());
+        for (size_t i = 0; i < n; i++)
+            m_words[i] &= other.m_words[i];
+        std::fill(m_words.begin() + n, m_words.end(), 0);
+    }
+    // ------------------------------------------------------------------------
+    void encode(BareNetworkString* ns) const;
+    // ------------------------------------------------------------------------
+    void decode(const BareNetworkString& ns);
+
+};   // class AssetBitset
+
+/** List of karts and tracks of a server, the index of each asset is its bit
+ *  in an AssetBitset. So clients can tell their assets with one bit each
+ *  instead of sending all identities, and the server can intersect the
+ *  assets of all peers a word at a time.
+ *  Assets are only ever appended so indices stay stable when addons are
+ *  installed in the server, the hash tells if a client has an outdated copy.
+ */
+class AssetCatalog
+{
+private:
+    std::vector<std::string> m_karts;
+
+    std::vector<std::string> m_tracks;
+
+    std::unordered_map<std::string, unsigned> m_kart_indices;
+
+    std::unordered_map<std::string, unsigned> m_track_indices;
+
+    uint32_t m_hash;
+
+    // ------------------------------------------------------------------------
+    void updateHash();
+    // ------------------------------------------------------------------------
+    template<typename T>
+    AssetBitset getBitset(const T& idents, unsigned size,
+                          const std::unordered_map<std::string, unsigned>&
+                          indices) const
+    {
+        AssetBitset bitset;
+        bitset.resize(size);
+        for (const std::string& ident : idents)
+        {
+            auto it = indices.find(ident);
+            if (it != indices.end())
+                bitset.set(it->second);
+        }
+        return bitset;
+    }   // getBitset
+
+public:
+    AssetCatalog()                                          { clear(); }
+    // ------------------------------------------------------------------------
+    void clear();
+    // ------------------------------------------------------------------------
+    bool update(const std::vector<std::string>& karts,
+                const std::vector<std::string>& tracks);
+    // ------------------------------------------------------------------------
+    void encode(BareNetworkString* ns) const;
+    // ------------------------------------------------------------------------
+    void decode(const BareNetworkString& ns);
+    // ------------------------------------------------------------------------
+    void eraseMissingKarts(const AssetBitset& karts,
+                           std::set<std::string>* idents) const;
+    // ------------------------------------------------------------------------
+    void eraseMissingTracks(const AssetBitset& tracks,
+                            std::set<std::string>* idents) const;
+    // ------------------------------------------------------------------------
+    uint32_t getHash() const                                { return m_hash; }
+    // ------------------------------------------------------------------------
+    /** Returns the index of a kart, or -1 if not in the catalog. */
+    int getKartIndex(const std::string& ident) const
+    {
+        auto it = m_kart_indices.find(ident);
+        return it == m_kart_indices.end() ? -1 : (int)it->second;
+    }
+    // ------------------------------------------------------------------------
+    /** Returns the index of a track, or -1 if not in the catalog. */
+    int getTrackIndex(const std::string& ident) const
+    {
+        auto it = m_track_indices.find(ident);
+        return it == m_track_indices.end() ? -1 : (int)it->second;
+    }
+    // ------------------------------------------------------------------------
+    /** Returns a bitset with the given karts set, others are ignored. */
+    template<typename T>
+    AssetBitset getKartBitset(const T& idents) const
+    {
+        return getBitset(idents, (unsigned)m_karts.size(), m_kart_indices);
+    }
+    // ------------------------------------------------------------------------
+    /** Returns a bitset with the given tracks set, others are ignored. */
+    template<typename T>
+    AssetBitset getTrackBitset(const T& idents) const
+    {
+        return getBitset(idents, (unsigned)m_tracks.size(), m_track_indices);
+    }
+
+};   // class AssetCatalog
+
+#endif // HEADER_ASSET_CATALOG_HPP
@@ -0,0 +1,396 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifdef ENABLE_SQLITE3
+
+#include "network/ban_index.hpp"
+#include "network/socket_address.hpp"
+#include "network/stk_ipv6.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <functional>
+
+// ----------------------------------------------------------------------------
+/** Columns shared by all ban tables, appended after the table specific ones.
+ *  Times are converted to seconds since epoch by sqlite, so they can be
+ *  compared with time() without parsing.
+ */
+static const std::string g_ban_time_columns =
+    "reason, description, rowid, "
+    "CAST(strftime('%s', starting_time) AS INTEGER), "
+    "CASE WHEN expired_days IS NULL THEN -1 ELSE CAST(strftime('%s', "
+    "starting_time, '+'||expired_days||' days') AS INTEGER) END";
+
+// ----------------------------------------------------------------------------
+static void fillBan(sqlite3_stmt* stmt, int column, BanIndex::Ban* ban)
+{
+    const char* reason = (const char*)sqlite3_column_text(stmt, column);
+    const char* desc = (const char*)sqlite3_column_text(stmt, column + 1);
+    ban->m_reason = reason ? reason : "";
+    ban->m_description = desc ? desc : "";
+    ban->m_row_id = sqlite3_column_int(stmt, column + 2);
+    ban->m_starting_time = sqlite3_column_int64(stmt, column + 3);
+    ban->m_expired_time = sqlite3_column_int64(stmt, column + 4);
+}   // fillBan
+
+// ----------------------------------------------------------------------------
+static void fillIPBan(sqlite3_stmt* stmt, BanIndex::IPBan* ban)
+{
+    ban->m_ip_start = (uint32_t)sqlite3_column_int64(stmt, 0);
+    ban->m_ip_end = (uint32_t)sqlite3_column_int64(stmt, 1);
+    fillBan(stmt, 2, ban);
+}   // fillIPBan
+
+// ----------------------------------------------------------------------------
+static void fillIPv6Ban(sqlite3_stmt* stmt, BanIndex::IPv6Ban* ban)
+{
+    const char* cidr = (const char*)sqlite3_column_text(stmt, 0);
+    ban->m_ipv6_cidr = cidr ? cidr : "";
+    ban->m_mask_length = 0;
+    if (parseIPv6CIDR(ban->m_ipv6_cidr.c_str(), ban->m_prefix.data(),
+        &ban->m_mask_length) != 1)
+    {
+        Log::warn("BanIndex", "Invalid IPv6 CIDR %s in ban table, ignored.",
+            ban->m_ipv6_cidr.c_str());
+    }
+    fillBan(stmt, 1, ban);
+}   // fillIPv6Ban
+
+// ----------------------------------------------------------------------------
+static void fillOnlineIdBan(sqlite3_stmt* stmt, BanIndex::OnlineIdBan* ban)
+{
+    ban->m_online_id = (uint32_t)sqlite3_column_int64(stmt, 0);
+    fillBan(stmt, 1, ban);
+}   // fillOnlineIdBan
+
+// ----------------------------------------------------------------------------
+/** Masks the first mask_length bits of a 16 bytes IPv6 address. */
+static std::array<uint8_t, 16> maskIPv6(const uint8_t* addr, int mask_length)
+{
+    std::array<uint8_t, 16> result = {};
+    for (int i = mask_length, j = 0; i > 0; i -= 8, j++)
+    {
+        if (i >= 8)
+            result[j] = addr[j];
+        else
+            result[j] = addr[j] & (uint8_t)(0xffU << (8 - i));
+    }
+    return result;
+}   // maskIPv6
+
+// ============================================================================
+BanIndex::BanIndex(const std::string& path, int timeout,
+                   const std::string& ip_ban_table,
+                   const std::string& ipv6_ban_table,
+                   const std::string& online_id_ban_table)
+        : m_snapshot(std::make_shared<Snapshot>()), m_db(NULL),
+          m_ip_ban_table(ip_ban_table), m_ipv6_ban_table(ipv6_ban_table),
+          m_online_id_ban_table(online_id_ban_table), m_data_version(-1),
+          m_last_load_time(0), m_refresh_requested(false), m_quit(false)
+{
+    // Use a private cache, data_version doesn't detect changes made by
+    // connections sharing the same cache
+    int ret = sqlite3_open_v2(path.c_str(), &m_db,
+        SQLITE_OPEN_PRIVATECACHE | SQLITE_OPEN_NOMUTEX |
+        SQLITE_OPEN_READONLY, NULL);
+    if (ret != SQLITE_OK)
+    {
+        Log::error("BanIndex", "Cannot open database: %s.",
+            sqlite3_errmsg(m_db));
+        sqlite3_close(m_db);
+        m_db = NULL;
+        return;
+    }
+    sqlite3_busy_timeout(m_db, timeout);
+    m_data_version = getDataVersion();
+    load();
+    m_thread = std::thread(std::bind(&BanIndex::run, this));
+}   // BanIndex
+
+// ----------------------------------------------------------------------------
+BanIndex::~BanIndex()
+{
+    if (m_thread.joinable())
+    {
+        std::unique_lock<std::mutex> ul(m_refresh_mutex);
+        m_quit = true;
+        ul.unlock();
+        m_refresh_cv.notify_one();
+        m_thread.join();
+    }
+    if (m_db != NULL)
+        sqlite3_close(m_db);
+}   // ~BanIndex
+
+// ----------------------------------------------------------------------------
+/** Ask the loading thread to reload now, used after the server itself
+ *  changes a ban table.
+ */
+void BanIndex::requestRefresh()
+{
+    std::unique_lock<std::mutex> ul(m_refresh_mutex);
+    m_refresh_requested = true;
+    ul.unlock();
+    m_refresh_cv.notify_one();
+}   // requestRefresh
+
+// ----------------------------------------------------------------------------
+/** Returns a value which changes whenever another connection commits to the
+ *  database, or -1 if it cannot be read.
+ */
+int64_t BanIndex::getDataVersion() const
+{
+    sqlite3_stmt* stmt = NULL;
+    int64_t version = -1;
+    if (sqlite3_prepare_v2(m_db, "PRAGMA data_version;", -1, &stmt, 0) ==
+        SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            version = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return version;
+}   // getDataVersion
+
+// ----------------------------------------------------------------------------
+/** Appends all rows returned by query to bans.
+ *  \return True if the whole table is read.
+ */
+template<typename BanType>
+bool BanIndex::loadTable(const std::string& query,
+                         void (*fill)(sqlite3_stmt*, BanType*),
+                         std::vector<BanType>* bans) const
+{
+    sqlite3_stmt* stmt = NULL;
+    int ret = sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, 0);
+    if (ret != SQLITE_OK)
+    {
+        Log::error("BanIndex", "Error preparing database for query %s: %s",
+            query.c_str(), sqlite3_errmsg(m_db));
+        return false;
+    }
+    while ((ret = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        BanType ban;
+        fill(stmt, &ban);
+        bans->push_back(ban);
+    }
+    if (ret != SQLITE_DONE)
+    {
+        Log::error("BanIndex", "Error reading database for query %s: %s",
+            query.c_str(), sqlite3_errmsg(m_db));
+        sqlite3_finalize(stmt);
+        return false;
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}   // loadTable
+
+// ----------------------------------------------------------------------------
+/** Reads all ban tables into a new snapshot and replaces the current one.
+ *  If any table fails to load the current snapshot is kept.
+ *  \return True if loaded successfully.
+ */
+bool BanIndex::load()
+{
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    if (!m_ip_ban_table.empty() &&
+        !loadTable<IPBan>("SELECT ip_start, ip_end, " + g_ban_time_columns +
+        " FROM " + m_ip_ban_table + ";", &fillIPBan, &snapshot->m_ip_bans))
+        return false;
+    if (!m_ipv6_ban_table.empty() &&
+        !loadTable<IPv6Ban>("SELECT ipv6_cidr, " + g_ban_time_columns +
+        " FROM " + m_ipv6_ban_table + ";", &fillIPv6Ban,
+        &snapshot->m_ipv6_bans))
+        return false;
+    if (!m_online_id_ban_table.empty() &&
+        !loadTable<OnlineIdBan>("SELECT online_id, " + g_ban_time_columns +
+        " FROM " + m_online_id_ban_table + ";", &fillOnlineIdBan,
+        &snapshot->m_online_id_bans))
+        return false;
+
+    std::sort(snapshot->m_ip_bans.begin(), snapshot->m_ip_bans.end(),
+        [](const IPBan& a, const IPBan& b)
+        {
+            return a.m_ip_start < b.m_ip_start;
+        });
+    uint32_t max_end = 0;
+    for (const IPBan& ban : snapshot->m_ip_bans)
+    {
+        max_end = std::max(max_end, ban.m_ip_end);
+        snapshot->m_ip_max_end.push_back(max_end);
+    }
+
+    auto& ipv6_bans = snapshot->m_ipv6_bans;
+    ipv6_bans.erase(std::remove_if(ipv6_bans.begin(), ipv6_bans.end(),
+        [](const IPv6Ban& ban) { return ban.m_mask_length == 0; }),
+        ipv6_bans.end());
+    std::sort(ipv6_bans.begin(), ipv6_bans.end(),
+        [](const IPv6Ban& a, const IPv6Ban& b)
+        {
+            if (a.m_mask_length != b.m_mask_length)
+                return a.m_mask_length > b.m_mask_length;
+            return a.m_prefix < b.m_prefix;
+        });
+    for (unsigned i = 0; i < ipv6_bans.size(); i++)
+    {
+        if (i == 0 ||
+            ipv6_bans[i].m_mask_length != ipv6_bans[i - 1].m_mask_length)
+            snapshot->m_ipv6_groups.push_back(i);
+    }
+    snapshot->m_ipv6_groups.push_back((unsigned)ipv6_bans.size());
+
+    std::sort(snapshot->m_online_id_bans.begin(),
+        snapshot->m_online_id_bans.end(),
+        [](const OnlineIdBan& a, const OnlineIdBan& b)
+        {
+            return a.m_online_id < b.m_online_id;
+        });
+
+    Log::debug("BanIndex", "Loaded %d IP, %d IPv6 and %d online id bans.",
+        (int)snapshot->m_ip_bans.size(), (int)ipv6_bans.size(),
+        (int)snapshot->m_online_id_bans.size());
+    std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+    m_snapshot = snapshot;
+    return true;
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Thread function which reloads the tables when the database changes or a
+ *  refresh is requested. data_version is checked every few seconds, and a
+ *  full reload is done at least every minute like the old database polling,
+ *  in case the database file is replaced.
+ */
+void BanIndex::run()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> ul(m_refresh_mutex);
+        m_refresh_cv.wait_for(ul, std::chrono::seconds(5),
+            [this]() { return m_quit || m_refresh_requested; });
+        if (m_quit)
+            return;
+        bool requested = m_refresh_requested;
+        m_refresh_requested = false;
+        ul.unlock();
+
+        int64_t version = getDataVersion();
+        uint64_t now = StkTime::getMonoTimeMs();
+        if (!requested && version == m_data_version &&
+            now < m_last_load_time + 60000)
+            continue;
+        if (load())
+        {
+            m_data_version = version;
+            m_last_load_time = now;
+        }
+    }
+}   // run
+
+// ----------------------------------------------------------------------------
+/** Finds an active ban of an IPv4 address.
+ *  \param ip The address in host byte order.
+ *  \param ban If found the ban will be copied here.
+ *  \return True if the address is banned.
+ */
+bool BanIndex::findIPBan(uint32_t ip, IPBan* ban) const
+{
+    std::shared_ptr<const Snapshot> snapshot = getSnapshot();
+    const std::vector<IPBan>& bans = snapshot->m_ip_bans;
+    int64_t now = (int64_t)time(NULL);
+    // First range which starts after ip, all ranges before it start at or
+    // before ip
+    auto it = std::upper_bound(bans.begin(), bans.end(), ip,
+        [](uint32_t ip, const IPBan& b) { return ip < b.m_ip_start; });
+    for (int i = (int)(it - bans.begin()) - 1; i >= 0; i--)
+    {
+        if (snapshot->m_ip_max_end[i] < ip)
+            break;
+        if (bans[i].m_ip_end >= ip && bans[i].isActive(now))
+        {
+            *ban = bans[i];
+            return true;
+        }
+    }
+    return false;
+}   // findIPBan
+
+// ----------------------------------------------------------------------------
+/** Finds an active ban of an IPv6 address, checking longest prefix first.
+ *  \param addr The address, it must be a native IPv6 address.
+ *  \param ban If found the ban will be copied here.
+ *  \return True if the address is banned.
+ */
+bool BanIndex::findIPv6Ban(const SocketAddress& addr, IPv6Ban* ban) const
+{
+    std::shared_ptr<const Snapshot> snapshot = getSnapshot();
+    const std::vector<IPv6Ban>& bans = snapshot->m_ipv6_bans;
+    const sockaddr_in6* in6 = (const sockaddr_in6*)addr.getSockaddr();
+    int64_t now = (int64_t)time(NULL);
+    for (unsigned g = 0; g + 1 < snapshot->m_ipv6_groups.size(); g++)
+    {
+        auto first = bans.begin() + snapshot->m_ipv6_groups[g];
+        auto last = bans.begin() + snapshot->m_ipv6_groups[g + 1];
+        std::array<uint8_t, 16> prefix =
+            maskIPv6(in6->sin6_addr.s6_addr, first->m_mask_length);
+        auto it = std::lower_bound(first, last, prefix,
+            [](const IPv6Ban& b, const std::array<uint8_t, 16>& p)
+            {
+                return b.m_prefix < p;
+            });
+        for (; it != last && it->m_prefix == prefix; it++)
+        {
+            if (it->isActive(now))
+            {
+                *ban = *it;
+                return true;
+            }
+        }
+    }
+    return false;
+}   // findIPv6Ban
+
+// ----------------------------------------------------------------------------
+/** Finds an active ban of an online id.
+ *  \param online_id The online id.
+ *  \param ban If found the ban will be copied here.
+ *  \return True if the online id is banned.
+ */
+bool BanIndex::findOnlineIdBan(uint32_t online_id, OnlineIdBan* ban) const
+{
+    std::shared_ptr<const Snapshot> snapshot = getSnapshot();
+    const std::vector<OnlineIdBan>& bans = snapshot->m_online_id_bans;
+    int64_t now = (int64_t)time(NULL);
+    auto it = std::lower_bound(bans.begin(), bans.end(), online_id,
+        [](const OnlineIdBan& b, uint32_t id) { return b.m_online_id < id; });
+    for (; it != bans.end() && it->m_online_id == online_id; it++)
+    {
+        if (it->isActive(now))
+        {
+            *ban = *it;
+            return true;
+        }
+    }
+    return false;
+}   // findOnlineIdBan
+
+#endif // ENABLE_SQLITE3
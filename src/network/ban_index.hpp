@@ -0,0 +1,176 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_BAN_INDEX_HPP
+#define HEADER_BAN_INDEX_HPP
+
+#ifdef ENABLE_SQLITE3
+
+#include "utils/no_copy.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sqlite3.h>
+
+class SocketAddress;
+
+/** An in-memory copy of the IPv4, IPv6 and online id ban tables of the
+ *  server database, so that testing a connecting peer doesn't need to query
+ *  sqlite. The tables are loaded with a separate read-only connection and
+ *  reloaded by a background thread whenever the database content changes
+ *  (checked cheaply with PRAGMA data_version). Each load builds a new
+ *  immutable snapshot which replaces the old one, so lookups only hold a
+ *  mutex to copy a shared pointer.
+ *  Ban time is checked at lookup, so bans starting or expiring later are
+ *  handled without reloading.
+ */
+class BanIndex : public NoCopy
+{
+public:
+    /** Common part of all ban entries. */
+    struct Ban
+    {
+        std::string m_reason;
+        std::string m_description;
+        int m_row_id;
+        /** Seconds since epoch when the ban starts. */
+        int64_t m_starting_time;
+        /** Seconds since epoch when the ban expires, -1 if permanent. */
+        int64_t m_expired_time;
+        // --------------------------------------------------------------------
+        bool isActive(int64_t now) const
+        {
+            return now > m_starting_time &&
+                (m_expired_time == -1 || m_expired_time > now);
+        }
+    };
+    // ------------------------------------------------------------------------
+    struct IPBan : public Ban
+    {
+        uint32_t m_ip_start;
+        uint32_t m_ip_end;
+    };
+    // ------------------------------------------------------------------------
+    struct IPv6Ban : public Ban
+    {
+        std::string m_ipv6_cidr;
+        /** Address of the CIDR masked with m_mask_length. */
+        std::array<uint8_t, 16> m_prefix;
+        int m_mask_length;
+    };
+    // ------------------------------------------------------------------------
+    struct OnlineIdBan : public Ban
+    {
+        uint32_t m_online_id;
+    };
+
+private:
+    /** One loaded copy of all tables, never modified after creation. */
+    struct Snapshot
+    {
+        /** Sorted by m_ip_start. */
+        std::vector<IPBan> m_ip_bans;
+        /** m_ip_max_end[i] is the largest m_ip_end of m_ip_bans[0..i], so
+         *  searching backwards can stop once no earlier range can include
+         *  the address. */
+        std::vector<uint32_t> m_ip_max_end;
+        /** Sorted by mask length (longest first) then prefix. */
+        std::vector<IPv6Ban> m_ipv6_bans;
+        /** Index of the first entry in m_ipv6_bans of each mask length
+         *  used, with a final entry of m_ipv6_bans.size(). */
+        std::vector<unsigned> m_ipv6_groups;
+        /** Sorted by m_online_id. */
+        std::vector<OnlineIdBan> m_online_id_bans;
+    };
+
+    std::shared_ptr<const Snapshot> m_snapshot;
+
+    /** Protects m_snapshot. */
+    mutable std::mutex m_snapshot_mutex;
+
+    /** Read-only connection used by the loading thread only (after the first
+     *  load in constructor). */
+    sqlite3* m_db;
+
+    const std::string m_ip_ban_table;
+
+    const std::string m_ipv6_ban_table;
+
+    const std::string m_online_id_ban_table;
+
+    int64_t m_data_version;
+
+    uint64_t m_last_load_time;
+
+    std::thread m_thread;
+
+    std::mutex m_refresh_mutex;
+
+    std::condition_variable m_refresh_cv;
+
+    bool m_refresh_requested;
+
+    bool m_quit;
+
+    // ------------------------------------------------------------------------
+    int64_t getDataVersion() const;
+    // ------------------------------------------------------------------------
+    bool load();
+    // ------------------------------------------------------------------------
+    template<typename BanType>
+    bool loadTable(const std::string& query,
+                   void (*fill)(sqlite3_stmt*, BanType*),
+                   std::vector<BanType>* bans) const;
+    // ------------------------------------------------------------------------
+    void run();
+    // ------------------------------------------------------------------------
+    std::shared_ptr<const Snapshot> getSnapshot() const
+    {
+        std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+        return m_snapshot;
+    }
+
+public:
+    // ------------------------------------------------------------------------
+    BanIndex(const std::string& path, int timeout,
+             const std::string& ip_ban_table,
+             const std::string& ipv6_ban_table,
+             const std::string& online_id_ban_table);
+    // ------------------------------------------------------------------------
+    ~BanIndex();
+    // ------------------------------------------------------------------------
+    void requestRefresh();
+    // ------------------------------------------------------------------------
+    bool findIPBan(uint32_t ip, IPBan* ban) const;
+    // ------------------------------------------------------------------------
+    bool findIPv6Ban(const SocketAddress& addr, IPv6Ban* ban) const;
+    // ------------------------------------------------------------------------
+    bool findOnlineIdBan(uint32_t online_id, OnlineIdBan* ban) const;
+
+};   // class BanIndex
+
+#endif // ENABLE_SQLITE3
+
+#endif // HEADER_BAN_INDEX_HPP
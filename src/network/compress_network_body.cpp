@@ -0,0 +1,137 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/compress_network_body.hpp"
+#include "network/network_config.hpp"
+#include "tracks/track.hpp"
+#include "utils/vec3.hpp"
+
+#include <cmath>
+
+namespace CompressNetworkBody
+{
+    /** Bodies can be this far outside the track bounding box (for example
+     *  falling before being rescued) and still use quantized coordinates. */
+    const float QUANTIZE_MARGIN = 32.0f;
+    /** Size of each step of a quantized coordinate (in meters). */
+    const float QUANTIZE_STEP = 1.0f / 128.0f;
+
+    /** Describes how one axis of the origin is quantized, it only depends on
+     *  the track bounding box, so server and client compute the same. */
+    struct QuantizedAxis
+    {
+        float m_min;
+        float m_step;
+        /** Either 0xffff or 0xffffff (all bits set), which also marks a
+         *  coordinate out of range followed by a full float. */
+        uint32_t m_escape;
+    };
+    // ------------------------------------------------------------------------
+    /** Returns true and fills axes if quantized origin is used for the
+     *  current race. */
+    static bool getQuantizedAxes(QuantizedAxis axes[3])
+    {
+        Track* track = Track::getCurrentTrack();
+        if (!track || !NetworkConfig::get()->useQuantizedOrigin())
+            return false;
+        const Vec3 *min, *max;
+        track->getAABB(&min, &max);
+        for (int i = 0; i < 3; i++)
+        {
+            axes[i].m_min = (*min)[i] - QUANTIZE_MARGIN;
+            float range = (*max)[i] - (*min)[i] + QUANTIZE_MARGIN * 2.0f;
+            axes[i].m_step = QUANTIZE_STEP;
+            if (range / QUANTIZE_STEP < 65535.0f)
+            {
+                axes[i].m_escape = 0xffff;
+                continue;
+            }
+            axes[i].m_escape = 0xffffff;
+            // Only for extremely large tracks
+            if (range / QUANTIZE_STEP >= 16777215.0f)
+                axes[i].m_step = range / 16777214.0f;
+        }
+        return true;
+    }   // getQuantizedAxes
+
+    // ------------------------------------------------------------------------
+    /** Rounds the origin of a body to the value the remote side will get
+     *  from the network, and write it to bns if not null. If enabled for the
+     *  current race each coordinate is sent as fixed point relative to the
+     *  track bounding box (16 bits for most tracks) instead of a full float.
+     *  \param x, y, z Coordinates of origin, they will be rounded.
+     */
+    void compressOrigin(float* x, float* y, float* z, BareNetworkString* bns)
+    {
+        QuantizedAxis axes[3];
+        if (!getQuantizedAxes(axes))
+        {
+            if (bns)
+                bns->addFloat(*x).addFloat(*y).addFloat(*z);
+            return;
+        }
+        float* origin[3] = { x, y, z };
+        for (int i = 0; i < 3; i++)
+        {
+            const QuantizedAxis& axis = axes[i];
+            float q = std::floor((*origin[i] - axis.m_min) / axis.m_step +
+                0.5f);
+            uint32_t value = axis.m_escape;
+            if (q >= 0.0f && q < (float)axis.m_escape)
+            {
+                value = (uint32_t)q;
+                *origin[i] = axis.m_min + (float)value * axis.m_step;
+            }
+            if (!bns)
+                continue;
+            if (axis.m_escape == 0xffff)
+                bns->addUInt16((uint16_t)value);
+            else
+                bns->addInt24((int)value);
+            if (value == axis.m_escape)
+                bns->addFloat(*origin[i]);
+        }
+    }   // compressOrigin
+
+    // ------------------------------------------------------------------------
+    /** Reads an origin written by compressOrigin. */
+    void decompressOrigin(const BareNetworkString* bns, float* x, float* y,
+                          float* z)
+    {
+        QuantizedAxis axes[3];
+        if (!getQuantizedAxes(axes))
+        {
+            *x = bns->getFloat();
+            *y = bns->getFloat();
+            *z = bns->getFloat();
+            return;
+        }
+        float* origin[3] = { x, y, z };
+        for (int i = 0; i < 3; i++)
+        {
+            const QuantizedAxis& axis = axes[i];
+            uint32_t value = axis.m_escape == 0xffff ? bns->getUInt16() :
+                (uint32_t)bns->getInt24() & 0xffffff;
+            if (value == axis.m_escape)
+                *origin[i] = bns->getFloat();
+            else
+                *origin[i] = axis.m_min + (float)value * axis.m_step;
+        }
+    }   // decompressOrigin
+
+}   // namespace CompressNetworkBody
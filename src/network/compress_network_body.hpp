@@ -29,6 +29,11 @@ namespace CompressNetworkBody
 {
     using namespace MiniGLM;
     // ------------------------------------------------------------------------
+    void compressOrigin(float* x, float* y, float* z, BareNetworkString* bns);
+    // ------------------------------------------------------------------------
+    void decompressOrigin(const BareNetworkString* bns, float* x, float* y,
+                          float* z);
+    // ------------------------------------------------------------------------
     /** Set body and motion state of bullet object with compressed values. */
     inline void setCompressedValues(float x, float y, float z,
                                     uint32_t compressed_q,
@@ -55,9 +60,9 @@ namespace CompressNetworkBody
     /** Compress transformation and velocities of bullet object, it will
      *  call MiniGLM::compressQuaternion for compress quaternion of
      *  transformation and convert linear and angular velocities to half floats
-     *  it can be used by client to locally round values to make sure client
-     *  and server have similar state when saving state if you don't provoide
-     *  bns.
+     *  (and quantize the origin if enabled, see compressOrigin), it can be
+     *  used by client to locally round values to make sure client and server
+     *  have similar state when saving state if you don't provoide bns.
      */
     inline void compress(btRigidBody* body, btMotionState* ms,
                          BareNetworkString* bns = NULL)
@@ -65,6 +70,7 @@ namespace CompressNetworkBody
         float x = body->getWorldTransform().getOrigin().x();
         float y = body->getWorldTransform().getOrigin().y();
         float z = body->getWorldTransform().getOrigin().z();
+        compressOrigin(&x, &y, &z, bns);
         uint32_t compressed_q =
             compressQuaternion(body->getWorldTransform().getRotation());
         short lvx = toFloat16(body->getLinearVelocity().x());
@@ -79,7 +85,7 @@ namespace CompressNetworkBody
         if (!bns)
             return;
 
-        bns->addFloat(x).addFloat(y).addFloat(z).addUInt32(compressed_q);
+        bns->addUInt32(compressed_q);
         bns->addUInt16(lvx).addUInt16(lvy).addUInt16(lvz)
             .addUInt16(avx).addUInt16(avy).addUInt16(avz);
     }   // compress
@@ -88,9 +94,8 @@ namespace CompressNetworkBody
     inline void decompress(const BareNetworkString* bns,
                            btRigidBody* body, btMotionState* ms)
     {
-        float x = bns->getFloat();
-        float y = bns->getFloat();
-        float z = bns->getFloat();
+        float x, y, z;
+        decompressOrigin(bns, &x, &y, &z);
         uint32_t compressed_q = bns->getUInt32();
         short lvx = bns->getUInt16();
         short lvy = bns->getUInt16();
@@ -0,0 +1,136 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifdef ENABLE_SQLITE3
+
+#include "network/database_writer.hpp"
+#include "utils/log.hpp"
+#include "utils/vs.hpp"
+
+// ----------------------------------------------------------------------------
+/** \param db A connection opened only for the writer, which takes ownership.
+ */
+DatabaseWriter::DatabaseWriter(sqlite3* db)
+              : m_db(db), m_quit(false)
+{
+    m_thread = std::thread(std::bind(&DatabaseWriter::run, this));
+}   // DatabaseWriter
+
+// ----------------------------------------------------------------------------
+/** Writes all queued queries before returning. */
+DatabaseWriter::~DatabaseWriter()
+{
+    std::unique_lock<std::mutex> ul(m_queries_mutex);
+    m_quit = true;
+    ul.unlock();
+    m_queries_cv.notify_one();
+    m_thread.join();
+    sqlite3_close(m_db);
+}   // ~DatabaseWriter
+
+// ----------------------------------------------------------------------------
+/** Queues a query to be executed in the writer thread. The bind function
+ *  is called later in that thread, so it must only use data it captured by
+ *  value.
+ */
+void DatabaseWriter::addQuery(const std::string& query,
+                              std::function<void(sqlite3_stmt*)> bind_function,
+                              std::function<void(bool)> callback)
+{
+    std::unique_lock<std::mutex> ul(m_queries_mutex);
+    m_queries.push_back({ query, bind_function, callback });
+    ul.unlock();
+    m_queries_cv.notify_one();
+}   // addQuery
+
+// ----------------------------------------------------------------------------
+bool DatabaseWriter::execute(const Query& q) const
+{
+    sqlite3_stmt* stmt = NULL;
+    int ret = sqlite3_prepare_v2(m_db, q.m_query.c_str(), -1, &stmt, 0);
+    if (ret != SQLITE_OK)
+    {
+        Log::error("DatabaseWriter",
+            "Error preparing database for query %s: %s",
+            q.m_query.c_str(), sqlite3_errmsg(m_db));
+        return false;
+    }
+    if (q.m_bind_function)
+        q.m_bind_function(stmt);
+    ret = sqlite3_step(stmt);
+    ret = sqlite3_finalize(stmt);
+    if (ret != SQLITE_OK)
+    {
+        Log::error("DatabaseWriter",
+            "Error finalize database for query %s: %s",
+            q.m_query.c_str(), sqlite3_errmsg(m_db));
+        return false;
+    }
+    return true;
+}   // execute
+
+// ----------------------------------------------------------------------------
+/** Executes queries in one transaction (if more than one), then calls their
+ *  callbacks. If the transaction cannot be committed all queries are
+ *  reported as not written.
+ */
+void DatabaseWriter::executeAll(const std::vector<Query>& queries) const
+{
+    std::vector<bool> written(queries.size(), false);
+    bool transaction = queries.size() > 1 &&
+        sqlite3_exec(m_db, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK;
+    for (unsigned i = 0; i < queries.size(); i++)
+        written[i] = execute(queries[i]);
+    if (transaction &&
+        sqlite3_exec(m_db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        Log::error("DatabaseWriter", "Error committing %d queries: %s",
+            (int)queries.size(), sqlite3_errmsg(m_db));
+        sqlite3_exec(m_db, "ROLLBACK;", NULL, NULL, NULL);
+        written.assign(queries.size(), false);
+    }
+    for (unsigned i = 0; i < queries.size(); i++)
+    {
+        if (queries[i].m_callback)
+            queries[i].m_callback(written[i]);
+    }
+}   // executeAll
+
+// ----------------------------------------------------------------------------
+void DatabaseWriter::run()
+{
+    VS::setThreadName("DatabaseWriter");
+    std::vector<Query> queries;
+    while (true)
+    {
+        std::unique_lock<std::mutex> ul(m_queries_mutex);
+        m_queries_cv.wait(ul,
+            [this]() { return m_quit || !m_queries.empty(); });
+        std::swap(queries, m_queries);
+        bool quit = m_quit;
+        ul.unlock();
+
+        if (!queries.empty())
+            executeAll(queries);
+        queries.clear();
+        if (quit)
+            return;
+    }
+}   // run
+
+#endif // ENABLE_SQLITE3
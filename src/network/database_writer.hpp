@@ -0,0 +1,88 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_DATABASE_WRITER_HPP
+#define HEADER_DATABASE_WRITER_HPP
+
+#ifdef ENABLE_SQLITE3
+
+#include "utils/no_copy.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sqlite3.h>
+
+/** Runs write queries of the server database in a separate thread, so a
+ *  slow disk doesn't block the lobby. Queries queued while the thread is
+ *  busy are executed together in one transaction.
+ *  The writer has its own database connection, so queries run by the lobby
+ *  meanwhile never become part of its transactions.
+ */
+class DatabaseWriter : public NoCopy
+{
+private:
+    struct Query
+    {
+        std::string m_query;
+        /** Called before executing the query to bind its parameters. */
+        std::function<void(sqlite3_stmt*)> m_bind_function;
+        /** Called after the transaction with true if written, it runs in the
+         *  writer thread. */
+        std::function<void(bool)> m_callback;
+    };
+
+    /** Connection only used by the writer thread, closed with it. */
+    sqlite3* m_db;
+
+    std::vector<Query> m_queries;
+
+    std::mutex m_queries_mutex;
+
+    std::condition_variable m_queries_cv;
+
+    bool m_quit;
+
+    std::thread m_thread;
+
+    // ------------------------------------------------------------------------
+    bool execute(const Query& q) const;
+    // ------------------------------------------------------------------------
+    void executeAll(const std::vector<Query>& queries) const;
+    // ------------------------------------------------------------------------
+    void run();
+
+public:
+    // ------------------------------------------------------------------------
+    DatabaseWriter(sqlite3* db);
+    // ------------------------------------------------------------------------
+    ~DatabaseWriter();
+    // ------------------------------------------------------------------------
+    void addQuery(const std::string& query,
+                  std::function<void(sqlite3_stmt*)> bind_function = nullptr,
+                  std::function<void(bool)> callback = nullptr);
+
+};   // class DatabaseWriter
+
+#endif // ENABLE_SQLITE3
+
+#endif // HEADER_DATABASE_WRITER_HPP
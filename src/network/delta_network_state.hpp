@@ -0,0 +1,93 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_DELTA_NETWORK_STATE_HPP
+#define HEADER_DELTA_NETWORK_STATE_HPP
+
+#include "network/network_string.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/** Encodes a game state as the difference to a previous state (baseline)
+ *  which the receiver has confirmed. The state is XOR'ed byte by byte with
+ *  the baseline (missing baseline bytes count as 0), and every group of 8
+ *  bytes is written as a 1 byte mask of the non-zero bytes followed by those
+ *  bytes only. Unchanged values (item states, powerups, attachments, high
+ *  bytes of floats, ...) therefore cost 1 bit each.
+ */
+namespace DeltaNetworkState
+{
+    // ------------------------------------------------------------------------
+    /** Writes the delta of state against baseline into bns. */
+    inline void encode(const std::vector<uint8_t>& state,
+                       const std::vector<uint8_t>& baseline,
+                       BareNetworkString* bns)
+    {
+        const unsigned state_size = (unsigned)state.size();
+        const unsigned baseline_size = (unsigned)baseline.size();
+        bns->addUInt32(state_size);
+        for (unsigned i = 0; i < state_size; i += 8)
+        {
+            uint8_t mask = 0;
+            uint8_t diff[8];
+            unsigned diff_count = 0;
+            for (unsigned j = 0; j < 8 && i + j < state_size; j++)
+            {
+                uint8_t b = i + j < baseline_size ? baseline[i + j] : 0;
+                uint8_t d = state[i + j] ^ b;
+                if (d != 0)
+                {
+                    mask |= (uint8_t)(1 << j);
+                    diff[diff_count++] = d;
+                }
+            }
+            bns->addUInt8(mask);
+            for (unsigned j = 0; j < diff_count; j++)
+                bns->addUInt8(diff[j]);
+        }
+    }   // encode
+    // ------------------------------------------------------------------------
+    /** Restores a state written by encode using the same baseline. It will
+     *  throw std::out_of_range if bns is truncated.
+     *  \param[out] state The decoded state, appended to the existing content.
+     */
+    inline void decode(const BareNetworkString* bns,
+                       const std::vector<uint8_t>& baseline,
+                       std::vector<uint8_t>* state)
+    {
+        const unsigned state_size = bns->getUInt32();
+        const unsigned baseline_size = (unsigned)baseline.size();
+        if (state_size > bns->size() * 8)
+            throw std::out_of_range("Delta state size out of range.");
+        state->reserve(state->size() + state_size);
+        for (unsigned i = 0; i < state_size; i += 8)
+        {
+            uint8_t mask = bns->getUInt8();
+            for (unsigned j = 0; j < 8 && i + j < state_size; j++)
+            {
+                uint8_t b = i + j < baseline_size ? baseline[i + j] : 0;
+                if ((mask & (1 << j)) != 0)
+                    b ^= bns->getUInt8();
+                state->push_back(b);
+            }
+        }
+    }   // decode
+};
+
+#endif // HEADER_DELTA_NETWORK_STATE_HPP
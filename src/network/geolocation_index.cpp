@@ -0,0 +1,373 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifdef ENABLE_SQLITE3
+
+#include "network/geolocation_index.hpp"
+#include "network/socket_address.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef WIN32
+#  include <ws2tcpip.h>
+#else
+#  include <fcntl.h>
+#  include <netinet/in.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace
+{
+    const uint32_t GEOLOCATION_MAGIC = 0x4f45474b; // "KGEO" little endian
+    const uint32_t GEOLOCATION_VERSION = 3;
+
+    // ------------------------------------------------------------------------
+    struct Range
+    {
+        int64_t m_start;
+        int64_t m_end;
+        char m_country[2];
+    };
+
+    // ------------------------------------------------------------------------
+    /** Reads all rows of a geolocation table sorted by ip_start. */
+    bool readRanges(sqlite3* db, const std::string& table,
+                    std::vector<Range>* ranges)
+    {
+        if (table.empty())
+            return true;
+        std::string query = StringUtils::insertValues(
+            "SELECT ip_start, ip_end, country_code FROM %s "
+            "ORDER BY ip_start;", table.c_str());
+        sqlite3_stmt* stmt = NULL;
+        int ret = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, 0);
+        if (ret != SQLITE_OK)
+        {
+            Log::error("GeolocationIndex",
+                "Error preparing database for query %s: %s",
+                query.c_str(), sqlite3_errmsg(db));
+            return false;
+        }
+        while ((ret = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            const char* country_code =
+                (const char*)sqlite3_column_text(stmt, 2);
+            if (country_code == NULL || strlen(country_code) != 2)
+                continue;
+            Range r;
+            r.m_start = sqlite3_column_int64(stmt, 0);
+            r.m_end = sqlite3_column_int64(stmt, 1);
+            memcpy(r.m_country, country_code, 2);
+            ranges->push_back(r);
+        }
+        sqlite3_finalize(stmt);
+        if (ret != SQLITE_DONE)
+        {
+            Log::error("GeolocationIndex",
+                "Error reading database for query %s: %s",
+                query.c_str(), sqlite3_errmsg(db));
+            return false;
+        }
+        return true;
+    }   // readRanges
+
+}
+
+// ----------------------------------------------------------------------------
+GeolocationIndex::GeolocationIndex()
+{
+    m_data = NULL;
+    m_size = 0;
+    m_header = NULL;
+    m_ipv6_start = m_ipv6_end = NULL;
+    m_ipv4_start = m_ipv4_end = NULL;
+    m_ipv4_country = m_ipv6_country = NULL;
+}   // GeolocationIndex
+
+// ----------------------------------------------------------------------------
+/** Reads the row count and the largest rowid of a table, used to find out if
+ *  the binary file is outdated without reading all rows.
+ */
+bool GeolocationIndex::readTableInfo(sqlite3* db, const std::string& table,
+                                     uint32_t* count, int64_t* last_rowid)
+{
+    *count = 0;
+    *last_rowid = 0;
+    if (table.empty())
+        return true;
+    std::string query = StringUtils::insertValues(
+        "SELECT COUNT(*), IFNULL(MAX(rowid), 0) FROM %s;", table.c_str());
+    sqlite3_stmt* stmt = NULL;
+    if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, 0) != SQLITE_OK)
+    {
+        Log::error("GeolocationIndex",
+            "Error preparing database for query %s: %s",
+            query.c_str(), sqlite3_errmsg(db));
+        return false;
+    }
+    bool ok = sqlite3_step(stmt) == SQLITE_ROW;
+    if (ok)
+    {
+        *count = (uint32_t)sqlite3_column_int64(stmt, 0);
+        *last_rowid = sqlite3_column_int64(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    return ok;
+}   // readTableInfo
+
+// ----------------------------------------------------------------------------
+/** Writes the binary file from the database tables. It's written to a
+ *  temporary file first, so other servers using the old file are not
+ *  affected.
+ */
+bool GeolocationIndex::generate(sqlite3* db, const std::string& ip_table,
+                                const std::string& ipv6_table,
+                                const std::string& path)
+{
+    Header header = {};
+    header.m_magic = GEOLOCATION_MAGIC;
+    header.m_version = GEOLOCATION_VERSION;
+    std::vector<Range> ipv4, ipv6;
+    if (!readTableInfo(db, ip_table, &header.m_ipv4_rows,
+        &header.m_ipv4_last_rowid) ||
+        !readTableInfo(db, ipv6_table, &header.m_ipv6_rows,
+        &header.m_ipv6_last_rowid) ||
+        !readRanges(db, ip_table, &ipv4) || !readRanges(db, ipv6_table, &ipv6))
+        return false;
+    header.m_ipv4_count = (uint32_t)ipv4.size();
+    header.m_ipv6_count = (uint32_t)ipv6.size();
+
+    std::vector<int64_t> ipv6_start, ipv6_end;
+    std::vector<uint32_t> ipv4_start, ipv4_end;
+    std::string ipv4_country, ipv6_country;
+    for (const Range& r : ipv4)
+    {
+        ipv4_start.push_back((uint32_t)r.m_start);
+        ipv4_end.push_back((uint32_t)r.m_end);
+        ipv4_country.append(r.m_country, 2);
+    }
+    for (const Range& r : ipv6)
+    {
+        ipv6_start.push_back(r.m_start);
+        ipv6_end.push_back(r.m_end);
+        ipv6_country.append(r.m_country, 2);
+    }
+    std::string tmp_path = path + ".tmp" +
+        StringUtils::toString(StkTime::getMonoTimeMs());
+    FILE* fp = FileUtils::fopenU8Path(tmp_path, "wb");
+    if (!fp)
+    {
+        Log::error("GeolocationIndex", "Cannot write %s.", tmp_path.c_str());
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1;
+    auto write_data = [fp, &written](const void* data, size_t size)
+        {
+            if (written && size > 0)
+                written = fwrite(data, size, 1, fp) == 1;
+        };
+    write_data(ipv6_start.data(), ipv6_start.size() * sizeof(int64_t));
+    write_data(ipv6_end.data(), ipv6_end.size() * sizeof(int64_t));
+    write_data(ipv4_start.data(), ipv4_start.size() * sizeof(uint32_t));
+    write_data(ipv4_end.data(), ipv4_end.size() * sizeof(uint32_t));
+    write_data(ipv4_country.data(), ipv4_country.size());
+    write_data(ipv6_country.data(), ipv6_country.size());
+    written = fclose(fp) == 0 && written;
+    if (written && FileUtils::renameU8Path(tmp_path, path) != 0)
+    {
+        // Windows doesn't replace existing file when renaming
+        remove(FileUtils::getPortableWritingPath(path).c_str());
+        written = FileUtils::renameU8Path(tmp_path, path) == 0;
+    }
+    if (!written)
+    {
+        Log::error("GeolocationIndex", "Cannot write %s.", path.c_str());
+        remove(FileUtils::getPortableWritingPath(tmp_path).c_str());
+        return false;
+    }
+    Log::info("GeolocationIndex", "Generated %s with %d IPv4 and %d IPv6 "
+        "ranges.", path.c_str(), (int)ipv4.size(), (int)ipv6.size());
+    return true;
+}   // generate
+
+// ----------------------------------------------------------------------------
+/** Maps the binary file and checks its size against the header.
+ */
+bool GeolocationIndex::map(const std::string& path)
+{
+    unmap();
+#ifdef WIN32
+    FILE* fp = FileUtils::fopenU8Path(path, "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size > 0)
+    {
+        m_buffer.resize(size);
+        if (fread(m_buffer.data(), size, 1, fp) != 1)
+            m_buffer.clear();
+    }
+    fclose(fp);
+    if (m_buffer.empty())
+        return false;
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    m_data = (const uint8_t*)data;
+    m_size = st.st_size;
+#endif
+
+    if (m_size < sizeof(Header))
+    {
+        unmap();
+        return false;
+    }
+    m_header = (const Header*)m_data;
+    size_t ipv4_count = m_header->m_ipv4_count;
+    size_t ipv6_count = m_header->m_ipv6_count;
+    if (m_header->m_magic != GEOLOCATION_MAGIC ||
+        m_header->m_version != GEOLOCATION_VERSION ||
+        m_size != sizeof(Header) + ipv6_count * 2 * sizeof(int64_t) +
+        ipv4_count * 2 * sizeof(uint32_t) + (ipv4_count + ipv6_count) * 2)
+    {
+        unmap();
+        return false;
+    }
+    const uint8_t* p = m_data + sizeof(Header);
+    m_ipv6_start = (const int64_t*)p;
+    p += ipv6_count * sizeof(int64_t);
+    m_ipv6_end = (const int64_t*)p;
+    p += ipv6_count * sizeof(int64_t);
+    m_ipv4_start = (const uint32_t*)p;
+    p += ipv4_count * sizeof(uint32_t);
+    m_ipv4_end = (const uint32_t*)p;
+    p += ipv4_count * sizeof(uint32_t);
+    m_ipv4_country = (const char*)p;
+    p += ipv4_count * 2;
+    m_ipv6_country = (const char*)p;
+    return true;
+}   // map
+
+// ----------------------------------------------------------------------------
+void GeolocationIndex::unmap()
+{
+#ifdef WIN32
+    m_buffer.clear();
+#else
+    if (m_data)
+        munmap((void*)m_data, m_size);
+#endif
+    m_data = NULL;
+    m_size = 0;
+    m_header = NULL;
+}   // unmap
+
+// ----------------------------------------------------------------------------
+/** Maps the binary file at path, (re-)generating it first if it doesn't
+ *  match the tables in database.
+ *  \param ip_table IPv4 geolocation table name, empty if not exists.
+ *  \param ipv6_table IPv6 geolocation table name, empty if not exists.
+ *  \return True if the index can be used, false if the file can't be
+ *          generated or mapped.
+ */
+bool GeolocationIndex::init(sqlite3* db, const std::string& ip_table,
+                            const std::string& ipv6_table,
+                            const std::string& path)
+{
+    uint32_t ipv4_count = 0;
+    uint32_t ipv6_count = 0;
+    int64_t ipv4_last_rowid = 0;
+    int64_t ipv6_last_rowid = 0;
+    if (!readTableInfo(db, ip_table, &ipv4_count, &ipv4_last_rowid) ||
+        !readTableInfo(db, ipv6_table, &ipv6_count, &ipv6_last_rowid))
+        return false;
+
+    if (map(path) && m_header->m_ipv4_rows == ipv4_count &&
+        m_header->m_ipv6_rows == ipv6_count &&
+        m_header->m_ipv4_last_rowid == ipv4_last_rowid &&
+        m_header->m_ipv6_last_rowid == ipv6_last_rowid)
+        return true;
+
+    unmap();
+    if (generate(db, ip_table, ipv6_table, path) && map(path))
+        return true;
+    Log::error("GeolocationIndex", "Cannot use %s.", path.c_str());
+    return false;
+}   // init
+
+// ----------------------------------------------------------------------------
+/** Returns the 2-letter country code of an address, or empty if not found.
+ */
+std::string GeolocationIndex::getCountryCode(const SocketAddress& addr) const
+{
+    if (!m_header)
+        return "";
+
+    if (addr.isIPv6())
+    {
+        // Only the upper 64bit is stored, see upperIPv6
+        const sockaddr_in6* in6 = (const sockaddr_in6*)addr.getSockaddr();
+        uint64_t upper = 0;
+        for (unsigned i = 0; i < 8; i++)
+            upper = (upper << 8) | in6->sin6_addr.s6_addr[i];
+        int64_t ip = (int64_t)upper;
+        const int64_t* end = m_ipv6_start + m_header->m_ipv6_count;
+        const int64_t* it = std::upper_bound(m_ipv6_start, end, ip);
+        if (it == m_ipv6_start)
+            return "";
+        size_t idx = it - m_ipv6_start - 1;
+        if (m_ipv6_end[idx] < ip)
+            return "";
+        return std::string(m_ipv6_country + idx * 2, 2);
+    }
+
+    uint32_t ip = addr.getIP();
+    const uint32_t* end = m_ipv4_start + m_header->m_ipv4_count;
+    const uint32_t* it = std::upper_bound(m_ipv4_start, end, ip);
+    if (it == m_ipv4_start)
+        return "";
+    size_t idx = it - m_ipv4_start - 1;
+    if (m_ipv4_end[idx] < ip)
+        return "";
+    return std::string(m_ipv4_country + idx * 2, 2);
+}   // getCountryCode
+
+#endif // ENABLE_SQLITE3
@@ -0,0 +1,112 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_GEOLOCATION_INDEX_HPP
+#define HEADER_GEOLOCATION_INDEX_HPP
+
+#ifdef ENABLE_SQLITE3
+
+#include "utils/no_copy.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+class SocketAddress;
+
+/** Sorted range tables of the IPv4 and IPv6 geolocation tables, stored in a
+ *  binary file next to the database and memory-mapped, so all server
+ *  processes on a machine share one copy. The file is generated from the
+ *  database tables when it doesn't exist or when the tables changed (row
+ *  count or largest rowid differs), which is checked without reading the
+ *  rows. Rows edited in place are not detected, the file needs to be deleted
+ *  then.
+ *  Ranges are assumed not to overlap, like the ones generated by
+ *  tools/generate-ip-mappings.py.
+ */
+class GeolocationIndex : public NoCopy
+{
+private:
+    /** Beginning of the file, followed by the IPv6 starts and ends (int64),
+     *  the IPv4 starts and ends (uint32), then the 2-letter country codes
+     *  of IPv4 and IPv6 ranges. */
+    struct Header
+    {
+        uint32_t m_magic;
+        uint32_t m_version;
+        uint32_t m_ipv4_count;
+        uint32_t m_ipv6_count;
+        /** Row count and largest rowid of the tables when generated. */
+        uint32_t m_ipv4_rows;
+        uint32_t m_ipv6_rows;
+        int64_t m_ipv4_last_rowid;
+        int64_t m_ipv6_last_rowid;
+    };
+
+    /** The mapped file (or a copy of it if mapping is not supported). */
+    const uint8_t* m_data;
+
+    size_t m_size;
+
+    std::vector<uint8_t> m_buffer;
+
+    const Header* m_header;
+
+    const int64_t* m_ipv6_start;
+
+    const int64_t* m_ipv6_end;
+
+    const uint32_t* m_ipv4_start;
+
+    const uint32_t* m_ipv4_end;
+
+    const char* m_ipv4_country;
+
+    const char* m_ipv6_country;
+
+    // ------------------------------------------------------------------------
+    static bool readTableInfo(sqlite3* db, const std::string& table,
+                              uint32_t* count, int64_t* last_rowid);
+    // ------------------------------------------------------------------------
+    static bool generate(sqlite3* db, const std::string& ip_table,
+                         const std::string& ipv6_table,
+                         const std::string& path);
+    // ------------------------------------------------------------------------
+    bool map(const std::string& path);
+    // ------------------------------------------------------------------------
+    void unmap();
+
+public:
+    // ------------------------------------------------------------------------
+    GeolocationIndex();
+    // ------------------------------------------------------------------------
+    ~GeolocationIndex()                                            { unmap(); }
+    // ------------------------------------------------------------------------
+    bool init(sqlite3* db, const std::string& ip_table,
+              const std::string& ipv6_table, const std::string& path);
+    // ------------------------------------------------------------------------
+    std::string getCountryCode(const SocketAddress& addr) const;
+
+};   // class GeolocationIndex
+
+#endif // ENABLE_SQLITE3
+
+#endif // HEADER_GEOLOCATION_INDEX_HPP
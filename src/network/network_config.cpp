@@ -157,6 +157,7 @@ NetworkConfig::NetworkConfig()
     m_joined_server_version = 0;
     m_network_ai_instance = false;
     m_state_frequency = 10;
+    m_quantized_origin = false;
     m_nat64_prefix_data.fill(-1);
     m_num_fixed_ai = 0;
     m_tux_hitbox_addon = false;
@@ -119,6 +119,11 @@ private:
     /** Set by client or server which is required to be the same. */
     int m_state_frequency;
 
+    /** True if origin of physical bodies is quantized in game states of the
+     *  current race (see CompressNetworkBody::compressOrigin), set by server
+     *  when starting race if all peers support it. */
+    bool m_quantized_origin;
+
     /** List of server capabilities set when joining it, to determine features
      *  available in same version. */
     std::set<std::string> m_server_capabilities;
@@ -288,6 +293,10 @@ public:
     // ------------------------------------------------------------------------
     int getStateFrequency() const                 { return m_state_frequency; }
     // ------------------------------------------------------------------------
+    void setQuantizedOrigin(bool val)            { m_quantized_origin = val; }
+    // ------------------------------------------------------------------------
+    bool useQuantizedOrigin() const              { return m_quantized_origin; }
+    // ------------------------------------------------------------------------
     bool roundValuesNow() const;
     // ------------------------------------------------------------------------
     void setServerCapabilities(std::set<std::string>& caps)
@@ -23,6 +23,9 @@
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
 #include "network/protocols/server_lobby.hpp"
+#include "io/file_manager.hpp"
+#include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
 #include "utils/time.hpp"
 #include "utils/vs.hpp"
 #include "main_loop.hpp"
@@ -53,6 +56,9 @@ void showHelp()
     std::cout << "listpeers, List all peers with host ID and IP." << std::endl;
     std::cout << "listban, List IP ban list of server." << std::endl;
     std::cout << "speedstats, Show upload and download speed." << std::endl;
+    std::cout << "starttrace, Start writing profiler markers of all threads "
+        "to a Chrome trace file." << std::endl;
+    std::cout << "stoptrace, Stop writing the trace file." << std::endl;
 }   // showHelp
 
 // ----------------------------------------------------------------------------
@@ -178,6 +184,21 @@ void mainLoop(STKHost* host)
                 "   Download speed (KBps): " <<
                 (float)host->getDownloadSpeed() / 1024.0f  << std::endl;
         }
+        else if (str == "starttrace")
+        {
+            std::string path = file_manager->getUserConfigFile(
+                file_manager->getStdoutName()) + ".trace-" +
+                StringUtils::toString(StkTime::getTimeSinceEpoch()) + ".json";
+            if (profiler.startTrace(path))
+                std::cout << "Writing trace to " << path << std::endl;
+            else
+                std::cout << "A trace is already being written." << std::endl;
+        }
+        else if (str == "stoptrace")
+        {
+            if (!profiler.stopTrace())
+                std::cout << "No trace is being written." << std::endl;
+        }
         else
         {
             std::cout << "Unknown command: " << str << std::endl;
@@ -57,6 +57,7 @@ std::shared_ptr<ProtocolManager> ProtocolManager::createInstance()
             if (pt == PT_CHILD)
                 thread_name += "_child";
             VS::setThreadName(thread_name.c_str());
+            profiler.setThreadName(thread_name.c_str());
             STKProcess::init(pt);
             while(!pm->m_exit.load())
             {
@@ -71,6 +72,7 @@ std::shared_ptr<ProtocolManager> ProtocolManager::createInstance()
         pm->m_game_protocol_thread = std::thread([pm, pt]()
             {
                 VS::setThreadName("CtrlEvents");
+                profiler.setThreadName("CtrlEvents");
                 STKProcess::init(pt);
                 while (true)
                 {
@@ -95,10 +97,12 @@ std::shared_ptr<ProtocolManager> ProtocolManager::createInstance()
                             continue;
                         }
                     }
+                    PROFILER_PUSH_CPU_MARKER("Controller event", 255, 128, 0);
                     auto gp = GameProtocol::lock();
                     if (gp)
                         gp->notifyEventAsynchronous(event_top);
                     delete event_top;
+                    PROFILER_POP_CPU_MARKER();
                 }
             });
     }
@@ -473,7 +477,7 @@ void ProtocolManager::asynchronousUpdate()
     m_async_events_to_process.unlock();
 
     PROFILER_POP_CPU_MARKER();
-    PROFILER_PUSH_CPU_MARKER("Message delivery", 255, 0, 0);
+    PROFILER_PUSH_CPU_MARKER("Protocol update", 255, 64, 0);
 
     // Second: update all running protocols
     // ====================================
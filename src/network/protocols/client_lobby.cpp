@@ -51,6 +51,7 @@
 #include "network/protocols/server_lobby.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/race_event_manager.hpp"
+#include "network/rewind_manager.hpp"
 #include "network/server.hpp"
 #include "network/server_config.hpp"
 #include "network/stk_host.hpp"
@@ -213,6 +214,7 @@ bool ClientLobby::notifyEvent(Event* event)
         case LE_KART_INFO:             handleKartInfo(event);      break;
         case LE_START_RACE:            startGame(event);           break;
         case LE_REPORT_PLAYER:         reportSuccess(event);       break;
+        case LE_ASSET_CATALOG:         handleAssetCatalog(event);  break;
         default:
             break;
     }   // switch
@@ -406,6 +408,7 @@ void ClientLobby::update(int ticks)
     case LINKED:
     {
         NetworkConfig::get()->clearServerCapabilities();
+        m_asset_catalog.clear();
         std::string ua = StringUtils::getUserAgentString();
         if (NetworkConfig::get()->isNetworkAIInstance())
             ua = "AI";
@@ -1022,6 +1025,13 @@ void ClientLobby::startGame(Event* event)
         (Track::getCurrentTrack()->getItemManager());
     assert(nim);
     nim->restoreCompleteState(event->data());
+    if (NetworkConfig::get()->getServerCapabilities().find("rewinder_id") !=
+        NetworkConfig::get()->getServerCapabilities().end())
+        RewindManager::get()->decodeRewinderTable(event->data());
+    NetworkConfig::get()->setQuantizedOrigin(
+        NetworkConfig::get()->getServerCapabilities().find("quantized_origin")
+        != NetworkConfig::get()->getServerCapabilities().end() &&
+        event->data().getUInt8() == 1);
 
     core::stringw err_msg = _("Failed to start the network game.");
     // Different stk process thread may have different stk host
@@ -1351,6 +1361,13 @@ void ClientLobby::liveJoinAcknowledged(Event* event)
             }
         }
     }
+    if (NetworkConfig::get()->getServerCapabilities().find("rewinder_id") !=
+        NetworkConfig::get()->getServerCapabilities().end())
+        RewindManager::get()->decodeRewinderTable(data);
+    NetworkConfig::get()->setQuantizedOrigin(
+        NetworkConfig::get()->getServerCapabilities().find("quantized_origin")
+        != NetworkConfig::get()->getServerCapabilities().end() &&
+        data.getUInt8() == 1);
 }   // liveJoinAcknowledged
 
 //-----------------------------------------------------------------------------
@@ -1876,9 +1893,12 @@ void ClientLobby::handleClientCommand(const std::string& cmd)
 }   // handleClientCommand
 
 // ----------------------------------------------------------------------------
-void ClientLobby::getKartsTracksNetworkString(BareNetworkString* ns)
+void ClientLobby::getAvailableKartsTracks(std::vector<std::string>* karts,
+                                          std::vector<std::string>* tracks)
+                                          const
 {
-    std::vector<std::string> all_k;
+    std::vector<std::string>& all_k = *karts;
+    all_k.clear();
     for (unsigned i = 0; i < kart_properties_manager->getNumberOfKarts(); i++)
     {
         const KartProperties* kp = kart_properties_manager->getKartById(i);
@@ -1891,9 +1911,16 @@ void ClientLobby::getKartsTracksNetworkString(BareNetworkString* ns)
     for (const std::string& k : oks)
         all_k.push_back(k);
 
-    auto all_t = track_manager->getAllTrackIdentifiers();
-    if (all_t.size() >= 65536)
-        all_t.resize(65535);
+    *tracks = track_manager->getAllTrackIdentifiers();
+    if (tracks->size() >= 65536)
+        tracks->resize(65535);
+}   // getAvailableKartsTracks
+
+// ----------------------------------------------------------------------------
+void ClientLobby::getKartsTracksNetworkString(BareNetworkString* ns)
+{
+    std::vector<std::string> all_k, all_t;
+    getAvailableKartsTracks(&all_k, &all_t);
     ns->addUInt16((uint16_t)all_k.size()).addUInt16((uint16_t)all_t.size());
     for (const std::string& kart : all_k)
     {
@@ -1906,15 +1933,39 @@ void ClientLobby::getKartsTracksNetworkString(BareNetworkString* ns)
 }   // getKartsTracksNetworkString
 
 // ----------------------------------------------------------------------------
+/** Sends the karts and tracks of this client, as bitsets of the asset
+ *  catalog of server if supported. */
 void ClientLobby::updateAssetsToServer()
 {
     NetworkString* ns = getNetworkString(1);
     ns->addUInt8(LE_ASSETS_UPDATE);
-    getKartsTracksNetworkString(ns);
+    if (NetworkConfig::get()->getServerCapabilities().find("asset_catalog")
+        != NetworkConfig::get()->getServerCapabilities().end())
+    {
+        std::vector<std::string> all_k, all_t;
+        getAvailableKartsTracks(&all_k, &all_t);
+        // Server sends the catalog again if the hash doesn't match
+        ns->addUInt32(m_asset_catalog.getHash());
+        m_asset_catalog.getKartBitset(all_k).encode(ns);
+        m_asset_catalog.getTrackBitset(all_t).encode(ns);
+    }
+    else
+        getKartsTracksNetworkString(ns);
     sendToServer(ns, /*reliable*/true);
     delete ns;
 }   // updateAssetsToServer
 
+// ----------------------------------------------------------------------------
+void ClientLobby::handleAssetCatalog(Event* event)
+{
+    if (!checkDataSize(event, 5)) return;
+    const NetworkString& data = event->data();
+    bool request_assets = data.getUInt8() == 1;
+    m_asset_catalog.decode(data);
+    if (request_assets)
+        updateAssetsToServer();
+}   // handleAssetCatalog
+
 // ----------------------------------------------------------------------------
 void ClientLobby::downloadAddonsPack(std::shared_ptr<Online::HTTPRequest> r)
 {
@@ -20,6 +20,7 @@
 #define CLIENT_LOBBY_HPP
 
 #include "input/input.hpp"
+#include "network/asset_catalog.hpp"
 #include "network/protocols/lobby_protocol.hpp"
 #include "utils/cpp2011.hpp"
 
@@ -74,6 +75,7 @@ private:
     void handleChat(Event* event);
     void handleServerInfo(Event* event);
     void reportSuccess(Event* event);
+    void handleAssetCatalog(Event* event);
     void handleBadTeam();
     void handleBadConnection();
     void becomingServerOwner();
@@ -125,6 +127,10 @@ private:
     std::set<std::string> m_available_karts;
     std::set<std::string> m_available_tracks;
 
+    /** Karts and tracks of server, used to send assets updates as bitsets
+     *  if the server supports it. */
+    AssetCatalog m_asset_catalog;
+
     void addAllPlayers(Event* event);
     void finalizeConnectionRequest(NetworkString* header,
                                    BareNetworkString* rest, bool encrypt);
@@ -150,6 +156,8 @@ private:
          bool* is_spectator = NULL) const;
     void getPlayersAddonKartType(const BareNetworkString& data,
         std::vector<std::shared_ptr<NetworkPlayerProfile> >& players) const;
+    void getAvailableKartsTracks(std::vector<std::string>* karts,
+                                 std::vector<std::string>* tracks) const;
     void getKartsTracksNetworkString(BareNetworkString* ns);
     void doInstallAddonsPack();
 public:
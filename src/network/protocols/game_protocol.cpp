@@ -22,6 +22,7 @@
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/player_controller.hpp"
 #include "modes/world.hpp"
+#include "network/delta_network_state.hpp"
 #include "network/event.hpp"
 #include "network/network_config.hpp"
 #include "network/game_setup.hpp"
@@ -31,6 +32,8 @@
 #include "network/protocol_manager.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/rewinder.hpp"
+#include "network/server_config.hpp"
 #include "network/socket_address.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
@@ -39,6 +42,8 @@
 #include "utils/time.hpp"
 #include "main_loop.hpp"
 
+#include <algorithm>
+
 // ============================================================================
 std::weak_ptr<GameProtocol> GameProtocol::m_game_protocol[PT_COUNT];
 // ============================================================================
@@ -63,12 +68,22 @@ GameProtocol::GameProtocol()
     m_network_item_manager = static_cast<NetworkItemManager*>
         (Track::getCurrentTrack()->getItemManager());
     m_data_to_send = getNetworkString();
+    m_peer_state = getNetworkString();
+    m_legacy_state = getNetworkString();
+    m_delta_state = getNetworkString();
+    m_confirmed_state_ticks = -1;
+    m_rewinder_header_size = 0;
+    m_rewinder_state_offset = 0;
+    m_state_count = 0;
 }   // GameProtocol
 
 //-----------------------------------------------------------------------------
 GameProtocol::~GameProtocol()
 {
     delete m_data_to_send;
+    delete m_peer_state;
+    delete m_legacy_state;
+    delete m_delta_state;
 }   // ~GameProtocol
 
 //-----------------------------------------------------------------------------
@@ -131,7 +146,9 @@ bool GameProtocol::notifyEventAsynchronous(Event* event)
     {
     case GP_CONTROLLER_ACTION: handleControllerAction(event); break;
     case GP_STATE:             handleState(event);            break;
+    case GP_STATE_DELTA:       handleStateDelta(event);       break;
     case GP_ITEM_CONFIRMATION: handleItemEventConfirmation(event); break;
+    case GP_STATE_CONFIRMATION: handleStateConfirmation(event); break;
     case GP_ADJUST_TIME:
     case GP_ITEM_UPDATE:
         break;
@@ -284,58 +301,374 @@ void GameProtocol::handleItemEventConfirmation(Event *event)
  */
 void GameProtocol::startNewState()
 {
-    assert(NetworkConfig::get()->isServer());
+    assert(!NetworkConfig::get()->isClient());
+    const unsigned header_size = 1/*protocol type*/ + 1 /*gp event type*/+
+        4/*time*/;
     m_data_to_send->clear();
     m_data_to_send->addUInt8(GP_STATE)
         .addUInt32(World::getWorld()->getTicksSinceStart());
+    // Reserve space for the rewinder ids as large as in the last state (it
+    // only changes when rewinders are added or removed), so finalizeState
+    // doesn't need to move the states of all rewinders
+    m_data_to_send->getBuffer().resize(header_size + m_rewinder_header_size);
+    m_state_rewinders.clear();
 }   // startNewState
 
 // ----------------------------------------------------------------------------
-/** Called by a server to add data to the current state. The data in buffer
- *  is copied, so the data can be freed after this call/.
- *  \param buffer Adds the data in the buffer to the current state.
+/** Called by a server before a rewinder saves its state, which should be
+ *  written directly into the returned buffer. It must be followed by
+ *  endRewinderState.
  */
-void GameProtocol::addState(BareNetworkString *buffer)
+BareNetworkString* GameProtocol::beginRewinderState()
 {
-    assert(NetworkConfig::get()->isServer());
-    m_data_to_send->addUInt16(buffer->size());
-    (*m_data_to_send) += *buffer;
-}   // addState
+    assert(!NetworkConfig::get()->isClient());
+    m_rewinder_state_offset = m_data_to_send->getTotalSize();
+    // Size of the state, written in endRewinderState
+    m_data_to_send->addUInt16(0);
+    return m_data_to_send;
+}   // beginRewinderState
 
 // ----------------------------------------------------------------------------
-/** Called by a server to finalize the current state, which add updated
- *  names of rewinder using to the beginning of state buffer
- *  \param cur_rewinder List of current rewinder using.
+/** Called by a server after a rewinder saved its state.
+ *  \param saved If false the rewinder didn't save a state and anything
+ *  written will be discarded.
  */
-void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder)
+void GameProtocol::endRewinderState(bool saved)
 {
-    assert(NetworkConfig::get()->isServer());
+    assert(!NetworkConfig::get()->isClient());
     auto& buffer = m_data_to_send->getBuffer();
-    auto pos = buffer.begin() + 1/*protocol type*/ + 1 /*gp event type*/+
+    if (!saved)
+    {
+        buffer.resize(m_rewinder_state_offset);
+        return;
+    }
+    const unsigned size =
+        (unsigned)buffer.size() - m_rewinder_state_offset - 2;
+    assert(size <= 65535);
+    buffer[m_rewinder_state_offset] = (size >> 8) & 0xff;
+    buffer[m_rewinder_state_offset + 1] = size & 0xff;
+    StateRewinder sr;
+    sr.m_kart_id = -1;
+    sr.m_header_offset = sr.m_header_size = 0;
+    sr.m_data_offset = m_rewinder_state_offset;
+    sr.m_data_size = 2 + size;
+    m_state_rewinders.push_back(sr);
+}   // endRewinderState
+
+// ----------------------------------------------------------------------------
+/** Called by a server to finalize the current state, which writes the
+ *  rewinders using into the space reserved at the beginning of state buffer,
+ *  as id in the rewinder table or the unique identity for rewinders not in
+ *  the table. The unique identity of all rewinders is saved for clients not
+ *  supporting rewinder id.
+ *  \param cur_rewinder List of unique identity of current rewinder using.
+ *  \param cur_rewinder_ids Id of each current rewinder using.
+ */
+void GameProtocol::finalizeState(const std::vector<std::string>& cur_rewinder,
+                                 const std::vector<uint8_t>& cur_rewinder_ids)
+{
+    assert(!NetworkConfig::get()->isClient());
+    assert(cur_rewinder.size() == cur_rewinder_ids.size());
+    assert(cur_rewinder.size() == m_state_rewinders.size());
+    const unsigned header_size = 1/*protocol type*/ + 1 /*gp event type*/+
         4/*time*/;
+    auto& buffer = m_data_to_send->getBuffer();
 
     m_data_to_send->reset();
-    std::vector<uint8_t> names;
-    names.push_back((uint8_t)cur_rewinder.size());
-    for (std::string& name : cur_rewinder)
+    std::vector<uint8_t>& ids = m_rewinder_header;
+    ids.clear();
+    m_legacy_rewinder_header.clear();
+    ids.push_back((uint8_t)cur_rewinder.size());
+    m_legacy_rewinder_header.push_back((uint8_t)cur_rewinder.size());
+    for (unsigned i = 0; i < cur_rewinder.size(); i++)
     {
-        names.push_back((uint8_t)name.size());
-        std::vector<uint8_t> rewinder(name.begin(), name.end());
-        names.insert(names.end(), rewinder.begin(), rewinder.end());
+        const std::string& name = cur_rewinder[i];
+        m_legacy_rewinder_header.push_back((uint8_t)name.size());
+        m_legacy_rewinder_header.insert(m_legacy_rewinder_header.end(),
+            name.begin(), name.end());
+        StateRewinder& sr = m_state_rewinders[i];
+        sr.m_header_offset = header_size + (unsigned)ids.size();
+        ids.push_back(cur_rewinder_ids[i]);
+        if (cur_rewinder_ids[i] == Rewinder::NO_REWINDER_ID)
+        {
+            ids.push_back((uint8_t)name.size());
+            ids.insert(ids.end(), name.begin(), name.end());
+        }
+        sr.m_header_size =
+            header_size + (unsigned)ids.size() - sr.m_header_offset;
+        if (name.size() == 2 && name[0] == RN_KART)
+            sr.m_kart_id = (uint8_t)name[1];
+    }
+    // Only resize the reserved space if the number of rewinders changed
+    const unsigned reserved = m_rewinder_header_size;
+    m_rewinder_header_size = (unsigned)ids.size();
+    if (m_rewinder_header_size != reserved)
+    {
+        auto pos = buffer.begin() + header_size;
+        if (m_rewinder_header_size > reserved)
+        {
+            buffer.insert(pos + reserved,
+                m_rewinder_header_size - reserved, 0);
+        }
+        else
+            buffer.erase(pos + m_rewinder_header_size, pos + reserved);
+        for (StateRewinder& sr : m_state_rewinders)
+        {
+            sr.m_data_offset =
+                sr.m_data_offset - reserved + m_rewinder_header_size;
+        }
     }
-    buffer.insert(pos, names.begin(), names.end());
+    memcpy(buffer.data() + header_size, ids.data(), ids.size());
 }   // finalizeState
 
 // ----------------------------------------------------------------------------
 /** Called when the last state information has been added and the message
- *  can be sent to the clients.
+ *  can be sent to the clients. Karts far away from all karts of a client are
+ *  only sent in every far-kart-state-interval states to it. Clients which
+ *  support delta states and have confirmed a state still kept as baseline
+ *  get the state encoded against that baseline, clients not supporting
+ *  rewinder id get the full state with unique identity of rewinders.
  */
 void GameProtocol::sendState()
 {
     assert(NetworkConfig::get()->isServer());
-    sendMessageToPeers(m_data_to_send, /*reliable*/false);
+    const int ticks = World::getWorld()->getTicksSinceStart();
+    const int header_size = 1/*protocol type*/ + 1 /*gp event type*/ +
+        4/*time*/;
+    auto& buffer = m_data_to_send->getBuffer();
+
+    std::map<STKPeer*, int> delta_peers;
+    std::unique_lock<std::mutex> ul(m_state_confirmation_mutex);
+    for (auto it = m_last_confirmed_state_ticks.begin();
+         it != m_last_confirmed_state_ticks.end();)
+    {
+        std::shared_ptr<STKPeer> peer = it->first.lock();
+        if (!peer)
+        {
+            it = m_last_confirmed_state_ticks.erase(it);
+            continue;
+        }
+        delta_peers[peer.get()] = it->second;
+        it++;
+    }
+    ul.unlock();
+    for (auto it = m_sent_states.begin(); it != m_sent_states.end();)
+    {
+        if (it->first.expired())
+            it = m_sent_states.erase(it);
+        else
+            it++;
+    }
+
+    const int far_interval = ServerConfig::m_far_kart_state_interval;
+    const bool send_far_karts = ServerConfig::m_state_relevance_distance <=
+        0.0f || far_interval <= 1 ||
+        m_state_count % (unsigned)far_interval == 0;
+    m_state_count++;
+
+    bool legacy_created = false;
+    auto peers = STKHost::get()->getPeers();
+    for (auto& peer : peers)
+    {
+        if (!peer->isValidated() || peer->isWaitingForGame())
+            continue;
+        const std::set<std::string>& caps = peer->getClientCapabilities();
+        if (caps.find("rewinder_id") == caps.end())
+        {
+            if (!legacy_created)
+            {
+                legacy_created = true;
+                auto& legacy = m_legacy_state->getBuffer();
+                legacy.assign(buffer.begin(), buffer.begin() + header_size);
+                legacy.insert(legacy.end(), m_legacy_rewinder_header.begin(),
+                    m_legacy_rewinder_header.end());
+                legacy.insert(legacy.end(),
+                    buffer.begin() + header_size + m_rewinder_header_size,
+                    buffer.end());
+            }
+            peer->sendPacket(m_legacy_state, /*reliable*/false);
+            continue;
+        }
+
+        NetworkString* state = m_data_to_send;
+        if (!send_far_karts && filterStateForPeer(peer.get()))
+            state = m_peer_state;
+        if (caps.find("delta_state") == caps.end())
+        {
+            peer->sendPacket(state, /*reliable*/false);
+            continue;
+        }
+
+        std::deque<StateBaseline>& sent_states = m_sent_states[peer];
+        auto it = delta_peers.find(peer.get());
+        const StateBaseline* baseline = it == delta_peers.end() ?
+            NULL : findStateBaseline(sent_states, it->second);
+        const std::vector<uint8_t>& state_buffer = state->getBuffer();
+        // Save what is sent to this client as baseline for future delta
+        // states, which may discard the oldest one
+        if (baseline && sent_states.size() >= MAX_STATE_BASELINES &&
+            baseline == &sent_states.front())
+            baseline = NULL;
+        saveStateBaseline(sent_states, ticks,
+            state_buffer.data() + header_size,
+            state_buffer.size() - header_size);
+        if (!baseline)
+        {
+            // Confirmed state too old or not available, send full state
+            peer->sendPacket(state, /*reliable*/false);
+            continue;
+        }
+        NetworkString* delta = m_delta_state;
+        delta->clear();
+        delta->addUInt8(GP_STATE_DELTA).addUInt32(ticks)
+            .addUInt32(baseline->m_ticks);
+        DeltaNetworkState::encode(sent_states.back().m_data, baseline->m_data,
+            delta);
+        if (delta->getTotalSize() >= state_buffer.size())
+            peer->sendPacket(state, /*reliable*/false);
+        else
+            peer->sendPacket(delta, /*reliable*/false);
+    }
 }   // sendState
 
+// ----------------------------------------------------------------------------
+/** Writes the current state without karts far away from all karts of the
+ *  given client into m_peer_state. The client keeps the karts left out
+ *  where they are when rewinding to this state (see RewindManager::rewindTo).
+ *  \return False if all karts are relevant for this client (or it is
+ *  spectating), in which case m_peer_state is not written.
+ */
+bool GameProtocol::filterStateForPeer(const STKPeer* peer)
+{
+    const std::set<unsigned>& peer_karts = peer->getAvailableKartIDs();
+    if (peer_karts.empty())
+        return false;
+
+    World* w = World::getWorld();
+    const float max_distance = ServerConfig::m_state_relevance_distance;
+    std::vector<bool> relevant(m_state_rewinders.size(), true);
+    unsigned relevant_count = 0;
+    for (unsigned i = 0; i < m_state_rewinders.size(); i++)
+    {
+        const int kart_id = m_state_rewinders[i].m_kart_id;
+        if (kart_id != -1 && kart_id < (int)w->getNumKarts() &&
+            peer_karts.find(kart_id) == peer_karts.end())
+        {
+            const AbstractKart* kart = w->getKart(kart_id);
+            bool near = false;
+            for (unsigned peer_kart : peer_karts)
+            {
+                if (peer_kart < w->getNumKarts() && w->getDistanceBetweenKarts(
+                    w->getKart(peer_kart), kart) < max_distance)
+                {
+                    near = true;
+                    break;
+                }
+            }
+            relevant[i] = near;
+        }
+        if (relevant[i])
+            relevant_count++;
+    }
+    if (relevant_count == m_state_rewinders.size())
+        return false;
+
+    const int header_size = 1/*protocol type*/ + 1 /*gp event type*/ +
+        4/*time*/;
+    const std::vector<uint8_t>& buffer = m_data_to_send->getBuffer();
+    std::vector<uint8_t>& out = m_peer_state->getBuffer();
+    out.assign(buffer.begin(), buffer.begin() + header_size);
+    out.push_back((uint8_t)relevant_count);
+    for (unsigned i = 0; i < m_state_rewinders.size(); i++)
+    {
+        if (!relevant[i])
+            continue;
+        const StateRewinder& sr = m_state_rewinders[i];
+        out.insert(out.end(), buffer.begin() + sr.m_header_offset,
+            buffer.begin() + sr.m_header_offset + sr.m_header_size);
+    }
+    for (unsigned i = 0; i < m_state_rewinders.size(); i++)
+    {
+        if (!relevant[i])
+            continue;
+        const StateRewinder& sr = m_state_rewinders[i];
+        out.insert(out.end(), buffer.begin() + sr.m_data_offset,
+            buffer.begin() + sr.m_data_offset + sr.m_data_size);
+    }
+    return true;
+}   // filterStateForPeer
+
+// ----------------------------------------------------------------------------
+/** Saves a state (without header) as a possible baseline for delta states,
+ *  the oldest one will be discarded if too many are kept.
+ */
+void GameProtocol::saveStateBaseline(std::deque<StateBaseline>& baselines,
+                                     int ticks, const uint8_t* data,
+                                     size_t size)
+{
+    if (!baselines.empty() && baselines.back().m_ticks >= ticks)
+    {
+        // Out-of-order state on client, not used as baseline
+        return;
+    }
+    StateBaseline sb;
+    if (baselines.size() >= MAX_STATE_BASELINES)
+    {
+        // Reuse the memory of the discarded state
+        std::swap(sb.m_data, baselines.front().m_data);
+        baselines.pop_front();
+    }
+    sb.m_ticks = ticks;
+    sb.m_data.assign(data, data + size);
+    baselines.push_back(std::move(sb));
+}   // saveStateBaseline
+
+// ----------------------------------------------------------------------------
+/** Returns the saved state at the given ticks, or NULL if it's not kept
+ *  anymore.
+ */
+const GameProtocol::StateBaseline* GameProtocol::findStateBaseline(
+                     const std::deque<StateBaseline>& baselines, int ticks) const
+{
+    auto it = std::lower_bound(baselines.begin(), baselines.end(), ticks,
+        [](const StateBaseline& sb, int t) { return sb.m_ticks < t; });
+    if (it == baselines.end() || it->m_ticks != ticks)
+        return NULL;
+    return &(*it);
+}   // findStateBaseline
+
+// ----------------------------------------------------------------------------
+/** Handles a state confirmation from a client supporting delta states, the
+ *  confirmed state will be used as baseline for the next states sent to it.
+ *  \param event The data from the client.
+ */
+void GameProtocol::handleStateConfirmation(Event *event)
+{
+    if (!NetworkConfig::get()->isServer())
+        return;
+    STKPeer* peer = event->getPeer();
+    if (peer->isWaitingForGame() || peer->getClientCapabilities().find(
+        "delta_state") == peer->getClientCapabilities().end())
+        return;
+    int ticks = event->data().getTime();
+    std::lock_guard<std::mutex> lock(m_state_confirmation_mutex);
+    auto it = m_last_confirmed_state_ticks.find(event->getPeerSP());
+    if (it == m_last_confirmed_state_ticks.end())
+        m_last_confirmed_state_ticks[event->getPeerSP()] = ticks;
+    else if (ticks > it->second)
+        it->second = ticks;
+}   // handleStateConfirmation
+
+// ----------------------------------------------------------------------------
+/** Removes the confirmed state of a peer, so it will get full states again
+ *  (for example after going back to lobby or live joining).
+ */
+void GameProtocol::eraseStateConfirmation(std::weak_ptr<STKPeer> peer)
+{
+    std::lock_guard<std::mutex> lock(m_state_confirmation_mutex);
+    m_last_confirmed_state_ticks.erase(peer);
+}   // eraseStateConfirmation
+
 // ----------------------------------------------------------------------------
 /** Called when a new full state is received form the server.
  */
@@ -345,22 +678,94 @@ void GameProtocol::handleState(Event *event)
         return;
     NetworkString &data = event->data();
     int ticks          = data.getUInt32();
+    saveStateBaseline(m_state_baselines, ticks,
+        (const uint8_t*)data.getCurrentData(), data.size());
+    addNetworkState(ticks, data);
+}   // handleState
+
+// ----------------------------------------------------------------------------
+/** Called when a state encoded against a previously received state is
+ *  received from the server. If the baseline is not available anymore the
+ *  state is ignored, the server will fallback to full state eventually
+ *  because this client can't confirm newer states.
+ */
+void GameProtocol::handleStateDelta(Event *event)
+{
+    if (!NetworkConfig::get()->isClient())
+        return;
+    NetworkString &data = event->data();
+    int ticks = data.getUInt32();
+    int baseline_ticks = data.getUInt32();
+    const StateBaseline* baseline =
+        findStateBaseline(m_state_baselines, baseline_ticks);
+    if (!baseline)
+    {
+        Log::debug("GameProtocol", "Missing baseline %d for state %d.",
+            baseline_ticks, ticks);
+        return;
+    }
+
+    // Rebuild the message as if it's a full state, the header is kept
+    // so that the state offset is the same as in handleState
+    const int header_size = 1/*protocol type*/ + 1 /*gp event type*/ +
+        4/*time*/;
+    NetworkString state(data.getBuffer().data(), header_size);
+    std::vector<uint8_t>& buffer = state.getBuffer();
+    DeltaNetworkState::decode(&data, baseline->m_data, &buffer);
+    state.reset();
+    state.skip(header_size);
+    saveStateBaseline(m_state_baselines, ticks, buffer.data() + header_size,
+        buffer.size() - header_size);
+    addNetworkState(ticks, state);
+}   // handleStateDelta
 
-    // Check for updated rewinder using
+// ----------------------------------------------------------------------------
+/** Adds a full state received from server (either directly or decoded from
+ *  a delta state) to the rewind manager, and confirms it to the server if
+ *  it supports delta states.
+ *  \param ticks Time of the state.
+ *  \param data The state with read offset after the time header.
+ */
+void GameProtocol::addNetworkState(int ticks, NetworkString& data)
+{
+    // Check for updated rewinder using, either id in the rewinder table or
+    // the unique identity
+    const bool use_id =
+        NetworkConfig::get()->getServerCapabilities().find("rewinder_id") !=
+        NetworkConfig::get()->getServerCapabilities().end();
     unsigned rewinder_size = data.getUInt8();
-    std::vector<std::string> rewinder_using;
+    std::vector<uint8_t> rewinder_ids;
+    std::vector<std::string> rewinder_names;
+    rewinder_ids.reserve(rewinder_size);
     for (unsigned i = 0; i < rewinder_size; i++)
     {
-        std::string name;
-        data.decodeString(&name);
-        rewinder_using.push_back(name);
+        uint8_t id = use_id ? data.getUInt8() : Rewinder::NO_REWINDER_ID;
+        rewinder_ids.push_back(id);
+        if (id == Rewinder::NO_REWINDER_ID)
+        {
+            std::string name;
+            data.decodeString(&name);
+            rewinder_names.push_back(name);
+        }
     }
 
     // The memory for bns will be handled in the RewindInfoState object
     RewindInfoState* ris = new RewindInfoState(ticks, data.getCurrentOffset(),
-        rewinder_using, data.getBuffer());
+        rewinder_ids, rewinder_names, data.getBuffer());
     RewindManager::get()->addNetworkRewindInfo(ris);
-}   // handleState
+
+    if (ticks > m_confirmed_state_ticks &&
+        NetworkConfig::get()->getServerCapabilities().find("delta_state") !=
+        NetworkConfig::get()->getServerCapabilities().end())
+    {
+        m_confirmed_state_ticks = ticks;
+        NetworkString *ns = getNetworkString(5);
+        ns->addUInt8(GP_STATE_CONFIRMATION).addUInt32(ticks);
+        // Unreliable, a lost confirmation only delays using a newer baseline
+        sendToServer(ns, /*reliable*/false);
+        delete ns;
+    }
+}   // addNetworkState
 
 // ----------------------------------------------------------------------------
 /** Called from the RewindManager when rolling back.
@@ -27,7 +27,11 @@
 #include "utils/stk_process.hpp"
 
 #include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 #include <tuple>
 
@@ -49,9 +53,88 @@ private:
            GP_STATE,
            GP_ITEM_UPDATE,
            GP_ITEM_CONFIRMATION,
-           GP_ADJUST_TIME
+           GP_ADJUST_TIME,
+           GP_STATE_DELTA,
+           GP_STATE_CONFIRMATION
     };
 
+    /** Maximum number of previous states kept as baseline for delta state
+     *  compression (on both server and client). */
+    static const unsigned MAX_STATE_BASELINES = 32;
+
+    /** A previous state (without message and time header), used as baseline
+     *  for delta compression. */
+    struct StateBaseline
+    {
+        int                  m_ticks;
+        std::vector<uint8_t> m_data;
+    };   // struct StateBaseline
+
+    /** On the client the states received recently, sorted by ticks. */
+    std::deque<StateBaseline> m_state_baselines;
+
+    /** On the server the states sent recently to each client supporting
+     *  delta states, sorted by ticks. Only used by the main thread. */
+    std::map<std::weak_ptr<STKPeer>, std::deque<StateBaseline>,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_sent_states;
+
+    /** Protects m_last_confirmed_state_ticks, which is updated by the
+     *  network thread. */
+    std::mutex m_state_confirmation_mutex;
+
+    /** Stores on the server the latest state ticks confirmed by each client
+     *  which supports delta states. */
+    std::map<std::weak_ptr<STKPeer>, int,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_last_confirmed_state_ticks;
+
+    /** Latest state ticks confirmed to server by this client. */
+    int m_confirmed_state_ticks;
+
+    /** Location of the data of a rewinder in the current state, used by the
+     *  server to leave out far away karts for a client. */
+    struct StateRewinder
+    {
+        /** World kart id if the rewinder is a kart, -1 otherwise. */
+        int      m_kart_id;
+        /** Offset and size of the rewinder id (and unique identity). */
+        unsigned m_header_offset;
+        unsigned m_header_size;
+        /** Offset and size of the state data (including its size). */
+        unsigned m_data_offset;
+        unsigned m_data_size;
+    };   // struct StateRewinder
+
+    /** All rewinders in the current state, in order. */
+    std::vector<StateRewinder> m_state_rewinders;
+
+    /** Size of the rewinder ids in front of the current state, space of the
+     *  same size is reserved for the next state when it is started. */
+    unsigned m_rewinder_header_size;
+
+    /** Rewinder ids of the current state, copied into the reserved space in
+     *  front of the state. */
+    std::vector<uint8_t> m_rewinder_header;
+
+    /** Offset in m_data_to_send of the state of the rewinder being saved. */
+    unsigned m_rewinder_state_offset;
+
+    /** Unique identity of the rewinders in the current state, sent instead
+     *  of the rewinder ids to clients not supporting it. */
+    std::vector<uint8_t> m_legacy_rewinder_header;
+
+    /** Number of states sent, used to decide when far away karts are
+     *  sent. */
+    unsigned m_state_count;
+
+    /** Reused buffer for the current state without far away karts for a
+     *  client. */
+    NetworkString *m_peer_state;
+
+    /** Reused buffers for the current state with unique identity of
+     *  rewinders for older clients, and for delta states. */
+    NetworkString *m_legacy_state;
+    NetworkString *m_delta_state;
+
     /** A network string that collects all information from the server to be sent
      *  next. */
     NetworkString *m_data_to_send;
@@ -78,6 +161,14 @@ private:
     void handleState(Event *event);
     void handleAdjustTime(Event *event);
     void handleItemEventConfirmation(Event *event);
+    void handleStateDelta(Event *event);
+    void handleStateConfirmation(Event *event);
+    void addNetworkState(int ticks, NetworkString& data);
+    bool filterStateForPeer(const STKPeer* peer);
+    const StateBaseline* findStateBaseline(
+                    const std::deque<StateBaseline>& baselines, int ticks) const;
+    void saveStateBaseline(std::deque<StateBaseline>& baselines, int ticks,
+                           const uint8_t* data, size_t size);
     static std::weak_ptr<GameProtocol> m_game_protocol[PT_COUNT];
     NetworkItemManager* m_network_item_manager;
     // Maximum value of values are only 32768
@@ -112,10 +203,13 @@ public:
     void controllerAction(int kart_id, PlayerAction action,
                           int value, int val_l, int val_r);
     void startNewState();
-    void addState(BareNetworkString *buffer);
+    BareNetworkString* beginRewinderState();
+    void endRewinderState(bool saved);
     void sendState();
-    void finalizeState(std::vector<std::string>& cur_rewinder);
+    void finalizeState(const std::vector<std::string>& cur_rewinder,
+                       const std::vector<uint8_t>& cur_rewinder_ids);
     void sendItemEventConfirmation(int ticks);
+    void eraseStateConfirmation(std::weak_ptr<STKPeer> peer);
 
     virtual void undo(BareNetworkString *buffer) OVERRIDE;
     virtual void rewind(BareNetworkString *buffer) OVERRIDE;
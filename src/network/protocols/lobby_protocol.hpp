@@ -81,6 +81,7 @@ public:
                          // (like abusive behaviour)
         LE_ASSETS_UPDATE, // Client tell server with updated assets
         LE_COMMAND, // Command
+        LE_ASSET_CATALOG, // Server tell client its karts and tracks indices
     };
 
     enum RejectReason : uint8_t
@@ -29,9 +29,12 @@
 #include "karts/official_karts.hpp"
 #include "modes/capture_the_flag.hpp"
 #include "modes/linear_world.hpp"
+#include "network/ban_index.hpp"
 #include "network/crypto.hpp"
+#include "network/database_writer.hpp"
 #include "network/event.hpp"
 #include "network/game_setup.hpp"
+#include "network/geolocation_index.hpp"
 #include "network/network.hpp"
 #include "network/network_config.hpp"
 #include "network/network_player_profile.hpp"
@@ -41,6 +44,7 @@
 #include "network/protocols/game_protocol.hpp"
 #include "network/protocols/game_events_protocol.hpp"
 #include "network/race_event_manager.hpp"
+#include "network/rewind_manager.hpp"
 #include "network/server_config.hpp"
 #include "network/socket_address.hpp"
 #include "network/stk_host.hpp"
@@ -49,6 +53,7 @@
 #include "online/online_profile.hpp"
 #include "online/request_manager.hpp"
 #include "online/xml_request.hpp"
+#include "race/history.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/check_manager.hpp"
 #include "tracks/track.hpp"
@@ -143,6 +148,40 @@ void insideIPv6CIDRSQL(sqlite3_context* context, int argc,
     sqlite3_result_int(context, insideIPv6CIDR(ipv6_cidr, ipv6_in));
 }   // insideIPv6CIDRSQL
 
+// ----------------------------------------------------------------------------
+/** Opens a connection to the server database with the busy handler and the
+ *  IPv6 functions used by queries, or returns NULL if it can't be opened.
+ */
+static sqlite3* openDatabase(const std::string& path, int flags)
+{
+    sqlite3* db = NULL;
+    int ret = sqlite3_open_v2(path.c_str(), &db, flags, NULL);
+    if (ret != SQLITE_OK)
+    {
+        Log::error("ServerLobby", "Cannot open database: %s.",
+            sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    sqlite3_busy_handler(db, [](void* data, int retry)
+        {
+            int retry_count = ServerConfig::m_database_timeout / 100;
+            if (retry < retry_count)
+            {
+                sqlite3_sleep(100);
+                // Return non-zero to let caller retry again
+                return 1;
+            }
+            // Return zero to let caller return SQLITE_BUSY immediately
+            return 0;
+        }, NULL);
+    sqlite3_create_function(db, "insideIPv6CIDR", 2, SQLITE_UTF8, NULL,
+        &insideIPv6CIDRSQL, NULL, NULL);
+    sqlite3_create_function(db, "upperIPv6", 1, SQLITE_UTF8, NULL,
+        &upperIPv6SQL, NULL, NULL);
+    return db;
+}   // openDatabase
+
 // ----------------------------------------------------------------------------
 /*
 Copy below code so it can be use as loadable extension to be used in sqlite3
@@ -285,33 +324,16 @@ void ServerLobby::initDatabase()
         return;
     const std::string& path = ServerConfig::getConfigDirectory() + "/" +
         ServerConfig::m_database_file.c_str();
-    int ret = sqlite3_open_v2(path.c_str(), &m_db,
-        SQLITE_OPEN_SHAREDCACHE | SQLITE_OPEN_FULLMUTEX |
-        SQLITE_OPEN_READWRITE, NULL);
-    if (ret != SQLITE_OK)
-    {
-        Log::error("ServerLobby", "Cannot open database: %s.",
-            sqlite3_errmsg(m_db));
-        sqlite3_close(m_db);
-        m_db = NULL;
+    m_db = openDatabase(path, SQLITE_OPEN_SHAREDCACHE |
+        SQLITE_OPEN_FULLMUTEX | SQLITE_OPEN_READWRITE);
+    if (!m_db)
         return;
-    }
-    sqlite3_busy_handler(m_db, [](void* data, int retry)
-        {
-            int retry_count = ServerConfig::m_database_timeout / 100;
-            if (retry < retry_count)
-            {
-                sqlite3_sleep(100);
-                // Return non-zero to let caller retry again
-                return 1;
-            }
-            // Return zero to let caller return SQLITE_BUSY immediately
-            return 0;
-        }, NULL);
-    sqlite3_create_function(m_db, "insideIPv6CIDR", 2, SQLITE_UTF8, NULL,
-        &insideIPv6CIDRSQL, NULL, NULL);
-    sqlite3_create_function(m_db, "upperIPv6", 1, SQLITE_UTF8, NULL,
-        &upperIPv6SQL, NULL, NULL);
+    // Not in shared cache, so the writer transactions are isolated from the
+    // lobby connection
+    sqlite3* writer_db = openDatabase(path, SQLITE_OPEN_FULLMUTEX |
+        SQLITE_OPEN_READWRITE);
+    if (writer_db)
+        m_db_writer.reset(new DatabaseWriter(writer_db));
     checkTableExists(ServerConfig::m_ip_ban_table, m_ip_ban_table_exists);
     checkTableExists(ServerConfig::m_ipv6_ban_table, m_ipv6_ban_table_exists);
     checkTableExists(ServerConfig::m_online_id_ban_table,
@@ -322,6 +344,32 @@ void ServerLobby::initDatabase()
         m_ip_geolocation_table_exists);
     checkTableExists(ServerConfig::m_ipv6_geolocation_table,
         m_ipv6_geolocation_table_exists);
+    if (m_ip_ban_table_exists || m_ipv6_ban_table_exists ||
+        m_online_id_ban_table_exists)
+    {
+        m_ban_index.reset(new BanIndex(path, ServerConfig::m_database_timeout,
+            m_ip_ban_table_exists ?
+            ServerConfig::m_ip_ban_table : std::string(),
+            m_ipv6_ban_table_exists ?
+            ServerConfig::m_ipv6_ban_table : std::string(),
+            m_online_id_ban_table_exists ?
+            ServerConfig::m_online_id_ban_table : std::string()));
+    }
+    if (m_ip_geolocation_table_exists || m_ipv6_geolocation_table_exists)
+    {
+        m_geolocation_index.reset(new GeolocationIndex());
+        if (!m_geolocation_index->init(m_db,
+            m_ip_geolocation_table_exists ?
+            ServerConfig::m_ip_geolocation_table : std::string(),
+            m_ipv6_geolocation_table_exists ?
+            ServerConfig::m_ipv6_geolocation_table : std::string(),
+            path + ".geolocation"))
+        {
+            Log::error("ServerLobby", "Geolocation index not available, "
+                "looking up the database instead.");
+            m_geolocation_index.reset();
+        }
+    }
 #endif
 }   // initDatabase
 
@@ -542,6 +590,10 @@ void ServerLobby::destroyDatabase()
     auto peers = STKHost::get()->getPeers();
     for (auto& peer : peers)
         writeDisconnectInfoTable(peer.get());
+    // Finish all queued writes before closing
+    m_db_writer.reset();
+    m_ban_index.reset();
+    m_geolocation_index.reset();
     if (m_db != NULL)
         sqlite3_close(m_db);
 #endif
@@ -559,7 +611,7 @@ void ServerLobby::writeDisconnectInfoTable(STKPeer* peer)
         "WHERE host_id = %u;", m_server_stats_table.c_str(),
         peer->getAveragePing(), peer->getPacketLoss(),
         peer->getHostId());
-    easySQLQuery(query);
+    asyncSQLQuery(query);
 #endif
 }   // writeDisconnectInfoTable
 
@@ -621,6 +673,39 @@ void ServerLobby::updateAddons()
         m_available_kts.first = m_official_kts.first;
     else
         m_available_kts.first = { all_k.begin(), all_k.end() };
+
+    bool catalog_grown = m_asset_catalog.update(all_k,
+        track_manager->getAllTrackIdentifiers());
+    m_official_kts_bitsets.first =
+        m_asset_catalog.getKartBitset(m_official_kts.first);
+    m_official_kts_bitsets.second =
+        m_asset_catalog.getTrackBitset(m_official_kts.second);
+    m_addon_kts_bitsets.first =
+        m_asset_catalog.getKartBitset(m_addon_kts.first);
+    m_addon_kts_bitsets.second =
+        m_asset_catalog.getTrackBitset(m_addon_kts.second);
+    m_addon_arenas_bitset = m_asset_catalog.getTrackBitset(m_addon_arenas);
+    m_addon_soccers_bitset = m_asset_catalog.getTrackBitset(m_addon_soccers);
+
+    // The bitsets of peers don't have the new assets, which would be removed
+    // for everyone when they are intersected
+    if (!catalog_grown || !STKHost::existHost())
+        return;
+    for (auto& peer : STKHost::get()->getPeers())
+    {
+        if (peer->getClientAssets().first.empty())
+            continue;
+        if (peer->getClientCapabilities().find("asset_catalog") !=
+            peer->getClientCapabilities().end())
+        {
+            sendAssetCatalog(peer.get(), true/*request_assets*/);
+            continue;
+        }
+        const auto& idents = peer->getAssetIdents();
+        AssetBitset karts = m_asset_catalog.getKartBitset(idents.first);
+        AssetBitset tracks = m_asset_catalog.getTrackBitset(idents.second);
+        setPeerAssets(peer.get(), karts, tracks);
+    }
 }   // updateAddons
 
 //-----------------------------------------------------------------------------
@@ -941,8 +1026,7 @@ bool ServerLobby::notifyEventAsynchronous(Event* event)
         case LE_CLIENT_BACK_LOBBY:
             clientSelectingAssetsWantsToBackLobby(event);         break;
         case LE_REPORT_PLAYER: writePlayerReport(event);          break;
-        case LE_ASSETS_UPDATE:
-            handleAssets(event->data(), event->getPeer());        break;
+        case LE_ASSETS_UPDATE: handleAssetsUpdate(event);         break;
         case LE_COMMAND:
             handleServerCommand(event, event->getPeerSP());       break;
         default:                                                  break;
@@ -960,7 +1044,7 @@ bool ServerLobby::notifyEventAsynchronous(Event* event)
 /* Every 1 minute STK will poll database:
  * 1. Set disconnected time to now for non-exists host.
  * 2. Clear expired player reports if necessary
- * 3. Kick active peer from ban list
+ * 3. Kick active peer from ban list (using the in-memory ban index)
  */
 void ServerLobby::pollDatabase()
 {
@@ -972,115 +1056,37 @@ void ServerLobby::pollDatabase()
 
     m_last_poll_db_time = StkTime::getMonoTimeMs();
 
-    if (m_ip_ban_table_exists)
-    {
-        std::string query =
-            "SELECT ip_start, ip_end, reason, description FROM ";
-        query += ServerConfig::m_ip_ban_table;
-        query += " WHERE datetime('now') > datetime(starting_time) AND "
-            "(expired_days is NULL OR datetime"
-            "(starting_time, '+'||expired_days||' days') > datetime('now'));";
-        auto peers = STKHost::get()->getPeers();
-        sqlite3_exec(m_db, query.c_str(),
-            [](void* ptr, int count, char** data, char** columns)
-            {
-                std::vector<std::shared_ptr<STKPeer> >* peers_ptr =
-                    (std::vector<std::shared_ptr<STKPeer> >*)ptr;
-                for (std::shared_ptr<STKPeer>& p : *peers_ptr)
-                {
-                    // IPv4 ban list atm
-                    if (p->isAIPeer() || p->getAddress().isIPv6())
-                        continue;
-
-                    uint32_t ip_start = 0;
-                    uint32_t ip_end = 0;
-                    if (!StringUtils::fromString(data[0], ip_start))
-                        continue;
-                    if (!StringUtils::fromString(data[1], ip_end))
-                        continue;
-                    uint32_t peer_addr = p->getAddress().getIP();
-                    if (ip_start <= peer_addr && ip_end >= peer_addr)
-                    {
-                        Log::info("ServerLobby",
-                            "Kick %s, reason: %s, description: %s",
-                            p->getAddress().toString().c_str(),
-                            data[2], data[3]);
-                        p->kick();
-                    }
-                }
-                return 0;
-            }, &peers, NULL);
-    }
-
-    if (m_ipv6_ban_table_exists)
-    {
-        std::string query =
-            "SELECT ipv6_cidr, reason, description FROM ";
-        query += ServerConfig::m_ipv6_ban_table;
-        query += " WHERE datetime('now') > datetime(starting_time) AND "
-            "(expired_days is NULL OR datetime"
-            "(starting_time, '+'||expired_days||' days') > datetime('now'));";
-        auto peers = STKHost::get()->getPeers();
-        sqlite3_exec(m_db, query.c_str(),
-            [](void* ptr, int count, char** data, char** columns)
-            {
-                std::vector<std::shared_ptr<STKPeer> >* peers_ptr =
-                    (std::vector<std::shared_ptr<STKPeer> >*)ptr;
-                for (std::shared_ptr<STKPeer>& p : *peers_ptr)
-                {
-                    std::string ipv6;
-                    if (p->getAddress().isIPv6())
-                        ipv6 = p->getAddress().toString(false);
-                    // IPv6 ban list atm
-                    if (p->isAIPeer() || ipv6.empty())
-                        continue;
-
-                    char* ipv6_cidr = data[0];
-                    if (insideIPv6CIDR(ipv6_cidr, ipv6.c_str()) == 1)
-                    {
-                        Log::info("ServerLobby",
-                            "Kick %s, reason: %s, description: %s",
-                            ipv6.c_str(), data[1], data[2]);
-                        p->kick();
-                    }
-                }
-                return 0;
-            }, &peers, NULL);
-    }
-
-    if (m_online_id_ban_table_exists)
+    if (m_ban_index)
     {
-        std::string query = "SELECT online_id, reason, description FROM ";
-        query += ServerConfig::m_online_id_ban_table;
-        query += " WHERE datetime('now') > datetime(starting_time) AND "
-            "(expired_days is NULL OR datetime"
-            "(starting_time, '+'||expired_days||' days') > datetime('now'));";
         auto peers = STKHost::get()->getPeers();
-        sqlite3_exec(m_db, query.c_str(),
-            [](void* ptr, int count, char** data, char** columns)
+        for (std::shared_ptr<STKPeer>& p : peers)
+        {
+            if (p->isAIPeer())
+                continue;
+            const SocketAddress& addr = p->getAddress();
+            BanIndex::IPBan ip_ban;
+            BanIndex::IPv6Ban ipv6_ban;
+            BanIndex::OnlineIdBan online_id_ban;
+            const BanIndex::Ban* ban = NULL;
+            if (!addr.isIPv6() &&
+                m_ban_index->findIPBan(addr.getIP(), &ip_ban))
+                ban = &ip_ban;
+            else if (addr.isIPv6() &&
+                m_ban_index->findIPv6Ban(addr, &ipv6_ban))
+                ban = &ipv6_ban;
+            else if (!p->getPlayerProfiles().empty() &&
+                m_ban_index->findOnlineIdBan(
+                p->getPlayerProfiles()[0]->getOnlineId(), &online_id_ban))
+                ban = &online_id_ban;
+            if (ban)
             {
-                std::vector<std::shared_ptr<STKPeer> >* peers_ptr =
-                    (std::vector<std::shared_ptr<STKPeer> >*)ptr;
-                for (std::shared_ptr<STKPeer>& p : *peers_ptr)
-                {
-                    if (p->isAIPeer()
-                        || p->getPlayerProfiles().empty())
-                        continue;
-
-                    uint32_t online_id = 0;
-                    if (!StringUtils::fromString(data[0], online_id))
-                        continue;
-                    if (online_id == p->getPlayerProfiles()[0]->getOnlineId())
-                    {
-                        Log::info("ServerLobby",
-                            "Kick %s, reason: %s, description: %s",
-                            p->getAddress().toString().c_str(),
-                            data[1], data[2]);
-                        p->kick();
-                    }
-                }
-                return 0;
-            }, &peers, NULL);
+                Log::info("ServerLobby",
+                    "Kick %s, reason: %s, description: %s",
+                    addr.toString().c_str(), ban->m_reason.c_str(),
+                    ban->m_description.c_str());
+                p->kick();
+            }
+        }
     }
 
     if (m_player_reports_table_exists &&
@@ -1092,7 +1098,7 @@ void ServerLobby::pollDatabase()
             "(reported_time, '+%f days') < datetime('now');",
             ServerConfig::m_player_reports_table.c_str(),
             ServerConfig::m_player_reports_expired_days);
-        easySQLQuery(query);
+        asyncSQLQuery(query);
     }
     if (m_server_stats_table.empty())
         return;
@@ -1132,7 +1138,7 @@ void ServerLobby::pollDatabase()
         oss << ");";
         query = oss.str();
     }
-    easySQLQuery(query);
+    asyncSQLQuery(query);
 }   // pollDatabase
 
 //-----------------------------------------------------------------------------
@@ -1171,6 +1177,27 @@ bool ServerLobby::easySQLQuery(const std::string& query,
     return true;
 }   // easySQLQuery
 
+//-----------------------------------------------------------------------------
+/** Queue a query (usually a write) to be run in the database writer thread,
+ *  so the lobby doesn't wait for the disk. bind_function and callback are
+ *  called in that thread, so they must only use data captured by value.
+ *  \param callback Called with true if the query is written.
+ */
+void ServerLobby::asyncSQLQuery(const std::string& query,
+                   std::function<void(sqlite3_stmt* stmt)> bind_function,
+                   std::function<void(bool)> callback) const
+{
+    if (!m_db_writer)
+    {
+        // Writer connection couldn't be opened, write in the lobby then
+        bool written = easySQLQuery(query, bind_function);
+        if (callback)
+            callback(written);
+        return;
+    }
+    m_db_writer->addQuery(query, bind_function, callback);
+}   // asyncSQLQuery
+
 //-----------------------------------------------------------------------------
 /* Write true to result if table name exists in database. */
 void ServerLobby::checkTableExists(const std::string& table, bool& result)
@@ -1219,6 +1246,8 @@ std::string ServerLobby::ip2Country(const SocketAddress& addr) const
 {
     if (!m_db || !m_ip_geolocation_table_exists || addr.isLAN())
         return "";
+    if (m_geolocation_index)
+        return m_geolocation_index->getCountryCode(addr);
 
     std::string cc_code;
     std::string query = StringUtils::insertValues(
@@ -1260,6 +1289,8 @@ std::string ServerLobby::ipv62Country(const SocketAddress& addr) const
 {
     if (!m_db || !m_ipv6_geolocation_table_exists)
         return "";
+    if (m_geolocation_index)
+        return m_geolocation_index->getCountryCode(addr);
 
     std::string cc_code;
     const std::string& ipv6 = addr.toString(false/*show_port*/);
@@ -1348,7 +1379,8 @@ void ServerLobby::writePlayerReport(Event* event)
             reporter->getAddress().getIP(), reporter_npp->getOnlineId(),
             reporting_peer->getAddress().getIP(), reporting_npp->getOnlineId());
     }
-    bool written = easySQLQuery(query,
+    std::shared_ptr<STKPeer> reporter_sp = event->getPeerSP();
+    asyncSQLQuery(query,
         [reporter_npp, reporting_npp, info](sqlite3_stmt* stmt)
         {
             // SQLITE_TRANSIENT to copy string
@@ -1379,16 +1411,18 @@ void ServerLobby::writePlayerReport(Event* event)
                 Log::error("easySQLQuery", "Failed to bind %s.",
                     StringUtils::wideToUtf8(reporting_npp->getName()).c_str());
             }
+        },
+        [this, reporter_sp, reporting_npp](bool written)
+        {
+            if (!written)
+                return;
+            NetworkString* success = getNetworkString();
+            success->setSynchronous(true);
+            success->addUInt8(LE_REPORT_PLAYER).addUInt8(1)
+                .encodeString(reporting_npp->getName());
+            reporter_sp->sendPacket(success, true/*reliable*/);
+            delete success;
         });
-    if (written)
-    {
-        NetworkString* success = getNetworkString();
-        success->setSynchronous(true);
-        success->addUInt8(LE_REPORT_PLAYER).addUInt8(1)
-            .encodeString(reporting_npp->getName());
-        event->getPeer()->sendPacket(success, true/*reliable*/);
-        delete success;
-    }
 #endif
 }   // writePlayerReport
 
@@ -1829,6 +1863,14 @@ void ServerLobby::liveJoinRequest(Event* event)
         rejectLiveJoin(peer, BLR_NO_GAME_FOR_LIVE_JOIN);
         return;
     }
+    if (NetworkConfig::get()->useQuantizedOrigin() &&
+        peer->getClientCapabilities().find("quantized_origin") ==
+        peer->getClientCapabilities().end())
+    {
+        // Game state of current game cannot be read by this peer
+        rejectLiveJoin(peer, BLR_NO_GAME_FOR_LIVE_JOIN);
+        return;
+    }
 
     peer->clearAvailableKartIDs();
     if (!spectator)
@@ -2059,6 +2101,8 @@ void ServerLobby::finishedLoadingLiveJoinClient(Event* event)
     assert(nim);
     nim->saveCompleteState(ns);
     nim->addLiveJoinPeer(peer);
+    if (auto gp = GameProtocol::lock())
+        gp->eraseStateConfirmation(peer);
 
     w->saveCompleteState(ns, peer.get());
     if (RaceManager::get()->supportsLiveJoining())
@@ -2071,6 +2115,15 @@ void ServerLobby::finishedLoadingLiveJoinClient(Event* event)
         for (unsigned i = 0; i < players.size(); i++)
             players[i]->getKartData().encode(ns);
     }
+    if (peer->getClientCapabilities().find("rewinder_id") !=
+        peer->getClientCapabilities().end())
+        RewindManager::get()->encodeRewinderTable(ns);
+    if (peer->getClientCapabilities().find("quantized_origin") !=
+        peer->getClientCapabilities().end())
+    {
+        ns->addUInt8(
+            NetworkConfig::get()->useQuantizedOrigin() ? 1 : 0);
+    }
 
     m_peers_ready[peer] = false;
     peer->setWaitingForGame(false);
@@ -2500,7 +2553,10 @@ void ServerLobby::startSelection(const Event *event)
     }
 
     // Remove karts / tracks from server that are not supported on all clients
-    std::set<std::string> karts_erase, tracks_erase;
+    AssetBitset karts_available =
+        m_asset_catalog.getKartBitset(m_available_kts.first);
+    AssetBitset tracks_available =
+        m_asset_catalog.getTrackBitset(m_available_kts.second);
     auto peers = STKHost::get()->getPeers();
     std::set<STKPeer*> always_spectate_peers;
     bool has_peer_plays_game = false;
@@ -2508,8 +2564,8 @@ void ServerLobby::startSelection(const Event *event)
     {
         if (!peer->isValidated() || peer->isWaitingForGame())
             continue;
-        peer->eraseServerKarts(m_available_kts.first, karts_erase);
-        peer->eraseServerTracks(m_available_kts.second, tracks_erase);
+        peer->eraseServerKarts(karts_available);
+        peer->eraseServerTracks(tracks_available);
         if (peer->alwaysSpectate())
             always_spectate_peers.insert(peer.get());
         else if (!peer->isAIPeer())
@@ -2551,14 +2607,10 @@ void ServerLobby::startSelection(const Event *event)
         always_spectate_peers.insert(peer.get());
     }
 
-    for (const std::string& kart_erase : karts_erase)
-    {
-        m_available_kts.first.erase(kart_erase);
-    }
-    for (const std::string& track_erase : tracks_erase)
-    {
-        m_available_kts.second.erase(track_erase);
-    }
+    m_asset_catalog.eraseMissingKarts(karts_available,
+        &m_available_kts.first);
+    m_asset_catalog.eraseMissingTracks(tracks_available,
+        &m_available_kts.second);
 
     max_player = 0;
     STKHost::get()->updatePlayers(&max_player);
@@ -2877,6 +2929,12 @@ void ServerLobby::checkRaceFinished()
     if (!RaceEventManager::get()->isRaceOver()) return;
 
     Log::info("ServerLobby", "The game is considered finished.");
+    if (ServerConfig::m_save_history)
+    {
+        history->Save(ServerConfig::getConfigDirectory() + "/history-" +
+            ServerConfig::m_server_uid + "-" +
+            StringUtils::toString(StkTime::getTimeSinceEpoch()) + ".dat");
+    }
     // notify the network world that it is stopped
     RaceEventManager::get()->stop();
 
@@ -3409,66 +3467,103 @@ void ServerLobby::saveIPBanTable(const SocketAddress& addr)
         "INSERT INTO %s (ip_start, ip_end) "
         "VALUES (%u, %u);",
         ServerConfig::m_ip_ban_table.c_str(), addr.getIP(), addr.getIP());
-    easySQLQuery(query);
+    BanIndex* ban_index = m_ban_index.get();
+    asyncSQLQuery(query, nullptr, [ban_index](bool written)
+        {
+            if (written && ban_index)
+                ban_index->requestRefresh();
+        });
 #endif
 }   // saveIPBanTable
 
 //-----------------------------------------------------------------------------
 bool ServerLobby::handleAssets(const NetworkString& ns, STKPeer* peer)
 {
-    std::set<std::string> client_karts, client_tracks;
-    const unsigned kart_num = ns.getUInt16();
-    const unsigned track_num = ns.getUInt16();
-    for (unsigned i = 0; i < kart_num; i++)
-    {
-        std::string kart;
+    std::vector<std::string> client_karts(ns.getUInt16());
+    std::vector<std::string> client_tracks(ns.getUInt16());
+    for (std::string& kart : client_karts)
         ns.decodeString(&kart);
-        client_karts.insert(kart);
-    }
-    for (unsigned i = 0; i < track_num; i++)
-    {
-        std::string track;
+    for (std::string& track : client_tracks)
         ns.decodeString(&track);
-        client_tracks.insert(track);
-    }
 
-    // Drop this player if he doesn't have at least 1 kart / track the same
-    // as server
-    float okt = 0.0f;
-    float ott = 0.0f;
-    for (auto& client_kart : client_karts)
-    {
-        if (m_official_kts.first.find(client_kart) !=
-            m_official_kts.first.end())
-            okt += 1.0f;
-    }
-    okt = okt / (float)m_official_kts.first.size();
-    for (auto& client_track : client_tracks)
-    {
-        if (m_official_kts.second.find(client_track) !=
-            m_official_kts.second.end())
-            ott += 1.0f;
-    }
-    ott = ott / (float)m_official_kts.second.size();
+    AssetBitset karts = m_asset_catalog.getKartBitset(client_karts);
+    AssetBitset tracks = m_asset_catalog.getTrackBitset(client_tracks);
+    // Clients with the catalog send their assets again when it grows
+    if (peer->getClientCapabilities().find("asset_catalog") ==
+        peer->getClientCapabilities().end())
+        peer->setAssetIdents(client_karts, client_tracks);
+    return updatePeerAssets(peer, karts, tracks);
+}   // handleAssets
 
-    std::set<std::string> karts_erase, tracks_erase;
-    for (const std::string& server_kart : m_available_kts.first)
+//-----------------------------------------------------------------------------
+/** Handles assets sent as bitsets of the asset catalog by clients which
+ *  received it, the catalog is sent again if it changed since then. */
+void ServerLobby::handleAssetsUpdate(Event* event)
+{
+    STKPeer* peer = event->getPeer();
+    const NetworkString& data = event->data();
+    if (peer->getClientCapabilities().find("asset_catalog") ==
+        peer->getClientCapabilities().end())
     {
-        if (client_karts.find(server_kart) == client_karts.end())
-        {
-            karts_erase.insert(server_kart);
-        }
+        handleAssets(data, peer);
+        return;
     }
-    for (const std::string& server_track : m_available_kts.second)
+
+    // Addons installed by the owner of a child process server are added to
+    // the catalog first, so they are included in the bitsets sent back
+    const uint32_t hash = m_asset_catalog.getHash();
+    if (m_process_type == PT_CHILD &&
+        peer->getHostId() == m_client_server_host_id.load())
+        updateAddons();
+    // If it grew, updateAddons already sent it again to all peers
+    if (m_asset_catalog.getHash() != hash)
+        return;
+    if (data.getUInt32() != hash)
     {
-        if (client_tracks.find(server_track) == client_tracks.end())
-        {
-            tracks_erase.insert(server_track);
-        }
+        sendAssetCatalog(peer, true/*request_assets*/);
+        return;
     }
+    AssetBitset karts, tracks;
+    karts.decode(data);
+    tracks.decode(data);
+    updatePeerAssets(peer, karts, tracks);
+}   // handleAssetsUpdate
+
+//-----------------------------------------------------------------------------
+/** Sends the asset catalog to a client, which will send its assets back
+ *  if request_assets is true. */
+void ServerLobby::sendAssetCatalog(STKPeer* peer, bool request_assets)
+{
+    NetworkString* ns = getNetworkString();
+    ns->setSynchronous(true);
+    ns->addUInt8(LE_ASSET_CATALOG).addUInt8(request_assets ? 1 : 0);
+    m_asset_catalog.encode(ns);
+    peer->sendPacket(ns, true/*reliable*/);
+    delete ns;
+}   // sendAssetCatalog
 
-    if (karts_erase.size() == m_available_kts.first.size() ||
-        tracks_erase.size() == m_available_kts.second.size() ||
+//-----------------------------------------------------------------------------
+/** Checks the karts and tracks of a client against the server ones, which
+ *  are intersected a word at a time. The peer is refused if it doesn't have
+ *  enough of them.
+ *  \return False if refused.
+ */
+bool ServerLobby::updatePeerAssets(STKPeer* peer, AssetBitset& karts,
+                                   AssetBitset& tracks)
+{
+    // Drop this player if he doesn't have at least 1 kart / track the same
+    // as server
+    float okt = (float)karts.countCommon(m_official_kts_bitsets.first) /
+        (float)m_official_kts.first.size();
+    float ott = (float)tracks.countCommon(m_official_kts_bitsets.second) /
+        (float)m_official_kts.second.size();
+
+    AssetBitset karts_available =
+        m_asset_catalog.getKartBitset(m_available_kts.first);
+    AssetBitset tracks_available =
+        m_asset_catalog.getTrackBitset(m_available_kts.second);
+    if (karts.countCommon(karts_available) == 0 ||
+        tracks.countCommon(tracks_available) == 0 ||
         okt < ServerConfig::m_official_karts_threshold ||
         ott < ServerConfig::m_official_tracks_threshold)
     {
@@ -3484,32 +3579,27 @@ bool ServerLobby::handleAssets(const NetworkString& ns, STKPeer* peer)
         return false;
     }
 
-    std::array<int, AS_TOTAL> addons_scores = {{ -1, -1, -1, -1 }};
-    size_t addon_kart = 0;
-    size_t addon_track = 0;
-    size_t addon_arena = 0;
-    size_t addon_soccer = 0;
-
-    for (auto& kart : m_addon_kts.first)
-    {
-        if (client_karts.find(kart) != client_karts.end())
-            addon_kart++;
-    }
-    for (auto& track : m_addon_kts.second)
-    {
-        if (client_tracks.find(track) != client_tracks.end())
-            addon_track++;
-    }
-    for (auto& arena : m_addon_arenas)
-    {
-        if (client_tracks.find(arena) != client_tracks.end())
-            addon_arena++;
-    }
-    for (auto& soccer : m_addon_soccers)
+    setPeerAssets(peer, karts, tracks);
+    if (m_process_type == PT_CHILD &&
+        peer->getHostId() == m_client_server_host_id.load())
     {
-        if (client_tracks.find(soccer) != client_tracks.end())
-            addon_soccer++;
+        // Update child process addons list too so player can choose later
+        updateAddons();
+        updateTracksForMode();
     }
+    return true;
+}   // updatePeerAssets
+
+//-----------------------------------------------------------------------------
+/** Saves the karts and tracks of a peer with its addons scores. */
+void ServerLobby::setPeerAssets(STKPeer* peer, AssetBitset& karts,
+                                AssetBitset& tracks)
+{
+    std::array<int, AS_TOTAL> addons_scores = {{ -1, -1, -1, -1 }};
+    size_t addon_kart = karts.countCommon(m_addon_kts_bitsets.first);
+    size_t addon_track = tracks.countCommon(m_addon_kts_bitsets.second);
+    size_t addon_arena = tracks.countCommon(m_addon_arenas_bitset);
+    size_t addon_soccer = tracks.countCommon(m_addon_soccers_bitset);
 
     if (!m_addon_kts.first.empty())
     {
@@ -3534,18 +3624,9 @@ bool ServerLobby::handleAssets(const NetworkString& ns, STKPeer* peer)
 
     // Save available karts and tracks from clients in STKPeer so if this peer
     // disconnects later in lobby it won't affect current players
-    peer->setAvailableKartsTracks(client_karts, client_tracks);
+    peer->setAvailableKartsTracks(karts, tracks);
     peer->setAddonsScores(addons_scores);
-
-    if (m_process_type == PT_CHILD &&
-        peer->getHostId() == m_client_server_host_id.load())
-    {
-        // Update child process addons list too so player can choose later
-        updateAddons();
-        updateTracksForMode();
-    }
-    return true;
-}   // handleAssets
+}   // setPeerAssets
 
 //-----------------------------------------------------------------------------
 void ServerLobby::connectionRequested(Event* event)
@@ -3888,6 +3969,11 @@ void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
         }
     }
 
+    // Later assets updates from this peer are sent as bitsets of it
+    if (peer->getClientCapabilities().find("asset_catalog") !=
+        peer->getClientCapabilities().end())
+        sendAssetCatalog(peer.get(), false/*request_assets*/);
+
 #ifdef ENABLE_SQLITE3
     if (m_server_stats_table.empty() || peer->isAIPeer())
         return;
@@ -3914,15 +4000,18 @@ void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
             peer->getAddress().getIP(), peer->getAddress().getPort(),
             online_id, player_count, peer->getAveragePing());
     }
-    easySQLQuery(query, [peer, country_code](sqlite3_stmt* stmt)
+    // Copy the values now, as the peer may be reset before the query runs
+    std::string username =
+        StringUtils::wideToUtf8(peer->getPlayerProfiles()[0]->getName());
+    auto version_os = StringUtils::extractVersionOS(peer->getUserVersion());
+    asyncSQLQuery(query, [username, country_code, version_os]
+        (sqlite3_stmt* stmt)
         {
-            if (sqlite3_bind_text(stmt, 1, StringUtils::wideToUtf8(
-                peer->getPlayerProfiles()[0]->getName()).c_str(),
+            if (sqlite3_bind_text(stmt, 1, username.c_str(),
                 -1, SQLITE_TRANSIENT) != SQLITE_OK)
             {
                 Log::error("easySQLQuery", "Failed to bind %s.",
-                    StringUtils::wideToUtf8(
-                    peer->getPlayerProfiles()[0]->getName()).c_str());
+                    username.c_str());
             }
             if (country_code.empty())
             {
@@ -3941,8 +4030,6 @@ void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
                         country_code.c_str());
                 }
             }
-            auto version_os =
-                StringUtils::extractVersionOS(peer->getUserVersion());
             if (sqlite3_bind_text(stmt, 3, version_os.first.c_str(),
                 -1, SQLITE_TRANSIENT) != SQLITE_OK)
             {
@@ -4474,6 +4561,7 @@ void ServerLobby::finishedLoadingWorld()
         if (auto peer = p.first.lock())
             peer->updateLastActivity();
     }
+    RewindManager::get()->createRewinderTable();
     m_server_has_loaded_world.store(true);
 }   // finishedLoadingWorld;
 
@@ -4703,12 +4791,30 @@ void ServerLobby::configPeersStartTime()
     // (due to packet loss), the start time will still ahead of current time
     uint64_t start_time = STKHost::get()->getNetworkTimer() + (uint64_t)2500;
     powerup_manager->setRandomSeed(start_time);
+
+    // Quantized origin in game state is only used if all peers in game
+    // support it
+    bool quantized_origin = true;
+    for (auto p : m_peers_ready)
+    {
+        auto peer = p.first.lock();
+        if (peer && peer->getClientCapabilities().find("quantized_origin") ==
+            peer->getClientCapabilities().end())
+        {
+            quantized_origin = false;
+            break;
+        }
+    }
+    NetworkConfig::get()->setQuantizedOrigin(quantized_origin);
     NetworkString* ns = getNetworkString(10);
     ns->setSynchronous(true);
     ns->addUInt8(LE_START_RACE).addUInt64(start_time);
     const uint8_t cc = (uint8_t)Track::getCurrentTrack()->getCheckManager()->getCheckStructureCount();
     ns->addUInt8(cc);
     *ns += *m_items_complete_state;
+    RewindManager::get()->encodeRewinderTable(ns);
+    // Older clients ignore it
+    ns->addUInt8(quantized_origin ? 1 : 0);
     m_client_starting_time = start_time;
     sendMessageToPeers(ns, /*reliable*/true);
 
@@ -4806,66 +4912,29 @@ void ServerLobby::resetServer()
 void ServerLobby::testBannedForIP(STKPeer* peer) const
 {
 #ifdef ENABLE_SQLITE3
-    if (!m_db || !m_ip_ban_table_exists)
+    if (!m_ban_index || !m_ip_ban_table_exists)
         return;
 
     // Test for IPv4
     if (peer->getAddress().isIPv6())
         return;
 
-    int row_id = -1;
-    unsigned ip_start = 0;
-    unsigned ip_end = 0;
-    std::string query = StringUtils::insertValues(
-        "SELECT rowid, ip_start, ip_end, reason, description FROM %s "
-        "WHERE ip_start <= %u AND ip_end >= %u "
-        "AND datetime('now') > datetime(starting_time) AND "
-        "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now')) "
-        "LIMIT 1;",
-        ServerConfig::m_ip_ban_table.c_str(),
-        peer->getAddress().getIP(), peer->getAddress().getIP());
-
-    sqlite3_stmt* stmt = NULL;
-    int ret = sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, 0);
-    if (ret == SQLITE_OK)
-    {
-        ret = sqlite3_step(stmt);
-        if (ret == SQLITE_ROW)
-        {
-            row_id = sqlite3_column_int(stmt, 0);
-            ip_start = (unsigned)sqlite3_column_int64(stmt, 1);
-            ip_end = (unsigned)sqlite3_column_int64(stmt, 2);
-            const char* reason = (char*)sqlite3_column_text(stmt, 3);
-            const char* desc = (char*)sqlite3_column_text(stmt, 4);
-            Log::info("ServerLobby", "%s banned by IP: %s "
-                "(rowid: %d, description: %s).",
-                peer->getAddress().toString().c_str(), reason, row_id, desc);
-            kickPlayerWithReason(peer, reason);
-        }
-        ret = sqlite3_finalize(stmt);
-        if (ret != SQLITE_OK)
-        {
-            Log::error("ServerLobby",
-                "Error finalize database for query %s: %s",
-                query.c_str(), sqlite3_errmsg(m_db));
-        }
-    }
-    else
-    {
-        Log::error("ServerLobby", "Error preparing database for query %s: %s",
-            query.c_str(), sqlite3_errmsg(m_db));
+    BanIndex::IPBan ban;
+    if (!m_ban_index->findIPBan(peer->getAddress().getIP(), &ban))
         return;
-    }
-    if (row_id != -1)
-    {
-        query = StringUtils::insertValues(
-            "UPDATE %s SET trigger_count = trigger_count + 1, "
-            "last_trigger = datetime('now') "
-            "WHERE ip_start = %u AND ip_end = %u;",
-            ServerConfig::m_ip_ban_table.c_str(), ip_start, ip_end);
-        easySQLQuery(query);
-    }
+
+    Log::info("ServerLobby", "%s banned by IP: %s "
+        "(rowid: %d, description: %s).",
+        peer->getAddress().toString().c_str(), ban.m_reason.c_str(),
+        ban.m_row_id, ban.m_description.c_str());
+    kickPlayerWithReason(peer, ban.m_reason.c_str());
+
+    std::string query = StringUtils::insertValues(
+        "UPDATE %s SET trigger_count = trigger_count + 1, "
+        "last_trigger = datetime('now') "
+        "WHERE ip_start = %u AND ip_end = %u;",
+        ServerConfig::m_ip_ban_table.c_str(), ban.m_ip_start, ban.m_ip_end);
+    asyncSQLQuery(query);
 #endif
 }   // testBannedForIP
 
@@ -4873,78 +4942,37 @@ void ServerLobby::testBannedForIP(STKPeer* peer) const
 void ServerLobby::testBannedForIPv6(STKPeer* peer) const
 {
 #ifdef ENABLE_SQLITE3
-    if (!m_db || !m_ipv6_ban_table_exists)
+    if (!m_ban_index || !m_ipv6_ban_table_exists)
         return;
 
     // Test for IPv6
     if (!peer->getAddress().isIPv6())
         return;
 
-    int row_id = -1;
-    std::string ipv6_cidr;
-    std::string query = StringUtils::insertValues(
-        "SELECT rowid, ipv6_cidr, reason, description FROM %s "
-        "WHERE insideIPv6CIDR(ipv6_cidr, ?) = 1 "
-        "AND datetime('now') > datetime(starting_time) AND "
-        "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now')) "
-        "LIMIT 1;",
-        ServerConfig::m_ipv6_ban_table.c_str());
+    BanIndex::IPv6Ban ban;
+    if (!m_ban_index->findIPv6Ban(peer->getAddress(), &ban))
+        return;
 
-    sqlite3_stmt* stmt = NULL;
-    int ret = sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, 0);
-    if (ret == SQLITE_OK)
-    {
-        if (sqlite3_bind_text(stmt, 1,
-            peer->getAddress().toString(false).c_str(), -1, SQLITE_TRANSIENT)
-            != SQLITE_OK)
-        {
-            Log::error("ServerLobby", "Error binding ipv6 addr for query: %s",
-                sqlite3_errmsg(m_db));
-        }
+    Log::info("ServerLobby", "%s banned by IP: %s "
+        "(rowid: %d, description: %s).",
+        peer->getAddress().toString().c_str(), ban.m_reason.c_str(),
+        ban.m_row_id, ban.m_description.c_str());
+    kickPlayerWithReason(peer, ban.m_reason.c_str());
 
-        ret = sqlite3_step(stmt);
-        if (ret == SQLITE_ROW)
-        {
-            row_id = sqlite3_column_int(stmt, 0);
-            ipv6_cidr = (char*)sqlite3_column_text(stmt, 1);
-            const char* reason = (char*)sqlite3_column_text(stmt, 2);
-            const char* desc = (char*)sqlite3_column_text(stmt, 3);
-            Log::info("ServerLobby", "%s banned by IP: %s "
-                "(rowid: %d, description: %s).",
-                peer->getAddress().toString().c_str(), reason, row_id, desc);
-            kickPlayerWithReason(peer, reason);
-        }
-        ret = sqlite3_finalize(stmt);
-        if (ret != SQLITE_OK)
+    std::string query = StringUtils::insertValues(
+        "UPDATE %s SET trigger_count = trigger_count + 1, "
+        "last_trigger = datetime('now') "
+        "WHERE ipv6_cidr = ?;", ServerConfig::m_ipv6_ban_table.c_str());
+    std::string ipv6_cidr = ban.m_ipv6_cidr;
+    asyncSQLQuery(query, [ipv6_cidr](sqlite3_stmt* stmt)
         {
-            Log::error("ServerLobby",
-                "Error finalize database for query %s: %s",
-                query.c_str(), sqlite3_errmsg(m_db));
-        }
-    }
-    else
-    {
-        Log::error("ServerLobby", "Error preparing database for query %s: %s",
-            query.c_str(), sqlite3_errmsg(m_db));
-        return;
-    }
-    if (row_id != -1)
-    {
-        query = StringUtils::insertValues(
-            "UPDATE %s SET trigger_count = trigger_count + 1, "
-            "last_trigger = datetime('now') "
-            "WHERE ipv6_cidr = ?;", ServerConfig::m_ipv6_ban_table.c_str());
-        easySQLQuery(query, [ipv6_cidr](sqlite3_stmt* stmt)
+            if (sqlite3_bind_text(stmt, 1, ipv6_cidr.c_str(),
+                -1, SQLITE_TRANSIENT) != SQLITE_OK)
             {
-                if (sqlite3_bind_text(stmt, 1, ipv6_cidr.c_str(),
-                    -1, SQLITE_TRANSIENT) != SQLITE_OK)
-                {
-                    Log::error("easySQLQuery", "Failed to bind %s.",
-                        ipv6_cidr.c_str());
-                }
-            });
-    }
+                Log::error("easySQLQuery", "Failed to bind %s.",
+                    ipv6_cidr.c_str());
+            }
+        });
 #endif
 }   // testBannedForIPv6
 
@@ -4953,57 +4981,25 @@ void ServerLobby::testBannedForOnlineId(STKPeer* peer,
                                         uint32_t online_id) const
 {
 #ifdef ENABLE_SQLITE3
-    if (!m_db || !m_online_id_ban_table_exists)
+    if (!m_ban_index || !m_online_id_ban_table_exists)
         return;
 
-    int row_id = -1;
+    BanIndex::OnlineIdBan ban;
+    if (!m_ban_index->findOnlineIdBan(online_id, &ban))
+        return;
+
+    Log::info("ServerLobby", "%s banned by online id: %s "
+        "(online id: %u rowid: %d, description: %s).",
+        peer->getAddress().toString().c_str(), ban.m_reason.c_str(),
+        online_id, ban.m_row_id, ban.m_description.c_str());
+    kickPlayerWithReason(peer, ban.m_reason.c_str());
+
     std::string query = StringUtils::insertValues(
-        "SELECT rowid, reason, description FROM %s "
-        "WHERE online_id = %u "
-        "AND datetime('now') > datetime(starting_time) AND "
-        "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now')) "
-        "LIMIT 1;",
+        "UPDATE %s SET trigger_count = trigger_count + 1, "
+        "last_trigger = datetime('now') "
+        "WHERE online_id = %u;",
         ServerConfig::m_online_id_ban_table.c_str(), online_id);
-
-    sqlite3_stmt* stmt = NULL;
-    int ret = sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, 0);
-    if (ret == SQLITE_OK)
-    {
-        ret = sqlite3_step(stmt);
-        if (ret == SQLITE_ROW)
-        {
-            row_id = sqlite3_column_int(stmt, 0);
-            const char* reason = (char*)sqlite3_column_text(stmt, 1);
-            const char* desc = (char*)sqlite3_column_text(stmt, 2);
-            Log::info("ServerLobby", "%s banned by online id: %s "
-                "(online id: %u rowid: %d, description: %s).",
-                peer->getAddress().toString().c_str(), reason, online_id,
-                row_id, desc);
-            kickPlayerWithReason(peer, reason);
-        }
-        ret = sqlite3_finalize(stmt);
-        if (ret != SQLITE_OK)
-        {
-            Log::error("ServerLobby", "Error finalize database: %s",
-                sqlite3_errmsg(m_db));
-        }
-    }
-    else
-    {
-        Log::error("ServerLobby", "Error preparing database: %s",
-            sqlite3_errmsg(m_db));
-        return;
-    }
-    if (row_id != -1)
-    {
-        query = StringUtils::insertValues(
-            "UPDATE %s SET trigger_count = trigger_count + 1, "
-            "last_trigger = datetime('now') "
-            "WHERE online_id = %u;",
-            ServerConfig::m_online_id_ban_table.c_str(), online_id);
-        easySQLQuery(query);
-    }
+    asyncSQLQuery(query);
 #endif
 }   // testBannedForOnlineId
 
@@ -5138,21 +5134,15 @@ void ServerLobby::handleServerConfiguration(Event* event)
     m_game_mode.store(new_game_mode);
     updateTracksForMode();
 
+    AssetBitset tracks_available =
+        m_asset_catalog.getTrackBitset(m_available_kts.second);
     auto peers = STKHost::get()->getPeers();
     for (auto& peer : peers)
     {
-        auto assets = peer->getClientAssets();
-        if (!peer->isValidated() || assets.second.empty())
+        const AssetBitset& tracks = peer->getClientAssets().second;
+        if (!peer->isValidated() || tracks.empty())
             continue;
-        std::set<std::string> tracks_erase;
-        for (const std::string& server_track : m_available_kts.second)
-        {
-            if (assets.second.find(server_track) == assets.second.end())
-            {
-                tracks_erase.insert(server_track);
-            }
-        }
-        if (tracks_erase.size() == m_available_kts.second.size())
+        if (tracks.countCommon(tracks_available) == 0)
         {
             NetworkString *message = getNetworkString(2);
             message->setSynchronous(true);
@@ -5493,6 +5483,8 @@ void ServerLobby::clientInGameWantsToBackLobby(Event* event)
         (Track::getCurrentTrack()->getItemManager());
     assert(nim);
     nim->erasePeerInGame(peer);
+    if (auto gp = GameProtocol::lock())
+        gp->eraseStateConfirmation(peer);
     m_peers_ready.erase(peer);
     peer->setWaitingForGame(true);
     peer->setSpectator(false);
@@ -5804,27 +5796,11 @@ void ServerLobby::handleServerCommand(Event* event,
         else
         {
             std::string addon_id_test = Addon::createAddonId(addon_id);
-            bool found = false;
             const auto& kt = player_peer->getClientAssets();
-            for (auto& kart : kt.first)
-            {
-                if (kart == addon_id_test)
-                {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found)
-            {
-                for (auto& track : kt.second)
-                {
-                    if (track == addon_id_test)
-                    {
-                        found = true;
-                        break;
-                    }
-                }
-            }
+            int kart = m_asset_catalog.getKartIndex(addon_id_test);
+            int track = m_asset_catalog.getTrackIndex(addon_id_test);
+            bool found = (kart != -1 && kt.first.test(kart)) ||
+                (track != -1 && kt.second.test(track));
             if (found)
             {
                 chat->encodeString16(StringUtils::utf8ToWide
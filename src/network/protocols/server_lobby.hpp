@@ -19,6 +19,7 @@
 #ifndef SERVER_LOBBY_HPP
 #define SERVER_LOBBY_HPP
 
+#include "network/asset_catalog.hpp"
 #include "network/protocols/lobby_protocol.hpp"
 #include "utils/cpp2011.hpp"
 #include "utils/time.hpp"
@@ -38,7 +39,10 @@
 #include <sqlite3.h>
 #endif
 
+class BanIndex;
 class BareNetworkString;
+class DatabaseWriter;
+class GeolocationIndex;
 class NetworkItemManager;
 class NetworkString;
 class NetworkPlayerProfile;
@@ -83,6 +87,9 @@ private:
 #ifdef ENABLE_SQLITE3
     sqlite3* m_db;
 
+    /** Runs all write queries after initialization in a separate thread. */
+    std::unique_ptr<DatabaseWriter> m_db_writer;
+
     std::string m_server_stats_table;
 
     bool m_ip_ban_table_exists;
@@ -95,6 +102,13 @@ private:
 
     bool m_ipv6_geolocation_table_exists;
 
+    /** In-memory copy of the ban tables, so connecting peers are tested
+     *  without querying the database. */
+    std::unique_ptr<BanIndex> m_ban_index;
+
+    /** Memory-mapped copy of the geolocation tables. */
+    std::unique_ptr<GeolocationIndex> m_geolocation_index;
+
     uint64_t m_last_poll_db_time;
 
     void pollDatabase();
@@ -102,6 +116,10 @@ private:
     bool easySQLQuery(const std::string& query,
         std::function<void(sqlite3_stmt* stmt)> bind_function = nullptr) const;
 
+    void asyncSQLQuery(const std::string& query,
+        std::function<void(sqlite3_stmt* stmt)> bind_function = nullptr,
+        std::function<void(bool)> callback = nullptr) const;
+
     void checkTableExists(const std::string& table, bool& result);
 
     std::string ip2Country(const SocketAddress& addr) const;
@@ -155,6 +173,22 @@ private:
      *  with data in server first. */
     std::pair<std::set<std::string>, std::set<std::string> > m_available_kts;
 
+    /** All karts and tracks ever available in server, clients send their
+     *  assets as bitsets of it. */
+    AssetCatalog m_asset_catalog;
+
+    /** m_official_kts in m_asset_catalog. */
+    std::pair<AssetBitset, AssetBitset> m_official_kts_bitsets;
+
+    /** m_addon_kts in m_asset_catalog. */
+    std::pair<AssetBitset, AssetBitset> m_addon_kts_bitsets;
+
+    /** m_addon_arenas in m_asset_catalog. */
+    AssetBitset m_addon_arenas_bitset;
+
+    /** m_addon_soccers in m_asset_catalog. */
+    AssetBitset m_addon_soccers_bitset;
+
     /** Keeps track of the server state. */
     std::atomic_bool m_server_has_loaded_world;
 
@@ -360,6 +394,12 @@ private:
     std::vector<std::shared_ptr<NetworkPlayerProfile> > getLivePlayers() const;
     void setPlayerKarts(const NetworkString& ns, STKPeer* peer) const;
     bool handleAssets(const NetworkString& ns, STKPeer* peer);
+    void handleAssetsUpdate(Event* event);
+    bool updatePeerAssets(STKPeer* peer, AssetBitset& karts,
+                          AssetBitset& tracks);
+    void setPeerAssets(STKPeer* peer, AssetBitset& karts,
+                       AssetBitset& tracks);
+    void sendAssetCatalog(STKPeer* peer, bool request_assets);
     void handleServerCommand(Event* event, std::shared_ptr<STKPeer> peer);
     void liveJoinRequest(Event* event);
     void rejectLiveJoin(STKPeer* peer, BackLobbyReason blr);
@@ -48,11 +48,13 @@ void RewindInfo::setTicks(int ticks)
 
 // ============================================================================
 RewindInfoState::RewindInfoState(int ticks, int start_offset,
-                                 std::vector<std::string>& rewinder_using,
+                                 std::vector<uint8_t>& rewinder_ids,
+                                 std::vector<std::string>& rewinder_names,
                                  std::vector<uint8_t>& buffer)
                : RewindInfo(ticks, true/*is_confirmed*/)
 {
-    std::swap(m_rewinder_using, rewinder_using);
+    std::swap(m_rewinder_ids, rewinder_ids);
+    std::swap(m_rewinder_names, rewinder_names);
     m_start_offset = start_offset;
     m_buffer = new BareNetworkString();
     std::swap(m_buffer->getBuffer(), buffer);
@@ -78,18 +80,30 @@ void RewindInfoState::restore()
 {
     m_buffer->reset();
     m_buffer->skip(m_start_offset);
-    for (const std::string& name : m_rewinder_using)
+    unsigned name_index = 0;
+    for (uint8_t id : m_rewinder_ids)
     {
         const uint16_t data_size = m_buffer->getUInt16();
         const unsigned current_offset_now = m_buffer->getCurrentOffset();
-        std::shared_ptr<Rewinder> r =
-            RewindManager::get()->getRewinder(name);
-
-        if (!r)
+        std::shared_ptr<Rewinder> r;
+        std::string name;
+        if (id != Rewinder::NO_REWINDER_ID)
+        {
+            r = RewindManager::get()->getRewinder(id);
+            if (!r)
+                name = RewindManager::get()->getRewinderTableName(id);
+        }
+        else
         {
-            // For now we only need to get missing rewinder from
-            // projectile_manager
-            r = ProjectileManager::get()->addRewinderFromNetworkState(name);
+            name = m_rewinder_names.at(name_index++);
+            r = RewindManager::get()->getRewinder(name);
+            if (!r)
+            {
+                // For now we only need to get missing rewinder from
+                // projectile_manager
+                r = ProjectileManager::get()
+                    ->addRewinderFromNetworkState(name);
+            }
         }
         if (!r)
         {
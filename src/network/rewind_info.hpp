@@ -92,7 +92,13 @@ public:
 class RewindInfoState: public RewindInfo
 {
 private:
-    std::vector<std::string> m_rewinder_using;
+    /** Id in the rewinder table of each rewinder in this state, in order of
+     *  their data in the buffer. */
+    std::vector<uint8_t> m_rewinder_ids;
+
+    /** Unique identity of each rewinder in this state which has no id in the
+     *  rewinder table (Rewinder::NO_REWINDER_ID), in order. */
+    std::vector<std::string> m_rewinder_names;
 
     int m_start_offset;
 
@@ -102,7 +108,8 @@ private:
 public:
     // ------------------------------------------------------------------------
     RewindInfoState(int ticks, int start_offset,
-                    std::vector<std::string>& rewinder_using,
+                    std::vector<uint8_t>& rewinder_ids,
+                    std::vector<std::string>& rewinder_names,
                     std::vector<uint8_t>& buffer);
     // ------------------------------------------------------------------------
     RewindInfoState(int ticks, BareNetworkString *buffer, bool is_confirmed);
@@ -114,6 +121,10 @@ public:
     /** Returns a pointer to the state buffer. */
     BareNetworkString *getBuffer() const { return m_buffer; }
     // ------------------------------------------------------------------------
+    /** Returns the id of each rewinder with data in this state. */
+    const std::vector<uint8_t>& getRewinderIDs() const
+                                                    { return m_rewinder_ids; }
+    // ------------------------------------------------------------------------
     virtual bool isState() const { return true; }
     // ------------------------------------------------------------------------
     /** Called when going back in time to undo any rewind information.
@@ -19,6 +19,8 @@
 #include "network/rewind_manager.hpp"
 
 #include "graphics/irr_driver.hpp"
+#include "karts/kart_rewinder.hpp"
+#include "modes/benchmark.hpp"
 #include "modes/soccer_world.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
@@ -37,6 +39,20 @@
 
 #include <algorithm>
 
+namespace
+{
+    /** A kart not in the state rewound to, saved before the rewind to put
+     *  it back afterwards. It's kinematic meanwhile, so the replay doesn't
+     *  move it. */
+    struct KeptKart
+    {
+        KartRewinder* m_kart;
+        std::unique_ptr<BareNetworkString> m_state;
+        std::function<void()> m_local_state;
+        int m_collision_flags;
+    };
+}
+
 RewindManager* RewindManager::m_rewind_manager[PT_COUNT];
 std::atomic_bool RewindManager::m_enable_rewind_manager(false);
 
@@ -157,27 +173,34 @@ void RewindManager::saveState()
     PROFILER_PUSH_CPU_MARKER("RewindManager - save state", 0x20, 0x7F, 0x20);
     auto gp = GameProtocol::lock();
     if (!gp)
+    {
+        PROFILER_POP_CPU_MARKER();
         return;
+    }
     gp->startNewState();
 
     m_overall_state_size = 0;
-    std::vector<std::string> rewinder_using;
+    m_rewinder_using.clear();
+    m_rewinder_ids.clear();
 
     for (auto& p : m_all_rewinder)
     {
-        // TODO: check if it's worth passing in a sufficiently large buffer from
-        // GameProtocol - this would save the copy operation.
-        BareNetworkString* buffer = NULL;
-        if (auto r = p.second.lock())
-            buffer = r->saveState(&rewinder_using);
-        if (buffer != NULL)
+        auto r = p.second.lock();
+        if (!r)
+            continue;
+        // Each rewinder writes directly into the state buffer of
+        // GameProtocol, which is reused for all states
+        BareNetworkString* buffer = gp->beginRewinderState();
+        const unsigned start = buffer->getTotalSize();
+        const bool saved = r->saveState(buffer, &m_rewinder_using);
+        if (saved)
         {
-            m_overall_state_size += buffer->size();
-            gp->addState(buffer);
+            m_rewinder_ids.push_back(r->getRewinderID());
+            m_overall_state_size += buffer->getTotalSize() - start;
         }
-        delete buffer;    // buffer can be freed
+        gp->endRewinderState(saved);
     }
-    gp->finalizeState(rewinder_using);
+    gp->finalizeState(m_rewinder_using, m_rewinder_ids);
     PROFILER_POP_CPU_MARKER();
 }   // saveState
 
@@ -213,10 +236,18 @@ void RewindManager::update(int ticks_not_used)
     }
     else
     {
+        Benchmark::beginSection(Benchmark::BS_STATE_SAVE);
         saveState();
+        Benchmark::endSection(Benchmark::BS_STATE_SAVE);
         PROFILER_PUSH_CPU_MARKER("RewindManager - send state", 0x20, 0x7F, 0x40);
         if (auto gp = GameProtocol::lock())
-            gp->sendState();
+        {
+            // There are no clients in benchmark mode or history replay
+            if (Benchmark::isEnabled())
+                Benchmark::addStateSize(gp->getState()->getTotalSize());
+            if (NetworkConfig::get()->isNetworking())
+                gp->sendState();
+        }
     }
     PROFILER_POP_CPU_MARKER();
 }   // update
@@ -280,6 +311,65 @@ bool RewindManager::addRewinder(std::shared_ptr<Rewinder> rewinder)
     return true;
 }   // addRewinder
 
+// ----------------------------------------------------------------------------
+/** Called by the server when the world is loaded, it assigns an id to each
+ *  rewinder existing at the start of race, which is used instead of its
+ *  unique identity in state messages. Rewinders added later (like projectiles)
+ *  keep using their unique identity.
+ */
+void RewindManager::createRewinderTable()
+{
+    clearExpiredRewinder();
+    m_rewinder_table.clear();
+    m_rewinder_table_names.clear();
+    for (auto& p : m_all_rewinder)
+    {
+        auto r = p.second.lock();
+        if (!r || m_rewinder_table.size() == Rewinder::NO_REWINDER_ID)
+            continue;
+        r->setRewinderID((uint8_t)m_rewinder_table.size());
+        m_rewinder_table.push_back(r);
+        m_rewinder_table_names.push_back(p.first);
+    }
+}   // createRewinderTable
+
+// ----------------------------------------------------------------------------
+/** Writes the unique identity of rewinders in the rewinder table (in id
+ *  order), sent to clients when starting or live joining the race.
+ */
+void RewindManager::encodeRewinderTable(BareNetworkString* ns) const
+{
+    ns->addUInt8((uint8_t)m_rewinder_table_names.size());
+    for (const std::string& name : m_rewinder_table_names)
+        ns->encodeString(name);
+}   // encodeRewinderTable
+
+// ----------------------------------------------------------------------------
+/** Called on the client with the rewinder table from server, it assigns the
+ *  id to local rewinders so that state messages can be decoded.
+ */
+void RewindManager::decodeRewinderTable(const BareNetworkString& ns)
+{
+    m_rewinder_table.clear();
+    m_rewinder_table_names.clear();
+    unsigned size = ns.getUInt8();
+    for (unsigned i = 0; i < size; i++)
+    {
+        std::string name;
+        ns.decodeString(&name);
+        std::shared_ptr<Rewinder> r = getRewinder(name);
+        if (r)
+            r->setRewinderID((uint8_t)i);
+        else
+        {
+            Log::warn("RewindManager", "Missing rewinder %s in table.",
+                name.c_str());
+        }
+        m_rewinder_table.push_back(r);
+        m_rewinder_table_names.push_back(name);
+    }
+}   // decodeRewinderTable
+
 // ----------------------------------------------------------------------------
 /** Rewinds to the specified time, then goes forward till the current
  *  World::getTime() is reached again: it will replay everything before
@@ -307,6 +397,36 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
             r->saveTransform();
     }
 
+    // The server can leave karts far away from all local karts out of a
+    // state (see GameProtocol::filterStateForPeer). Those are not rewound,
+    // so save them now to put them back after the replay, instead of
+    // simulating them again from their current position.
+    World* world = World::getWorld();
+    std::vector<KeptKart> kept_karts;
+    const std::vector<uint8_t> ids =
+        m_rewind_queue.getRewinderIDsAt(rewind_ticks);
+    for (unsigned i = 0; i < world->getNumKarts(); i++)
+    {
+        // All karts are kart rewinders when rewind is enabled
+        KartRewinder* kart = static_cast<KartRewinder*>(world->getKart(i));
+        uint8_t id = kart->getRewinderID();
+        if (id == Rewinder::NO_REWINDER_ID ||
+            std::find(ids.begin(), ids.end(), id) != ids.end())
+            continue;
+        KeptKart kk;
+        kk.m_kart = kart;
+        kk.m_state.reset(new BareNetworkString());
+        std::vector<std::string> ru;
+        if (!kart->saveState(kk.m_state.get(), &ru))
+            continue;
+        kk.m_local_state = kart->getLocalStateRestoreFunction();
+        btRigidBody* body = kart->getBody();
+        kk.m_collision_flags = body->getCollisionFlags();
+        body->setCollisionFlags(kk.m_collision_flags |
+            btCollisionObject::CF_KINEMATIC_OBJECT);
+        kept_karts.push_back(std::move(kk));
+    }
+
     // Then undo the rewind infos going backwards in time
     // --------------------------------------------------
     m_is_rewinding = true;
@@ -317,8 +437,6 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
 
     // Rewind the required state(s)
     // ----------------------------
-    World* world = World::getWorld();
-
     // Now start the rewind with the full state. It is important that the
     // world time is set first, since e.g. the NetworkItem manager relies
     // on having the access to the 'confirmed' state time using 
@@ -395,6 +513,16 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
 
     }   // while (world->getTicks() < current_ticks)
 
+    for (KeptKart& kk : kept_karts)
+    {
+        kk.m_kart->getBody()->setCollisionFlags(kk.m_collision_flags);
+        kk.m_state->reset();
+        kk.m_kart->restoreState(kk.m_state.get(),
+            kk.m_state->getTotalSize());
+        if (kk.m_local_state)
+            kk.m_local_state();
+    }
+
     // Now compute the errors which need to be visually smoothed
     for (auto& p : m_all_rewinder)
     {
@@ -31,6 +31,7 @@
 #include <string>
 #include <vector>
 
+class BareNetworkString;
 class Rewinder;
 class RewindInfo;
 class RewindInfoEventFunction;
@@ -96,12 +97,24 @@ private:
     /** A list of all objects that can be rewound. */
     std::map<std::string, std::weak_ptr<Rewinder> > m_all_rewinder;
 
+    /** Rewinders existing when the race starts, indexed by the id used for
+     *  them in state messages instead of their unique identity. */
+    std::vector<std::weak_ptr<Rewinder> > m_rewinder_table;
+
+    /** Unique identity of each rewinder in m_rewinder_table. */
+    std::vector<std::string> m_rewinder_table_names;
+
     /** The queue that stores all rewind infos. */
     RewindQueue m_rewind_queue;
 
     /** Overall amount of memory allocated by states. */
     unsigned int m_overall_state_size;
 
+    /** Unique identity and id of rewinders in the state being saved, kept to
+     *  reuse their memory for each state. */
+    std::vector<std::string> m_rewinder_using;
+    std::vector<uint8_t> m_rewinder_ids;
+
     /** Indicates if currently a rewind is happening. */
     bool m_is_rewinding;
 
@@ -188,6 +201,31 @@ public:
         return nullptr;
     }
     // ------------------------------------------------------------------------
+    /** Returns the rewinder with the given id in the rewinder table. */
+    std::shared_ptr<Rewinder> getRewinder(uint8_t id)
+    {
+        if (id >= m_rewinder_table.size())
+            return nullptr;
+        if (auto r = m_rewinder_table[id].lock())
+            return r;
+        return nullptr;
+    }
+    // ------------------------------------------------------------------------
+    /** Returns the unique identity of the rewinder with the given id in the
+     *  rewinder table, or an empty string if the id is unknown. */
+    std::string getRewinderTableName(uint8_t id) const
+    {
+        if (id >= m_rewinder_table_names.size())
+            return "";
+        return m_rewinder_table_names[id];
+    }
+    // ------------------------------------------------------------------------
+    void createRewinderTable();
+    // ------------------------------------------------------------------------
+    void encodeRewinderTable(BareNetworkString* ns) const;
+    // ------------------------------------------------------------------------
+    void decodeRewinderTable(const BareNetworkString& ns);
+    // ------------------------------------------------------------------------
     bool addRewinder(std::shared_ptr<Rewinder> rewinder);
     // ------------------------------------------------------------------------
     /** Returns true if currently a rewind is happening. */
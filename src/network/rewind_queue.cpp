@@ -26,6 +26,8 @@
 #include "network/rewinder.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/server_config.hpp"
+#include "race/history.hpp"
 
 #include <algorithm>
 
@@ -259,6 +261,15 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
             (*i)->setTicks(world_ticks);
         }
 
+        // Record the events with the time they are used at, so that the
+        // race can be re-simulated from the history
+        if ((*i)->isEvent() && NetworkConfig::get()->isServer() &&
+            ServerConfig::m_save_history)
+        {
+            history->addNetworkEvent((*i)->getTicks(),
+                static_cast<RewindInfoEvent*>(*i)->getBuffer());
+        }
+
         insertRewindInfo(*i);
 
         // Check if a rewind is necessary, i.e. a message is received in the
@@ -390,6 +401,36 @@ int RewindQueue::undoUntil(int undo_ticks)
     return (*m_current)->getTicks();
 }   // undoUntil
 
+// ----------------------------------------------------------------------------
+/** Returns the ids of the rewinders in the states undoUntil would rewind
+ *  to, without undoing anything.
+ *  \param undo_ticks Time to rewind to, like in undoUntil.
+ */
+std::vector<uint8_t> RewindQueue::getRewinderIDsAt(int undo_ticks) const
+{
+    std::vector<uint8_t> ids;
+    if (m_all_rewind_info.empty())
+        return ids;
+    AllRewindInfo::const_iterator i = m_all_rewind_info.end();
+    i--;
+    while ((*i)->getTicks() > undo_ticks || (*i)->isEvent() ||
+        !(*i)->isConfirmed())
+    {
+        if (i == m_all_rewind_info.begin())
+            return ids;
+        i--;
+    }
+    const int ticks = (*i)->getTicks();
+    for (; i != m_all_rewind_info.end() && (*i)->getTicks() == ticks &&
+        (*i)->isState(); i++)
+    {
+        const RewindInfoState* state = static_cast<RewindInfoState*>(*i);
+        ids.insert(ids.end(), state->getRewinderIDs().begin(),
+            state->getRewinderIDs().end());
+    }
+    return ids;
+}   // getRewinderIDsAt
+
 // ----------------------------------------------------------------------------
 /** Replays all events (not states) that happened at the specified time.
  *  \param ticks Time in ticks.
@@ -82,6 +82,7 @@ public:
     bool isEmpty() const;
     bool hasMoreRewindInfo() const;
     int  undoUntil(int undo_ticks);
+    std::vector<uint8_t> getRewinderIDsAt(int undo_ticks) const;
     void insertRewindInfo(RewindInfo *ri);
 
     // ------------------------------------------------------------------------
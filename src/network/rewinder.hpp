@@ -20,6 +20,7 @@
 #define HEADER_REWINDER_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <memory>
@@ -56,8 +57,20 @@ private:
     */
     std::string m_unique_identity;
 
+    /** Index of this rewinder in the rewinder table created when the race
+     *  starts, used instead of the unique identity in state messages. */
+    uint8_t m_rewinder_id;
+
 public:
-    Rewinder(const std::string& ui = "")             { m_unique_identity = ui; }
+    /** Rewinder id for rewinders not in the rewinder table (for example
+     *  projectiles fired during the race). */
+    static const uint8_t NO_REWINDER_ID = 255;
+    // -------------------------------------------------------------------------
+    Rewinder(const std::string& ui = "")
+    {
+        m_unique_identity = ui;
+        m_rewinder_id = NO_REWINDER_ID;
+    }
 
     virtual ~Rewinder() {}
 
@@ -70,12 +83,15 @@ public:
      *  caused by the rewind (which is then visually smoothed over time). */
     virtual void computeError() = 0;
 
-    /** Provides a copy of the state of the object in one memory buffer.
-     *  The memory is managed by the RewindManager.
+    /** Appends the state of the object to the state being assembled, the
+     *  buffer is owned by GameProtocol and reused for every state.
+     *  \param buffer The state buffer to write to.
      *  \param[out] ru The unique identity of rewinder writing to.
-     *  \return The address of the memory buffer with the state.
+     *  \return False if no state is needed for this object, anything written
+     *  to buffer will be discarded then (and nothing should be added to ru).
      */
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru) = 0;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru) = 0;
 
     /** Called when an event needs to be undone. This is called while going
      *  backwards for rewinding - all stored events will get an 'undo' call.
@@ -112,6 +128,10 @@ public:
         return m_unique_identity;
     }
     // -------------------------------------------------------------------------
+    void setRewinderID(uint8_t id)                       { m_rewinder_id = id; }
+    // -------------------------------------------------------------------------
+    uint8_t getRewinderID() const                      { return m_rewinder_id; }
+    // -------------------------------------------------------------------------
     bool rewinderAdd();
     // -------------------------------------------------------------------------
     template<typename T> std::shared_ptr<T> getShared()
@@ -357,6 +357,26 @@ namespace ServerConfig
         "more rewind, which clients with slow device may have problem playing "
         "this server, use the default value is recommended."));
 
+    SERVER_CFG_PREFIX FloatServerConfigParam m_state_relevance_distance
+        SERVER_CFG_DEFAULT(FloatServerConfigParam(0.0f,
+        "state-relevance-distance",
+        "Karts farther than this distance (in meters, along the track or "
+        "arena navmesh) from all karts of a player will be sent to that "
+        "player less frequently, see far-kart-state-interval, which saves "
+        "bandwidth in servers with many players. 0 to disable."));
+
+    SERVER_CFG_PREFIX IntServerConfigParam m_far_kart_state_interval
+        SERVER_CFG_DEFAULT(IntServerConfigParam(3,
+        "far-kart-state-interval",
+        "Send the state of karts farther than state-relevance-distance only "
+        "in every this number of states."));
+
+    SERVER_CFG_PREFIX BoolServerConfigParam m_save_history
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(false, "save-history",
+        "Save the inputs of all players of each race in a history file in "
+        "the directory of this config, which can be re-simulated with "
+        "--history=file (add --benchmark=n to time it)."));
+
     SERVER_CFG_PREFIX BoolServerConfigParam m_sql_management
         SERVER_CFG_DEFAULT(BoolServerConfigParam(false,
         "sql-management",
@@ -37,6 +37,7 @@
 #include "network/stk_ipv6.hpp"
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
+#include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/time.hpp"
 #include "utils/vs.hpp"
@@ -257,6 +258,7 @@ constexpr bool isPingPacket(unsigned char* data, size_t length)
 /** The constructor for a server or client.
  */
 STKHost::STKHost(bool server)
+       : m_enet_cmd(4096)
 {
     m_public_address.reset(new SocketAddress());
     init();
@@ -321,6 +323,10 @@ void STKHost::init()
     m_network          = NULL;
     m_exit_timeout.store(std::numeric_limits<uint64_t>::max());
     m_client_ping.store(0);
+    m_has_enet_cmd_overflow.store(false);
+    m_enet_cmd_wakeup.store(false);
+    m_wakeup_address = {};
+    m_listening.store(false);
 
     // Start with initialising ENet
     // ============================
@@ -363,7 +369,10 @@ STKHost::~STKHost()
     stopListening();
 
     // Drop all unsent packets
-    for (auto& p : m_enet_cmd)
+    ENetCommand cmd;
+    while (m_enet_cmd.pop(&cmd))
+        m_enet_cmd_overflow.push_back(cmd);
+    for (auto& p : m_enet_cmd_overflow)
     {
         if (std::get<3>(p) == ECT_SEND_PACKET)
         {
@@ -766,11 +775,143 @@ void STKHost::setErrorMessage(const irr::core::stringw &message)
  */
 void STKHost::startListening()
 {
+    SocketAddress wakeup_address("127.0.0.1", m_network->getPort());
+    wakeup_address.convertForIPv6Socket(isIPv6Socket());
+    m_wakeup_address = wakeup_address.toENetAddress();
+    m_enet_cmd_wakeup.store(false);
+    // Commands added before are run in the first loop without wake up
+    m_listening.store(true);
     m_exit_timeout.store(std::numeric_limits<uint64_t>::max());
     m_listening_thread = std::thread(std::bind(&STKHost::mainLoop, this,
         STKProcess::getType()));
 }   // startListening
 
+// ----------------------------------------------------------------------------
+/** Adds a command to be run by the listening thread (see mainLoop), which
+ *  is woken up if it is waiting for ENet events, so it doesn't need to wait
+ *  for the service timeout. It can be called from any thread.
+ */
+void STKHost::addEnetCommand(ENetPeer* peer, ENetPacket* packet, uint32_t i,
+                             ENetCommandType ect, ENetAddress ea)
+{
+    ENetCommand cmd(peer, packet, i, ect, ea);
+    // Once the ring buffer was full use the overflow list until all
+    // commands in it are handled, so they keep their order
+    if (m_has_enet_cmd_overflow.load() || !m_enet_cmd.push(cmd))
+    {
+        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
+        m_enet_cmd_overflow.push_back(cmd);
+        m_has_enet_cmd_overflow.store(true);
+    }
+    if (m_listening.load() && !m_enet_cmd_wakeup.exchange(true) &&
+        m_network)
+    {
+        // Send a 1 byte packet to the ENet socket itself, which makes
+        // enet_host_service return (see interceptWakeUp)
+        uint8_t data = 0xFF;
+        ENetBuffer buffer;
+        buffer.data = &data;
+        buffer.dataLength = 1;
+        enet_socket_send(m_network->getENetHost()->socket, &m_wakeup_address,
+            &buffer, 1);
+    }
+}   // addEnetCommand
+
+// ----------------------------------------------------------------------------
+/** Intercept callback in enet for the wake up packet sent by addEnetCommand,
+ *  it returns a receive event without peer to stop enet_host_service.
+ */
+int STKHost::interceptWakeUp(ENetHost* host, ENetEvent* event)
+{
+    // Valid ENet protocol packets are never 1 byte long
+    if (host->receivedDataLength != 1 || host->receivedData[0] != 0xFF)
+        return 0;
+    if (event)
+    {
+        event->type = ENET_EVENT_TYPE_RECEIVE;
+        event->peer = NULL;
+        event->channelID = 0;
+        event->data = 0;
+        event->packet = NULL;
+    }
+    return 1;
+}   // interceptWakeUp
+
+// ----------------------------------------------------------------------------
+/** Runs all commands added by addEnetCommand, in the listening thread. */
+void STKHost::handleEnetCommands(ENetHost* host)
+{
+    // Commands added from now on need a new wake up
+    m_enet_cmd_wakeup.store(false);
+    const bool has_overflow = m_has_enet_cmd_overflow.load();
+    std::vector<ENetCommand> overflow;
+    if (has_overflow)
+    {
+        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
+        std::swap(overflow, m_enet_cmd_overflow);
+    }
+    // Commands in ring buffer are always older than the overflow ones
+    ENetCommand cmd;
+    while (m_enet_cmd.pop(&cmd))
+        handleEnetCommand(host, cmd);
+    if (!has_overflow)
+        return;
+    for (ENetCommand& c : overflow)
+        handleEnetCommand(host, c);
+    std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
+    if (m_enet_cmd_overflow.empty())
+        m_has_enet_cmd_overflow.store(false);
+}   // handleEnetCommands
+
+// ----------------------------------------------------------------------------
+void STKHost::handleEnetCommand(ENetHost* host, ENetCommand& cmd)
+{
+    ENetPeer* peer = std::get<0>(cmd);
+    ENetAddress& ea = std::get<4>(cmd);
+    ENetAddress& ea_peer_now = peer->address;
+    ENetPacket* packet = std::get<1>(cmd);
+    // Enet will reuse a disconnected peer so we check here to avoid
+    // sending to wrong peer
+    if (peer->state != ENET_PEER_STATE_CONNECTED ||
+#if defined(ENABLE_IPV6) || defined(__SWITCH__)
+        (enet_ip_not_equal(ea_peer_now.host, ea.host) &&
+        ea_peer_now.port != ea.port))
+#else
+        (ea_peer_now.host != ea.host && ea_peer_now.port != ea.port))
+#endif
+    {
+        if (packet != NULL)
+            enet_packet_destroy(packet);
+        return;
+    }
+
+    switch (std::get<3>(cmd))
+    {
+    case ECT_SEND_PACKET:
+    {
+        // If enet_peer_send failed, destroy the packet to
+        // prevent leaking, this can only be done if the packet
+        // is copied instead of shared sending to all peers
+        if (enet_peer_send(peer, (uint8_t)std::get<2>(cmd), packet) < 0)
+        {
+            enet_packet_destroy(packet);
+        }
+        break;
+    }
+    case ECT_DISCONNECT:
+        enet_peer_disconnect(peer, std::get<2>(cmd));
+        break;
+    case ECT_RESET:
+        // Flush enet before reset (so previous command is send)
+        enet_host_flush(host);
+        enet_peer_reset(peer);
+        // Remove the stk peer of it
+        std::lock_guard<std::mutex> lock(m_peers_mutex);
+        m_peers.erase(peer);
+        break;
+    }
+}   // handleEnetCommand
+
 // ----------------------------------------------------------------------------
 /** \brief Stops the listening of events from ENet.
  *  Stops the thread that was receiving events.
@@ -779,6 +920,7 @@ void STKHost::stopListening()
 {
     if (m_exit_timeout.load() == std::numeric_limits<uint64_t>::max())
         m_exit_timeout.store(0);
+    m_listening.store(false);
     if (m_listening_thread.joinable())
         m_listening_thread.join();
 }   // stopListening
@@ -796,11 +938,13 @@ void STKHost::mainLoop(ProcessType pt)
     if (pt == PT_CHILD)
         thread_name += "_child";
     VS::setThreadName(thread_name.c_str());
+    profiler.setThreadName(thread_name.c_str());
 
     STKProcess::init(pt);
     Log::info("STKHost", "Listening has been started.");
     ENetEvent event;
     ENetHost* host = m_network->getENetHost();
+    host->intercept = STKHost::interceptWakeUp;
     const bool is_server = NetworkConfig::get()->isServer();
 
     // A separate network connection (socket) to handle LAN requests.
@@ -826,6 +970,7 @@ void STKHost::mainLoop(ProcessType pt)
     std::map<std::string, uint64_t> ctp;
     while (m_exit_timeout.load() > StkTime::getMonoTimeMs())
     {
+        PROFILER_PUSH_CPU_MARKER("STKHost update", 0, 128, 255);
         // Clear outdated connect to peer list every 15 seconds
         for (auto it = ctp.begin(); it != ctp.end();)
         {
@@ -909,8 +1054,7 @@ void STKHost::mainLoop(ProcessType pt)
                                 player_name.c_str(), ap, max_ping);
                             p.second->setWarnedForHighPing(true);
                             p.second->setDisconnected(true);
-                            std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
-                            m_enet_cmd.emplace_back(p.second->getENetPeer(),
+                            addEnetCommand(p.second->getENetPeer(),
                                 (ENetPacket*)NULL, PDI_KICK_HIGH_PING,
                                 ECT_DISCONNECT, p.first->address);
                         }
@@ -994,62 +1138,18 @@ void STKHost::mainLoop(ProcessType pt)
             peer_lock.unlock();
         }
 
-        std::vector<std::tuple<ENetPeer*, ENetPacket*, uint32_t,
-            ENetCommandType, ENetAddress> > copied_list;
-        std::unique_lock<std::mutex> lock(m_enet_cmd_mutex);
-        std::swap(copied_list, m_enet_cmd);
-        lock.unlock();
-        for (auto& p : copied_list)
-        {
-            ENetPeer* peer = std::get<0>(p);
-            ENetAddress& ea = std::get<4>(p);
-            ENetAddress& ea_peer_now = peer->address;
-            ENetPacket* packet = std::get<1>(p);
-            // Enet will reuse a disconnected peer so we check here to avoid
-            // sending to wrong peer
-            if (peer->state != ENET_PEER_STATE_CONNECTED ||
-#if defined(ENABLE_IPV6) || defined(__SWITCH__)
-                (enet_ip_not_equal(ea_peer_now.host, ea.host) &&
-                ea_peer_now.port != ea.port))
-#else
-                (ea_peer_now.host != ea.host && ea_peer_now.port != ea.port))
-#endif
-            {
-                if (packet != NULL)
-                    enet_packet_destroy(packet);
-                continue;
-            }
-
-            switch (std::get<3>(p))
-            {
-            case ECT_SEND_PACKET:
-            {
-                // If enet_peer_send failed, destroy the packet to
-                // prevent leaking, this can only be done if the packet
-                // is copied instead of shared sending to all peers
-                if (enet_peer_send(peer, (uint8_t)std::get<2>(p), packet) < 0)
-                {
-                    enet_packet_destroy(packet);
-                }
-                break;
-            }
-            case ECT_DISCONNECT:
-                enet_peer_disconnect(peer, std::get<2>(p));
-                break;
-            case ECT_RESET:
-                // Flush enet before reset (so previous command is send)
-                enet_host_flush(host);
-                enet_peer_reset(peer);
-                // Remove the stk peer of it
-                std::lock_guard<std::mutex> lock(m_peers_mutex);
-                m_peers.erase(peer);
-                break;
-            }
-        }
+        handleEnetCommands(host);
+        PROFILER_POP_CPU_MARKER();
 
         bool need_ping_update = false;
         while (enet_host_service(host, &event, 10) != 0)
         {
+            // Woken up by addEnetCommand
+            if (event.type == ENET_EVENT_TYPE_RECEIVE && event.peer == NULL)
+            {
+                handleEnetCommands(host);
+                continue;
+            }
             auto lp = LobbyProtocol::get<LobbyProtocol>();
             if (!is_server &&
                 last_ping_time_update_for_client < StkTime::getMonoTimeMs())
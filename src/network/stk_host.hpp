@@ -22,6 +22,7 @@
 #ifndef STK_HOST_HPP
 #define STK_HOST_HPP
 
+#include "utils/mpsc_ring_buffer.hpp"
 #include "utils/stk_process.hpp"
 #include "utils/synchronised.hpp"
 #include "utils/time.hpp"
@@ -89,15 +90,35 @@ private:
     /** Make sure the removing or adding a peer is thread-safe. */
     mutable std::mutex m_peers_mutex;
 
-    /** Let (atm enet_peer_send and enet_peer_disconnect) run in the listening
-     *  thread. */
-    std::vector<std::tuple</*peer receive*/ENetPeer*,
+    typedef std::tuple</*peer receive*/ENetPeer*,
         /*packet to send*/ENetPacket*, /*integer data*/uint32_t,
-        ENetCommandType, ENetAddress> > m_enet_cmd;
+        ENetCommandType, ENetAddress> ENetCommand;
+
+    /** Let (atm enet_peer_send and enet_peer_disconnect) run in the listening
+     *  thread, added without locking from any thread. */
+    MPSCRingBuffer<ENetCommand> m_enet_cmd;
+
+    /** Commands added when \ref m_enet_cmd is full, all commands go here
+     *  until the listening thread handled them to keep the order. */
+    std::vector<ENetCommand> m_enet_cmd_overflow;
 
-    /** Protect \ref m_enet_cmd from multiple threads usage. */
+    /** True if \ref m_enet_cmd_overflow is not empty. */
+    std::atomic_bool m_has_enet_cmd_overflow;
+
+    /** Protect \ref m_enet_cmd_overflow from multiple threads usage. */
     std::mutex m_enet_cmd_mutex;
 
+    /** True if the listening thread has been woken up for new commands and
+     *  not yet handled them, so only 1 wake up packet is sent for them. */
+    std::atomic_bool m_enet_cmd_wakeup;
+
+    /** Address of the ENet host socket itself to send the wake up packet. */
+    ENetAddress m_wakeup_address;
+
+    /** True once \ref m_wakeup_address is set by startListening, until
+     *  stopListening, wake up packets are only sent meanwhile. */
+    std::atomic_bool m_listening;
+
     /** The list of peers connected to this instance. */
     std::map<ENetPeer*, std::shared_ptr<STKPeer> > m_peers;
 
@@ -170,6 +191,12 @@ private:
     // ------------------------------------------------------------------------
     void mainLoop(ProcessType pt);
     // ------------------------------------------------------------------------
+    void handleEnetCommands(ENetHost* host);
+    // ------------------------------------------------------------------------
+    void handleEnetCommand(ENetHost* host, ENetCommand& cmd);
+    // ------------------------------------------------------------------------
+    static int interceptWakeUp(ENetHost* host, ENetEvent* event);
+    // ------------------------------------------------------------------------
     void getIPFromStun(int socket, const std::string& stun_address,
                        short family, SocketAddress* result);
 public:
@@ -287,11 +314,7 @@ public:
     void setErrorMessage(const irr::core::stringw &message);
     // ------------------------------------------------------------------------
     void addEnetCommand(ENetPeer* peer, ENetPacket* packet, uint32_t i,
-                        ENetCommandType ect, ENetAddress ea)
-    {
-        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
-        m_enet_cmd.emplace_back(peer, packet, i, ect, ea);
-    }
+                        ENetCommandType ect, ENetAddress ea);
     // ------------------------------------------------------------------------
     /** Returns the last error (or "" if no error has happened). */
     const irr::core::stringw& getErrorMessage() const
@@ -444,13 +444,16 @@ extern "C" int64_t upperIPv6(const char* ipv6)
 }
 
 // ----------------------------------------------------------------------------
-extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
+/** Parses an IPv6 CIDR (like 2001::/64), prefix (16 bytes) will be filled
+ *  with the address masked by the prefix length.
+ *  \return 1 if ipv6_cidr is valid, 0 otherwise.
+ */
+extern "C" int parseIPv6CIDR(const char* ipv6_cidr, uint8_t* prefix,
+                             int* mask_length)
 {
     const char* mask_location = strchr(ipv6_cidr, '/');
-    if (mask_location == NULL)
-        return 0;
-    struct in6_addr v6_in;
-    if (stk_inet_pton6(ipv6_in, &v6_in) != 1)
+    if (mask_location == NULL ||
+        mask_location - ipv6_cidr >= INET6_ADDRSTRLEN)
         return 0;
 
     char ipv6[INET6_ADDRSTRLEN] = {};
@@ -459,8 +462,34 @@ extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
     if (stk_inet_pton6(ipv6, &cidr) != 1)
         return 0;
 
-    int mask_length = atoi(mask_location + 1);
-    if (mask_length > 128 || mask_length <= 0)
+    int length = atoi(mask_location + 1);
+    if (length > 128 || length <= 0)
+        return 0;
+
+    struct in6_addr mask = {};
+    for (int i = length, j = 0; i > 0; i -= 8, j++)
+    {
+        if (i >= 8)
+            mask.s6_addr[j] = 0xff;
+        else
+            mask.s6_addr[j] = (unsigned long)(0xffU << (8 - i));
+    }
+    andIPv6(&cidr, &mask);
+    memcpy(prefix, cidr.s6_addr, 16);
+    *mask_length = length;
+    return 1;
+}   // parseIPv6CIDR
+
+// ----------------------------------------------------------------------------
+extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
+{
+    struct in6_addr v6_in;
+    if (stk_inet_pton6(ipv6_in, &v6_in) != 1)
+        return 0;
+
+    uint8_t cidr[16];
+    int mask_length = 0;
+    if (parseIPv6CIDR(ipv6_cidr, cidr, &mask_length) != 1)
         return 0;
 
     struct in6_addr mask = {};
@@ -472,11 +501,10 @@ extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
             mask.s6_addr[j] = (unsigned long)(0xffU << (8 - i));
     }
 
-    andIPv6(&cidr, &mask);
     andIPv6(&v6_in, &mask);
     for (unsigned i = 0; i < sizeof(struct in6_addr); i++)
     {
-        if (cidr.s6_addr[i] != v6_in.s6_addr[i])
+        if (cidr[i] != v6_in.s6_addr[i])
             return 0;
     }
     return 1;
@@ -27,6 +27,7 @@ int getaddrinfo_compat(const char* hostname, const char* servname,
                        const struct addrinfo* hints, struct addrinfo** res);
 int64_t upperIPv6(const char* ipv6);
 int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in);
+int parseIPv6CIDR(const char* ipv6_cidr, uint8_t* prefix, int* mask_length);
 #ifdef __cplusplus
 }
 #endif
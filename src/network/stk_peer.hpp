@@ -23,6 +23,7 @@
 #ifndef STK_PEER_HPP
 #define STK_PEER_HPP
 
+#include "network/asset_catalog.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/time.hpp"
 #include "utils/types.hpp"
@@ -111,8 +112,14 @@ protected:
 
     int m_consecutive_messages;
 
-    /** Available karts and tracks from this peer */
-    std::pair<std::set<std::string>, std::set<std::string> > m_available_kts;
+    /** Available karts and tracks from this peer, in the asset catalog of
+     *  server. */
+    std::pair<AssetBitset, AssetBitset> m_available_kts;
+
+    /** Karts and tracks of a client without the asset catalog capability
+     *  as sent, to map them again when the catalog grows. */
+    std::pair<std::vector<std::string>, std::vector<std::string> >
+        m_asset_idents;
 
     std::unique_ptr<Crypto> m_crypto;
 
@@ -171,42 +178,32 @@ public:
     float getConnectedTime() const
        { return float(StkTime::getMonoTimeMs() - m_connected_time) / 1000.0f; }
     // ------------------------------------------------------------------------
-    void setAvailableKartsTracks(std::set<std::string>& k,
-                                 std::set<std::string>& t)
+    void setAvailableKartsTracks(AssetBitset& k, AssetBitset& t)
               { m_available_kts = std::make_pair(std::move(k), std::move(t)); }
     // ------------------------------------------------------------------------
-    void eraseServerKarts(const std::set<std::string>& server_karts,
-                          std::set<std::string>& karts_erase) const
+    /** Clears the server karts not available in this peer. */
+    void eraseServerKarts(AssetBitset& server_karts) const
     {
-        if (m_available_kts.first.empty())
-            return;
-        for (const std::string& server_kart : server_karts)
-        {
-            if (m_available_kts.first.find(server_kart) ==
-                m_available_kts.first.end())
-            {
-                karts_erase.insert(server_kart);
-            }
-        }
+        if (!m_available_kts.first.empty())
+            server_karts.intersect(m_available_kts.first);
     }
     // ------------------------------------------------------------------------
-    void eraseServerTracks(const std::set<std::string>& server_tracks,
-                           std::set<std::string>& tracks_erase) const
+    /** Clears the server tracks not available in this peer. */
+    void eraseServerTracks(AssetBitset& server_tracks) const
     {
-        if (m_available_kts.second.empty())
-            return;
-        for (const std::string& server_track : server_tracks)
-        {
-            if (m_available_kts.second.find(server_track) ==
-                m_available_kts.second.end())
-            {
-                tracks_erase.insert(server_track);
-            }
-        }
+        if (!m_available_kts.second.empty())
+            server_tracks.intersect(m_available_kts.second);
     }
     // ------------------------------------------------------------------------
-    std::pair<std::set<std::string>, std::set<std::string> >
-                            getClientAssets() const { return m_available_kts; }
+    const std::pair<AssetBitset, AssetBitset>& getClientAssets() const
+                                                  { return m_available_kts; }
+    // ------------------------------------------------------------------------
+    void setAssetIdents(std::vector<std::string>& k,
+                        std::vector<std::string>& t)
+               { m_asset_idents = std::make_pair(std::move(k), std::move(t)); }
+    // ------------------------------------------------------------------------
+    const std::pair<std::vector<std::string>, std::vector<std::string> >&
+        getAssetIdents() const                     { return m_asset_idents; }
     // ------------------------------------------------------------------------
     void setPingInterval(uint32_t interval)
                             { enet_peer_ping_interval(m_enet_peer, interval); }
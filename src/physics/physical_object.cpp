@@ -32,6 +32,7 @@
 #include "network/compress_network_body.hpp"
 #include "network/network_config.hpp"
 #include "network/protocols/lobby_protocol.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object.hpp"
 #include "utils/constants.hpp"
@@ -154,6 +155,8 @@ PhysicalObject::PhysicalObject(bool is_dynamic,
     m_explode_kart       = false;
     m_flatten_kart       = false;
     m_triangle_mesh      = NULL;
+    m_on_kart_collision_fn = NULL;
+    m_on_item_collision_fn = NULL;
 
     m_object             = object;
     m_init_xyz           = object->getAbsoluteCenterPosition();
@@ -704,6 +707,31 @@ bool PhysicalObject::castRay(const btVector3 &from, const btVector3 &to,
     return result;
 }   // castRay
 
+// ----------------------------------------------------------------------------
+/** Looks up the collision scripting functions of this object, so that
+ *  collisions don't need to find them by name. Called once the scripts of
+ *  the track are compiled.
+ */
+void PhysicalObject::resolveScriptCallbacks()
+{
+    Scripting::ScriptEngine* script_engine =
+        Scripting::ScriptEngine::getInstance();
+    m_on_kart_collision_fn = NULL;
+    m_on_item_collision_fn = NULL;
+    if (!m_on_kart_collision.empty())
+    {
+        m_on_kart_collision_fn = script_engine->getFunction(true, "void " +
+            m_on_kart_collision + "(int, const string, const string)");
+    }
+    if (!m_on_item_collision.empty())
+    {
+        m_on_item_collision_fn = script_engine->getFunction(true, "void " +
+            m_on_item_collision + "(int, int, const string)");
+    }
+    TrackObject* library = m_object->getParentLibrary();
+    m_library_id = library ? library->getID() : "";
+}   // resolveScriptCallbacks
+
 // ----------------------------------------------------------------------------
 void PhysicalObject::reset()
 {
@@ -838,14 +866,14 @@ void PhysicalObject::computeError()
 }   // computeError
 
 // ----------------------------------------------------------------------------
-BareNetworkString* PhysicalObject::saveState(std::vector<std::string>* ru)
+bool PhysicalObject::saveState(BareNetworkString* buffer,
+                               std::vector<std::string>* ru)
 {
     bool has_live_join = false;
 
     if (auto sl = LobbyProtocol::get<LobbyProtocol>())
         has_live_join = sl->hasLiveJoiningRecently();
 
-    BareNetworkString* buffer = new BareNetworkString();
     // This will compress and round down values of body, use the rounded
     // down value to test if sending state is needed
     // If any client live-joined always send new state for this object
@@ -858,16 +886,13 @@ BareNetworkString* PhysicalObject::saveState(std::vector<std::string>* ru)
         .length() < 0.01f &&
         (current_lv - m_last_lv).length() < 0.01f &&
         (current_av - m_last_av).length() < 0.01f && !has_live_join)
-    {
-        delete buffer;
-        return nullptr;
-    }
+        return false;
 
     ru->push_back(getUniqueIdentity());
     m_last_transform = cur_transform;
     m_last_lv = current_lv;
     m_last_av = current_av;
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
@@ -1051,6 +1076,9 @@ void PhysicalObject::copyFromMainProcess(TrackObject* track_obj)
     m_no_server_state = false;
     m_body_added = false;
     m_object = track_obj;
+    // Child process has no scripting engine
+    m_on_kart_collision_fn = NULL;
+    m_on_item_collision_fn = NULL;
     if (m_triangle_mesh)
     {
         const TriangleMesh& old_tm = *m_triangle_mesh;
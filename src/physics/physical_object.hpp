@@ -28,6 +28,7 @@
 #include "physics/user_pointer.hpp"
 #include "utils/vec3.hpp"
 
+class asIScriptFunction;
 class Material;
 class TrackObject;
 class XMLNode;
@@ -178,6 +179,14 @@ private:
     * when a (flyable) item collides with this object
     */
     std::string           m_on_item_collision;
+    /** The scripting functions of m_on_kart_collision and
+     *  m_on_item_collision, resolved once the scripts are compiled (or NULL
+     *  if there are none). */
+    asIScriptFunction*    m_on_kart_collision_fn;
+    asIScriptFunction*    m_on_item_collision_fn;
+    /** ID of the parent library of the track object, passed to the kart
+     *  collision function. */
+    std::string           m_library_id;
     /** If this body is a bullet dynamic body, i.e. affected by physics
      *  or not (static (not moving) or kinematic (animated outside
      *  of physics). */
@@ -221,7 +230,7 @@ public:
     bool isDynamic() const { return m_is_dynamic; }
     // ------------------------------------------------------------------------
     /** Returns the ID of this physical object. */
-    std::string getID()          { return m_id; }
+    const std::string& getID() const { return m_id; }
     // ------------------------------------------------------------------------
     btDefaultMotionState* getMotionState() const { return m_motion_state; }
     // ------------------------------------------------------------------------
@@ -251,6 +260,16 @@ public:
     // ------------------------------------------------------------------------
     const std::string& getOnItemCollisionFunction() const { return m_on_item_collision; }
     // ------------------------------------------------------------------------
+    void resolveScriptCallbacks();
+    // ------------------------------------------------------------------------
+    asIScriptFunction* getOnKartCollisionScript() const
+                                            { return m_on_kart_collision_fn; }
+    // ------------------------------------------------------------------------
+    asIScriptFunction* getOnItemCollisionScript() const
+                                            { return m_on_item_collision_fn; }
+    // ------------------------------------------------------------------------
+    const std::string& getLibraryID() const           { return m_library_id; }
+    // ------------------------------------------------------------------------
     TrackObject* getTrackObject() { return m_object; }
 
     // Methods usable by scripts
@@ -284,7 +303,8 @@ public:
     void addForRewind();
     virtual void saveTransform();
     virtual void computeError();
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru);
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru);
     virtual void undoEvent(BareNetworkString *buffer) {}
     virtual void rewindToEvent(BareNetworkString *buffer) {}
     virtual void restoreState(BareNetworkString *buffer, int count);
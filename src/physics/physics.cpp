@@ -77,6 +77,7 @@ void Physics::destroy()
  */
 Physics::Physics() : btSequentialImpulseConstraintSolver()
 {
+    m_kart_kart_collision_fn = NULL;
     m_collision_conf      = new btDefaultCollisionConfiguration();
     m_dispatcher          = new btCollisionDispatcher(m_collision_conf);
 }   // Physics
@@ -89,6 +90,7 @@ Physics::Physics() : btSequentialImpulseConstraintSolver()
 void Physics::init(const Vec3 &world_min, const Vec3 &world_max)
 {
     m_physics_loop_active = false;
+    m_kart_kart_collision_fn = NULL;
     m_axis_sweep          = new btAxisSweep3(world_min, world_max);
     m_dynamics_world      = new STKDynamicsWorld(m_dispatcher,
                                                  m_axis_sweep,
@@ -114,6 +116,16 @@ void Physics::init(const Vec3 &world_min, const Vec3 &world_max)
                       | stk_config->m_solver_set_flags;
 }   // init
 
+//-----------------------------------------------------------------------------
+/** Looks up the kart-kart collision function of the track script once it is
+ *  compiled, so that collisions don't need to find it by name.
+ */
+void Physics::resolveScriptCallbacks()
+{
+    m_kart_kart_collision_fn = Scripting::ScriptEngine::getInstance()
+        ->getFunction(false, "void onKartKartCollision(int, int)");
+}   // resolveScriptCallbacks
+
 //-----------------------------------------------------------------------------
 Physics::~Physics()
 {
@@ -211,6 +223,8 @@ void Physics::update(int ticks)
     std::vector<CollisionPair>::iterator p;
     // Child process currently has no scripting engine
     bool is_child = STKProcess::getType() == PT_CHILD;
+    Scripting::ScriptEngine* script_engine =
+        is_child ? NULL : Scripting::ScriptEngine::getInstance();
     for(p=m_all_collisions.begin(); p!=m_all_collisions.end(); ++p)
     {
         // Kart-kart collision
@@ -223,15 +237,17 @@ void Physics::update(int ticks)
                               p->getContactPointCS(1)                );
             if (!is_child)
             {
-                Scripting::ScriptEngine* script_engine =
-                                                Scripting::ScriptEngine::getInstance();
                 int kartid1 = p->getUserPointer(0)->getPointerKart()->getWorldKartId();
                 int kartid2 = p->getUserPointer(1)->getPointerKart()->getWorldKartId();
-                script_engine->runFunction(false, "void onKartKartCollision(int, int)",
-                    [=](asIScriptContext* ctx) {
-                        ctx->SetArgDWord(0, kartid1);
-                        ctx->SetArgDWord(1, kartid2);
-                    });
+                asIScriptContext* ctx = m_kart_kart_collision_fn ?
+                    script_engine->prepareFunction(m_kart_kart_collision_fn) :
+                    NULL;
+                if (ctx)
+                {
+                    ctx->SetArgDWord(0, kartid1);
+                    ctx->SetArgDWord(1, kartid2);
+                    script_engine->executeFunction(ctx);
+                }
             }
             continue;
         }  // if kart-kart collision
@@ -243,26 +259,17 @@ void Physics::update(int ticks)
             AbstractKart *kart = p->getUserPointer(1)->getPointerKart();
             int kartId = kart->getWorldKartId();
             PhysicalObject* obj = p->getUserPointer(0)->getPointerPhysicalObject();
-            std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnKartCollisionFunction();
-
-            TrackObject* to = obj->getTrackObject();
-            TrackObject* library = to->getParentLibrary();
-            std::string lib_id;
-            std::string* lib_id_ptr = NULL;
-            if (library != NULL)
-                lib_id = library->getID();
-            lib_id_ptr = &lib_id;
-
-            if (!is_child && scripting_function.size() > 0)
+            asIScriptFunction* fn = obj->getOnKartCollisionScript();
+            asIScriptContext* ctx = !is_child && fn ?
+                script_engine->prepareFunction(fn) : NULL;
+            if (ctx)
             {
-                Scripting::ScriptEngine* script_engine = Scripting::ScriptEngine::getInstance();
-                script_engine->runFunction(true, "void " + scripting_function + "(int, const string, const string)",
-                    [&](asIScriptContext* ctx) {
-                        ctx->SetArgDWord(0, kartId);
-                        ctx->SetArgObject(1, lib_id_ptr);
-                        ctx->SetArgObject(2, &obj_id);
-                    });
+                // The strings are copied by the context as they are passed
+                // by value
+                ctx->SetArgDWord(0, kartId);
+                ctx->SetArgObject(1, (void*)&obj->getLibraryID());
+                ctx->SetArgObject(2, (void*)&obj->getID());
+                script_engine->executeFunction(ctx);
             }
             if (obj->isCrashReset())
             {
@@ -345,17 +352,15 @@ void Physics::update(int ticks)
             // -------------------------------
             Flyable* flyable = p->getUserPointer(0)->getPointerFlyable();
             PhysicalObject* obj = p->getUserPointer(1)->getPointerPhysicalObject();
-            std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnItemCollisionFunction();
-            if (!is_child && scripting_function.size() > 0)
+            asIScriptFunction* fn = obj->getOnItemCollisionScript();
+            asIScriptContext* ctx = !is_child && fn ?
+                script_engine->prepareFunction(fn) : NULL;
+            if (ctx)
             {
-                Scripting::ScriptEngine* script_engine = Scripting::ScriptEngine::getInstance();
-                script_engine->runFunction(true, "void " + scripting_function + "(int, int, const string)",
-                        [&](asIScriptContext* ctx) {
-                        ctx->SetArgDWord(0, (int)flyable->getType());
-                        ctx->SetArgDWord(1, flyable->getOwnerId());
-                        ctx->SetArgObject(2, &obj_id);
-                    });
+                ctx->SetArgDWord(0, (int)flyable->getType());
+                ctx->SetArgDWord(1, flyable->getOwnerId());
+                ctx->SetArgObject(2, (void*)&obj->getID());
+                script_engine->executeFunction(ctx);
             }
             flyable->hit(NULL, obj);
 
@@ -34,6 +34,7 @@
 #include "physics/user_pointer.hpp"
 
 class AbstractKart;
+class asIScriptFunction;
 class STKDynamicsWorld;
 class Vec3;
 
@@ -147,6 +148,9 @@ private:
     btDefaultCollisionConfiguration *m_collision_conf;
     CollisionList                    m_all_collisions;
 
+    /** The onKartKartCollision function of the track script, or NULL. */
+    asIScriptFunction               *m_kart_kart_collision_fn;
+
              Physics();
     virtual ~Physics();
 
@@ -159,6 +163,7 @@ public:
     static void destroy();
     // ----------------------------------------------------------------------------------------
     void  init             (const Vec3 &min_world, const Vec3 &max_world);
+    void  resolveScriptCallbacks();
     void  addKart          (const AbstractKart *k);
     void  addBody          (btRigidBody* b) {m_dynamics_world->addRigidBody(b);}
     void  removeKart       (const AbstractKart *k);
@@ -21,10 +21,17 @@
 #include <stdio.h>
 
 #include "io/file_manager.hpp"
+#include "items/item_manager.hpp"
+#include "items/powerup_manager.hpp"
+#include "main_loop.hpp"
+#include "modes/benchmark.hpp"
 #include "modes/world.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
 #include "network/network_config.hpp"
+#include "network/network_string.hpp"
+#include "network/protocols/game_protocol.hpp"
+#include "network/remote_kart_info.hpp"
 #include "network/rewind_manager.hpp"
 #include "physics/physics.hpp"
 #include "race/race_manager.hpp"
@@ -39,9 +46,18 @@ bool History::m_online_history_replay = false;
  */
 History::History()
 {
-    m_replay_history = false;
+    m_replay_history      = false;
+    m_network_replay      = false;
+    m_event_index         = 0;
+    m_network_event_index = 0;
+    m_filename            = "history.dat";
 }   // History
 
+//-----------------------------------------------------------------------------
+History::~History()
+{
+}   // ~History
+
 //-----------------------------------------------------------------------------
 /** Initialise the history for a new recording. It especially allocates memory
  *  to store the history.
@@ -51,6 +67,7 @@ void History::initRecording()
     allocateMemory();
     m_event_index = 0;
     m_all_input_events.clear();
+    m_all_network_events.clear();
 }   // initRecording
 
 //-----------------------------------------------------------------------------
@@ -87,6 +104,21 @@ void History::addEvent(int kart_id, PlayerAction pa, int value)
     m_all_input_events.emplace_back(ie);
 }   // addEvent
 
+//-----------------------------------------------------------------------------
+/** Stores an event which a server received from a client, so that the
+ *  race can be re-simulated later.
+ *  \param world_ticks The time at which the server used the event.
+ *  \param data The event data, as passed to the rewind manager.
+ */
+void History::addNetworkEvent(int world_ticks, const BareNetworkString* data)
+{
+    NetworkEvent ne;
+    ne.m_world_ticks = world_ticks;
+    ne.m_data.assign((const uint8_t*)data->getData(),
+        (const uint8_t*)data->getData() + data->getTotalSize());
+    m_all_network_events.emplace_back(std::move(ne));
+}   // addNetworkEvent
+
 //-----------------------------------------------------------------------------
 /** Sets the kart position and controls to the recorded history value.
  *  \param world_ticks WOrld time in ticks.
@@ -94,6 +126,12 @@ void History::addEvent(int kart_id, PlayerAction pa, int value)
  */
 void History::updateReplay(int world_ticks)
 {
+    if (m_network_replay)
+    {
+        updateNetworkReplay(world_ticks);
+        return;
+    }
+
     World *world = World::getWorld();
 
     while (m_event_index < m_all_input_events.size() &&
@@ -127,23 +165,74 @@ void History::updateReplay(int world_ticks)
 }   // updateReplay
 
 //-----------------------------------------------------------------------------
-/** Saves the history stored in the internal data structures into a file called
- *  history.dat.
+/** Replays the network events of a history recorded on a server. They are
+ *  given to the rewind manager at the time at which the server used them,
+ *  which then plays them like RaceEventManager does on a server.
+ *  \param world_ticks World time in ticks.
  */
-void History::Save()
+void History::updateNetworkReplay(int world_ticks)
+{
+    // Created here as it needs the item manager of the loaded track
+    if (!m_game_protocol)
+        m_game_protocol = GameProtocol::createInstance();
+
+    while (m_network_event_index < m_all_network_events.size() &&
+        m_all_network_events[m_network_event_index].m_world_ticks <=
+        world_ticks)
+    {
+        const NetworkEvent &ne = m_all_network_events[m_network_event_index];
+        BareNetworkString *s = new BareNetworkString(
+            (const char*)ne.m_data.data(), (int)ne.m_data.size());
+        RewindManager::get()->addNetworkEvent(m_game_protocol.get(), s,
+                                              world_ticks);
+        m_network_event_index++;
+        // Stop after the last event, unless benchmarking
+        if (m_network_event_index == m_all_network_events.size())
+        {
+            Log::info("History", "Replay finished");
+            if (!Benchmark::isEnabled())
+                main_loop->requestAbort();
+        }
+    }
+    RewindManager::get()->playEventsTill(world_ticks, /*fast_forward*/false);
+}   // updateNetworkReplay
+
+//-----------------------------------------------------------------------------
+/** Saves the history stored in the internal data structures into a file.
+ *  After two text lines with the versions the data is binary.
+ *  \param filename Full path of the file. If empty, history.dat in the
+ *         current directory or the config directory is used.
+ */
+void History::Save(const std::string& filename)
 {
     World *world   = World::getWorld();
     if (!world)
         return;
-    FILE *fd = fopen("history.dat","w");
-    if(fd)
-        Log::info("History", "Saved in ./history.dat.");
+    FILE *fd = NULL;
+    if (!filename.empty())
+    {
+        fd = FileUtils::fopenU8Path(filename, "wb");
+        if (fd)
+            Log::info("History", "Saved in '%s'.", filename.c_str());
+        else
+        {
+            Log::error("History", "Can't open '%s' for writing.",
+                       filename.c_str());
+            return;
+        }
+    }
     else
     {
-        std::string fn = file_manager->getUserConfigFile("history.dat");
-        fd = FileUtils::fopenU8Path(fn, "w");
+        fd = fopen("history.dat","wb");
         if(fd)
-            Log::info("History", "Saved in '%s'.", fn.c_str());
+            Log::info("History", "Saved in ./history.dat.");
+        else
+        {
+            std::string fn = file_manager->getUserConfigFile("history.dat");
+            fd = FileUtils::fopenU8Path(fn, "wb");
+            if(fd)
+                Log::info("History", "Saved in '%s'.", fn.c_str());
+        }
     }
     if(!fd)
     {
@@ -154,57 +243,78 @@ void History::Save()
     }
 
     const int num_karts = world->getNumKarts();
-    fprintf(fd, "STK-version:      %s\n",   STK_VERSION);
-    fprintf(fd, "History-version:  %d\n",   1);
-    fprintf(fd, "numkarts:         %d\n",   num_karts);
-    fprintf(fd, "numplayers:       %d\n", RaceManager::get()->getNumPlayers());
-    fprintf(fd, "difficulty:       %d\n", RaceManager::get()->getDifficulty());
-    fprintf(fd, "reverse: %c\n", RaceManager::get()->getReverseTrack() ? 'y' : 'n');
-
-    fprintf(fd, "track: %s\n", Track::getCurrentTrack()->getIdent().c_str());
-
     assert(num_karts > 0);
+    fprintf(fd, "STK-version:      %s\n",   STK_VERSION);
+    fprintf(fd, "History-version:  %d\n",   2);
+
+    RaceManager* rm = RaceManager::get();
+    BareNetworkString data(1024 + (int)m_all_input_events.size() * 10 +
+                           (int)m_all_network_events.size() * 16);
+    data.addUInt8(NetworkConfig::get()->isServer() ? 1 : 0)
+        .addUInt8((uint8_t)num_karts).addUInt8((uint8_t)rm->getNumPlayers())
+        .addUInt8((uint8_t)rm->getDifficulty())
+        .addUInt8(rm->getReverseTrack() ? 1 : 0)
+        .addUInt32((uint32_t)rm->getMinorMode())
+        .addUInt32((uint32_t)rm->getNumLaps())
+        .encodeString(Track::getCurrentTrack()->getIdent())
+        .addUInt32((uint32_t)rm->getMaxGoal())
+        .addFloat(rm->getTimeTarget())
+        .addUInt32((uint32_t)rm->getHitCaptureLimit())
+        .addUInt32(ItemManager::getRandomSeed())
+        .addUInt64(powerup_manager->getRandomSeed());
+
+    for (int k = 0; k < num_karts; k++)
+    {
+        KartTeam team = world->hasTeam() ? world->getKartTeam(k)
+                                         : KART_TEAM_NONE;
+        data.encodeString(world->getKart(k)->getIdent())
+            .addUInt8((uint8_t)rm->getKartType(k))
+            .addUInt8((uint8_t)(team + 1))
+            .addUInt8((uint8_t)world->getKart(k)->getHandicap());
+    }
 
-    int k;
-    for(k=0; k<num_karts; k++)
+    data.addUInt32((uint32_t)m_all_input_events.size());
+    for (const InputEvent& ie : m_all_input_events)
     {
-        fprintf(fd, "model %d: %s\n",k, world->getKart(k)->getIdent().c_str());
+        data.addUInt32(ie.m_world_ticks).addUInt8((uint8_t)ie.m_kart_index)
+            .addUInt8((uint8_t)ie.m_action).addUInt32((uint32_t)ie.m_value);
     }
-    fprintf(fd, "count:     %zu\n", m_all_input_events.size());
 
-    for (unsigned int i = 0; i < m_all_input_events.size(); i++)
+    data.addUInt32((uint32_t)m_all_network_events.size());
+    for (const NetworkEvent& ne : m_all_network_events)
     {
-        fprintf(fd, "%d %d %d %d\n",
-                m_all_input_events[i].m_world_ticks,
-                m_all_input_events[i].m_kart_index,
-                m_all_input_events[i].m_action,
-                m_all_input_events[i].m_value      );
-    }   // for i
+        data.addUInt32(ne.m_world_ticks)
+            .addUInt16((uint16_t)ne.m_data.size());
+        for (uint8_t c : ne.m_data)
+            data.addUInt8(c);
+    }
 
-    fprintf(fd, "History file end.\n");
+    if (fwrite(data.getData(), data.getTotalSize(), 1, fd) != 1)
+        Log::error("History", "Could not write the history.");
     fclose(fd);
 }   // Save
 
 //-----------------------------------------------------------------------------
-/** Loads a history from history.dat in the current directory.
+/** Loads a history from the history file (history.dat by default), which is
+ *  searched in the current directory and the config directory.
  */
 void History::Load()
 {
     char s[1024], s1[1024];
     int  n;
 
-    FILE *fd = fopen("history.dat","r");
+    FILE *fd = FileUtils::fopenU8Path(m_filename, "rb");
     if(fd)
-        Log::info("History", "Reading ./history.dat");
+        Log::info("History", "Reading '%s'.", m_filename.c_str());
     else
     {
-        std::string fn = file_manager->getUserConfigFile("history.dat");
-        fd = FileUtils::fopenU8Path(fn, "r");
+        std::string fn = file_manager->getUserConfigFile(m_filename);
+        fd = FileUtils::fopenU8Path(fn, "rb");
         if(fd)
             Log::info("History", "Reading '%s'.", fn.c_str());
     }
     if(!fd)
-        Log::fatal("History", "Could not open history.dat");
+        Log::fatal("History", "Could not open %s", m_filename.c_str());
 
     if (fgets(s, 1023, fd) == NULL)
         Log::fatal("History", "Could not read history.dat.");
@@ -231,6 +341,25 @@ void History::Load()
     if (sscanf(s, "History-version: %1023d", &version) != 1)
         Log::fatal("Invalid version number found: '%s'", s);
 
+    if (version == 2)
+    {
+        std::vector<char> data;
+        size_t count;
+        while ((count = fread(s, 1, sizeof(s), fd)) > 0)
+            data.insert(data.end(), s, s + count);
+        fclose(fd);
+        BareNetworkString bns(data.data(), (int)data.size());
+        try
+        {
+            loadBinary(&bns);
+        }
+        catch (std::exception& e)
+        {
+            Log::fatal("History", "Invalid history file: %s", e.what());
+        }
+        return;
+    }
+
     if (version != 1)
         Log::fatal("History",
                    "Old-style history files are not supported anymore.");
@@ -311,3 +440,110 @@ void History::Load()
     fclose(fd);
 }   // Load
 
+
+//-----------------------------------------------------------------------------
+/** Reads the binary part of a version 2 history file and sets up the race
+ *  manager for it. Throws std::out_of_range if the data is too short.
+ */
+void History::loadBinary(BareNetworkString* data)
+{
+    RaceManager* rm = RaceManager::get();
+    m_network_replay = data->getUInt8() != 0;
+    const unsigned int num_karts = data->getUInt8();
+    const unsigned int num_players = data->getUInt8();
+    rm->setNumKarts(num_karts);
+    rm->setDifficulty((RaceManager::Difficulty)data->getUInt8());
+    rm->setReverseTrack(data->getUInt8() != 0);
+    rm->setMinorMode((RaceManager::MinorRaceModeType)data->getUInt32());
+    rm->setMajorMode(RaceManager::MAJOR_MODE_SINGLE);
+    int laps = (int)data->getUInt32();
+    std::string track;
+    data->decodeString(&track);
+    rm->setTrack(track);
+    rm->setMaxGoal((int)data->getUInt32());
+    float time_target = data->getFloat();
+    rm->setHitCaptureTime((int)data->getUInt32(), time_target);
+    ItemManager::updateRandomSeed(data->getUInt32());
+    powerup_manager->setRandomSeed(data->getUInt64());
+    // Like version 1 histories the race must not end, unless it was
+    // recorded on a server
+    rm->setNumLaps(m_network_replay ? laps : 100);
+
+    // A server has only network players (and AI karts in front of them),
+    // which get their inputs from the network events
+    std::vector<std::string> ai_karts;
+    std::vector<RemoteKartInfo> network_karts;
+    unsigned int num_red_ai = 0, num_blue_ai = 0;
+    m_kart_ident.clear();
+    for (unsigned int i = 0; i < num_karts; i++)
+    {
+        std::string ident;
+        data->decodeString(&ident);
+        RaceManager::KartType type = (RaceManager::KartType)data->getUInt8();
+        KartTeam team = (KartTeam)((int)data->getUInt8() - 1);
+        HandicapLevel handicap = (HandicapLevel)data->getUInt8();
+        m_kart_ident.push_back(ident);
+        if (!m_network_replay)
+        {
+            if (i < num_players && !m_online_history_replay)
+                rm->setPlayerKart(i, ident);
+            continue;
+        }
+        if (type == RaceManager::KT_AI)
+        {
+            ai_karts.push_back(ident);
+            if (team == KART_TEAM_RED)
+                num_red_ai++;
+            else if (team == KART_TEAM_BLUE)
+                num_blue_ai++;
+            continue;
+        }
+        RemoteKartInfo rki(ident);
+        rki.setNetworkPlayer(true);
+        rki.setKartTeam(team);
+        rki.setHandicap(handicap);
+        network_karts.push_back(rki);
+    }
+    if (m_network_replay)
+    {
+        rm->setNumPlayers((int)network_karts.size(), /*local_players*/0);
+        for (unsigned int i = 0; i < network_karts.size(); i++)
+            rm->setPlayerKart(i, network_karts[i]);
+        rm->setDefaultAIKartList(ai_karts);
+        rm->setNumRedAI(num_red_ai);
+        rm->setNumBlueAI(num_blue_ai);
+    }
+    else
+        rm->setNumPlayers(num_players);
+
+    // We need to disable the rewind manager here (otherwise setting the
+    // KartControl data would access the rewind manager).
+    bool rewind_manager_was_enabled = RewindManager::isEnabled();
+    RewindManager::setEnable(false);
+    const uint32_t count = data->getUInt32();
+    allocateMemory(count);
+    m_event_index = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        InputEvent &ie = m_all_input_events[i];
+        ie.m_world_ticks = (int)data->getUInt32();
+        ie.m_kart_index  = data->getUInt8();
+        ie.m_action      = (PlayerAction)data->getUInt8();
+        ie.m_value       = (int)data->getUInt32();
+    }
+    RewindManager::setEnable(rewind_manager_was_enabled);
+
+    const uint32_t network_count = data->getUInt32();
+    m_all_network_events.resize(network_count);
+    m_network_event_index = 0;
+    for (uint32_t i = 0; i < network_count; i++)
+    {
+        NetworkEvent &ne = m_all_network_events[i];
+        ne.m_world_ticks = (int)data->getUInt32();
+        ne.m_data.resize(data->getUInt16());
+        for (uint8_t& c : ne.m_data)
+            c = data->getUInt8();
+    }
+    Log::info("History", "%u input events and %u network events loaded.",
+              count, network_count);
+}   // loadBinary
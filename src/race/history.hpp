@@ -23,9 +23,12 @@
 #include "input/input.hpp"
 #include "karts/controller/kart_control.hpp"
 
+#include <memory>
 #include <string>
 #include <vector>
 
+class BareNetworkString;
+class GameProtocol;
 class Kart;
 
 /**
@@ -40,9 +43,22 @@ private:
     /** Points to the last used input event index. */
     unsigned int m_event_index;
 
+    /** True if the history was recorded on a server, it is then replayed
+     *  by feeding its network events to the rewind manager. */
+    bool m_network_replay;
+
+    /** Points to the next network event to replay. */
+    unsigned int m_network_event_index;
+
+    /** Name of the history file to load. */
+    std::string m_filename;
+
     /** The identities of the karts to use. */
     std::vector<std::string> m_kart_ident;
 
+    /** Receives the replayed network events, like on the server. */
+    std::shared_ptr<GameProtocol> m_game_protocol;
+
     // ------------------------------------------------------------------------
     struct InputEvent
     {
@@ -60,15 +76,32 @@ private:
     /** All input events. */
     std::vector<InputEvent> m_all_input_events;
 
+    // ------------------------------------------------------------------------
+    /** An event received by a server from a client (a controller action),
+     *  with the time at which the server used it. */
+    struct NetworkEvent
+    {
+        int m_world_ticks;
+        std::vector<uint8_t> m_data;
+    };   // NetworkEvent
+    // ------------------------------------------------------------------------
+
+    /** All network events. */
+    std::vector<NetworkEvent> m_all_network_events;
+
     void  allocateMemory(int size=-1);
+    void  loadBinary(BareNetworkString* data);
+    void  updateNetworkReplay(int world_ticks);
 public:
     static bool m_online_history_replay;
           History        ();
+         ~History        ();
     void  initRecording  ();
-    void  Save           ();
+    void  Save           (const std::string& filename = "");
     void  Load           ();
     void  updateReplay(int world_ticks);
     void  addEvent(int kart_id, PlayerAction pa, int value);
+    void  addNetworkEvent(int world_ticks, const BareNetworkString* data);
 
     // -------------------I-----------------------------------------------------
     /** Returns the identifier of the n-th kart. */
@@ -82,6 +115,13 @@ public:
     // ------------------------------------------------------------------------
     /** Set if replay is enabled or not. */
     void  setReplayHistory(bool b) { m_replay_history=b;  }
+    // ------------------------------------------------------------------------
+    /** Returns if a history recorded on a server is replayed. */
+    bool  replayNetworkEvents() const
+                            { return m_replay_history && m_network_replay; }
+    // ------------------------------------------------------------------------
+    /** Sets the name of the history file to load. */
+    void  setFilename(const std::string& filename) { m_filename = filename; }
 };
 
 extern History* history;
@@ -18,8 +18,38 @@
 #include "replay/replay_base.hpp"
 
 #include "io/file_manager.hpp"
+#include "network/network_string.hpp"
 #include "utils/file_utils.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /** Fixed point scales of the values of an event in binary replays, in
+     *  the order used by encodeEvent. Integers use a scale of 1. The time is
+     *  stored in ms, positions in 1/1024 m and rotations and steering with
+     *  15 bits. */
+    const float g_event_scale[] =
+    {
+        1000.0f,                             // time
+        1024.0f, 1024.0f, 1024.0f,           // origin
+        32767.0f, 32767.0f, 32767.0f, 32767.0f, // rotation
+        256.0f, 32767.0f,                    // speed, steer
+        4096.0f, 4096.0f, 4096.0f, 4096.0f,  // suspension
+        1.0f,                                // skidding state
+        1.0f, 256.0f, 1.0f, 1.0f, 1.0f,      // bonus info
+        256.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f // replay event
+    };
+
+    // ------------------------------------------------------------------------
+    int32_t quantise(float f, float scale)
+    {
+        float q = std::max(-2.0e9f, std::min(2.0e9f, f * scale));
+        return (int32_t)lrintf(q);
+    }   // quantise
+}   // namespace
+
 // -----------------------------------------------------------------------------
 ReplayBase::ReplayBase()
 {
@@ -34,7 +64,7 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path, int replay_file
 {
     FILE* fd = FileUtils::fopenU8Path(full_path ? getReplayFilename(replay_file_number) :
         file_manager->getReplayDir() + getReplayFilename(replay_file_number),
-        writeable ? "w" : "r");
+        writeable ? "wb" : "rb");
     if (!fd)
     {
         return NULL;
@@ -42,3 +72,99 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path, int replay_file
     return fd;
 
 }   // openReplayFile
+
+// -----------------------------------------------------------------------------
+/** Converts an event to the fixed point values stored in binary replays.
+ *  \param fields Array of BINARY_EVENT_FIELDS values to fill in.
+ */
+void ReplayBase::encodeEvent(const TransformEvent& te, const PhysicInfo& pi,
+                             const BonusInfo& bi, const KartReplayEvent& kre,
+                             int32_t* fields)
+{
+    const btVector3& xyz = te.m_transform.getOrigin();
+    const btQuaternion q = te.m_transform.getRotation();
+    const float values[BINARY_EVENT_FIELDS] =
+    {
+        te.m_time,
+        xyz.getX(), xyz.getY(), xyz.getZ(),
+        q.getX(), q.getY(), q.getZ(), q.getW(),
+        pi.m_speed, pi.m_steer,
+        pi.m_suspension_length[0], pi.m_suspension_length[1],
+        pi.m_suspension_length[2], pi.m_suspension_length[3],
+        (float)pi.m_skidding_state,
+        (float)bi.m_attachment, bi.m_nitro_amount, (float)bi.m_item_amount,
+        (float)bi.m_item_type, (float)bi.m_special_value,
+        kre.m_distance, (float)kre.m_nitro_usage, (float)kre.m_zipper_usage,
+        (float)kre.m_skidding_effect, (float)kre.m_red_skidding,
+        (float)kre.m_jumping
+    };
+    for (int i = 0; i < BINARY_EVENT_FIELDS; i++)
+        fields[i] = quantise(values[i], g_event_scale[i]);
+}   // encodeEvent
+
+// -----------------------------------------------------------------------------
+/** Converts the fixed point values of binary replays back to an event. */
+void ReplayBase::decodeEvent(const int32_t* fields, TransformEvent* te,
+                             PhysicInfo* pi, BonusInfo* bi,
+                             KartReplayEvent* kre)
+{
+    float v[BINARY_EVENT_FIELDS];
+    for (int i = 0; i < BINARY_EVENT_FIELDS; i++)
+        v[i] = (float)fields[i] / g_event_scale[i];
+
+    btQuaternion q(v[4], v[5], v[6], v[7]);
+    if (q.length2() > 0.0f)
+        q.normalize();
+    else
+        q = btQuaternion(0.0f, 0.0f, 0.0f, 1.0f);
+    te->m_time                = v[0];
+    te->m_transform           = btTransform(q, btVector3(v[1], v[2], v[3]));
+    pi->m_speed               = v[8];
+    pi->m_steer               = v[9];
+    for (int i = 0; i < 4; i++)
+        pi->m_suspension_length[i] = v[10 + i];
+    pi->m_skidding_state      = fields[14];
+    bi->m_attachment          = fields[15];
+    bi->m_nitro_amount        = v[16];
+    bi->m_item_amount         = fields[17];
+    bi->m_item_type           = fields[18];
+    bi->m_special_value       = fields[19];
+    kre->m_distance           = v[20];
+    kre->m_nitro_usage        = fields[21];
+    kre->m_zipper_usage       = fields[22] != 0;
+    kre->m_skidding_effect    = fields[23];
+    kre->m_red_skidding       = fields[24] != 0;
+    kre->m_jumping            = fields[25] != 0;
+}   // decodeEvent
+
+// -----------------------------------------------------------------------------
+/** Adds a signed integer with zigzag and variable length encoding, so that
+ *  small deltas between events only use one byte.
+ */
+void ReplayBase::addVarInt(BareNetworkString* s, int32_t value)
+{
+    uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    while (v >= 0x80)
+    {
+        s->addUInt8((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    s->addUInt8((uint8_t)v);
+}   // addVarInt
+
+// -----------------------------------------------------------------------------
+/** Reads an integer written by addVarInt. Throws std::out_of_range if the
+ *  string ends or the value is invalid.
+ */
+int32_t ReplayBase::getVarInt(const BareNetworkString& s)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        uint8_t b = s.getUInt8();
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+    }
+    throw std::out_of_range("Invalid variable length integer.");
+}   // getVarInt
@@ -22,10 +22,13 @@
 #include "LinearMath/btTransform.h"
 #include "utils/no_copy.hpp"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string>
 #include <vector>
 
+class BareNetworkString;
+
 /**
   * \ingroup race
   */
@@ -97,6 +100,11 @@ protected:
         bool        m_jumping;
     };   // KartReplayEvent
 
+    // ------------------------------------------------------------------------
+    /** Number of values stored for each event in binary replays, it's the
+     *  same as the number of values in a line of text replays. */
+    static const int BINARY_EVENT_FIELDS = 26;
+
     // ------------------------------------------------------------------------
     FILE *openReplayFile(bool writeable, bool full_path = false, int replay_file_number=1);
     // ------------------------------------------------------------------------
@@ -105,13 +113,31 @@ protected:
     // ------------------------------------------------------------------------
     /** Returns the version number of the replay file recorderd by this executable.
      *  This is also used as a maximum supported version by this exexcutable. */
-    unsigned int getCurrentReplayVersion() const { return 4; }
+    unsigned int getCurrentReplayVersion() const { return 6; }
+
+    // ------------------------------------------------------------------------
+    /** The first replay version which is saved in binary format after the
+     *  version line. */
+    unsigned int getFirstBinaryReplayVersion() const { return 5; }
 
     // ------------------------------------------------------------------------
     /** This is used to check that a loaded replay file can still
      *  be understood by this executable. */
     unsigned int getMinSupportedReplayVersion() const { return 3; }
 
+    // ------------------------------------------------------------------------
+    static void encodeEvent(const TransformEvent& te, const PhysicInfo& pi,
+                            const BonusInfo& bi, const KartReplayEvent& kre,
+                            int32_t* fields);
+    // ------------------------------------------------------------------------
+    static void decodeEvent(const int32_t* fields, TransformEvent* te,
+                            PhysicInfo* pi, BonusInfo* bi,
+                            KartReplayEvent* kre);
+    // ------------------------------------------------------------------------
+    static void addVarInt(BareNetworkString* s, int32_t value);
+    // ------------------------------------------------------------------------
+    static int32_t getVarInt(const BareNetworkString& s);
+
 public:
              ReplayBase();
     virtual ~ReplayBase() {};
@@ -23,20 +23,75 @@
 #include "karts/ghost_kart.hpp"
 #include "karts/controller/ghost_controller.hpp"
 #include "modes/world.hpp"
+#include "network/network_string.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/file_utils.hpp"
 #include "utils/mem_utils.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include <stdio.h>
 #include <string>
 #include <cinttypes>
+#include <sys/stat.h>
+#include <zlib.h>
 
 ReplayPlay::SortOrder ReplayPlay::m_sort_order = ReplayPlay::SO_DEFAULT;
 ReplayPlay *ReplayPlay::m_replay_play = NULL;
 
+namespace
+{
+    const uint32_t REPLAY_INDEX_MAGIC = 0x58495052; // "RPIX" little endian
+    /** Increase when the index or the binary replay header changes. */
+    const uint8_t REPLAY_INDEX_VERSION = 2;
+    /** First binary replay version with a flags byte in the header. */
+    const unsigned int REPLAY_FLAGS_VERSION = 6;
+    /** Header flag: the event blocks of the karts are zlib compressed. */
+    const uint8_t REPLAY_FLAG_COMPRESSED_EVENTS = 1;
+
+    // ------------------------------------------------------------------------
+    /** Reads a block of a binary replay, which is its size in 4 bytes
+     *  followed by the data.
+     *  \param skip True to seek over the data without reading it.
+     */
+    bool readBlock(FILE* fd, std::vector<char>* data, bool skip = false)
+    {
+        char size_data[4];
+        if (fread(size_data, 4, 1, fd) != 1)
+            return false;
+        uint32_t size = BareNetworkString(size_data, 4).getUInt32();
+        // Replays have at most a few MB per kart
+        if (size > 64 * 1024 * 1024)
+            return false;
+        if (skip)
+            return fseek(fd, size, SEEK_CUR) == 0;
+        data->resize(size);
+        return size == 0 || fread(data->data(), size, 1, fd) == 1;
+    }   // readBlock
+
+    // ------------------------------------------------------------------------
+    /** Replaces a compressed block, which is its uncompressed size in 4 bytes
+     *  followed by the zlib data, with the uncompressed data.
+     */
+    bool uncompressBlock(std::vector<char>* data)
+    {
+        if (data->size() < 4)
+            return false;
+        uLongf size = BareNetworkString(data->data(), 4).getUInt32();
+        if (size > 64 * 1024 * 1024)
+            return false;
+        std::vector<char> raw(size);
+        if (uncompress((Bytef*)raw.data(), &size,
+                       (const Bytef*)data->data() + 4,
+                       (uLong)data->size() - 4) != Z_OK || size != raw.size())
+            return false;
+        data->swap(raw);
+        return true;
+    }   // uncompressBlock
+}   // namespace
+
 //-----------------------------------------------------------------------------
 /** Initialises the Replay engine
  */
@@ -45,6 +100,8 @@ ReplayPlay::ReplayPlay()
     m_current_replay_file   = 0;
     m_second_replay_file    = 0;
     m_second_replay_enabled = false;
+    m_index_loaded          = false;
+    m_index_changed         = false;
 }   // ReplayPlay
 
 //-----------------------------------------------------------------------------
@@ -65,9 +122,14 @@ void ReplayPlay::reset()
 }   // reset
 
 //-----------------------------------------------------------------------------
+/** Loads the headers of all replay files, using the replay index for files
+ *  which didn't change since it was saved.
+ */
 void ReplayPlay::loadAllReplayFile()
 {
     m_replay_file_list.clear();
+    if (!m_index_loaded)
+        loadIndex();
 
     // Load stock replay first
     std::set<std::string> pre_record;
@@ -101,26 +163,252 @@ void ReplayPlay::loadAllReplayFile()
         j++;
     }
 
+    files.insert(pre_record.begin(), pre_record.end());
+    saveIndex(files);
 }   // loadAllReplayFile
 
 //-----------------------------------------------------------------------------
-bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int call_index)
+std::string ReplayPlay::getIndexFilename() const
 {
+    return file_manager->getReplayDir() + "replay_index.bin";
+}   // getIndexFilename
 
-    char s[1024], s1[1024];
-    if (StringUtils::getExtension(fn) != "replay") return false;
-    FILE* fd = FileUtils::fopenU8Path(custom_replay ? fn :
-        file_manager->getReplayDir() + fn, "r");
-    if (fd == NULL) return false;
-    auto scoped = [&]() { fclose(fd); };
-    MemUtils::deref<decltype(scoped)> cls(scoped); 
-    ReplayData rd;
+//-----------------------------------------------------------------------------
+/** Reads the replay index file, an invalid file is ignored.
+ */
+void ReplayPlay::loadIndex()
+{
+    m_index_loaded = true;
+    m_replay_index.clear();
+    FILE* fd = FileUtils::fopenU8Path(getIndexFilename(), "rb");
+    if (!fd)
+        return;
+    std::vector<char> data;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fd)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(fd);
 
+    BareNetworkString index(data.data(), (int)data.size());
+    try
+    {
+        if (index.getUInt32() != REPLAY_INDEX_MAGIC ||
+            index.getUInt8() != REPLAY_INDEX_VERSION)
+            return;
+        uint32_t count = index.getUInt32();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            core::stringw fn;
+            index.decodeString16(&fn);
+            IndexEntry entry;
+            entry.m_mtime = index.getUInt64();
+            entry.m_size = index.getUInt64();
+            entry.m_data.m_replay_version = index.getUInt8();
+            decodeHeader(index, entry.m_data);
+            m_replay_index[StringUtils::wideToUtf8(fn)] = entry;
+        }
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("Replay", "Ignoring invalid replay index: %s", e.what());
+        m_replay_index.clear();
+    }
+}   // loadIndex
+
+//-----------------------------------------------------------------------------
+/** Removes entries of files which don't exist anymore from the replay index,
+ *  and saves it if it was changed.
+ *  \param files All replay files which exist.
+ */
+void ReplayPlay::saveIndex(const std::set<std::string>& files)
+{
+    for (auto it = m_replay_index.begin(); it != m_replay_index.end();)
+    {
+        if (files.find(it->first) == files.end())
+        {
+            it = m_replay_index.erase(it);
+            m_index_changed = true;
+        }
+        else
+            it++;
+    }
+    if (!m_index_changed)
+        return;
+
+    BareNetworkString index;
+    index.addUInt32(REPLAY_INDEX_MAGIC).addUInt8(REPLAY_INDEX_VERSION)
+        .addUInt32((uint32_t)m_replay_index.size());
+    for (auto& e : m_replay_index)
+    {
+        index.encodeString16(StringUtils::utf8ToWide(e.first));
+        index.addUInt64(e.second.m_mtime).addUInt64(e.second.m_size)
+            .addUInt8((uint8_t)e.second.m_data.m_replay_version);
+        encodeHeader(&index, e.second.m_data);
+    }
+
+    const std::string path = getIndexFilename();
+    std::string tmp_path = path + ".tmp" +
+        StringUtils::toString(StkTime::getMonoTimeMs());
+    FILE* fd = FileUtils::fopenU8Path(tmp_path, "wb");
+    if (!fd)
+    {
+        Log::warn("Replay", "Cannot write %s.", tmp_path.c_str());
+        return;
+    }
+    bool written =
+        fwrite(index.getData(), index.getTotalSize(), 1, fd) == 1;
+    written = fclose(fd) == 0 && written;
+    if (written && FileUtils::renameU8Path(tmp_path, path) != 0)
+    {
+        // Windows doesn't replace existing file when renaming
+        remove(FileUtils::getPortableWritingPath(path).c_str());
+        written = FileUtils::renameU8Path(tmp_path, path) == 0;
+    }
+    if (!written)
+    {
+        Log::warn("Replay", "Cannot write %s.", path.c_str());
+        remove(FileUtils::getPortableWritingPath(tmp_path).c_str());
+        return;
+    }
+    m_index_changed = false;
+}   // saveIndex
+
+//-----------------------------------------------------------------------------
+/** Writes the header of a binary replay file (also used in the replay
+ *  index). The replay version, file name and track are not included.
+ */
+void ReplayPlay::encodeHeader(BareNetworkString* s, const ReplayData& rd)
+{
+    s->encodeString(rd.m_stk_version);
+    s->addUInt8((uint8_t)rd.m_kart_list.size());
+    for (unsigned int i = 0; i < rd.m_kart_list.size(); i++)
+    {
+        s->encodeString(rd.m_kart_list[i]).encodeString(rd.m_name_list[i])
+            .addFloat(rd.m_kart_color[i]);
+    }
+    s->addUInt8(rd.m_reverse ? 1 : 0).addUInt8((uint8_t)rd.m_difficulty)
+        .encodeString(rd.m_minor_mode).encodeString(rd.m_track_name)
+        .addUInt16((uint16_t)rd.m_laps).addFloat(rd.m_min_time)
+        .addUInt64(rd.m_replay_uid);
+    if (rd.m_replay_version >= REPLAY_FLAGS_VERSION)
+    {
+        s->addUInt8(rd.m_compressed_events ? REPLAY_FLAG_COMPRESSED_EVENTS
+                                           : 0);
+    }
+}   // encodeHeader
+
+//-----------------------------------------------------------------------------
+/** Reads a header written by encodeHeader, throws std::out_of_range if the
+ *  data is too short.
+ */
+void ReplayPlay::decodeHeader(const BareNetworkString& s, ReplayData& rd)
+{
+    s.decodeStringW(&rd.m_stk_version);
+    unsigned int num_karts = s.getUInt8();
+    rd.m_kart_list.resize(num_karts);
+    rd.m_name_list.resize(num_karts);
+    rd.m_kart_color.resize(num_karts);
+    for (unsigned int i = 0; i < num_karts; i++)
+    {
+        s.decodeString(&rd.m_kart_list[i]);
+        s.decodeStringW(&rd.m_name_list[i]);
+        rd.m_kart_color[i] = s.getFloat();
+    }
+    rd.m_user_name = num_karts > 0 ? rd.m_name_list[0] : L"";
+    rd.m_reverse = s.getUInt8() != 0;
+    rd.m_difficulty = s.getUInt8();
+    s.decodeString(&rd.m_minor_mode);
+    s.decodeString(&rd.m_track_name);
+    rd.m_laps = s.getUInt16();
+    rd.m_min_time = s.getFloat();
+    rd.m_replay_uid = s.getUInt64();
+    rd.m_compressed_events = false;
+    if (rd.m_replay_version >= REPLAY_FLAGS_VERSION)
+    {
+        rd.m_compressed_events =
+            (s.getUInt8() & REPLAY_FLAG_COMPRESSED_EVENTS) != 0;
+    }
+    rd.m_track = NULL;
+    rd.m_custom_replay_file = false;
+}   // decodeHeader
+
+//-----------------------------------------------------------------------------
+bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int call_index)
+{
+    if (StringUtils::getExtension(fn) != "replay") return false;
     // custom_replay is true when full path of filename is given
+    const std::string full_path = custom_replay ? fn :
+        file_manager->getReplayDir() + fn;
+    struct stat st;
+    if (FileUtils::statU8Path(full_path, &st) != 0) return false;
+
+    ReplayData rd;
+    auto it = m_replay_index.find(fn);
+    if (it != m_replay_index.end() &&
+        it->second.m_mtime == (uint64_t)st.st_mtime &&
+        it->second.m_size == (uint64_t)st.st_size)
+    {
+        rd = it->second.m_data;
+    }
+    else
+    {
+        FILE* fd = FileUtils::fopenU8Path(full_path, "rb");
+        if (fd == NULL) return false;
+        bool valid = readHeader(fd, fn, rd);
+        fclose(fd);
+        if (!valid) return false;
+        IndexEntry& entry = m_replay_index[fn];
+        entry.m_mtime = (uint64_t)st.st_mtime;
+        entry.m_size = (uint64_t)st.st_size;
+        entry.m_data = rd;
+        m_index_changed = true;
+    }
     rd.m_custom_replay_file = custom_replay;
     rd.m_filename = fn;
 
-    fgets(s, 1023, fd);
+    // No UID in old replay format
+    if (rd.m_replay_version < 4)
+        rd.m_replay_uid = call_index;
+
+    // If former official tracks are present as addons, show the matching replays.
+    if (rd.m_track_name.compare("greenvalley") == 0)
+        rd.m_track_name = std::string("addon_green-valley");
+    if (rd.m_track_name.compare("mansion") == 0)
+        rd.m_track_name = std::string("addon_blackhill-mansion");
+
+    Track* t = track_manager->getTrack(rd.m_track_name);
+    if (t == NULL)
+    {
+        Log::warn("Replay", "Track '%s' used in replay '%s' not found in STK!",
+        rd.m_track_name.c_str(), fn.c_str());
+        return false;
+    }
+
+    rd.m_track = t;
+
+    m_replay_file_list.push_back(rd);
+
+    assert(m_replay_file_list.size() > 0);
+    // Force to use custom replay file immediately
+    if (custom_replay)
+        m_current_replay_file = (unsigned int)m_replay_file_list.size() - 1;
+
+    return true;
+
+}   // addReplayFile
+
+//-----------------------------------------------------------------------------
+/** Reads the header of a replay file.
+ *  \param fd The replay file, opened at its beginning.
+ *  \param fn Name of the file for messages.
+ *  \param rd Where the header is stored.
+ *  \return True if the header is valid.
+ */
+bool ReplayPlay::readHeader(FILE* fd, const std::string& fn, ReplayData& rd)
+{
+    char s[1024], s1[1024];
+    if (fgets(s, 1023, fd) == NULL) return false;
     unsigned int version;
     if (sscanf(s,"version: %u", &version) != 1)
     {
@@ -137,7 +425,31 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
         Log::warn("Replay", "Skipped '%s'", fn.c_str());
         return false;
     }
-        rd.m_replay_version = version;
+    rd.m_replay_version = version;
+    rd.m_compressed_events = false;
+
+    if (version >= getFirstBinaryReplayVersion())
+    {
+        std::vector<char> data;
+        if (!readBlock(fd, &data))
+        {
+            Log::warn("Replay", "No header found in replay file, '%s'.",
+                      fn.c_str());
+            return false;
+        }
+        BareNetworkString header(data.data(), (int)data.size());
+        try
+        {
+            decodeHeader(header, rd);
+        }
+        catch (std::exception&)
+        {
+            Log::warn("Replay", "Invalid header in replay file, '%s'.",
+                      fn.c_str());
+            return false;
+        }
+        return true;
+    }
 
     if (version >= 4)
     {
@@ -154,14 +466,14 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
 
     while(true)
     {
-        fgets(s, 1023, fd);
+        if (fgets(s, 1023, fd) == NULL) return false;
         core::stringc is_end(s);
         is_end.trim();
         if (is_end == "kart_list_end") break;
         char s1[1024];
         char display_name_encoded[1024];
 
-        int scanned = sscanf(s,"kart: %1023s %1023[^\n]", s1, display_name_encoded);
+        int scanned = sscanf(s,"kart: %1023s %1023[^\r\n]", s1, display_name_encoded);
         if (scanned < 1)
         {
             Log::warn("Replay", "Could not read ghost karts info!");
@@ -239,22 +551,7 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
         return false;
     }
     rd.m_track_name = std::string(s1);
-
-    // If former official tracks are present as addons, show the matching replays.
-    if (rd.m_track_name.compare("greenvalley") == 0)
-        rd.m_track_name = std::string("addon_green-valley");
-    if (rd.m_track_name.compare("mansion") == 0)
-        rd.m_track_name = std::string("addon_blackhill-mansion");
-
-    Track* t = track_manager->getTrack(rd.m_track_name);
-    if (t == NULL)
-    {
-        Log::warn("Replay", "Track '%s' used in replay '%s' not found in STK!",
-        rd.m_track_name.c_str(), fn.c_str());
-        return false;
-    }
-
-    rd.m_track = t;
+    rd.m_track = NULL;
 
     fgets(s, 1023, fd);
     if (sscanf(s, "laps: %u", &rd.m_laps) != 1)
@@ -279,20 +576,13 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
             return false;
         }
     }
-    // No UID in old replay format
+    // No UID in old replay format, set by addReplayFile
     else
-        rd.m_replay_uid = call_index;
-
-    m_replay_file_list.push_back(rd);
-
-    assert(m_replay_file_list.size() > 0);
-    // Force to use custom replay file immediately
-    if (custom_replay)
-        m_current_replay_file = (unsigned int)m_replay_file_list.size() - 1;
+        rd.m_replay_uid = 0;
 
     return true;
 
-}   // addReplayFile
+}   // readHeader
 
 //-----------------------------------------------------------------------------
 void ReplayPlay::load()
@@ -330,6 +620,13 @@ void ReplayPlay::loadFile(bool second_replay)
                     getReplayFilename(replay_file_number).c_str());
 
     ReplayData &rd = m_replay_file_list[replay_index];
+    if (rd.m_replay_version >= getFirstBinaryReplayVersion())
+    {
+        readBinaryKartData(fd, second_replay);
+        fclose(fd);
+        return;
+    }
+
     unsigned int num_kart = (unsigned int)m_replay_file_list.at(replay_index)
                                                             .m_kart_list.size();
     unsigned int lines_to_skip = (rd.m_replay_version == 3) ? 7 : 10;
@@ -351,13 +648,11 @@ void ReplayPlay::loadFile(bool second_replay)
 }   // loadFile
 
 //-----------------------------------------------------------------------------
-/** Reads all data from a replay file for a specific kart.
- *  \param fd The file descriptor from which to read.
+/** Creates the ghost kart for the next kart of a replay file.
+ *  \return Index of the ghost kart.
  */
-void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
+unsigned int ReplayPlay::createGhostKart(bool second_replay)
 {
-    char s[1024];
-
     int replay_index = second_replay ? m_second_replay_file
                                      : m_current_replay_file;
 
@@ -376,6 +671,21 @@ void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
     Controller* controller = new GhostController(getGhostKart(kart_num).get(),
                                                  rd.m_name_list[kart_num-first_loaded_f_num]);
     getGhostKart(kart_num)->setController(controller);
+    return kart_num;
+}   // createGhostKart
+
+//-----------------------------------------------------------------------------
+/** Reads all data from a replay file for a specific kart.
+ *  \param fd The file descriptor from which to read.
+ */
+void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
+{
+    char s[1024];
+
+    int replay_index = second_replay ? m_second_replay_file
+                                     : m_current_replay_file;
+    ReplayData &rd = m_replay_file_list[replay_index];
+    const unsigned int kart_num = createGhostKart(second_replay);
 
     unsigned int size;
     if(sscanf(next_line,"size: %u",&size)!=1)
@@ -492,6 +802,69 @@ void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
 
 }   // readKartData
 
+//-----------------------------------------------------------------------------
+/** Reads the data of all karts from a binary replay file. The events of each
+ *  kart are in a separate block, which is decoded directly into its ghost
+ *  kart before the next block is read.
+ *  \param fd The replay file, opened at its beginning.
+ */
+void ReplayPlay::readBinaryKartData(FILE *fd, bool second_replay)
+{
+    char s[1024];
+    int replay_index = second_replay ? m_second_replay_file
+                                     : m_current_replay_file;
+    const ReplayData &rd = m_replay_file_list[replay_index];
+
+    std::vector<char> data;
+    if (fgets(s, 1023, fd) == NULL || !readBlock(fd, &data, /*skip*/true))
+    {
+        Log::warn("Replay", "Invalid replay file '%s'.",
+                  rd.m_filename.c_str());
+        return;
+    }
+
+    for (unsigned int k = 0; k < rd.m_kart_list.size(); k++)
+    {
+        if (!readBlock(fd, &data))
+        {
+            Log::warn("Replay", "Replay data missing for kart %d.", k);
+            return;
+        }
+        if (rd.m_compressed_events && !uncompressBlock(&data))
+        {
+            Log::warn("Replay", "Invalid compressed data for kart %d.", k);
+            return;
+        }
+        const unsigned int kart_num = createGhostKart(second_replay);
+        BareNetworkString events(data.data(), (int)data.size());
+        int32_t fields[BINARY_EVENT_FIELDS] = { 0 };
+        try
+        {
+            const uint32_t size = events.getUInt32();
+            for (uint32_t i = 0; i < size; i++)
+            {
+                // Each value is stored as difference to the previous event
+                for (int j = 0; j < BINARY_EVENT_FIELDS; j++)
+                {
+                    fields[j] = (int32_t)((uint32_t)fields[j] +
+                                          (uint32_t)getVarInt(events));
+                }
+                TransformEvent te;
+                PhysicInfo pi;
+                BonusInfo bi;
+                KartReplayEvent kre;
+                decodeEvent(fields, &te, &pi, &bi, &kre);
+                m_ghost_karts[kart_num]->addReplayEvent(te.m_time,
+                    te.m_transform, pi, bi, kre);
+            }
+        }
+        catch (std::exception&)
+        {
+            Log::warn("Replay", "Replay data of kart %d truncated.", k);
+        }
+    }
+}   // readBinaryKartData
+
 //-----------------------------------------------------------------------------
 /** call getReplayIdByUID and set the current replay file to the first one
  *  with a matching UID.
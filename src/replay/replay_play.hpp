@@ -24,12 +24,15 @@
 
 #include "irrString.h"
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 using namespace irr;
 
+class BareNetworkString;
 class GhostKart;
 
 /**
@@ -67,6 +70,7 @@ public:
         std::vector<float>         m_kart_color; //no sorting for this
         bool                       m_reverse;
         bool                       m_custom_replay_file;
+        bool                       m_compressed_events; //no sorting for this
         unsigned int               m_difficulty;
         unsigned int               m_laps;
         unsigned int               m_replay_version; //no sorting for this
@@ -122,14 +126,41 @@ private:
     /** All ghost karts. */
     std::vector<std::shared_ptr<GhostKart> > m_ghost_karts;
 
+    /** Header of a replay file saved in the replay index, so the files
+     *  don't need to be opened again if they didn't change. */
+    struct IndexEntry
+    {
+        uint64_t   m_mtime;
+        uint64_t   m_size;
+        ReplayData m_data;
+    };
+
+    /** The replay index, the key is the file name as given to
+     *  addReplayFile. */
+    std::map<std::string, IndexEntry> m_replay_index;
+
+    /** True if the index file was read. */
+    bool                     m_index_loaded;
+
+    /** True if the index differs from the index file. */
+    bool                     m_index_changed;
+
           ReplayPlay();
          ~ReplayPlay();
     void  readKartData(FILE *fd, char *next_line, bool second_replay);
+    void  readBinaryKartData(FILE *fd, bool second_replay);
+    unsigned int createGhostKart(bool second_replay);
+    bool  readHeader(FILE *fd, const std::string& fn, ReplayData& rd);
+    void  loadIndex();
+    void  saveIndex(const std::set<std::string>& files);
+    std::string getIndexFilename() const;
 public:
     void  reset();
     void  load();
     void  loadFile(bool second_replay);
     void  loadAllReplayFile();
+    static void encodeHeader(BareNetworkString* s, const ReplayData& rd);
+    static void decodeHeader(const BareNetworkString& s, ReplayData& rd);
     // ------------------------------------------------------------------------
     static void        setSortOrder(SortOrder so)       { m_sort_order = so; }
     // ------------------------------------------------------------------------
@@ -31,8 +31,10 @@
 #include "modes/easter_egg_hunt.hpp"
 #include "modes/linear_world.hpp"
 #include "modes/world.hpp"
+#include "network/network_string.hpp"
 #include "physics/btKart.hpp"
 #include "race/race_manager.hpp"
+#include "replay/replay_play.hpp"
 #include "tracks/track.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
@@ -41,6 +43,7 @@
 #include <stdio.h>
 #include <string>
 #include <cinttypes>
+#include <zlib.h>
 
 ReplayRecorder *ReplayRecorder::m_replay_recorder = NULL;
 
@@ -347,6 +350,39 @@ uint64_t ReplayRecorder::computeUID(float min_time)
     return unique_identifier;
 }
 
+//-----------------------------------------------------------------------------
+/** Writes a block of a binary replay, which is the size of the data in 4
+ *  bytes followed by the data.
+ */
+static void writeBlock(FILE* fd, const char* data, uint32_t data_size)
+{
+    BareNetworkString size(4);
+    size.addUInt32(data_size);
+    fwrite(size.getData(), 4, 1, fd);
+    if (data_size > 0)
+        fwrite(data, data_size, 1, fd);
+}   // writeBlock
+
+//-----------------------------------------------------------------------------
+/** Compresses the data of a block with zlib, the result is the uncompressed
+ *  size in 4 bytes followed by the compressed data.
+ *  eturn False if zlib failed.
+ */
+static bool compressBlock(const std::vector<char>& data,
+                          std::vector<char>* out)
+{
+    uLongf size = compressBound((uLong)data.size());
+    out->resize(size + 4);
+    BareNetworkString raw_size(4);
+    raw_size.addUInt32((uint32_t)data.size());
+    memcpy(out->data(), raw_size.getData(), 4);
+    if (compress2((Bytef*)out->data() + 4, &size, (const Bytef*)data.data(),
+                  (uLong)data.size(), Z_BEST_COMPRESSION) != Z_OK)
+        return false;
+    out->resize(size + 4);
+    return true;
+}   // compressBlock
+
 //-----------------------------------------------------------------------------
 /** Saves the replay data stored in the internal data structures.
  */
@@ -395,26 +431,25 @@ void ReplayRecorder::save()
         StringUtils::utf8ToWide(file_manager->getReplayDir() + getReplayFilename()));
     MessageQueue::add(MessageQueue::MT_GENERIC, msg);
 
-    fprintf(fd, "version: %d\n", getCurrentReplayVersion());
-    fprintf(fd, "stk_version: %s\n", STK_VERSION);
-
+    ReplayPlay::ReplayData rd;
+    rd.m_stk_version = STK_VERSION;
     unsigned int player_count = 0;
     for (unsigned int real_karts = 0; real_karts < num_karts; real_karts++)
     {
         const AbstractKart *kart = world->getKart(real_karts);
         if (kart->isGhostKart()) continue;
 
-        // XML encode the username to handle Unicode
-        fprintf(fd, "kart: %s %s\n", kart->getIdent().c_str(),
-                StringUtils::xmlEncode(kart->getController()->getName()).c_str());
-
+        rd.m_kart_list.push_back(kart->getIdent());
+        rd.m_name_list.push_back(kart->getController()->getName());
         if (kart->getController()->isPlayerController())
         {
-            fprintf(fd, "kart_color: %f\n", StateManager::get()->getActivePlayer(player_count)->getConstProfile()->getDefaultKartColor());
+            rd.m_kart_color.push_back(StateManager::get()
+                ->getActivePlayer(player_count)->getConstProfile()
+                ->getDefaultKartColor());
             player_count++;
         }
         else
-            fprintf(fd, "kart_color: 0\n");
+            rd.m_kart_color.push_back(0.0f);
     }
 
     m_last_uid = computeUID(min_time);
@@ -422,15 +457,15 @@ void ReplayRecorder::save()
     int num_laps = RaceManager::get()->getNumLaps();
     if (num_laps == 9999) num_laps = 0; // no lap in that race mode
 
-    fprintf(fd, "kart_list_end\n");
-    fprintf(fd, "reverse: %d\n",    (int)RaceManager::get()->getReverseTrack());
-    fprintf(fd, "difficulty: %d\n", RaceManager::get()->getDifficulty());
-    fprintf(fd, "mode: %s\n",       RaceManager::get()->getMinorModeName().c_str());
-    fprintf(fd, "track: %s\n",      Track::getCurrentTrack()->getIdent().c_str());
-    fprintf(fd, "laps: %d\n",       num_laps);
-    fprintf(fd, "min_time: %f\n",   min_time);
-    fprintf(fd, "replay_uid: %" PRIu64 "\n", m_last_uid);
+    rd.m_reverse      = RaceManager::get()->getReverseTrack();
+    rd.m_difficulty   = RaceManager::get()->getDifficulty();
+    rd.m_minor_mode   = RaceManager::get()->getMinorModeName();
+    rd.m_track_name   = Track::getCurrentTrack()->getIdent();
+    rd.m_laps         = num_laps;
+    rd.m_min_time     = min_time;
+    rd.m_replay_uid   = m_last_uid;
 
+    std::vector<std::vector<char> > blocks;
     for (unsigned int k = 0; k < num_karts; k++)
     {
         if (world->getKart(k)->isGhostKart()) continue;
@@ -438,44 +473,54 @@ void ReplayRecorder::save()
         const unsigned int num_transforms = std::min(m_max_frames,
                                                      m_count_transforms[k]);
 
-        fprintf(fd, "size:     %d\n", num_transforms);
-
+        BareNetworkString events(num_transforms * BINARY_EVENT_FIELDS + 4);
+        events.addUInt32(num_transforms);
+        int32_t previous[BINARY_EVENT_FIELDS] = { 0 };
+        int32_t fields[BINARY_EVENT_FIELDS];
         for (unsigned int i = 0; i < num_transforms; i++)
         {
-            const TransformEvent *p  = &(m_transform_events[k][i]);
-            const PhysicInfo *q      = &(m_physic_info[k][i]);
-            const BonusInfo *b      = &(m_bonus_info[k][i]);
-            const KartReplayEvent *r = &(m_kart_replay_event[k][i]);
-            fprintf(fd, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
-                    p->m_time,
-                    p->m_transform.getOrigin().getX(),
-                    p->m_transform.getOrigin().getY(),
-                    p->m_transform.getOrigin().getZ(),
-                    p->m_transform.getRotation().getX(),
-                    p->m_transform.getRotation().getY(),
-                    p->m_transform.getRotation().getZ(),
-                    p->m_transform.getRotation().getW(),
-                    q->m_speed,
-                    q->m_steer,
-                    q->m_suspension_length[0],
-                    q->m_suspension_length[1],
-                    q->m_suspension_length[2],
-                    q->m_suspension_length[3],
-                    q->m_skidding_state,
-                    b->m_attachment,
-                    b->m_nitro_amount,
-                    b->m_item_amount,
-                    b->m_item_type,
-                    b->m_special_value,
-                    r->m_distance,
-                    r->m_nitro_usage,
-                    (int)r->m_zipper_usage,
-                    r->m_skidding_effect,
-                    (int)r->m_red_skidding,
-                    (int)r->m_jumping
-                );
+            encodeEvent(m_transform_events[k][i], m_physic_info[k][i],
+                        m_bonus_info[k][i], m_kart_replay_event[k][i],
+                        fields);
+            // Store the differences, which are mostly small numbers
+            for (int j = 0; j < BINARY_EVENT_FIELDS; j++)
+            {
+                addVarInt(&events,
+                    (int32_t)((uint32_t)fields[j] - (uint32_t)previous[j]));
+                previous[j] = fields[j];
+            }
         }   // for i
+        blocks.emplace_back(events.getData(),
+                            events.getData() + events.getTotalSize());
+    }
+
+    // The events are compressed unless zlib fails for any kart, the header
+    // tells which is the case.
+    std::vector<std::vector<char> > compressed(blocks.size());
+    rd.m_compressed_events = true;
+    for (unsigned int i = 0; i < blocks.size(); i++)
+    {
+        if (!compressBlock(blocks[i], &compressed[i]))
+        {
+            Log::warn("ReplayRecorder", "Cannot compress replay data, "
+                      "saving it uncompressed.");
+            rd.m_compressed_events = false;
+            break;
+        }
     }
+    if (rd.m_compressed_events)
+        blocks.swap(compressed);
+
+    // The version line stays text, so older versions can tell that they
+    // can't read this file. It's followed by blocks of the header and of
+    // the events of each kart, each starting with its size.
+    rd.m_replay_version = getCurrentReplayVersion();
+    fprintf(fd, "version: %d\n", rd.m_replay_version);
+    BareNetworkString header;
+    ReplayPlay::encodeHeader(&header, rd);
+    writeBlock(fd, header.getData(), header.getTotalSize());
+    for (const std::vector<char>& block : blocks)
+        writeBlock(fd, block.data(), (uint32_t)block.size());
     fclose(fd);
 }   // save
 
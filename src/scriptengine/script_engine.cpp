@@ -322,6 +322,131 @@ namespace Scripting
     */
     //-----------------------------------------------------------------------------
 
+    /** Returns the script function with the given declaration, or NULL if
+    *  the script doesn't have it. The function is looked up once and cached
+    *  until the track is unloaded, so callers which call it often can keep
+    *  the returned handle (it is released by cleanupCache()).
+    *  \param function_name Declaration of the function, e.g. "void onStart()"
+    */
+    asIScriptFunction* ScriptEngine::getFunction(bool warn_if_not_found,
+                                                const std::string& function_name)
+    {
+        auto cached_function = m_functions_cache.find(function_name);
+        if (cached_function != m_functions_cache.end())
+        {
+            // Script present in cache
+            return cached_function->second;
+        }
+
+        // Find the function for the function we want to execute.
+        //      This is how you call a normal function with arguments
+        //      asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl("void func(arg1Type, arg2Type)");
+        asIScriptModule* module = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE);
+
+        if (module == NULL)
+        {
+#ifndef SERVER_ONLY
+            if (warn_if_not_found)
+                Log::warn("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
+            else
+                Log::debug("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
+#endif
+            m_functions_cache[function_name] = NULL; // remember that this function is unavailable
+            return NULL;
+        }
+
+        asIScriptFunction* func = module->GetFunctionByDecl(function_name.c_str());
+
+        if (func == NULL)
+        {
+#ifndef SERVER_ONLY
+            if (warn_if_not_found)
+                Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
+            else
+                Log::debug("Scripting", "Scripting function was not found : %s", function_name.c_str());
+#endif
+            m_functions_cache[function_name] = NULL; // remember that this function is unavailable
+            return NULL;
+        }
+
+        m_functions_cache[function_name] = func;
+        func->AddRef();
+        return func;
+    }
+
+    //-----------------------------------------------------------------------------
+    /** Returns a context prepared to call the given function, the arguments
+    *  can then be set with ctx->SetArg*() before calling executeFunction().
+    *  Contexts come from the pool of the engine, so no context is created
+    *  per call. Returns NULL on error.
+    */
+    asIScriptContext* ScriptEngine::prepareFunction(asIScriptFunction* func)
+    {
+        asIScriptContext *ctx = m_engine->RequestContext();
+        if (ctx == NULL)
+        {
+            Log::error("Scripting", "Failed to create the context.");
+            return NULL;
+        }
+
+        // Prepare the script context with the function we wish to execute. Prepare()
+        // must be called on the context before each new script function that will be
+        // executed.
+        int r = ctx->Prepare(func);
+        if (r < 0)
+        {
+            Log::error("Scripting", "Failed to prepare the context.");
+            m_engine->ReturnContext(ctx);
+            return NULL;
+        }
+        return ctx;
+    }
+
+    //-----------------------------------------------------------------------------
+    /** Executes a context from prepareFunction() and returns it to the pool.
+    */
+    void ScriptEngine::executeFunction(asIScriptContext* ctx)
+    {
+        execute(ctx);
+        m_engine->ReturnContext(ctx);
+    }
+
+    //-----------------------------------------------------------------------------
+    /** Executes a prepared context.
+    *  \return True if the function finished, false if an error was logged.
+    */
+    bool ScriptEngine::execute(asIScriptContext* ctx)
+    {
+        // Execute the function
+        int r = ctx->Execute();
+        if (r == asEXECUTION_FINISHED)
+            return true;
+
+        // The execution didn't finish as we had planned. Determine why.
+        if (r == asEXECUTION_ABORTED)
+        {
+            Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
+        }
+        else if (r == asEXECUTION_EXCEPTION)
+        {
+            Log::error("Scripting", "The script ended with an exception.");
+
+            // Write some information about the script exception
+            //asIScriptFunction *func = ctx->GetExceptionFunction();
+            //std::cout << "func: " << func->GetDeclaration() << std::endl;
+            //std::cout << "modl: " << func->GetModuleName() << std::endl;
+            //std::cout << "sect: " << func->GetScriptSectionName() << std::endl;
+            //std::cout << "line: " << ctx->GetExceptionLineNumber() << std::endl;
+            //std::cout << "desc: " << ctx->GetExceptionString() << std::endl;
+        }
+        else
+        {
+            Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
+        }
+        return false;
+    }
+
+    //-----------------------------------------------------------------------------
     /** runs the specified script
     *  \param string scriptName = name of script to run
     */
@@ -342,7 +467,6 @@ namespace Scripting
     }
 
     //-----------------------------------------------------------------------------
-
     /** runs the specified script
     *  \param string scriptName = name of script to run
     */
@@ -350,55 +474,8 @@ namespace Scripting
         std::function<void(asIScriptContext*)> callback,
         std::function<void(asIScriptContext*)> get_return_value)
     {
-        int r; //int for error checking
-
-        asIScriptFunction *func;
-
         // TODO: allow splitting in multiple files
-        std::string script_filename = "scripting.as";
-        auto cached_function = m_functions_cache.find(function_name);
-        if (cached_function == m_functions_cache.end())
-        {
-            // Find the function for the function we want to execute.
-            //      This is how you call a normal function with arguments
-            //      asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl("void func(arg1Type, arg2Type)");
-            asIScriptModule* module = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE);
-
-            if (module == NULL)
-            {
-#ifndef SERVER_ONLY
-                if (warn_if_not_found)
-                    Log::warn("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
-                else
-                    Log::debug("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
-#endif
-                m_functions_cache[function_name] = NULL; // remember that this function is unavailable
-                return;
-            }
-
-            func = module->GetFunctionByDecl(function_name.c_str());
-            
-            if (func == NULL)
-            {
-#ifndef SERVER_ONLY
-                if (warn_if_not_found)
-                    Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
-                else
-                    Log::debug("Scripting", "Scripting function was not found : %s", function_name.c_str());
-#endif
-                m_functions_cache[function_name] = NULL; // remember that this function is unavailable
-                return;
-            }
-
-            m_functions_cache[function_name] = func;
-            func->AddRef();
-        }
-        else
-        {
-            // Script present in cache
-            func = cached_function->second;
-        }
-
+        asIScriptFunction *func = getFunction(warn_if_not_found, function_name);
         if (func == NULL)
         {
             if (warn_if_not_found)
@@ -406,28 +483,9 @@ namespace Scripting
             return; // function unavailable
         }
 
-        // Create a context that will execute the script.
-        asIScriptContext *ctx = m_engine->CreateContext();
+        asIScriptContext *ctx = prepareFunction(func);
         if (ctx == NULL)
-        {
-            Log::error("Scripting", "Failed to create the context.");
-            //m_engine->Release();
             return;
-        }
-
-        // Prepare the script context with the function we wish to execute. Prepare()
-        // must be called on the context before each new script function that will be
-        // executed. Note, that if because we intend to execute the same function 
-        // several times, we will store the function returned by 
-        // GetFunctionByDecl(), so that this relatively slow call can be skipped.
-        r = ctx->Prepare(func);
-        if (r < 0)
-        {
-            Log::error("Scripting", "Failed to prepare the context.");
-            ctx->Release();
-            //m_engine->Release();
-            return;
-        }
 
         // Here, we can pass parameters to the script functions. 
         //ctx->setArgType(index, value);
@@ -436,44 +494,14 @@ namespace Scripting
         if (callback)
             callback(ctx);
 
-        // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
-        {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception.");
+        // Retrieve the return value from the context here (for scripts that return values)
+        // <type> returnValue = ctx->getReturnType(); for example
+        //float returnValue = ctx->GetReturnFloat();
+        if (execute(ctx) && get_return_value)
+            get_return_value(ctx);
 
-                // Write some information about the script exception
-                //asIScriptFunction *func = ctx->GetExceptionFunction();
-                //std::cout << "func: " << func->GetDeclaration() << std::endl;
-                //std::cout << "modl: " << func->GetModuleName() << std::endl;
-                //std::cout << "sect: " << func->GetScriptSectionName() << std::endl;
-                //std::cout << "line: " << ctx->GetExceptionLineNumber() << std::endl;
-                //std::cout << "desc: " << ctx->GetExceptionString() << std::endl;
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
-        }
-        else
-        {
-            // Retrieve the return value from the context here (for scripts that return values)
-            // <type> returnValue = ctx->getReturnType(); for example
-            //float returnValue = ctx->GetReturnFloat();
-
-            if (get_return_value)
-                get_return_value(ctx);
-        }
-
-        // We must release the contexts when no longer using them
-        ctx->Release();
+        // Contexts are kept by the engine for the next call
+        m_engine->ReturnContext(ctx);
     }
 
     //-----------------------------------------------------------------------------
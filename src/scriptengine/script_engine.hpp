@@ -73,6 +73,10 @@ namespace Scripting
         void runFunction(bool warn_if_not_found, std::string function_name,
             std::function<void(asIScriptContext*)> callback,
             std::function<void(asIScriptContext*)> get_return_value);
+        asIScriptFunction* getFunction(bool warn_if_not_found,
+                                       const std::string& function_name);
+        asIScriptContext* prepareFunction(asIScriptFunction* func);
+        void executeFunction(asIScriptContext* ctx);
         void runDelegate(asIScriptFunction* delegate_fn);
         void evalScript(std::string script_fragment);
         void cleanupCache();
@@ -92,6 +96,7 @@ namespace Scripting
         PtrVector<PendingTimeout> m_pending_timeouts;
 
         void configureEngine(asIScriptEngine *engine);
+        bool execute(asIScriptContext* ctx);
     };   // class ScriptEngine
 
 }
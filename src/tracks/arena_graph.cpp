@@ -25,25 +25,66 @@
 #include "tracks/arena_node.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
+#include "utils/file_utils.hpp"
 #include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 #include <queue>
+#include <thread>
+
+#ifndef WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace
+{
+    const uint32_t PATH_CACHE_MAGIC = 0x48545041; // "APTH" little endian
+    const uint32_t PATH_CACHE_VERSION = 1;
+
+    /** Beginning of the path cache file, followed by the distance matrix
+     *  (float) and the parent node matrix (int16_t). */
+    struct PathCacheHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_version;
+        uint32_t m_node_count;
+        uint32_t m_padding;
+        uint64_t m_checksum;
+    };
+}   // anonymous namespace
 
 // -----------------------------------------------------------------------------
 ArenaGraph::ArenaGraph(const std::string &navmesh, const XMLNode *node)
-          : Graph()
+          : Graph(), m_distance(NULL), m_parent(NULL), m_mapped_data(NULL),
+            m_mapped_size(0)
 {
     loadNavmesh(navmesh);
-    buildGraph();
-    // Compute shortest distance from all nodes
-    for (unsigned int i = 0; i < getNumNodes(); i++)
-        computeDijkstra(i);
+    // Shortest paths only depend on the navmesh, so they are saved in a file
+    // and later loads of the same navmesh just map it
+    const uint64_t checksum = getNavmeshChecksum();
+    const std::string cache_file = getPathCacheFile(navmesh, checksum);
+    if (getNumNodes() == 0 || !loadPathCache(cache_file, checksum))
+    {
+        buildGraph();
+        // Compute shortest distance from all nodes
+        computeAllDijkstra();
+        if (getNumNodes() > 0)
+            savePathCache(cache_file, checksum);
+    }
 
     setNearbyNodesOfAllNodes();
     if (node && RaceManager::get()->getMinorMode() == RaceManager::MINOR_MODE_SOCCER)
         loadGoalNodes(node);
 
+    buildGrid();
     loadBoundingBoxNodes();
 
 }   // ArenaGraph
@@ -178,9 +219,9 @@ void ArenaGraph::loadNavmesh(const std::string &navmesh)
 void ArenaGraph::buildGraph()
 {
     const unsigned int n_nodes = getNumNodes();
+    unmapPathCache();
 
-    m_distance_matrix = std::vector<std::vector<float>>
-        (n_nodes, std::vector<float>(n_nodes, 9999.9f));
+    m_distance_matrix.assign((size_t)n_nodes * n_nodes, 9999.9f);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         ArenaNode* cur_node = getNode(i);
@@ -188,24 +229,26 @@ void ArenaGraph::buildGraph()
         {
             Vec3 diff = getNode(adjacent)->getCenter() - cur_node->getCenter();
             float distance = diff.length();
-            m_distance_matrix[i][adjacent] = distance;
+            m_distance_matrix[(size_t)i * n_nodes + adjacent] = distance;
         }
-        m_distance_matrix[i][i] = 0.0f;
+        m_distance_matrix[(size_t)i * n_nodes + i] = 0.0f;
     }
 
     // Allocate and initialise the previous node data structure:
-    m_parent_node = std::vector<std::vector<int16_t>>
-        (n_nodes, std::vector<int16_t>(n_nodes, Graph::UNKNOWN_SECTOR));
+    m_parent_node.assign((size_t)n_nodes * n_nodes, Graph::UNKNOWN_SECTOR);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         for (unsigned int j = 0; j < n_nodes; j++)
         {
-            if (i == j || m_distance_matrix[i][j] >= 9899.9f)
-                m_parent_node[i][j] = -1;
+            const size_t ij = (size_t)i * n_nodes + j;
+            if (i == j || m_distance_matrix[ij] >= 9899.9f)
+                m_parent_node[ij] = -1;
             else
-                m_parent_node[i][j] = i;
+                m_parent_node[ij] = i;
         }   // for j
     }   // for i
+    m_distance = m_distance_matrix.data();
+    m_parent = m_parent_node.data();
 
 }   // buildGraph
 
@@ -216,6 +259,8 @@ void ArenaGraph::buildGraph()
  *  source to j and m_parent_node[source][j] stores the last vertex visited on
  *  the shortest path from i to j before visiting j. Suppose the shortest path
  *  from i to j is i->......->k->j  then m_parent_node[i][j] = k
+ *  Only the row of 'source' is written, so it can run in parallel for
+ *  different sources.
  */
 void ArenaGraph::computeDijkstra(int source)
 {
@@ -235,6 +280,8 @@ void ArenaGraph::computeDijkstra(int source)
     IndDistPair begin(source, 0.0f);
     queue.push(begin);
     const unsigned int n = getNumNodes();
+    float* distance = m_distance_matrix.data() + (size_t)source * n;
+    int16_t* parent = m_parent_node.data() + (size_t)source * n;
     std::vector<bool> visited;
     visited.resize(n, false);
     while (!queue.empty())
@@ -246,17 +293,20 @@ void ArenaGraph::computeDijkstra(int source)
         if (visited[cur_index]) continue;
         visited[cur_index] = true;
 
-        for (const int& adjacent : getNode(cur_index)->getAdjacentNodes())
+        ArenaNode* cur_node = getNode(cur_index);
+        for (const int& adjacent : cur_node->getAdjacentNodes())
         {
             // Distance already computed, can be ignored
             if (visited[adjacent]) continue;
 
-            float new_dist =
-                current.second + m_distance_matrix[cur_index][adjacent];
-            if (new_dist < m_distance_matrix[source][adjacent])
+            // Same edge length as in buildGraph, other rows of the distance
+            // matrix may be written by other threads
+            Vec3 diff = getNode(adjacent)->getCenter() - cur_node->getCenter();
+            float new_dist = current.second + diff.length();
+            if (new_dist < distance[adjacent])
             {
-                m_distance_matrix[source][adjacent] = new_dist;
-                m_parent_node[source][adjacent] = cur_index;
+                distance[adjacent] = new_dist;
+                parent[adjacent] = cur_index;
             }
             IndDistPair pair(adjacent, new_dist);
             queue.push(pair);
@@ -264,6 +314,35 @@ void ArenaGraph::computeDijkstra(int source)
     }
 }   // computeDijkstra
 
+// ----------------------------------------------------------------------------
+/** Runs computeDijkstra from all nodes, using all cores for big navmeshes.
+ */
+void ArenaGraph::computeAllDijkstra()
+{
+    const unsigned int n = getNumNodes();
+    unsigned int thread_count = std::thread::hardware_concurrency();
+    // Not worth starting threads for small arenas
+    if (n < 256 || thread_count < 2)
+    {
+        for (unsigned int i = 0; i < n; i++)
+            computeDijkstra(i);
+        return;
+    }
+
+    std::atomic<unsigned int> next_source(0);
+    auto compute = [this, n, &next_source]()
+        {
+            for (unsigned int i = next_source++; i < n; i = next_source++)
+                computeDijkstra(i);
+        };
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < thread_count; i++)
+        threads.emplace_back(compute);
+    compute();
+    for (std::thread& t : threads)
+        t.join();
+}   // computeAllDijkstra
+
 // ----------------------------------------------------------------------------
 /** THIS FUNCTION IS ONLY USED FOR UNIT-TESTING, to verify that the new
  *  Dijkstra algorithm gives the same results.
@@ -277,6 +356,7 @@ void ArenaGraph::computeDijkstra(int source)
 void ArenaGraph::computeFloydWarshall()
 {
     unsigned int n = getNumNodes();
+    std::vector<float>& d = m_distance_matrix;
 
     for (unsigned int k = 0; k < n; k++)
     {
@@ -284,12 +364,10 @@ void ArenaGraph::computeFloydWarshall()
         {
             for (unsigned int j = 0; j < n; j++)
             {
-                if ((m_distance_matrix[i][k] + m_distance_matrix[k][j]) <
-                    m_distance_matrix[i][j])
+                if ((d[i * n + k] + d[k * n + j]) < d[i * n + j])
                 {
-                    m_distance_matrix[i][j] =
-                        m_distance_matrix[i][k] + m_distance_matrix[k][j];
-                    m_parent_node[i][j] = m_parent_node[k][j];
+                    d[i * n + j] = d[i * n + k] + d[k * n + j];
+                    m_parent_node[i * n + j] = m_parent_node[k * n + j];
                 }
             }
         }
@@ -297,6 +375,183 @@ void ArenaGraph::computeFloydWarshall()
 
 }   // computeFloydWarshall
 
+// ----------------------------------------------------------------------------
+/** Returns a checksum of everything the shortest paths depend on (node
+ *  centers and adjacency), used to check if the path cache is up to date.
+ */
+uint64_t ArenaGraph::getNavmeshChecksum() const
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&hash](const void* data, size_t size)
+        {
+            const uint8_t* p = (const uint8_t*)data;
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= p[i];
+                hash *= 1099511628211ULL;
+            }
+        };
+    const unsigned int n = getNumNodes();
+    add(&n, sizeof(n));
+    for (unsigned int i = 0; i < n; i++)
+    {
+        ArenaNode* node = getNode(i);
+        const Vec3& center = node->getCenter();
+        float xyz[3] = { center.x(), center.y(), center.z() };
+        add(xyz, sizeof(xyz));
+        const std::vector<int>& adjacents = node->getAdjacentNodes();
+        unsigned int count = (unsigned int)adjacents.size();
+        add(&count, sizeof(count));
+        if (count > 0)
+            add(adjacents.data(), count * sizeof(int));
+    }
+    return hash;
+}   // getNavmeshChecksum
+
+// ----------------------------------------------------------------------------
+/** Returns the path cache file of a navmesh. For addons it's saved next to
+ *  the navmesh (so it's removed with the addon), for other tracks (whose
+ *  directory may not be writable) in the cache directory.
+ */
+std::string ArenaGraph::getPathCacheFile(const std::string &navmesh,
+                                         uint64_t checksum) const
+{
+    const std::string& addons_dir = file_manager->getAddonsDir();
+    if (!addons_dir.empty() && navmesh.compare(0, addons_dir.size(),
+        addons_dir) == 0)
+        return StringUtils::removeExtension(navmesh) + ".paths";
+    char name[64];
+    snprintf(name, sizeof(name), "navmesh-%016llx.paths",
+        (unsigned long long)checksum);
+    return file_manager->getCacheDir() + name;
+}   // getPathCacheFile
+
+// ----------------------------------------------------------------------------
+/** Maps the path cache file (or reads it if mapping is not supported).
+ *  \return False if the file doesn't exist or doesn't match the navmesh.
+ */
+bool ArenaGraph::loadPathCache(const std::string &path, uint64_t checksum)
+{
+    const size_t n = getNumNodes();
+    const size_t expected_size = sizeof(PathCacheHeader) +
+        n * n * (sizeof(float) + sizeof(int16_t));
+    PathCacheHeader header;
+#ifdef WIN32
+    FILE* fp = FileUtils::fopenU8Path(path, "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    bool loaded = size == (long)expected_size &&
+        fread(&header, sizeof(header), 1, fp) == 1 &&
+        header.m_magic == PATH_CACHE_MAGIC &&
+        header.m_version == PATH_CACHE_VERSION &&
+        header.m_node_count == n && header.m_checksum == checksum;
+    if (loaded)
+    {
+        m_distance_matrix.resize(n * n);
+        m_parent_node.resize(n * n);
+        loaded = fread(m_distance_matrix.data(), n * n * sizeof(float), 1,
+            fp) == 1 && fread(m_parent_node.data(), n * n * sizeof(int16_t),
+            1, fp) == 1;
+    }
+    fclose(fp);
+    if (!loaded)
+    {
+        m_distance_matrix.clear();
+        m_parent_node.clear();
+        return false;
+    }
+    m_distance = m_distance_matrix.data();
+    m_parent = m_parent_node.data();
+#else
+    int fd = open(FileUtils::getPortableWritingPath(path).c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != expected_size)
+    {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, expected_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.m_magic != PATH_CACHE_MAGIC ||
+        header.m_version != PATH_CACHE_VERSION ||
+        header.m_node_count != n || header.m_checksum != checksum)
+    {
+        munmap(data, expected_size);
+        return false;
+    }
+    m_mapped_data = (const uint8_t*)data;
+    m_mapped_size = expected_size;
+    m_distance = (const float*)(m_mapped_data + sizeof(PathCacheHeader));
+    m_parent = (const int16_t*)(m_mapped_data + sizeof(PathCacheHeader) +
+        n * n * sizeof(float));
+#endif
+    Log::info("ArenaGraph", "Loaded shortest paths from %s.", path.c_str());
+    return true;
+}   // loadPathCache
+
+// ----------------------------------------------------------------------------
+/** Saves the computed shortest paths, written to a temporary file first so
+ *  other processes never map a partial file.
+ */
+bool ArenaGraph::savePathCache(const std::string &path,
+                               uint64_t checksum) const
+{
+    const size_t n = getNumNodes();
+    PathCacheHeader header;
+    header.m_magic = PATH_CACHE_MAGIC;
+    header.m_version = PATH_CACHE_VERSION;
+    header.m_node_count = (uint32_t)n;
+    header.m_padding = 0;
+    header.m_checksum = checksum;
+
+    std::string tmp_path = path + ".tmp" +
+        StringUtils::toString(StkTime::getMonoTimeMs());
+    FILE* fp = FileUtils::fopenU8Path(tmp_path, "wb");
+    if (!fp)
+    {
+        Log::warn("ArenaGraph", "Cannot write %s.", tmp_path.c_str());
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        fwrite(m_distance_matrix.data(), n * n * sizeof(float), 1, fp) == 1 &&
+        fwrite(m_parent_node.data(), n * n * sizeof(int16_t), 1, fp) == 1;
+    written = fclose(fp) == 0 && written;
+    if (written && FileUtils::renameU8Path(tmp_path, path) != 0)
+    {
+        // Windows doesn't replace existing file when renaming
+        remove(FileUtils::getPortableWritingPath(path).c_str());
+        written = FileUtils::renameU8Path(tmp_path, path) == 0;
+    }
+    if (!written)
+    {
+        Log::warn("ArenaGraph", "Cannot write %s.", path.c_str());
+        remove(FileUtils::getPortableWritingPath(tmp_path).c_str());
+    }
+    return written;
+}   // savePathCache
+
+// ----------------------------------------------------------------------------
+void ArenaGraph::unmapPathCache()
+{
+#ifndef WIN32
+    if (m_mapped_data)
+        munmap((void*)m_mapped_data, m_mapped_size);
+#endif
+    m_mapped_data = NULL;
+    m_mapped_size = 0;
+    m_distance = m_distance_matrix.data();
+    m_parent = m_parent_node.data();
+}   // unmapPathCache
+
 // -----------------------------------------------------------------------------
 void ArenaGraph::loadGoalNodes(const XMLNode *node)
 {
@@ -349,7 +604,8 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
         // Get the distance to all nodes at i
         ArenaNode* cur_node = getNode(i);
         std::vector<int> nearby_nodes;
-        std::vector<float> dist = m_distance_matrix[i];
+        std::vector<float> dist(m_distance + (size_t)i * getNumNodes(),
+            m_distance + (size_t)(i + 1) * getNumNodes());
 
         // Skip the same node
         dist[i] = 999999.0f;
@@ -371,13 +627,14 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
  *  std::vector (in reverse order). Used only for unit testing.
  */
 std::vector<int16_t> ArenaGraph::getPathFromTo(int from, int to,
-                      const std::vector< std::vector< int16_t > >& parent_node)
+                                        const std::vector<int16_t>& parent_node,
+                                        unsigned int n)
 {
     std::vector<int16_t> path;
     path.push_back(to);
     while(from!=to)
     {
-        to = parent_node[from][to];
+        to = parent_node[from * n + to];
         path.push_back(to);
     }
     return path;
@@ -400,9 +657,11 @@ void ArenaGraph::unitTesting()
     double e = StkTime::getRealTime();
     Log::error("Time", "Dijkstra       %lf", e-s);
 
-    // Save the Dijkstra results
-    std::vector< std::vector< float > > distance_matrix = ag->m_distance_matrix;
-    std::vector< std::vector< int16_t > > parent_node = ag->m_parent_node;
+    // Save the Dijkstra results (which may come from the path cache)
+    const unsigned int n = ag->getNumNodes();
+    std::vector<float> distance_matrix(ag->m_distance,
+                                       ag->m_distance + n * n);
+    std::vector<int16_t> parent_node(ag->m_parent, ag->m_parent + n * n);
     ag->buildGraph();
 
     // Now compute results with Floyd-Warshall
@@ -412,15 +671,16 @@ void ArenaGraph::unitTesting()
     Log::error("Time", "Floyd-Warshall %lf", e-s);
 
     int error_count = 0;
-    for(unsigned int i=0; i<ag->m_distance_matrix.size(); i++)
+    for(unsigned int i=0; i<n; i++)
     {
-        for(unsigned int j=0; j<ag->m_distance_matrix[i].size(); j++)
+        for(unsigned int j=0; j<n; j++)
         {
-            if(ag->m_distance_matrix[i][j] - distance_matrix[i][j] > 0.001f)
+            if(ag->m_distance_matrix[i*n+j] - distance_matrix[i*n+j] > 0.001f)
             {
                 Log::error("ArenaGraph",
                            "Incorrect distance %d, %d: Dijkstra: %f F.W.: %f",
-                           i, j, distance_matrix[i][j], ag->m_distance_matrix[i][j]);
+                           i, j, distance_matrix[i*n+j],
+                           ag->m_distance_matrix[i*n+j]);
                 error_count++;
             }    // if distance is too different
 
@@ -432,16 +692,19 @@ void ArenaGraph::unitTesting()
             // debugging in the feature
 #undef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
 #ifdef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
-            if(ag->m_parent_node[i][j] != parent_node[i][j])
+            if(ag->m_parent_node[i*n+j] != parent_node[i*n+j])
             {
                 error_count++;
-                std::vector<int16_t> dijkstra_path = getPathFromTo(i, j, parent_node);
-                std::vector<int16_t> floyd_path = getPathFromTo(i, j, ag->m_parent_node);
+                std::vector<int16_t> dijkstra_path =
+                    getPathFromTo(i, j, parent_node, n);
+                std::vector<int16_t> floyd_path =
+                    getPathFromTo(i, j, ag->m_parent_node, n);
                 if(dijkstra_path.size()!=floyd_path.size())
                 {
                     Log::error("ArenaGraph",
                                "Incorrect path length %d, %d: Dijkstra: %d F.W.: %d",
-                               i, j, parent_node[i][j], ag->m_parent_node[i][j]);
+                               i, j, parent_node[i*n+j],
+                               ag->m_parent_node[i*n+j]);
                     continue;
                 }
                 Log::error("ArenaGraph", "Path problems from %d to %d:",
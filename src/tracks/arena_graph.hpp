@@ -22,6 +22,8 @@
 #include "tracks/graph.hpp"
 #include "utils/cpp2011.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <set>
 
 class ArenaNode;
@@ -34,11 +36,23 @@ class XMLNode;
 class ArenaGraph : public Graph
 {
 private:
-    /** The actual graph data structure, it is an adjacency matrix. */
-    std::vector<std::vector<float>> m_distance_matrix;
+    /** The actual graph data structure, it is an adjacency matrix stored
+     *  row by row (m_distance_matrix[i * n + j]). */
+    std::vector<float> m_distance_matrix;
 
     /** The matrix that is used to store computed shortest paths. */
-    std::vector<std::vector<int16_t>> m_parent_node;
+    std::vector<int16_t> m_parent_node;
+
+    /** The matrices used for lookup, either the vectors above or the mapped
+     *  path cache file. */
+    const float* m_distance;
+
+    const int16_t* m_parent;
+
+    /** The mapped path cache file, NULL if not used. */
+    const uint8_t* m_mapped_data;
+
+    size_t m_mapped_size;
 
     /** Used in soccer mode to colorize the goal lines in minimap. */
     std::set<int> m_red_node;
@@ -56,10 +70,24 @@ private:
     // ------------------------------------------------------------------------
     void computeDijkstra(int n);
     // ------------------------------------------------------------------------
+    void computeAllDijkstra();
+    // ------------------------------------------------------------------------
     void computeFloydWarshall();
     // ------------------------------------------------------------------------
+    uint64_t getNavmeshChecksum() const;
+    // ------------------------------------------------------------------------
+    std::string getPathCacheFile(const std::string &navmesh,
+                                 uint64_t checksum) const;
+    // ------------------------------------------------------------------------
+    bool loadPathCache(const std::string &path, uint64_t checksum);
+    // ------------------------------------------------------------------------
+    bool savePathCache(const std::string &path, uint64_t checksum) const;
+    // ------------------------------------------------------------------------
+    void unmapPathCache();
+    // ------------------------------------------------------------------------
     static std::vector<int16_t> getPathFromTo(int from, int to,
-                     const std::vector< std::vector< int16_t > >& parent_node);
+                                   const std::vector<int16_t>& parent_node,
+                                   unsigned int n);
     // ------------------------------------------------------------------------
     virtual bool hasLapLine() const OVERRIDE                  { return false; }
     // ------------------------------------------------------------------------
@@ -72,7 +100,7 @@ public:
     // ------------------------------------------------------------------------
     ArenaGraph(const std::string &navmesh, const XMLNode *node = NULL);
     // ------------------------------------------------------------------------
-    virtual ~ArenaGraph() {}
+    virtual ~ArenaGraph()                               { unmapPathCache(); }
     // ------------------------------------------------------------------------
     ArenaNode* getNode(unsigned int i) const;
     // ------------------------------------------------------------------------
@@ -84,7 +112,7 @@ public:
     {
         if (i == Graph::UNKNOWN_SECTOR || j == Graph::UNKNOWN_SECTOR)
             return Graph::UNKNOWN_SECTOR;
-        return (int)(m_parent_node[j][i]);
+        return (int)(m_parent[(size_t)j * getNumNodes() + i]);
     }
     // ------------------------------------------------------------------------
     /** Returns the distance between any two nodes */
@@ -92,7 +120,7 @@ public:
     {
         if (from == Graph::UNKNOWN_SECTOR || to == Graph::UNKNOWN_SECTOR)
             return 99999.0f;
-        return m_distance_matrix[from][to];
+        return m_distance[(size_t)from * getNumNodes() + to];
     }
 
 };   // ArenaGraph
@@ -260,6 +260,7 @@ void DriveGraph::load(const std::string &quad_file_name,
             m_lap_length = l;
     }
 
+    buildGrid();
     loadBoundingBoxNodes();
 
 }   // load
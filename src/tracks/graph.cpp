@@ -55,6 +55,9 @@ Graph::Graph()
     m_bb_min      = Vec3( 99999,  99999,  99999);
     m_bb_max      = Vec3(-99999, -99999, -99999);
     memset(m_bb_nodes, 0, 4 * sizeof(int));
+    m_grid_min_x = m_grid_min_z = 0.0f;
+    m_grid_cell_size = 1.0f;
+    m_grid_width = m_grid_height = 0;
 }  // Graph
 
 // -----------------------------------------------------------------------------
@@ -693,6 +696,37 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
                             ? (unsigned int)all_sectors->size()
                             : (unsigned int)m_all_nodes.size();
     *sector = UNKNOWN_SECTOR;
+
+    if (!all_sectors && !m_grid_cell_start.empty())
+    {
+        // Only test the quads in the grid cell of xyz. If more than one
+        // contains xyz, take the one the linear search below would find
+        // first, i.e. the first one after indx.
+        const float x = xyz.getX();
+        const float z = xyz.getZ();
+        if (x < m_grid_min_x || z < m_grid_min_z ||
+            x > m_grid_min_x + m_grid_width * m_grid_cell_size ||
+            z > m_grid_min_z + m_grid_height * m_grid_cell_size)
+            return;
+        const int n = (int)m_all_nodes.size();
+        const int first = indx < n - 1 ? indx + 1 : 0;
+        int min_order = n;
+        const int cell = getGridZ(z) * m_grid_width + getGridX(x);
+        for (unsigned int i = m_grid_cell_start[cell];
+             i < m_grid_cell_start[cell + 1]; i++)
+        {
+            const int node = m_grid_nodes[i];
+            const int order = node >= first ? node - first : node - first + n;
+            if (order < min_order &&
+                getQuad(node)->pointInside(xyz, ignore_vertical))
+            {
+                min_order = order;
+                *sector = node;
+            }
+        }
+        return;
+    }
+
     for(unsigned int i=0; i<max_count; i++)
     {
         if(all_sectors)
@@ -766,6 +800,18 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
         if(current_sector<0) current_sector += getNumNodes();
     }
 
+    if (!all_sectors && !m_grid_cell_start.empty())
+    {
+        int first_sector = current_sector + 1 == (int)getNumNodes()
+                         ? 0 : current_sector + 1;
+        int sector = findOutOfRoadSectorInGrid(xyz, first_sector,
+                                               ignore_vertical);
+        if (sector != UNKNOWN_SECTOR)
+            return sector;
+        Log::warn("Graph", "unknown sector found.");
+        return 0;
+    }
+
     int   min_sector = UNKNOWN_SECTOR;
     float min_dist_2 = 999999.0f*999999.0f;
 
@@ -821,6 +867,154 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
     return 0;
 }   // findOutOfRoadSector
 
+//-----------------------------------------------------------------------------
+/** Same result as the linear search in findOutOfRoadSector, but using the
+ *  grid: cells are visited in rings around xyz, until no quad in further
+ *  rings can be closer than the best one found. This works because the
+ *  line used in getDistance2FromPoint lies inside the quad, so its 2d
+ *  distance from xyz is at least the distance to any cell the quad is in.
+ *  \param first_sector The first sector the linear search would test,
+ *         used to choose the same quad if two have the same distance.
+ */
+int Graph::findOutOfRoadSectorInGrid(const Vec3& xyz, int first_sector,
+                                     bool ignore_vertical) const
+{
+    const int n = (int)m_all_nodes.size();
+    const int cx = getGridX(xyz.getX());
+    const int cz = getGridZ(xyz.getZ());
+    const int max_ring = std::max(m_grid_width, m_grid_height);
+
+    // Same two phases as findOutOfRoadSector: first with height condition,
+    // then without if nothing is found.
+    for (int phase = 0; phase < 2; phase++)
+    {
+        int min_sector = UNKNOWN_SECTOR;
+        int min_order = n;
+        float min_dist_2 = 999999.0f*999999.0f;
+        for (int ring = 0; ring <= max_ring; ring++)
+        {
+            // All cells of this ring are at least ring - 1 cells away
+            float ring_dist = (ring - 1) * m_grid_cell_size;
+            if (min_sector != UNKNOWN_SECTOR && ring_dist > 0.0f &&
+                ring_dist * ring_dist > min_dist_2)
+                break;
+            for (int z = cz - ring; z <= cz + ring; z++)
+            {
+                if (z < 0 || z >= m_grid_height)
+                    continue;
+                // Only the border of the ring is new
+                const bool border_row = z == cz - ring || z == cz + ring;
+                const int step = border_row ? 1 : 2 * ring;
+                for (int x = cx - ring; x <= cx + ring; x += step)
+                {
+                    if (x < 0 || x >= m_grid_width)
+                        continue;
+                    const int cell = z * m_grid_width + x;
+                    for (unsigned int i = m_grid_cell_start[cell];
+                         i < m_grid_cell_start[cell + 1]; i++)
+                    {
+                        const int node = m_grid_nodes[i];
+                        const Quad* q = getQuad(node);
+                        if (q->isIgnored())
+                            continue;
+                        float dist_2 = q->getDistance2FromPoint(xyz);
+                        int order = node >= first_sector ?
+                            node - first_sector : node - first_sector + n;
+                        if (dist_2 > min_dist_2 ||
+                            (dist_2 == min_dist_2 && order >= min_order))
+                            continue;
+                        float dist = xyz.getY() - q->getMinHeight();
+                        if (phase == 1 || (dist < 5.0f && dist > -1.0f) ||
+                            q->is3DQuad() || ignore_vertical)
+                        {
+                            min_dist_2 = dist_2;
+                            min_order = order;
+                            min_sector = node;
+                        }
+                    }
+                }
+            }
+        }
+        if (min_sector != UNKNOWN_SECTOR)
+            return min_sector;
+    }
+    return UNKNOWN_SECTOR;
+}   // findOutOfRoadSectorInGrid
+
+//-----------------------------------------------------------------------------
+/** Builds the uniform grid used by findRoadSector and findOutOfRoadSector,
+ *  it must be called after all quads are created. The cell size is chosen
+ *  so that there are about as many cells as quads.
+ */
+void Graph::buildGrid()
+{
+    m_grid_cell_start.clear();
+    m_grid_nodes.clear();
+    const unsigned int n = getNumNodes();
+    if (n == 0)
+        return;
+
+    // 2d bounding box of each quad, 3d quads use the box of pointInside
+    // which extends along the normal
+    std::vector<std::pair<Vec3, Vec3> > quad_bb(n);
+    Vec3 grid_min( 99999,  99999,  99999);
+    Vec3 grid_max(-99999, -99999, -99999);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const Quad* q = getQuad(i);
+        Vec3 bb_min = (*q)[0];
+        Vec3 bb_max = (*q)[0];
+        for (int j = 0; j < 4; j++)
+        {
+            bb_min.min((*q)[j]);
+            bb_max.max((*q)[j]);
+            if (q->is3DQuad())
+            {
+                const Vec3& normal = q->getNormal();
+                bb_min.min((*q)[j] + 5.0f * normal);
+                bb_max.max((*q)[j] + 5.0f * normal);
+                bb_min.min((*q)[j] - 1.0f * normal);
+                bb_max.max((*q)[j] - 1.0f * normal);
+            }
+        }
+        quad_bb[i] = std::make_pair(bb_min, bb_max);
+        grid_min.min(bb_min);
+        grid_max.max(bb_max);
+    }
+
+    const float width = std::max(grid_max.getX() - grid_min.getX(), 1.0f);
+    const float height = std::max(grid_max.getZ() - grid_min.getZ(), 1.0f);
+    m_grid_cell_size = std::max(sqrtf(width * height / (float)n), 1.0f);
+    m_grid_min_x = grid_min.getX();
+    m_grid_min_z = grid_min.getZ();
+    m_grid_width = (int)(width / m_grid_cell_size) + 1;
+    m_grid_height = (int)(height / m_grid_cell_size) + 1;
+
+    std::vector<std::vector<int> > cells(m_grid_width * m_grid_height);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const int x0 = getGridX(quad_bb[i].first.getX());
+        const int x1 = getGridX(quad_bb[i].second.getX());
+        const int z0 = getGridZ(quad_bb[i].first.getZ());
+        const int z1 = getGridZ(quad_bb[i].second.getZ());
+        for (int z = z0; z <= z1; z++)
+        {
+            for (int x = x0; x <= x1; x++)
+                cells[z * m_grid_width + x].push_back(i);
+        }
+    }
+
+    m_grid_cell_start.reserve(cells.size() + 1);
+    for (const std::vector<int>& cell : cells)
+    {
+        m_grid_cell_start.push_back((unsigned int)m_grid_nodes.size());
+        m_grid_nodes.insert(m_grid_nodes.end(), cell.begin(), cell.end());
+    }
+    m_grid_cell_start.push_back((unsigned int)m_grid_nodes.size());
+    Log::debug("Graph", "Grid of %dx%d cells (size %f) for %d quads.",
+        m_grid_width, m_grid_height, m_grid_cell_size, n);
+}   // buildGrid
+
 //-----------------------------------------------------------------------------
 void Graph::loadBoundingBoxNodes()
 {
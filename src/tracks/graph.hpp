@@ -24,6 +24,7 @@
 
 #include <dimension2d.h>
 
+#include <cmath>
 #include <memory>
 #include <string>
 #include <vector>
@@ -66,6 +67,8 @@ protected:
     // ------------------------------------------------------------------------
     /** Map 4 bounding box points to 4 closest graph nodes. */
     void loadBoundingBoxNodes();
+    // ------------------------------------------------------------------------
+    void buildGrid();
 
 private:
     /** The 2d bounding box, used for hashing. */
@@ -75,6 +78,17 @@ private:
     /** The 4 closest graph nodes to the bounding box. */
     int m_bb_nodes[4];
 
+    /** A uniform 2d (x, z) grid over all quads, so finding the sector of a
+     *  point only needs to test the quads near it. Each cell lists the
+     *  quads whose bounding box overlaps it, sorted by index. The quads of
+     *  cell i are m_grid_nodes[m_grid_cell_start[i]] until
+     *  m_grid_cell_start[i + 1]. */
+    std::vector<unsigned int> m_grid_cell_start;
+    std::vector<int> m_grid_nodes;
+    float m_grid_min_x, m_grid_min_z;
+    float m_grid_cell_size;
+    int m_grid_width, m_grid_height;
+
     /** The node of the graph mesh. */
     scene::ISceneNode *m_node;
 
@@ -106,6 +120,21 @@ private:
     virtual bool hasLapLine() const = 0;
     // ------------------------------------------------------------------------
     virtual void differentNodeColor(int n, video::SColor* c) const = 0;
+    // ------------------------------------------------------------------------
+    int getGridX(float x) const
+    {
+        int cx = (int)floorf((x - m_grid_min_x) / m_grid_cell_size);
+        return cx < 0 ? 0 : cx >= m_grid_width ? m_grid_width - 1 : cx;
+    }
+    // ------------------------------------------------------------------------
+    int getGridZ(float z) const
+    {
+        int cz = (int)floorf((z - m_grid_min_z) / m_grid_cell_size);
+        return cz < 0 ? 0 : cz >= m_grid_height ? m_grid_height - 1 : cz;
+    }
+    // ------------------------------------------------------------------------
+    int findOutOfRoadSectorInGrid(const Vec3& xyz, int first_sector,
+                                  bool ignore_vertical) const;
 
 public:
     static const int UNKNOWN_SECTOR;
@@ -58,10 +58,12 @@
 #include "karts/abstract_kart.hpp"
 #include "karts/kart_properties.hpp"
 #include "main_loop.hpp"
+#include "modes/benchmark.hpp"
 #include "modes/linear_world.hpp"
 #include "modes/easter_egg_hunt.hpp"
 #include "network/network_config.hpp"
 #include "network/protocols/game_protocol.hpp"
+#include "network/rewind_manager.hpp"
 #include "network/protocols/server_lobby.hpp"
 #include "physics/physical_object.hpp"
 #include "physics/physics.hpp"
@@ -112,7 +114,7 @@ bool        Track::m_dont_load_navmesh = false;
 std::atomic<Track*> Track::m_current_track[PT_COUNT];
 
 // ----------------------------------------------------------------------------
-Track::Track(const std::string &filename)
+Track::Track(const std::string &filename, const XMLNode *xml)
 {
 #ifdef DEBUG
     m_magic_number          = 0x17AC3802;
@@ -187,7 +189,7 @@ Track::Track(const std::string &filename)
     m_all_nodes.clear();
     m_static_physics_only_nodes.clear();
     m_all_cached_meshes.clear();
-    loadTrackInfo();
+    loadTrackInfo(xml);
 }   // Track
 
 //-----------------------------------------------------------------------------
@@ -516,7 +518,9 @@ void Track::cleanup()
 }   // cleanup
 
 //-----------------------------------------------------------------------------
-void Track::loadTrackInfo()
+/** Loads the information of track.xml, which is already parsed in xml if
+ *  not NULL. */
+void Track::loadTrackInfo(const XMLNode *xml)
 {
     // Default values
     m_use_fog               = false;
@@ -540,11 +544,12 @@ void Track::loadTrackInfo()
     irr_driver->setSSAORadius(1.);
     irr_driver->setSSAOK(1.5);
     irr_driver->setSSAOSigma(1.);
-    XMLNode *root           = file_manager->createXMLTree(m_filename);
+    const XMLNode *root     = xml ? xml : file_manager->createXMLTree(m_filename);
 
     if(!root || root->getName()!="track")
     {
-        delete root;
+        if (root != xml)
+            delete root;
         std::ostringstream o;
         o<<"Can't load track '"<<m_filename<<"', no track element.";
         throw std::runtime_error(o.str());
@@ -620,7 +625,8 @@ void Track::loadTrackInfo()
     // Set the correct paths
     if (m_screenshot.length() > 0)
         m_screenshot = m_root+m_screenshot;
-    delete root;
+    if (root != xml)
+        delete root;
 
     std::string dir = StringUtils::getPath(m_filename);
     std::string easter_name = dir + "/easter_eggs.xml";
@@ -1683,7 +1689,9 @@ void Track::update(int ticks)
     }
     float dt = stk_config->ticks2Time(ticks);
     m_check_manager->update(dt);
+    Benchmark::beginSection(Benchmark::BS_ITEMS);
     m_item_manager->update(ticks);
+    Benchmark::endSection(Benchmark::BS_ITEMS);
 
     // TODO: enable onUpdate scripts if we ever find a compelling use for them
     //Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
@@ -1961,7 +1969,9 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         loadArenaGraph(*root);
     main_loop->renderGUI(3340);
 
-    if (NetworkConfig::get()->isNetworking())
+    // Items need to be rewound in network games (and in benchmark mode,
+    // which saves states like a server)
+    if (RewindManager::isEnabled())
     {
         auto nim = std::make_shared<NetworkItemManager>();
         nim->rewinderAdd();
@@ -2110,6 +2120,7 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     main_loop->renderGUI(5100);
 
     Scripting::ScriptEngine::getInstance()->compileLoadedScripts();
+    Physics::get()->resolveScriptCallbacks();
     main_loop->renderGUI(5200);
 
     // Init all track objects
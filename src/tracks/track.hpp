@@ -410,7 +410,7 @@ private:
     /** The number of laps that is predefined in a track info dialog. */
     int m_actual_number_of_laps;
 
-    void loadTrackInfo();
+    void loadTrackInfo(const XMLNode *xml);
     void loadDriveGraph(unsigned int mode_id, const bool reverse);
     void loadArenaGraph(const XMLNode &node);
     btQuaternion getArenaStartRotation(const Vec3& xyz, float heading);
@@ -457,7 +457,8 @@ public:
 
     static const float NOHIT;
 
-                       Track             (const std::string &filename);
+                       Track             (const std::string &filename,
+                                          const XMLNode *xml = NULL);
                       ~Track             ();
     void               cleanup           ();
     void               removeCachedData  ();
@@ -20,6 +20,7 @@
 
 #include "config/stk_config.hpp"
 #include "graphics/irr_driver.hpp"
+#include "io/asset_scanner.hpp"
 #include "io/file_manager.hpp"
 #include "tracks/track.hpp"
 
@@ -164,25 +165,13 @@ void TrackManager::loadTrackList()
         delete track;
     m_tracks.clear();
 
-    for(unsigned int i=0; i<m_track_search_path.size(); i++)
-    {
-        const std::string &dir = m_track_search_path[i];
-
-        // First test if the directory itself contains a track:
-        // ----------------------------------------------------
-        if(loadTrack(dir)) continue;  // track found, no more tests
-
-        // Then see if a subdir of this dir contains tracks
-        // ------------------------------------------------
-        std::set<std::string> dirs;
-        file_manager->listFiles(dirs, dir);
-        for(std::set<std::string>::iterator subdir = dirs.begin();
-            subdir != dirs.end(); subdir++)
-        {
-            if(*subdir=="." || *subdir=="..") continue;
-            loadTrack(dir+*subdir+"/");
-        }   // for dir in dirs
-    }   // for i <m_track_search_path.size()
+    // Each search path contains a track or subdirectories with tracks, all
+    // track.xml are parsed in parallel first
+    AssetScanner scanner("track.xml", /*trailing_slash*/true);
+    std::vector<AssetScanner::Asset> tracks =
+        scanner.scan(m_track_search_path);
+    for (AssetScanner::Asset& track : tracks)
+        loadTrack(track.m_dir, track.m_root.get());
     updateScreenshotCache();
     onDemandLoadTrackScreenshots();
 }  // loadTrackList
@@ -191,8 +180,9 @@ void TrackManager::loadTrackList()
 /** Tries to load a track from a single directory. Returns true if a track was
  *  successfully loaded.
  *  \param dirname Name of the directory to load the track from.
+ *  \param xml The already parsed track.xml if not NULL.
  */
-bool TrackManager::loadTrack(const std::string& dirname)
+bool TrackManager::loadTrack(const std::string& dirname, const XMLNode* xml)
 {
     std::string config_file = dirname+"track.xml";
     if(!file_manager->fileExists(config_file))
@@ -202,7 +192,7 @@ bool TrackManager::loadTrack(const std::string& dirname)
 
     try
     {
-        track = new Track(config_file);
+        track = new Track(config_file, xml);
     }
     catch (std::exception& e)
     {
@@ -386,6 +386,9 @@ void TrackObject::init(const XMLNode &xml_node, scene::ISceneNode* parent,
 
 void TrackObject::onWorldReady()
 {
+    if (m_physical_object)
+        m_physical_object->resolveScriptCallbacks();
+
     if (m_visibility_condition == "false")
     {
         m_initially_visible = false;
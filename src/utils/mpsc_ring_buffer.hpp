@@ -0,0 +1,115 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_MPSC_RING_BUFFER_HPP
+#define HEADER_MPSC_RING_BUFFER_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/** A bounded lock-free queue which can be pushed to from any number of
+ *  threads and popped from by a single thread. Each slot has a sequence
+ *  number telling if it is free for the push of a given position or filled
+ *  for the pop of it, so producers only contend on the push position.
+ */
+template<typename TYPE>
+class MPSCRingBuffer : public NoCopy
+{
+private:
+    struct Slot
+    {
+        std::atomic<size_t> m_sequence;
+        TYPE m_data;
+    };
+
+    std::vector<Slot> m_slots;
+
+    const size_t m_mask;
+
+    /** Position of the next push, shared by all producers. */
+    std::atomic<size_t> m_push_pos;
+
+    /** Position of the next pop, only used by the consumer. */
+    size_t m_pop_pos;
+
+public:
+    // ------------------------------------------------------------------------
+    /** \param capacity Number of slots, must be a power of 2. */
+    MPSCRingBuffer(size_t capacity)
+        : m_slots(capacity), m_mask(capacity - 1)
+    {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (size_t i = 0; i < capacity; i++)
+            m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+        m_push_pos.store(0, std::memory_order_relaxed);
+        m_pop_pos = 0;
+    }   // MPSCRingBuffer
+    // ------------------------------------------------------------------------
+    /** Adds a value, can be called from any thread.
+     *  \return False if the buffer is full.
+     */
+    bool push(const TYPE& value)
+    {
+        size_t pos = m_push_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Slot& slot = m_slots[pos & m_mask];
+            size_t seq = slot.m_sequence.load(std::memory_order_acquire);
+            if (seq == pos)
+            {
+                if (m_push_pos.compare_exchange_weak(pos, pos + 1,
+                    std::memory_order_relaxed))
+                {
+                    slot.m_data = value;
+                    slot.m_sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+                // pos is updated by compare_exchange_weak on failure
+            }
+            else if (seq < pos)
+            {
+                // Slot not yet popped since the last round
+                return false;
+            }
+            else
+                pos = m_push_pos.load(std::memory_order_relaxed);
+        }
+    }   // push
+    // ------------------------------------------------------------------------
+    /** Removes the oldest value, must only be called by the consumer thread.
+     *  \return False if no value is available.
+     */
+    bool pop(TYPE* value)
+    {
+        Slot& slot = m_slots[m_pop_pos & m_mask];
+        if (slot.m_sequence.load(std::memory_order_acquire) != m_pop_pos + 1)
+            return false;
+        *value = slot.m_data;
+        slot.m_sequence.store(m_pop_pos + m_slots.size(),
+            std::memory_order_release);
+        m_pop_pos++;
+        return true;
+    }   // pop
+
+};   // class MPSCRingBuffer
+
+#endif
@@ -27,6 +27,7 @@
 #include "guiengine/scalable_font.hpp"
 #include "io/file_manager.hpp"
 #include "utils/file_utils.hpp"
+#include "utils/log.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/tls.hpp"
 #include "utils/vs.hpp"
@@ -79,6 +80,23 @@ Profiler profiler;
 #endif
 // --- End portable precise timer ---
 
+/** Slot of the calling thread in m_all_threads_data, -1 if it has none. */
+thread_local int g_thread_id = -1;
+/** Name set by setThreadName, used when the thread gets its slot. */
+thread_local char g_thread_name[32] = {};
+/** Number of recorded markers of the calling thread not popped yet. */
+thread_local unsigned g_open_markers = 0;
+/** Number of markers of the calling thread which were dropped (because the
+ *  ring buffer was full) and not popped yet, markers nested in them are
+ *  dropped too. */
+thread_local unsigned g_dropped_markers = 0;
+const int MAX_THREADS = 10;
+/** Threads started after all other slots are used share the last one. */
+const int SHARED_THREAD_ID = MAX_THREADS - 1;
+/** Size of the marker event buffer of each thread, i.e. the number of
+ *  pushes and pops that can be recorded between two synchronizeFrame. */
+const unsigned MAX_MARKER_EVENTS = 4096;
+
 //-----------------------------------------------------------------------------
 Profiler::Profiler()
 {
@@ -93,79 +111,181 @@ Profiler::Profiler()
     m_current_frame       = 0;
     m_has_wrapped_around  = false;
     m_threads_used = 1;
+    m_tracing             = false;
+    m_trace_file          = NULL;
+    m_trace_start_time    = 0.0;
+    m_trace_first_event   = true;
+
+    // The marker buffers of a thread are only allocated when it records
+    // its first marker
+    for (int i = 0; i < MAX_THREADS; i++)
+        m_all_threads_data.emplace_back(new ThreadData());
+    // The profiler is constructed in the main thread
+    g_thread_id = 0;
+    m_all_threads_data[0]->m_name = "main";
+    m_all_threads_data[SHARED_THREAD_ID]->m_name = "other threads";
 }   // Profile
 
 //-----------------------------------------------------------------------------
 Profiler::~Profiler()
 {
+    if (m_trace_file)
+    {
+        fprintf(m_trace_file, "\n]\n");
+        fclose(m_trace_file);
+    }
 }   // ~Profiler
 
-thread_local int g_thread_id = -1;
-const int MAX_THREADS = 10;
 //-----------------------------------------------------------------------------
 /** It is split from the constructor so that it can be avoided allocating
- *  unnecessary memory when the profiler is never used (for example in no
- *  graphics). */
+ *  unnecessary memory when the profiler is never displayed (for example in
+ *  no graphics). */
 void Profiler::init()
 {
-    m_all_threads_data.resize(MAX_THREADS);
-
     // Add this thread to the thread mapping
     g_thread_id = 0;
     m_gpu_times.resize(Q_LAST * m_max_frames);
 }   // init
 
 //-----------------------------------------------------------------------------
-/** Returns a unique index for a thread. If the calling thread is not yet in
- *  the mapping, it will assign a new unique id to this thread. */
+/** Returns the slot of the calling thread. A thread gets its own slot when
+ *  it records its first marker, so threads which never record one don't
+ *  use a slot. When all slots are used, the thread shares the last slot with
+ *  the other threads which came too late, which is then written with
+ *  m_shared_thread_mutex held. */
 int Profiler::getThreadID()
 {
     if (g_thread_id == -1)
     {
-        if (m_threads_used >= MAX_THREADS)
+        m_lock.lock();
+        if (m_threads_used < SHARED_THREAD_ID)
         {
-            g_thread_id = MAX_THREADS - 1;
-            return g_thread_id;
+            g_thread_id = m_threads_used.fetch_add(1);
+            ThreadData& td = *m_all_threads_data[g_thread_id];
+            td.m_name = g_thread_name;
+            td.m_trace_named = false;
         }
-        g_thread_id = m_threads_used.fetch_add(1);
+        else
+        {
+            g_thread_id = SHARED_THREAD_ID;
+            m_threads_used = MAX_THREADS;
+        }
+        m_lock.unlock();
     }
     return g_thread_id;
 }   // getThreadID
 
+//-----------------------------------------------------------------------------
+int Profiler::getNumThreads() const
+{
+    return std::min(m_threads_used.load(), MAX_THREADS);
+}   // getNumThreads
+
+//-----------------------------------------------------------------------------
+/** Returns if markers are recorded, i.e. if the profiler is enabled and not
+ *  frozen, or a trace is being written. */
+bool Profiler::isRecording() const
+{
+    if (m_tracing.load(std::memory_order_relaxed))
+        return true;
+    return UserConfigParams::m_profiler_enabled &&
+           m_freeze_state != FROZEN && m_freeze_state != WAITING_FOR_UNFREEZE;
+}   // isRecording
+
+//-----------------------------------------------------------------------------
+/** Adds a marker event to the ring buffer, called only by the thread owning
+ *  it (or with m_shared_thread_mutex held for the shared slot). Returns false
+ *  if the buffer is full.
+ *  \param reserved Number of events which must still fit in the buffer
+ *         after this one.
+ */
+bool Profiler::ThreadData::addMarkerEvent(int event_id, double time,
+                                          unsigned reserved)
+{
+    // Allocated before the first event is published, so the reader only
+    // accesses the buffer after it's allocated
+    if (m_marker_events.empty())
+        m_marker_events.resize(MAX_MARKER_EVENTS);
+    unsigned written = m_events_written.load(std::memory_order_relaxed);
+    unsigned read = m_events_read.load(std::memory_order_acquire);
+    if (written - read + reserved >= m_marker_events.size())
+        return false;
+    MarkerEvent& me = m_marker_events[written % m_marker_events.size()];
+    me.m_event_id = event_id;
+    me.m_time = time;
+    m_events_written.store(written + 1, std::memory_order_release);
+    return true;
+}   // addMarkerEvent
+
+//-----------------------------------------------------------------------------
+/** Returns the id of an event name, adding it if it's new. The first colour
+ *  used for a name is kept.
+ */
+int Profiler::getEventID(const char* name, const video::SColor& colour)
+{
+    std::lock_guard<std::mutex> lock(m_event_info_mutex);
+    auto it = m_event_ids.find(name);
+    if (it != m_event_ids.end())
+        return it->second;
+    int id = (int)m_all_event_info.size();
+    m_all_event_info.push_back({ name, colour });
+    m_event_ids[name] = id;
+    return id;
+}   // getEventID
+
 //-----------------------------------------------------------------------------
 /// Push a new marker that starts now
-void Profiler::pushCPUMarker(const char* name, const video::SColor& colour)
+void Profiler::pushCPUMarker(int event_id)
 {
     // Don't do anything when disabled or frozen
-    if (!UserConfigParams::m_profiler_enabled ||
-         m_freeze_state == FROZEN || m_freeze_state == WAITING_FOR_UNFREEZE )
+    if (!isRecording())
         return;
 
-    // We need to look before getting the thread id (since this might
-    // be a new thread which changes the structure).
-    m_lock.lock();
-    int thread_id = getThreadID();
+    // Markers nested in a dropped marker are dropped too
+    if (g_dropped_markers > 0)
+    {
+        g_dropped_markers++;
+        return;
+    }
 
-    ThreadData &td = m_all_threads_data[thread_id];
-    AllEventData::iterator i = td.m_all_event_data.find(name);
-    double  start = getTimeMilliseconds() - m_time_last_sync;
-    if (i != td.m_all_event_data.end())
+    int thread_id = getThreadID();
+    ThreadData &td = *m_all_threads_data[thread_id];
+    std::unique_lock<std::mutex> shared_lock(m_shared_thread_mutex,
+                                             std::defer_lock);
+    if (thread_id == SHARED_THREAD_ID)
+        shared_lock.lock();
+    // Only recorded if the pops of this marker and all open ones still fit
+    // afterwards, so a recorded marker is always closed
+    if (td.addMarkerEvent(event_id, getTimeMilliseconds(),
+                          td.m_open_markers + 1))
     {
-        i->second.setStart(m_current_frame, start, (int)td.m_event_stack.size());
+        td.m_open_markers++;
+        g_open_markers++;
     }
     else
+        g_dropped_markers++;
+}   // pushCPUMarker
+
+//-----------------------------------------------------------------------------
+/// Push a new marker that starts now, with a name that is not constant
+void Profiler::pushCPUMarker(const char* name, const video::SColor& colour)
+{
+    if (!isRecording())
+        return;
+
+    int thread_id = getThreadID();
+    if (thread_id == SHARED_THREAD_ID)
     {
-        EventData ed(colour, m_max_frames);
-        ed.setStart(m_current_frame, start, (int)td.m_event_stack.size());
-        td.m_all_event_data[name] = ed;
-        // Ordered headings is used to determine the order in which the
-        // bar graph is drawn. Outer profiling events will be added first,
-        // so they will be drawn first, which gives the proper nested
-        // displayed of events.
-        td.m_ordered_headings.push_back(name);
+        pushCPUMarker(getEventID(name, colour));
+        return;
     }
-    td.m_event_stack.push_back(name);
-    m_lock.unlock();
+    // Names are only interned once per thread
+    std::map<std::string, int>& event_ids =
+        m_all_threads_data[thread_id]->m_dynamic_event_ids;
+    auto it = event_ids.find(name);
+    if (it == event_ids.end())
+        it = event_ids.emplace(name, getEventID(name, colour)).first;
+    pushCPUMarker(it->second);
 }   // pushCPUMarker
 
 //-----------------------------------------------------------------------------
@@ -173,32 +293,94 @@ void Profiler::pushCPUMarker(const char* name, const video::SColor& colour)
 void Profiler::popCPUMarker()
 {
     // Don't do anything when disabled or frozen
-    if( !UserConfigParams::m_profiler_enabled ||
-        m_freeze_state == FROZEN || m_freeze_state == WAITING_FOR_UNFREEZE )
+    if (!isRecording())
         return;
     double now = getTimeMilliseconds();
 
-    m_lock.lock();
-    int thread_id = getThreadID();
-    ThreadData &td = m_all_threads_data[thread_id];
-
+    if (g_dropped_markers > 0)
+    {
+        g_dropped_markers--;
+        return;
+    }
     // When the profiler gets enabled (which happens in the middle of the
     // main loop), there can be some pops without matching pushes (for one
     // frame) - ignore those events.
-    if (td.m_event_stack.size() == 0)
-    {
-        m_lock.unlock();
+    if (g_open_markers == 0)
         return;
-    }
+    g_open_markers--;
 
-    assert(td.m_event_stack.size() > 0);
+    int thread_id = getThreadID();
+    ThreadData &td = *m_all_threads_data[thread_id];
+    std::unique_lock<std::mutex> shared_lock(m_shared_thread_mutex,
+                                             std::defer_lock);
+    if (thread_id == SHARED_THREAD_ID)
+        shared_lock.lock();
+    // Space was reserved when it was pushed
+    td.m_open_markers--;
+    td.addMarkerEvent(-1, now, 0);
+}   // popCPUMarker
 
-    const std::string &name = td.m_event_stack.back();
-    td.m_all_event_data[name].setEnd(m_current_frame, now - m_time_last_sync);
+//-----------------------------------------------------------------------------
+/** Adds the markers pushed and popped by a thread (until now) to the
+ *  current frame. Called with m_lock held.
+ */
+void Profiler::processMarkerEvents(ThreadData& td, int thread_id,
+                                   double now)
+{
+    unsigned read = td.m_events_read.load(std::memory_order_relaxed);
+    const unsigned written =
+        td.m_events_written.load(std::memory_order_acquire);
+    if (read == written)
+        return;
+    if (m_trace_file && !td.m_trace_named)
+        writeTraceThreadName(td, thread_id);
+    const unsigned size = (unsigned)td.m_marker_events.size();
+    for (; read != written; read++)
+    {
+        const MarkerEvent& me = td.m_marker_events[read % size];
+        // Added after this sync started, keep it for the next frame
+        if (me.m_time > now)
+            break;
+        double time = me.m_time - m_time_last_sync;
+        if (me.m_event_id == -1)
+        {
+            if (td.m_event_stack.empty())
+                continue;
+            if (m_trace_file)
+            {
+                writeTraceEvent('E', td.m_event_stack.back(), thread_id,
+                                me.m_time);
+            }
+            td.m_all_event_data[td.m_event_stack.back()]
+                .setEnd(m_current_frame, time);
+            td.m_event_stack.pop_back();
+            continue;
+        }
 
-    td.m_event_stack.pop_back();
-    m_lock.unlock();
-}   // popCPUMarker
+        AllEventData::iterator i = td.m_all_event_data.find(me.m_event_id);
+        if (i == td.m_all_event_data.end())
+        {
+            video::SColor colour;
+            {
+                std::lock_guard<std::mutex> lock(m_event_info_mutex);
+                colour = m_all_event_info[me.m_event_id].m_colour;
+            }
+            i = td.m_all_event_data.emplace(me.m_event_id,
+                EventData(colour, m_max_frames)).first;
+            // Ordered headings is used to determine the order in which the
+            // bar graph is drawn. Outer profiling events will be added first,
+            // so they will be drawn first, which gives the proper nested
+            // displayed of events.
+            td.m_ordered_headings.push_back(me.m_event_id);
+        }
+        i->second.setStart(m_current_frame, time,
+            (int)td.m_event_stack.size());
+        td.m_event_stack.push_back(me.m_event_id);
+        if (m_trace_file)
+            writeTraceEvent('B', me.m_event_id, thread_id, me.m_time);
+    }
+    td.m_events_read.store(read, std::memory_order_release);
+}   // processMarkerEvents
 
 //-----------------------------------------------------------------------------
 /** Switches the profiler either on or off.
@@ -223,8 +405,11 @@ void Profiler::toggleStatus()
  */
 void Profiler::synchronizeFrame()
 {
-    // Don't do anything when frozen
-    if(!UserConfigParams::m_profiler_enabled || m_freeze_state == FROZEN)
+    // Don't do anything when frozen, unless a trace is being written (the
+    // display then keeps being updated)
+    bool tracing = m_tracing.load();
+    if (!tracing && m_trace_file == NULL &&
+        (!UserConfigParams::m_profiler_enabled || m_freeze_state == FROZEN))
         return;
 
     // Avoid using several times getTimeMilliseconds(),
@@ -232,6 +417,24 @@ void Profiler::synchronizeFrame()
     double now = getTimeMilliseconds();
 
     m_lock.lock();
+    if (tracing && m_trace_file == NULL)
+        openTrace();
+    // Add the markers recorded by all threads in this frame. When the
+    // profiler is unfrozen, drop the ones left from before it was frozen.
+    for (int i = 0; i < getNumThreads(); i++)
+    {
+        ThreadData &td = *m_all_threads_data[i];
+        if (m_freeze_state == WAITING_FOR_UNFREEZE && !tracing)
+        {
+            td.m_events_read.store(td.m_events_written.load(
+                std::memory_order_acquire), std::memory_order_release);
+        }
+        else
+            processMarkerEvents(td, i, now);
+    }
+    if (!tracing && m_trace_file)
+        closeTrace(now);
+
     // Set index to next frame
     int next_frame = m_current_frame+1;
     if (next_frame >= m_max_frames)
@@ -244,9 +447,9 @@ void Profiler::synchronizeFrame()
     // a new start marker for the next frame. So e.g. if a thread is busy in
     // one event while the main thread syncs the frame, this event will get
     // split into two parts in two consecutive frames
-    for (int i = 0; i < m_threads_used; i++)
+    for (int i = 0; i < getNumThreads(); i++)
     {
-        ThreadData &td = m_all_threads_data[i];
+        ThreadData &td = *m_all_threads_data[i];
         for(unsigned int j=0; j<td.m_event_stack.size(); j++)
         {
             EventData &ed = td.m_all_event_data[td.m_event_stack[j]];
@@ -260,9 +463,9 @@ void Profiler::synchronizeFrame()
         // The new entries for the circular buffer need to be cleared
         // to make sure the new values are not accumulated on top of
         // the data from a previous frame.
-        for (int i = 0; i < m_threads_used; i++)
+        for (int i = 0; i < getNumThreads(); i++)
         {
-            ThreadData &td = m_all_threads_data[i];
+            ThreadData &td = *m_all_threads_data[i];
             AllEventData &aed = td.m_all_event_data;
             AllEventData::iterator k;
             for (k = aed.begin(); k != aed.end(); ++k)
@@ -322,7 +525,7 @@ void Profiler::draw()
     // threads might have 'unfinished' events, or multiple identical events
     // in this frame (i.e. start time would be incorrect).
     int thread_id = getThreadID();
-    AllEventData &aed = m_all_threads_data[thread_id].m_all_event_data;
+    AllEventData &aed = m_all_threads_data[thread_id]->m_all_event_data;
     AllEventData::iterator j;
     for (j = aed.begin(); j != aed.end(); ++j)
     {
@@ -339,9 +542,9 @@ void Profiler::draw()
     core::vector2di mouse_pos = GUIEngine::EventHandler::get()->getMousePos();
 
     std::stack<AllEventData::iterator> hovered_markers;
-    for (int i = 0; i < m_threads_used; i++)
+    for (int i = 0; i < getNumThreads(); i++)
     {
-        ThreadData &td = m_all_threads_data[i];
+        ThreadData &td = *m_all_threads_data[i];
         AllEventData &aed = td.m_all_event_data;
 
         // Thread 1 has 'proper' start and end events (assuming that each
@@ -381,7 +584,7 @@ void Profiler::draw()
     // GPU profiler
     QueryPerf hovered_gpu_marker = Q_LAST;
     long hovered_gpu_marker_elapsed = 0;
-    int gpu_y = int(y_offset + m_threads_used*line_height + line_height/2);
+    int gpu_y = int(y_offset + getNumThreads()*line_height + line_height/2);
     float total = 0;
     for (unsigned i = 0; i < Q_LAST; i++)
     {
@@ -432,7 +635,7 @@ void Profiler::draw()
     {
         s32 x_sync = (s32)(x_offset + factor*m_time_between_sync);
         s32 y_up_sync = (s32)(MARGIN_Y*screen_size.Height);
-        s32 y_down_sync = (s32)( (MARGIN_Y + (2+m_threads_used)*LINE_HEIGHT)
+        s32 y_down_sync = (s32)( (MARGIN_Y + (2+getNumThreads())*LINE_HEIGHT)
                                 * screen_size.Height                         );
 
         GL32_draw2DRectangle(video::SColor(0xFF, 0x00, 0x00, 0x00),
@@ -451,7 +654,11 @@ void Profiler::draw()
             const Marker &marker = j->second.getMarker(indx);
             std::ostringstream oss;
             oss.precision(4);
-            oss << j->first << " [" << (marker.getDuration()) << " ms / ";
+            {
+                std::lock_guard<std::mutex> lock(m_event_info_mutex);
+                oss << m_all_event_info[j->first].m_name;
+            }
+            oss << " [" << (marker.getDuration()) << " ms / ";
             oss.precision(3);
             oss << marker.getDuration()*100.0 / duration << "%]" << std::endl;
             text += oss.str().c_str();
@@ -537,14 +744,19 @@ void Profiler::writeToFile()
     std::string base_name =
                file_manager->getUserConfigFile(file_manager->getStdoutName());
     // First CPU data
-    for (int thread_id = 0; thread_id < m_threads_used; thread_id++)
+    for (int thread_id = 0; thread_id < getNumThreads(); thread_id++)
     {
         std::ofstream f(FileUtils::getPortableWritingPath(
             base_name + ".profile-cpu-" + StringUtils::toString(thread_id)));
-        ThreadData &td = m_all_threads_data[thread_id];
+        ThreadData &td = *m_all_threads_data[thread_id];
         f << "#  ";
+        m_event_info_mutex.lock();
         for (unsigned int i = 0; i < td.m_ordered_headings.size(); i++)
-            f << "\"" << td.m_ordered_headings[i] << "(" << i+1 <<")\"   ";
+        {
+            f << "\"" << m_all_event_info[td.m_ordered_headings[i]].m_name
+              << "(" << i+1 <<")\"   ";
+        }
+        m_event_info_mutex.unlock();
         f << std::endl;
         int start = m_has_wrapped_around ? m_current_frame + 1 : 0;
         if (start > m_max_frames) start -= m_max_frames;
@@ -585,3 +797,166 @@ void Profiler::writeToFile()
     m_lock.unlock();
 
 }   // writeFile
+
+//-----------------------------------------------------------------------------
+/** Sets the name of the calling thread, which is shown in traces. It's only
+ *  used once the thread records its first marker, see getThreadID.
+ */
+void Profiler::setThreadName(const char* name)
+{
+    strncpy(g_thread_name, name, sizeof(g_thread_name) - 1);
+    // Threads sharing the last slot keep its name
+    if (g_thread_id < 0 || g_thread_id == SHARED_THREAD_ID)
+        return;
+    m_lock.lock();
+    ThreadData& td = *m_all_threads_data[g_thread_id];
+    td.m_name = g_thread_name;
+    td.m_trace_named = false;
+    m_lock.unlock();
+}   // setThreadName
+
+//-----------------------------------------------------------------------------
+/** Starts writing the markers of all threads to a file in the Chrome trace
+ *  event format (which can be opened in chrome://tracing or Perfetto). The
+ *  file is opened at the next synchronizeFrame, the profiler doesn't need
+ *  to be enabled. Can be called from any thread.
+ *  \return False if a trace is already being written.
+ */
+bool Profiler::startTrace(const std::string& path)
+{
+    m_lock.lock();
+    if (m_tracing || m_trace_file)
+    {
+        m_lock.unlock();
+        return false;
+    }
+    m_trace_path = path;
+    m_trace_start_time = getTimeMilliseconds();
+    m_tracing = true;
+    m_lock.unlock();
+    return true;
+}   // startTrace
+
+//-----------------------------------------------------------------------------
+/** Stops the trace, the file is closed at the next synchronizeFrame. Can be
+ *  called from any thread.
+ *  \return False if no trace was being written.
+ */
+bool Profiler::stopTrace()
+{
+    m_lock.lock();
+    bool tracing = m_tracing;
+    m_tracing = false;
+    m_lock.unlock();
+    return tracing;
+}   // stopTrace
+
+//-----------------------------------------------------------------------------
+/** Writes a string with JSON escaping. */
+static void writeJSONString(FILE* f, const std::string& s)
+{
+    fputc('"', f);
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            fputc('\\', f);
+        if ((unsigned char)c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}   // writeJSONString
+
+//-----------------------------------------------------------------------------
+/** Opens the trace file and begins the events which are currently in
+ *  progress. Called in synchronizeFrame with m_lock held.
+ */
+void Profiler::openTrace()
+{
+    m_trace_file = FileUtils::fopenU8Path(m_trace_path, "wb");
+    if (!m_trace_file)
+    {
+        Log::error("Profiler", "Can't open trace file '%s'.",
+            m_trace_path.c_str());
+        m_tracing = false;
+        return;
+    }
+    Log::info("Profiler", "Writing trace to '%s'.", m_trace_path.c_str());
+    fprintf(m_trace_file, "[\n");
+    m_trace_first_event = true;
+    for (int i = 0; i < getNumThreads(); i++)
+    {
+        ThreadData &td = *m_all_threads_data[i];
+        td.m_trace_named = false;
+        // The stacks are only up to date if the profiler was collecting
+        // frames until now
+        if (!UserConfigParams::m_profiler_enabled)
+        {
+            td.m_event_stack.clear();
+            continue;
+        }
+        if (td.m_event_stack.empty())
+            continue;
+        writeTraceThreadName(td, i);
+        for (int event_id : td.m_event_stack)
+            writeTraceEvent('B', event_id, i, m_trace_start_time);
+    }
+}   // openTrace
+
+//-----------------------------------------------------------------------------
+/** Ends the events which are in progress and closes the trace file. Called
+ *  in synchronizeFrame with m_lock held.
+ */
+void Profiler::closeTrace(double now)
+{
+    for (int i = 0; i < getNumThreads(); i++)
+    {
+        ThreadData &td = *m_all_threads_data[i];
+        for (int j = (int)td.m_event_stack.size() - 1; j >= 0; j--)
+            writeTraceEvent('E', td.m_event_stack[j], i, now);
+        if (!UserConfigParams::m_profiler_enabled)
+            td.m_event_stack.clear();
+    }
+    fprintf(m_trace_file, "\n]\n");
+    fclose(m_trace_file);
+    m_trace_file = NULL;
+    Log::info("Profiler", "Trace '%s' written.", m_trace_path.c_str());
+}   // closeTrace
+
+//-----------------------------------------------------------------------------
+/** Writes the begin ('B') or end ('E') of an event to the trace file.
+ *  \param time Time of the event in ms, as returned by getTimeMilliseconds.
+ */
+void Profiler::writeTraceEvent(char phase, int event_id, int thread_id,
+                               double time)
+{
+    if (!m_trace_first_event)
+        fprintf(m_trace_file, ",\n");
+    m_trace_first_event = false;
+    fprintf(m_trace_file, "{\"name\":");
+    m_event_info_mutex.lock();
+    writeJSONString(m_trace_file, m_all_event_info[event_id].m_name);
+    m_event_info_mutex.unlock();
+    // Timestamps are in microseconds
+    fprintf(m_trace_file,
+        ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", phase,
+        std::max(time - m_trace_start_time, 0.0) * 1000.0, thread_id);
+}   // writeTraceEvent
+
+//-----------------------------------------------------------------------------
+/** Writes the metadata event naming a thread in the trace file. */
+void Profiler::writeTraceThreadName(ThreadData& td, int thread_id)
+{
+    if (!m_trace_first_event)
+        fprintf(m_trace_file, ",\n");
+    m_trace_first_event = false;
+    std::string name = td.m_name.empty() ?
+        "thread " + StringUtils::toString(thread_id) : td.m_name;
+    fprintf(m_trace_file,
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+        "\"args\":{\"name\":", thread_id);
+    writeJSONString(m_trace_file, name);
+    fprintf(m_trace_file, "}}");
+    td.m_trace_named = true;
+}   // writeTraceThreadName
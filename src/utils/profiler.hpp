@@ -22,9 +22,12 @@
 
 #include <assert.h>
 #include <atomic>
+#include <cstdio>
 #include <iostream>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <stack>
 #include <streambuf>
@@ -71,7 +74,17 @@ double getTimeMilliseconds();
 #define ENABLE_PROFILER
 
 #ifdef ENABLE_PROFILER
-    #define PROFILER_PUSH_CPU_MARKER(name, r, g, b) \
+    /** The name is only interned once per call site, so it must be a
+     *  constant string. Use PROFILER_PUSH_CPU_MARKER_DYNAMIC otherwise. */
+    #define PROFILER_PUSH_CPU_MARKER(name, r, g, b)                        \
+        do                                                                 \
+        {                                                                  \
+            static const int profiler_event_id =                           \
+                profiler.getEventID(name, video::SColor(0xFF, r, g, b));   \
+            profiler.pushCPUMarker(profiler_event_id);                     \
+        } while (0)
+
+    #define PROFILER_PUSH_CPU_MARKER_DYNAMIC(name, r, g, b) \
         profiler.pushCPUMarker(name, video::SColor(0xFF, r, g, b))
 
     #define PROFILER_POP_CPU_MARKER()  \
@@ -84,6 +97,7 @@ double getTimeMilliseconds();
         profiler.draw()
 #else
     #define PROFILER_PUSH_CPU_MARKER(name, r, g, b)
+    #define PROFILER_PUSH_CPU_MARKER_DYNAMIC(name, r, g, b)
     #define PROFILER_POP_CPU_MARKER()
     #define PROFILER_SYNC_FRAME()
     #define PROFILER_DRAW()
@@ -203,28 +217,79 @@ private:
     };   // EventData
 
     // ========================================================================
-    /** The mapping of event names to the corresponding EventData. */
-    typedef std::map<std::string, EventData> AllEventData;
+    /** The mapping of event ids to the corresponding EventData. */
+    typedef std::map<int, EventData> AllEventData;
+    // ========================================================================
+    /** A push (event id) or pop (-1) of a marker, recorded by a thread. */
+    struct MarkerEvent
+    {
+        int    m_event_id;
+        double m_time;
+    };   // MarkerEvent
     // ========================================================================
     struct ThreadData
     {
+        /** Ring buffer of marker events, written only by the thread itself
+         *  and read in synchronizeFrame, so no lock is needed (except for
+         *  the slot shared by the threads which came too late). */
+        std::vector<MarkerEvent> m_marker_events;
+
+        std::atomic<unsigned> m_events_written;
+
+        std::atomic<unsigned> m_events_read;
+
+        /** Only used by the writing threads: number of recorded markers not
+         *  popped yet, the ring buffer keeps space for their pops. */
+        unsigned m_open_markers;
+
+        /** Only used by the thread itself: ids of the names used with
+         *  PROFILER_PUSH_CPU_MARKER_DYNAMIC. */
+        std::map<std::string, int> m_dynamic_event_ids;
+
         /** Stack of events to detect nesting. */
-        std::vector< std::string > m_event_stack;
+        std::vector<int> m_event_stack;
 
-        /** This stores the event names in the order in which they occur.
+        /** This stores the event ids in the order in which they occur.
         *  This means that 'outer' events occur here before any child
         *  events. This list is then used to determine the order in which the
         *  bar graphs are drawn, which results in the proper nesting of events.*/
-        std::vector<std::string> m_ordered_headings;
+        std::vector<int> m_ordered_headings;
 
         AllEventData m_all_event_data;
+
+        /** Name of the thread shown in traces, set by setThreadName. */
+        std::string m_name;
+
+        /** If the name of this thread was written to the current trace. */
+        bool m_trace_named;
+
+        ThreadData() : m_events_written(0), m_events_read(0),
+                       m_open_markers(0), m_trace_named(false) {}
+        // --------------------------------------------------------------------
+        bool addMarkerEvent(int event_id, double time, unsigned reserved);
     };   // class ThreadData
 
     // ========================================================================
+    /** Name and colour of an interned event. */
+    struct EventInfo
+    {
+        std::string   m_name;
+        video::SColor m_colour;
+    };   // EventInfo
+
+    /** All interned events, the index is the event id. */
+    std::vector<EventInfo> m_all_event_info;
+
+    /** Maps event names to their id. */
+    std::map<std::string, int> m_event_ids;
+
+    /** Protects m_all_event_info and m_event_ids, only used when a new name
+     *  is interned and when the data is displayed or saved. */
+    std::mutex m_event_info_mutex;
 
     /** Data structure containing all currently buffered markers. The index
      *  is the thread id. */
-    std::vector< ThreadData> m_all_threads_data;
+    std::vector<std::unique_ptr<ThreadData> > m_all_threads_data;
 
     /** Buffer for the GPU times (in ms). */
     std::vector<int> m_gpu_times;
@@ -232,13 +297,15 @@ private:
     /** Counts the threads used. */
     std::atomic<int> m_threads_used;
 
+    /** Held while writing to the slot shared by the threads which found
+     *  all other slots used. */
+    std::mutex m_shared_thread_mutex;
+
     /** Index of the current frame in the buffer. */
     int m_current_frame;
 
-    /** We don't need the bool, but easiest way to get a lock for the whole
-     *  instance (since we need to avoid that a synch is done which changes
-     *  the current frame while another threaded uses this variable, or
-     *  while a new thread is added. */
+    /** Lock for the buffered markers, which are only changed in
+     *  synchronizeFrame. Threads adding markers never take it. */
     Synchronised<bool> m_lock;
 
     /** True if the circular buffer has wrapped around. */
@@ -271,14 +338,41 @@ private:
 
     FreezeState     m_freeze_state;
 
+    /** True between startTrace and stopTrace. Markers are recorded while
+     *  tracing even if the profiler is disabled. */
+    std::atomic<bool> m_tracing;
+
+    /** File of the trace requested by startTrace, it's opened and closed
+     *  in synchronizeFrame. */
+    std::string m_trace_path;
+
+    /** The Chrome trace event file (JSON array of events), or NULL. */
+    FILE* m_trace_file;
+
+    /** Time of the beginning of the trace, timestamps are relative to it. */
+    double m_trace_start_time;
+
+    /** If no event was written to the trace file yet (for the commas). */
+    bool m_trace_first_event;
+
 private:
     int  getThreadID();
+    int  getNumThreads() const;
+    bool isRecording() const;
+    void processMarkerEvents(ThreadData& td, int thread_id, double now);
+    void openTrace();
+    void closeTrace(double now);
+    void writeTraceEvent(char phase, int event_id, int thread_id,
+                         double time);
+    void writeTraceThreadName(ThreadData& td, int thread_id);
     void drawBackground();
 
 public:
              Profiler();
     virtual ~Profiler();
     void     init();
+    int      getEventID(const char* name, const video::SColor& color);
+    void     pushCPUMarker(int event_id);
     void     pushCPUMarker(const char* name="N/A",
                            const video::SColor& color=video::SColor());
     void     popCPUMarker();
@@ -287,6 +381,9 @@ public:
     void     draw();
     void     onClick(const core::vector2di& mouse_pos);
     void     writeToFile();
+    void     setThreadName(const char* name);
+    bool     startTrace(const std::string& path);
+    bool     stopTrace();
 
     // ------------------------------------------------------------------------
     bool isFrozen() const { return m_freeze_state == FROZEN; }